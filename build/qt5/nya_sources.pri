@@ -32,13 +32,19 @@ SOURCES += \
     $${NYA_ENGINE_PATH}/math/matrix.cpp \
     $${NYA_ENGINE_PATH}/math/quadtree.cpp \
     $${NYA_ENGINE_PATH}/math/quaternion.cpp \
+    $${NYA_ENGINE_PATH}/math/rect_packer.cpp \
     $${NYA_ENGINE_PATH}/memory/memory.cpp \
     $${NYA_ENGINE_PATH}/memory/mutex.cpp \
+    $${NYA_ENGINE_PATH}/memory/thread_pool.cpp \
     $${NYA_ENGINE_PATH}/memory/tmp_buffer.cpp \
     $${NYA_ENGINE_PATH}/render/animation.cpp \
     $${NYA_ENGINE_PATH}/render/bitmap.cpp \
+    $${NYA_ENGINE_PATH}/render/bitmap_compress.cpp \
+    $${NYA_ENGINE_PATH}/render/bitmap_mipmap.cpp \
+    $${NYA_ENGINE_PATH}/render/bitmap_simd.cpp \
     $${NYA_ENGINE_PATH}/render/debug_draw.cpp \
     $${NYA_ENGINE_PATH}/render/fbo.cpp \
+    $${NYA_ENGINE_PATH}/render/mesh_optimize.cpp \
     $${NYA_ENGINE_PATH}/render/render.cpp \
     $${NYA_ENGINE_PATH}/render/shader.cpp \
     $${NYA_ENGINE_PATH}/render/shader_code_parser.cpp \
@@ -47,12 +53,16 @@ SOURCES += \
     $${NYA_ENGINE_PATH}/render/texture.cpp \
     $${NYA_ENGINE_PATH}/render/transform.cpp \
     $${NYA_ENGINE_PATH}/render/vbo.cpp \
+    $${NYA_ENGINE_PATH}/render/vertex_compress.cpp \
     $${NYA_ENGINE_PATH}/resources/composite_resources_provider.cpp \
     $${NYA_ENGINE_PATH}/resources/file_resources_provider.cpp \
     $${NYA_ENGINE_PATH}/resources/memory_resources_provider.cpp \
     $${NYA_ENGINE_PATH}/resources/resources.cpp \
     $${NYA_ENGINE_PATH}/scene/animation.cpp \
     $${NYA_ENGINE_PATH}/scene/camera.cpp \
+    $${NYA_ENGINE_PATH}/scene/cpu_skinning.cpp \
+    $${NYA_ENGINE_PATH}/scene/hot_reload.cpp \
+    $${NYA_ENGINE_PATH}/scene/level_loader.cpp \
     $${NYA_ENGINE_PATH}/scene/location.cpp \
     $${NYA_ENGINE_PATH}/scene/material.cpp \
     $${NYA_ENGINE_PATH}/scene/mesh.cpp \
@@ -61,8 +71,11 @@ SOURCES += \
     $${NYA_ENGINE_PATH}/scene/particles.cpp \
     $${NYA_ENGINE_PATH}/scene/scene.cpp \
     $${NYA_ENGINE_PATH}/scene/shader.cpp \
+    $${NYA_ENGINE_PATH}/scene/shader_warmup.cpp \
     $${NYA_ENGINE_PATH}/scene/texture.cpp \
+    $${NYA_ENGINE_PATH}/scene/texture_atlas.cpp \
     $${NYA_ENGINE_PATH}/scene/transform.cpp \
+    $${NYA_ENGINE_PATH}/system/assets_cache_provider.cpp \
     $${NYA_ENGINE_PATH}/system/shaders_cache_provider.cpp \
     $${NYA_ENGINE_PATH}/system/system.cpp \
     $${NYA_ENGINE_PATH}/ui/list.cpp \
@@ -100,6 +113,7 @@ HEADERS += \
     $${NYA_ENGINE_PATH}/math/matrix.h \
     $${NYA_ENGINE_PATH}/math/quadtree.h \
     $${NYA_ENGINE_PATH}/math/quaternion.h \
+    $${NYA_ENGINE_PATH}/math/rect_packer.h \
     $${NYA_ENGINE_PATH}/math/scalar.h \
     $${NYA_ENGINE_PATH}/math/simd.h \
     $${NYA_ENGINE_PATH}/math/vector.h \
@@ -115,12 +129,15 @@ HEADERS += \
     $${NYA_ENGINE_PATH}/memory/pool.h \
     $${NYA_ENGINE_PATH}/memory/shared_ptr.h \
     $${NYA_ENGINE_PATH}/memory/tag_list.h \
+    $${NYA_ENGINE_PATH}/memory/thread_pool.h \
     $${NYA_ENGINE_PATH}/memory/tile_map.h \
     $${NYA_ENGINE_PATH}/memory/tmp_buffer.h \
     $${NYA_ENGINE_PATH}/render/animation.h \
     $${NYA_ENGINE_PATH}/render/bitmap.h \
+    $${NYA_ENGINE_PATH}/render/bitmap_simd.h \
     $${NYA_ENGINE_PATH}/render/debug_draw.h \
     $${NYA_ENGINE_PATH}/render/fbo.h \
+    $${NYA_ENGINE_PATH}/render/mesh_optimize.h \
     $${NYA_ENGINE_PATH}/render/render.h \
     $${NYA_ENGINE_PATH}/render/render_objects.h \
     $${NYA_ENGINE_PATH}/render/shader.h \
@@ -130,6 +147,7 @@ HEADERS += \
     $${NYA_ENGINE_PATH}/render/texture.h \
     $${NYA_ENGINE_PATH}/render/transform.h \
     $${NYA_ENGINE_PATH}/render/vbo.h \
+    $${NYA_ENGINE_PATH}/render/vertex_compress.h \
     $${NYA_ENGINE_PATH}/resources/composite_resources_provider.h \
     $${NYA_ENGINE_PATH}/resources/file_resources_provider.h \
     $${NYA_ENGINE_PATH}/resources/memory_resources_provider.h \
@@ -137,6 +155,9 @@ HEADERS += \
     $${NYA_ENGINE_PATH}/resources/shared_resources.h \
     $${NYA_ENGINE_PATH}/scene/animation.h \
     $${NYA_ENGINE_PATH}/scene/camera.h \
+    $${NYA_ENGINE_PATH}/scene/cpu_skinning.h \
+    $${NYA_ENGINE_PATH}/scene/hot_reload.h \
+    $${NYA_ENGINE_PATH}/scene/level_loader.h \
     $${NYA_ENGINE_PATH}/scene/location.h \
     $${NYA_ENGINE_PATH}/scene/material.h \
     $${NYA_ENGINE_PATH}/scene/mesh.h \
@@ -146,11 +167,14 @@ HEADERS += \
     $${NYA_ENGINE_PATH}/scene/proxy.h \
     $${NYA_ENGINE_PATH}/scene/scene.h \
     $${NYA_ENGINE_PATH}/scene/shader.h \
+    $${NYA_ENGINE_PATH}/scene/shader_warmup.h \
     $${NYA_ENGINE_PATH}/scene/shared_resources.h \
     $${NYA_ENGINE_PATH}/scene/tags.h \
     $${NYA_ENGINE_PATH}/scene/texture.h \
+    $${NYA_ENGINE_PATH}/scene/texture_atlas.h \
     $${NYA_ENGINE_PATH}/scene/transform.h \
     $${NYA_ENGINE_PATH}/system/app.h \
+    $${NYA_ENGINE_PATH}/system/assets_cache_provider.h \
     $${NYA_ENGINE_PATH}/system/button_codes.h \
     $${NYA_ENGINE_PATH}/system/shaders_cache_provider.h \
     $${NYA_ENGINE_PATH}/system/system.h \
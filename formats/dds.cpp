@@ -2,6 +2,7 @@
 
 #include "dds.h"
 #include "memory/memory_reader.h"
+#include "memory/memory_writer.h"
 #include "memory/tmp_buffer.h"
 #include "resources/resources.h"
 #include <stdint.h>
@@ -505,7 +506,90 @@ size_t dds::get_mip_size(int mip_idx) const
     if(pf<=dxt5)
         return (w1>4?w1:4)/4 * (h1>4?h1:4)/4 * (pf==dxt1?8:16) * (type==texture_cube?6:1);
 
-    return (w1>1?w1:1) * (h1>1?h1:1) * (pf==bgra?4:(pf==bgr?3:1)) * (type==texture_cube?6:1);
+    return (w1>1?w1:1) * (h1>1?h1:1) * ((pf==bgra || pf==rgba)?4:((pf==bgr || pf==rgb)?3:1)) * (type==texture_cube?6:1);
+}
+
+size_t dds::encode_header(void *to_data,size_t to_size) const
+{
+    if(!to_data || to_size<dds_header_size || !width || !height)
+        return 0;
+
+    typedef uint32_t uint;
+
+    const uint dds_caps=0x1,dds_height=0x2,dds_width=0x4,dds_pitch=0x8;
+    const uint dds_pixelformat=0x1000,dds_mipmapcount=0x20000,dds_linearsize=0x80000;
+    const uint dds_alpha=0x1,dds_fourcc=0x4,dds_rgb=0x40,dds_luminance=0x20000;
+    const uint dds_complex=0x8,dds_texture=0x1000,dds_mipmap=0x400000;
+    const uint dds_cubemap=0x200,dds_cubemap_faces=0xfc00;
+
+    const bool compressed=pf<=dxt5;
+    const bool has_mips=mipmap_count>1;
+
+    dds_pixel_format format;
+    memset(&format,0,sizeof(format));
+    format.size=sizeof(format);
+
+    uint pitch=0;
+    switch(pf)
+    {
+        case dxt1: format.four_cc=0x31545844; break;
+        case dxt2: format.four_cc=0x32545844; break;
+        case dxt3: format.four_cc=0x33545844; break;
+        case dxt4: format.four_cc=0x34545844; break;
+        case dxt5: format.four_cc=0x35545844; break;
+
+        case rgba:
+        case bgra:
+            format.flags=dds_rgb|dds_alpha;
+            format.bpp=32;
+            format.bit_mask[0]=pf==rgba?0xff:0xff0000;
+            format.bit_mask[1]=0xff00;
+            format.bit_mask[2]=pf==rgba?0xff0000:0xff;
+            format.bit_mask[3]=0xff000000;
+            break;
+
+        case rgb:
+        case bgr:
+            format.flags=dds_rgb;
+            format.bpp=24;
+            format.bit_mask[0]=pf==rgb?0xff:0xff0000;
+            format.bit_mask[1]=0xff00;
+            format.bit_mask[2]=pf==rgb?0xff0000:0xff;
+            break;
+
+        case greyscale:
+            format.flags=dds_luminance;
+            format.bpp=8;
+            format.bit_mask[0]=0xff;
+            break;
+
+        default: return 0;
+    }
+
+    if(compressed)
+    {
+        format.flags=dds_fourcc;
+        pitch=(width>4?width:4)/4 * (height>4?height:4)/4 * (pf==dxt1?8:16);
+    }
+    else
+        pitch=width*format.bpp/8;
+
+    memset(to_data,0,dds_header_size);
+    nya_memory::memory_writer writer(to_data,to_size);
+    writer.write("DDS ",4);
+    writer.write_uint(124);
+    writer.write_uint(dds_caps|dds_height|dds_width|dds_pixelformat|(has_mips?dds_mipmapcount:0)|(compressed?dds_linearsize:dds_pitch));
+    writer.write_uint(height);
+    writer.write_uint(width);
+    writer.write_uint(pitch);
+    writer.write_uint(0); //depth
+    writer.write_uint(mipmap_count);
+    writer.seek(writer.get_offset()+44);
+    writer.write(format);
+    writer.write_uint(dds_texture|(has_mips || type==texture_cube?dds_complex:0)|(has_mips?dds_mipmap:0));
+    writer.write_uint(type==texture_cube?dds_cubemap|dds_cubemap_faces:0);
+
+    return dds_header_size;
 }
 
 }
@@ -55,6 +55,12 @@ public:
     size_t get_decoded_size() const;
     void decode_palette8_rgba(void *decoded_data) const; //width*height*4 to_data buf required
     void decode_dxt(void *decoded_data) const; //decoded_data must be allocated with get_decoded_size()
+
+public:
+    size_t encode_header(void *to_data,size_t to_size=dds_header_size) const; //palette formats are not supported
+
+public:
+    const static size_t dds_header_size=128;
 };
 
 }
@@ -2,6 +2,7 @@
 
 #include "ktx.h"
 #include "memory/memory_reader.h"
+#include "memory/memory_writer.h"
 #include "resources/resources.h"
 #include <stdint.h>
 
@@ -114,4 +115,51 @@ size_t ktx::decode_header(const void *data,size_t size)
     return reader.get_offset();
 }
 
+size_t ktx::encode_header(void *to_data,size_t to_size) const
+{
+    if(!to_data || to_size<ktx_header_size || !width || !height)
+        return 0;
+
+    ktx_header header;
+    memset(&header,0,sizeof(header));
+    header.endianess=0x04030201;
+    header.width=width;
+    header.height=height;
+    header.faces_count=1;
+    header.mipmap_count=mipmap_count>0?mipmap_count:1;
+
+    switch(pf)
+    {
+        case rgb: header.gl_format=header.gl_base_internal_format=0x1907,header.gl_internal_format=0x8051; break;
+        case rgba: header.gl_format=header.gl_base_internal_format=0x1908,header.gl_internal_format=0x8058; break;
+        case bgra: header.gl_format=0x80E1,header.gl_base_internal_format=0x1908,header.gl_internal_format=0x8058; break;
+
+        case etc1: header.gl_internal_format=0x8D64; break;
+        case etc2: header.gl_internal_format=0x9274; break;
+        case etc2_eac: header.gl_internal_format=0x9278; break;
+        case etc2_a1: header.gl_internal_format=0x9276; break;
+
+        case pvr_rgb2b: header.gl_internal_format=0x8c01; break;
+        case pvr_rgb4b: header.gl_internal_format=0x8c00; break;
+        case pvr_rgba2b: header.gl_internal_format=0x8c03; break;
+        case pvr_rgba4b: header.gl_internal_format=0x8c02; break;
+    }
+
+    if(pf<etc1)
+    {
+        header.gl_type=0x1401; //unsigned byte
+        header.gl_type_size=1;
+    }
+    else
+    {
+        header.gl_type_size=1;
+        header.gl_base_internal_format=(pf==etc1 || pf==etc2 || pf==pvr_rgb2b || pf==pvr_rgb4b)?0x1907:0x1908;
+    }
+
+    nya_memory::memory_writer writer(to_data,to_size);
+    writer.write("\xABKTX 11\xBB\r\n\x1A\n",12);
+    writer.write(header);
+    return writer.get_offset();
+}
+
 }
@@ -40,6 +40,13 @@ struct ktx
 
 public:
     size_t decode_header(const void *data,size_t size); //0 if invalid
+
+public:
+    //each mip should follow with its uint32 size prefix, uncompressed rows and mips are padded to 4 bytes
+    size_t encode_header(void *to_data,size_t to_size=ktx_header_size) const;
+
+public:
+    const static size_t ktx_header_size=64;
 };
 
 }
@@ -3,6 +3,8 @@
 #include "math_expr_parser.h"
 #include "math/scalar.h"
 #include "math/constants.h"
+#include "memory/memory_reader.h"
+#include "memory/memory_writer.h"
 #include <sstream>
 #include <stack>
 #include <time.h>
@@ -240,6 +242,31 @@ inline size_t check_func_var_const(const char *name,bool &is_func,bool &is_var,b
     return i;
 }
 
+namespace
+{
+    void init_rand() { struct init { init() { srand((unsigned int)time(NULL)),rand(); } } static once; }
+
+    const char compiled_sign[]={'n','m','e','c'};
+    const uint32_t compiled_version=1; //increase when ops or the compiled layout change
+
+    //fnv-1a, keys are only compared on the same platform
+    void hash_append(uint64_t &h,const void *data,size_t size)
+    {
+        for(const unsigned char *c=(const unsigned char *)data;size>0;++c,--size)
+        {
+            h^=*c;
+            h*=1099511628211ULL;
+        }
+    }
+
+    void hash_append(uint64_t &h,const std::string &s)
+    {
+        const uint32_t size=uint32_t(s.size());
+        hash_append(h,&size,sizeof(size));
+        hash_append(h,s.data(),s.size());
+    }
+}
+
 bool math_expr_parser::parse(const char *expr)
 {
     set_constant("pi",nya_math::constants::pi);
@@ -250,7 +277,7 @@ bool math_expr_parser::parse(const char *expr)
     if(!expr)
         return false;
 
-    struct init_rand { init_rand() { srand((unsigned int)time(NULL)),rand(); } } static once;
+    init_rand();
 
     std::vector<op_struct> ops;
     for(const char *c=expr;*c;++c)
@@ -764,4 +791,159 @@ void math_expr_parser::set_function(const char *name,int args_count,int return_c
     m_functions.back().f=f;
 }
 
+uint64_t math_expr_parser::get_compiled_key(const char *expr) const
+{
+    uint64_t h=14695981039346656037ULL;
+    hash_append(h,compiled_sign,sizeof(compiled_sign));
+    hash_append(h,&compiled_version,sizeof(compiled_version));
+    hash_append(h,std::string(expr?expr:""));
+
+    for(size_t i=0;i<m_functions.size();++i)
+    {
+        hash_append(h,m_functions[i].name);
+        hash_append(h,&m_functions[i].args_count,sizeof(m_functions[i].args_count));
+        hash_append(h,&m_functions[i].return_count,sizeof(m_functions[i].return_count));
+    }
+
+    const uint32_t constants_count=uint32_t(m_constants.size());
+    hash_append(h,&constants_count,sizeof(constants_count));
+    for(size_t i=0;i<m_constants.size();++i)
+    {
+        hash_append(h,m_constants[i].first);
+        hash_append(h,&m_constants[i].second,sizeof(m_constants[i].second));
+    }
+
+    for(size_t i=0;i<m_var_names.size();++i)
+        hash_append(h,m_var_names[i]);
+
+    return h;
+}
+
+size_t math_expr_parser::write_compiled(void *to_data,size_t to_size) const
+{
+    nya_memory::memory_writer w(to_data,to_size);
+    w.write(compiled_sign,sizeof(compiled_sign));
+    w.write_uint(compiled_version);
+    w.write_float(m_stack.get_constant());
+    w.write_int(m_stack.get_size());
+    w.write_uint((unsigned int)m_ops.size());
+    if(!m_ops.empty())
+        w.write(&m_ops[0],m_ops.size()*sizeof(m_ops[0]));
+
+    w.write_uint((unsigned int)m_var_names.size());
+    for(size_t i=0;i<m_var_names.size();++i)
+    {
+        w.write_uint((unsigned int)m_var_names[i].size());
+        if(!m_var_names[i].empty())
+            w.write(m_var_names[i].data(),m_var_names[i].size());
+    }
+
+    return to_data && w.get_offset()<w.get_size()?0:w.get_offset();
+}
+
+bool math_expr_parser::load_compiled(const void *data,size_t size)
+{
+    set_constant("pi",nya_math::constants::pi);
+    init_rand();
+
+    m_ops.clear();
+    m_ops_count=0;
+    m_stack.set_constant(0.0f);
+
+    nya_memory::memory_reader r(data,size);
+    if(!r.test(compiled_sign,sizeof(compiled_sign)) || r.read<uint32_t>()!=compiled_version)
+        return false;
+
+    const float constant=r.read<float>();
+    const int stack_size=r.read<int>();
+    const uint32_t ops_count=r.read<uint32_t>();
+    if(stack_size<0 || stack_size>64*1024 || !r.check_remained(size_t(ops_count)*sizeof(int)))
+        return false;
+
+    std::vector<int> ops(ops_count);
+    if(ops_count)
+        memcpy(&ops[0],r.get_data(),ops_count*sizeof(int));
+    r.skip(ops_count*sizeof(int));
+
+    const uint32_t vars_count=r.read<uint32_t>();
+    if(!r.check_remained(size_t(vars_count)*sizeof(uint32_t)))
+        return false;
+
+    std::vector<std::string> names(vars_count);
+    for(uint32_t i=0;i<vars_count;++i)
+    {
+        const uint32_t len=r.read<uint32_t>();
+        if(!r.check_remained(len))
+            return false;
+
+        if(len)
+            names[i].assign((const char *)r.get_data(),len);
+        r.skip(len);
+    }
+
+    if(r.get_remained())
+        return false;
+
+    for(size_t i=0;i<m_var_names.size();++i)
+    {
+        if(i>=names.size() || names[i]!=m_var_names[i])
+            return false;
+    }
+
+    //operands should be in range, as they are used as indices
+    for(size_t i=0;i<ops.size();++i)
+    {
+        switch(ops[i])
+        {
+            case read_const:
+            case op_func:
+                if(++i>=ops.size())
+                    return false;
+                break;
+
+            case read_var:
+                if(++i>=ops.size() || ops[i]<0 || ops[i]>=(int)names.size())
+                    return false;
+                break;
+
+            case op_user_func:
+                if(++i>=ops.size() || ops[i]<0 || ops[i]>=(int)m_functions.size())
+                    return false;
+                break;
+
+            default:
+                if(ops[i]<op_sub || ops[i]>op_user_func)
+                    return false;
+                break;
+        }
+    }
+
+    const size_t prev_vars_count=m_var_names.size();
+    for(size_t i=m_var_names.size();i<names.size();++i)
+        add_var(names[i].c_str());
+
+    m_ops.swap(ops);
+    if(m_ops.empty())
+    {
+        m_stack.set_constant(constant);
+        return true;
+    }
+
+    m_ops_count=(int)m_ops.size();
+
+    stack_validator v(m_ops);
+    calculate(v);
+    if(!v.is_valid() || v.get_size()>stack_size)
+    {
+        m_ops.clear();
+        m_ops_count=0;
+        m_vars.resize(prev_vars_count);
+        m_var_names.resize(prev_vars_count);
+        return false;
+    }
+
+    m_stack.set_size(stack_size);
+    return true;
+}
+
 }
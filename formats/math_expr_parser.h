@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <string>
+#include <stdint.h>
 #include "math/vector.h"
 
 namespace nya_formats
@@ -19,6 +20,14 @@ public:
 public:
     bool parse(const char *expr);
 
+public:
+    //compiled program for caching, see nya_scene::compiled_assets_provider
+    //the key covers the expression, functions, constants and vars set before parse, as the program depends on them
+    uint64_t get_compiled_key(const char *expr) const;
+    size_t get_compiled_size() const { return write_compiled(0,0); }
+    size_t write_compiled(void *to_data,size_t to_size) const;
+    bool load_compiled(const void *data,size_t size);
+
 public:
     int get_var_idx(const char *name) const;
     int get_vars_count() const;
@@ -108,6 +117,8 @@ private:
         //m_buf[0] is reserved for constant state
         void set_size(int size) { m_buf.resize(size+1,0.0f); m_pos=0; }
         void set_constant(float value) { m_buf.resize(1); m_buf[0]=value; m_pos=0; }
+        float get_constant() const { return m_buf[0]; }
+        int get_size() const { return (int)m_buf.size()-1; }
 
     public:
         stack() { set_constant(0.0f); }
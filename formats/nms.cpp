@@ -7,7 +7,50 @@
 #include <stdio.h>
 #include <stdint.h>
 
-namespace { const char nms_sign[]={'n','y','a',' ','m','e','s','h'}; }
+namespace
+{
+    const char nms_sign[]={'n','y','a',' ','m','e','s','h'};
+
+    bool write_padding(nya_memory::memory_writer &writer,size_t size)
+    {
+        static const char zeros[nya_formats::nms::data_alignment]={0};
+        return !size || (size<=sizeof(zeros) && writer.write(zeros,size));
+    }
+
+    size_t align(size_t offset) { return (offset+nya_formats::nms::data_alignment-1)/nya_formats::nms::data_alignment*nya_formats::nms::data_alignment; }
+
+    //count records of item_size at offset are inside of size
+    bool check_range(size_t offset,size_t count,size_t item_size,size_t size)
+    {
+        return offset<=size && (!item_size || count<=(size-offset)/item_size);
+    }
+
+    unsigned int get_type_size(nya_formats::nms_mesh_chunk::vertex_atrib_type type)
+    {
+        switch(type)
+        {
+            case nya_formats::nms_mesh_chunk::float16: return 2;
+            case nya_formats::nms_mesh_chunk::float32: return 4;
+            case nya_formats::nms_mesh_chunk::uint8: return 1;
+            case nya_formats::nms_mesh_chunk::uint16: return 2;
+        }
+
+        return 0;
+    }
+
+    struct string_table
+    {
+        std::string data;
+
+        unsigned int add(const std::string &s)
+        {
+            const unsigned int offset=(unsigned int)data.size();
+            data.append(s);
+            data.push_back(0);
+            return offset;
+        }
+    };
+}
 
 namespace nya_formats
 {
@@ -31,6 +74,15 @@ bool nms::read_chunks_info(const void *data,size_t size)
     for(size_t i=0;i<chunks.size();++i)
     {
         cdata+=read_chunk_info(chunks[i],cdata,data_end-cdata);
+        const size_t padding=get_chunk_padding(cdata-(const char *)data,version);
+        if(padding>size_t(data_end-cdata))
+        {
+            *this=nms();
+            return false;
+        }
+
+        cdata+=padding;
+        chunks[i].data=cdata;
         cdata+=chunks[i].size;
         if(cdata>data_end)
         {
@@ -79,7 +131,10 @@ size_t nms::get_nms_size()
 {
     size_t size=nms_header_size;
     for(size_t i=0;i<chunks.size();++i)
-        size+=get_chunk_write_size(chunks[i].size);
+    {
+        size+=get_chunk_write_size(0);
+        size+=get_chunk_padding(size,version)+chunks[i].size;
+    }
 
     return size;
 }
@@ -100,7 +155,25 @@ size_t nms::write_to_buf(void *data,size_t size)
         return 0;
 
     for(size_t i=0;i<chunks.size();++i)
-        cdata+=write_chunk_to_buf(chunks[i],cdata,data_end-cdata);
+    {
+        const size_t padding=get_chunk_padding(cdata-(char *)data+get_chunk_write_size(0),version);
+        if(!padding)
+        {
+            cdata+=write_chunk_to_buf(chunks[i],cdata,data_end-cdata);
+            continue;
+        }
+
+        const chunk_info &c=chunks[i];
+        if(size_t(data_end-cdata)<get_chunk_write_size(c.size)+padding || (c.size && !c.data))
+            return 0;
+
+        nya_memory::memory_writer writer(cdata,data_end-cdata);
+        writer.write_uint(c.type);
+        writer.write_uint(c.size);
+        write_padding(writer,padding);
+        writer.write(c.data,c.size);
+        cdata+=writer.get_offset();
+    }
 
     return cdata-(char *)data;
 }
@@ -120,6 +193,11 @@ size_t nms::write_header_to_buf(const header &h,void *to_data,size_t to_size)
 
 size_t nms::get_chunk_write_size(size_t chunk_data_size) { return chunk_data_size+sizeof(uint32_t)*2; }
 
+size_t nms::get_chunk_padding(size_t chunk_data_offset,unsigned int version)
+{
+    return version>=3?align(chunk_data_offset)-chunk_data_offset:0;
+}
+
 size_t nms::write_chunk_to_buf(const chunk_info &chunk,void *to_data,size_t to_size)
 {
     if(!to_data || to_size<get_chunk_write_size(chunk.size))
@@ -138,6 +216,189 @@ size_t nms::write_chunk_to_buf(const chunk_info &chunk,void *to_data,size_t to_s
     return writer.get_offset();
 }
 
+namespace
+{
+
+size_t read_mesh_v3(nms_mesh_chunk &c,const void *data,size_t size)
+{
+    nms_v3::mesh_header h;
+    if(size<sizeof(h))
+        return 0;
+
+    memcpy(&h,data,sizeof(h));
+    const char *cdata=(const char *)data;
+
+    if(!check_range(h.strings_offset,h.strings_size,1,size) || !h.vertex_stride ||
+       !check_range(h.elements_offset,h.elements_count,sizeof(nms_v3::mesh_element),size) ||
+       !check_range(h.vertices_offset,h.verts_count,h.vertex_stride,size) ||
+       !check_range(h.lods_offset,h.lods_count,sizeof(nms_v3::mesh_lod),size))
+        return 0;
+
+    c.aabb_min.set(h.aabb_min[0],h.aabb_min[1],h.aabb_min[2]);
+    c.aabb_max.set(h.aabb_max[0],h.aabb_max[1],h.aabb_max[2]);
+
+    c.elements.resize(h.elements_count);
+    for(size_t i=0;i<c.elements.size();++i)
+    {
+        nms_v3::mesh_element from;
+        memcpy(&from,cdata+h.elements_offset+i*sizeof(from),sizeof(from));
+        nms_mesh_chunk::element &to=c.elements[i];
+        to.type=from.type;
+        to.dimension=from.dimension;
+        to.offset=from.offset;
+        to.data_type=nms_mesh_chunk::vertex_atrib_type(from.data_type);
+        const unsigned int type_size=get_type_size(to.data_type);
+        const char *semantics=nms_v3::get_string(data,h.strings_offset,h.strings_size,from.semantics);
+        if(!type_size || !semantics || to.offset+to.dimension*type_size>h.vertex_stride)
+            return 0;
+
+        to.semantics=semantics;
+    }
+
+    c.vertex_stride=h.vertex_stride;
+    c.verts_count=h.verts_count;
+    c.vertices_data=cdata+h.vertices_offset;
+
+    switch(h.index_size)
+    {
+        case nms_mesh_chunk::no_indices: break;
+
+        case nms_mesh_chunk::index2b:
+        case nms_mesh_chunk::index4b:
+            if(!check_range(h.indices_offset,h.indices_count,h.index_size,size))
+                return 0;
+
+            c.index_size=nms_mesh_chunk::ind_size(h.index_size);
+            c.indices_count=h.indices_count;
+            c.indices_data=cdata+h.indices_offset;
+        break;
+
+        default: return 0;
+    }
+
+    c.lods.resize(h.lods_count);
+    for(size_t i=0;i<c.lods.size();++i)
+    {
+        nms_v3::mesh_lod l;
+        memcpy(&l,cdata+h.lods_offset+i*sizeof(l),sizeof(l));
+        if(!check_range(l.groups_offset,l.groups_count,sizeof(nms_v3::mesh_group),size))
+            return 0;
+
+        c.lods[i].groups.resize(l.groups_count);
+        for(size_t j=0;j<l.groups_count;++j)
+        {
+            nms_v3::mesh_group from;
+            memcpy(&from,cdata+l.groups_offset+j*sizeof(from),sizeof(from));
+            nms_mesh_chunk::group &to=c.lods[i].groups[j];
+            const char *name=nms_v3::get_string(data,h.strings_offset,h.strings_size,from.name);
+            if(!name)
+                return 0;
+
+            to.name=name;
+            to.aabb_min.set(from.aabb_min[0],from.aabb_min[1],from.aabb_min[2]);
+            to.aabb_max.set(from.aabb_max[0],from.aabb_max[1],from.aabb_max[2]);
+            to.material_idx=from.material_idx;
+            to.offset=from.offset;
+            to.count=from.count;
+            to.element_type=nms_mesh_chunk::draw_element_type(from.element_type);
+        }
+    }
+
+    return size;
+}
+
+size_t write_mesh_v3(const nms_mesh_chunk &c,void *to_data,size_t to_size)
+{
+    nms_v3::mesh_header h;
+    memset(&h,0,sizeof(h));
+    h.aabb_min[0]=c.aabb_min.x,h.aabb_min[1]=c.aabb_min.y,h.aabb_min[2]=c.aabb_min.z;
+    h.aabb_max[0]=c.aabb_max.x,h.aabb_max[1]=c.aabb_max.y,h.aabb_max[2]=c.aabb_max.z;
+
+    string_table strings;
+
+    std::vector<nms_v3::mesh_element> elements(c.elements.size());
+    for(size_t i=0;i<elements.size();++i)
+    {
+        const nms_mesh_chunk::element &from=c.elements[i];
+        nms_v3::mesh_element &to=elements[i];
+        to.type=(unsigned char)from.type;
+        to.dimension=(unsigned char)from.dimension;
+        to.data_type=(unsigned char)from.data_type;
+        to.reserved=0;
+        to.offset=from.offset;
+        to.semantics=strings.add(from.semantics);
+    }
+
+    std::vector<nms_v3::mesh_lod> lods(c.lods.size());
+    std::vector<nms_v3::mesh_group> groups;
+    size_t groups_offset=sizeof(h)+elements.size()*sizeof(nms_v3::mesh_element)+lods.size()*sizeof(nms_v3::mesh_lod);
+    for(size_t i=0;i<lods.size();++i)
+    {
+        lods[i].groups_count=(unsigned int)c.lods[i].groups.size();
+        lods[i].groups_offset=(unsigned int)(groups_offset+groups.size()*sizeof(nms_v3::mesh_group));
+        for(size_t j=0;j<c.lods[i].groups.size();++j)
+        {
+            const nms_mesh_chunk::group &from=c.lods[i].groups[j];
+            nms_v3::mesh_group to;
+            to.aabb_min[0]=from.aabb_min.x,to.aabb_min[1]=from.aabb_min.y,to.aabb_min[2]=from.aabb_min.z;
+            to.aabb_max[0]=from.aabb_max.x,to.aabb_max[1]=from.aabb_max.y,to.aabb_max[2]=from.aabb_max.z;
+            to.name=strings.add(from.name);
+            to.material_idx=from.material_idx;
+            to.offset=from.offset;
+            to.count=from.count;
+            to.element_type=from.element_type;
+            to.reserved=0;
+            groups.push_back(to);
+        }
+    }
+
+    h.elements_count=(unsigned int)elements.size();
+    h.elements_offset=sizeof(h);
+    h.lods_count=(unsigned int)lods.size();
+    h.lods_offset=(unsigned int)(h.elements_offset+elements.size()*sizeof(nms_v3::mesh_element));
+    h.strings_offset=(unsigned int)(groups_offset+groups.size()*sizeof(nms_v3::mesh_group));
+    h.strings_size=(unsigned int)strings.data.size();
+
+    h.vertex_stride=c.vertex_stride;
+    h.verts_count=c.verts_count;
+    h.vertices_offset=(unsigned int)align(h.strings_offset+h.strings_size);
+    size_t end=h.vertices_offset+size_t(c.verts_count)*c.vertex_stride;
+    if(c.index_size!=nms_mesh_chunk::no_indices)
+    {
+        h.index_size=c.index_size;
+        h.indices_count=c.indices_count;
+        h.indices_offset=(unsigned int)align(end);
+        end=h.indices_offset+size_t(c.indices_count)*c.index_size;
+    }
+
+    if(!to_data)
+        return end;
+
+    if(to_size<end)
+        return 0;
+
+    nya_memory::memory_writer writer(to_data,to_size);
+    writer.write(&h,sizeof(h));
+    if(!elements.empty())
+        writer.write(&elements[0],elements.size()*sizeof(elements[0]));
+    if(!lods.empty())
+        writer.write(&lods[0],lods.size()*sizeof(lods[0]));
+    if(!groups.empty())
+        writer.write(&groups[0],groups.size()*sizeof(groups[0]));
+    writer.write(strings.data.c_str(),strings.data.size());
+    write_padding(writer,h.vertices_offset-writer.get_offset());
+    writer.write(c.vertices_data,size_t(c.verts_count)*c.vertex_stride);
+    if(h.indices_offset)
+    {
+        write_padding(writer,h.indices_offset-writer.get_offset());
+        writer.write(c.indices_data,size_t(c.indices_count)*c.index_size);
+    }
+
+    return writer.get_offset();
+}
+
+}
+
 size_t nms_mesh_chunk::read_header(const void *data, size_t size, int version)
 {
     *this=nms_mesh_chunk();
@@ -145,6 +406,14 @@ size_t nms_mesh_chunk::read_header(const void *data, size_t size, int version)
     if(!data || !size)
         return 0;
 
+    if(version>=3)
+    {
+        const size_t result=read_mesh_v3(*this,data,size);
+        if(!result)
+            *this=nms_mesh_chunk();
+        return result;
+    }
+
     typedef uint32_t uint;
     typedef uint16_t ushort;
     typedef uint8_t uchar;
@@ -167,6 +436,8 @@ size_t nms_mesh_chunk::read_header(const void *data, size_t size, int version)
         {
             case float16: vertex_stride+=e.dimension*2; break;
             case float32: vertex_stride+=e.dimension*4; break;
+            case uint8: vertex_stride+=e.dimension; break;
+            case uint16: vertex_stride+=e.dimension*2; break;
             default:
                 *this=nms_mesh_chunk();
                 return 0;
@@ -244,8 +515,11 @@ size_t nms_mesh_chunk::read_header(const void *data, size_t size, int version)
     return reader.get_offset();
 }
 
-size_t nms_mesh_chunk::write_to_buf(void *to_data,size_t to_size) const
+size_t nms_mesh_chunk::write_to_buf(void *to_data,size_t to_size,unsigned int version) const
 {
+    if(version>=3)
+        return write_mesh_v3(*this,to_data,to_size);
+
     nya_memory::memory_writer writer(to_data,to_size);
 
     writer.write(aabb_min);
@@ -486,6 +760,39 @@ bool nms_skeleton_chunk::read(const void *data,size_t size,int version)
     if(!data || !size)
         return false;
 
+    if(version>=3)
+    {
+        nms_v3::skeleton_header h;
+        if(size<sizeof(h))
+            return false;
+
+        memcpy(&h,data,sizeof(h));
+        if(!check_range(h.strings_offset,h.strings_size,1,size) ||
+           !check_range(h.bones_offset,h.bones_count,sizeof(nms_v3::skeleton_bone),size))
+            return false;
+
+        bones.resize(h.bones_count);
+        for(size_t i=0;i<bones.size();++i)
+        {
+            nms_v3::skeleton_bone from;
+            memcpy(&from,(const char *)data+h.bones_offset+i*sizeof(from),sizeof(from));
+            const char *name=nms_v3::get_string(data,h.strings_offset,h.strings_size,from.name);
+            if(!name)
+            {
+                *this=nms_skeleton_chunk();
+                return false;
+            }
+
+            bone &to=bones[i];
+            to.name=name;
+            to.rot=nya_math::quat(from.rot[0],from.rot[1],from.rot[2],from.rot[3]);
+            to.pos.set(from.pos[0],from.pos[1],from.pos[2]);
+            to.parent=from.parent;
+        }
+
+        return true;
+    }
+
     nya_memory::memory_reader reader(data,size);
 
     bones.resize(reader.read<int32_t>());
@@ -501,9 +808,35 @@ bool nms_skeleton_chunk::read(const void *data,size_t size,int version)
     return true;
 }
 
-size_t nms_skeleton_chunk::write_to_buf(void *to_data,size_t to_size) const
+size_t nms_skeleton_chunk::write_to_buf(void *to_data,size_t to_size,unsigned int version) const
 {
     nya_memory::memory_writer writer(to_data,to_size);
+    if(version>=3)
+    {
+        string_table strings;
+        std::vector<nms_v3::skeleton_bone> to(bones.size());
+        for(size_t i=0;i<bones.size();++i)
+        {
+            const bone &from=bones[i];
+            to[i].rot[0]=from.rot.v.x,to[i].rot[1]=from.rot.v.y,to[i].rot[2]=from.rot.v.z,to[i].rot[3]=from.rot.w;
+            to[i].pos[0]=from.pos.x,to[i].pos[1]=from.pos.y,to[i].pos[2]=from.pos.z;
+            to[i].parent=from.parent;
+            to[i].name=strings.add(from.name);
+        }
+
+        nms_v3::skeleton_header h;
+        h.bones_count=(unsigned int)to.size();
+        h.bones_offset=sizeof(h);
+        h.strings_offset=(unsigned int)(h.bones_offset+to.size()*sizeof(nms_v3::skeleton_bone));
+        h.strings_size=(unsigned int)strings.data.size();
+
+        writer.write(&h,sizeof(h));
+        if(!to.empty())
+            writer.write(&to[0],to.size()*sizeof(to[0]));
+        writer.write(strings.data.c_str(),strings.data.size());
+        return writer.get_offset();
+    }
+
     writer.write_uint((unsigned int)bones.size());
     for(size_t i=0;i<bones.size();++i)
     {
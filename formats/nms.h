@@ -5,6 +5,7 @@
 #include <vector>
 #include <string>
 #include <stddef.h>
+#include <string.h>
 #include "math/vector.h"
 #include "math/quaternion.h"
 
@@ -63,9 +64,78 @@ public:
     static size_t get_chunk_write_size(size_t chunk_data_size);
     static size_t write_chunk_to_buf(const chunk_info &chunk,void *to_data,size_t to_size); //to_size=get_chunk_size()
 
+    //since version 3 chunk data starts at 16 bytes aligned file offset
+    static size_t get_chunk_padding(size_t chunk_data_offset,unsigned int version);
+
 public:
     const static size_t nms_header_size=16;
-    const static unsigned int latest_version=2;
+    const static unsigned int latest_version=3;
+    const static size_t data_alignment=16;
+};
+
+//version 3 chunks are fixed size records with a string table, so they could be read in place from a mapped file
+//nms_mesh_chunk::read_header points to vertex and index data in place, but still copies elements and groups with their strings
+//offsets are from the chunk data start, vertex and index data offsets are 16 bytes aligned
+//strings are zero-terminated, referenced by offset in the table
+struct nms_v3
+{
+    struct mesh_header
+    {
+        float aabb_min[3];
+        float aabb_max[3];
+        unsigned int elements_count,elements_offset;
+        unsigned int vertex_stride,verts_count,vertices_offset;
+        unsigned int index_size,indices_count,indices_offset;
+        unsigned int lods_count,lods_offset;
+        unsigned int strings_offset,strings_size;
+    };
+
+    struct mesh_element
+    {
+        unsigned char type,dimension,data_type,reserved;
+        unsigned int offset;
+        unsigned int semantics;
+    };
+
+    struct mesh_lod
+    {
+        unsigned int groups_count,groups_offset;
+    };
+
+    struct mesh_group
+    {
+        float aabb_min[3];
+        float aabb_max[3];
+        unsigned int name;
+        unsigned int material_idx;
+        unsigned int offset,count;
+        unsigned int element_type;
+        unsigned int reserved;
+    };
+
+    struct skeleton_header
+    {
+        unsigned int bones_count,bones_offset;
+        unsigned int strings_offset,strings_size;
+    };
+
+    struct skeleton_bone
+    {
+        float rot[4];
+        float pos[3];
+        int parent;
+        unsigned int name;
+    };
+
+    //returns 0 if out of the table
+    static const char *get_string(const void *chunk_data,unsigned int strings_offset,unsigned int strings_size,unsigned int offset)
+    {
+        if(offset>=strings_size)
+            return 0;
+
+        const char *table=(const char *)chunk_data+strings_offset;
+        return memchr(table+offset,0,strings_size-offset)?table+offset:0;
+    }
 };
 
 struct nms_mesh_chunk
@@ -82,7 +152,8 @@ struct nms_mesh_chunk
     {
         float16,
         float32,
-        uint8
+        uint8,
+        uint16
     };
 
     enum ind_size
@@ -149,8 +220,8 @@ public:
     size_t read_header(const void *data,size_t size,int version); //0 if invalid
 
 public:
-    size_t get_chunk_size() const { return write_to_buf(0,0); }
-    size_t write_to_buf(void *to_data,size_t to_size) const;
+    size_t get_chunk_size(unsigned int version=nms::latest_version) const { return write_to_buf(0,0,version); }
+    size_t write_to_buf(void *to_data,size_t to_size,unsigned int version=nms::latest_version) const;
 };
 
 struct nms_material_chunk
@@ -229,8 +300,8 @@ public:
     bool read(const void *data,size_t size,int version);
 
 public:
-    size_t get_chunk_size() const { return write_to_buf(0,0); }
-    size_t write_to_buf(void *to_data,size_t to_size) const;
+    size_t get_chunk_size(unsigned int version=nms::latest_version) const { return write_to_buf(0,0,version); }
+    size_t write_to_buf(void *to_data,size_t to_size,unsigned int version=nms::latest_version) const;
 };
 
 struct nms_general_chunk
@@ -4,11 +4,24 @@
 #include "log/log.h"
 #include "memory/invalid_object.h"
 #include "string_convert.h"
-
-#include <iostream>
-#include <sstream>
-#include <algorithm>
-#include <cstring>
+#include "memory/memory_reader.h"
+#include "memory/memory_writer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP>=2)
+    #define TEXT_PARSER_SSE2
+    #include <emmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined __ARM_NEON__ || defined __ARM_NEON
+    #define TEXT_PARSER_NEON
+    #include <arm_neon.h>
+#endif
 
 #ifdef _MSC_VER
     #define strcasecmp _stricmp
@@ -18,17 +31,149 @@ namespace
 {
     const char global_marker='@';
     const char *special_chars="=:";
+
+#if defined TEXT_PARSER_SSE2
+    inline unsigned int first_bit(unsigned int mask)
+    {
+    #ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx,mask);
+        return (unsigned int)idx;
+    #else
+        return (unsigned int)__builtin_ctz(mask);
+    #endif
+    }
+#endif
+
+    //index of the first a or b in [pos,size), size if none
+    size_t find_any(const char *text,size_t pos,size_t size,char a,char b)
+    {
+#if defined TEXT_PARSER_SSE2
+        const __m128i va=_mm_set1_epi8(a),vb=_mm_set1_epi8(b);
+        for(;pos+16<=size;pos+=16)
+        {
+            const __m128i v=_mm_loadu_si128((const __m128i *)(text+pos));
+            const unsigned int mask=(unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v,va),_mm_cmpeq_epi8(v,vb)));
+            if(mask)
+                return pos+first_bit(mask);
+        }
+#elif defined TEXT_PARSER_NEON
+        const uint8x16_t va=vdupq_n_u8((uint8_t)a),vb=vdupq_n_u8((uint8_t)b);
+        for(;pos+16<=size;pos+=16)
+        {
+            const uint8x16_t v=vld1q_u8((const uint8_t *)(text+pos));
+            const uint8x16_t eq=vorrq_u8(vceqq_u8(v,va),vceqq_u8(v,vb));
+            //4 bits per byte
+            const uint64_t mask=vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq),4)),0);
+            if(mask)
+                return pos+(size_t)(__builtin_ctzll(mask)>>2);
+        }
+#endif
+        for(;pos<size;++pos)
+        {
+            if(text[pos]==a || text[pos]==b)
+                return pos;
+        }
+
+        return size;
+    }
+
+    //index of the first two-char sequence in [pos,size), size if none
+    size_t find_pair(const char *text,size_t pos,size_t size,char a,char b)
+    {
+        while(pos+1<size)
+        {
+            const char *c=(const char *)memchr(text+pos,a,size-pos-1);
+            if(!c)
+                return size;
+
+            pos=c-text;
+            if(text[pos+1]==b)
+                return pos;
+
+            ++pos;
+        }
+
+        return size;
+    }
+
+    inline void remove_quotes(const char *&s,size_t &size)
+    {
+        if(size && s[0]=='"' && s[size-1]=='"')
+        {
+            ++s;
+            size=size>1?size-2:0;
+        }
+    }
+
+    const char compiled_sign[]={'n','t','p','c'};
+    const uint32_t compiled_version=1; //increase when parsing results or the compiled layout change
+
+    //fnv-1a over 8-byte words, keys are only compared on the same platform
+    void hash_append(uint64_t &h,const void *data,size_t size)
+    {
+        const char *c=(const char *)data;
+        for(;size>=sizeof(uint64_t);c+=sizeof(uint64_t),size-=sizeof(uint64_t))
+        {
+            uint64_t w;
+            memcpy(&w,c,sizeof(w));
+            h^=w;
+            h*=1099511628211ULL;
+            h^=h>>32;
+        }
+
+        for(;size>0;++c,--size)
+        {
+            h^=(unsigned char)*c;
+            h*=1099511628211ULL;
+        }
+    }
+
+    void write_str(nya_memory::memory_writer &w,const char *s,unsigned int size)
+    {
+        w.write_uint(size);
+        if(size)
+            w.write(s,size);
+    }
+
+    //every record takes at least 4 bytes, rejects counts that can't fit before allocating
+    bool read_count(nya_memory::memory_reader &r,uint32_t &count)
+    {
+        count=r.read<uint32_t>();
+        return r.check_remained(size_t(count)*sizeof(uint32_t));
+    }
 }
 
 namespace nya_formats
 {
 
+void text_parser::clear()
+{
+    m_strings.assign(1,0);
+    m_names.clear();
+    m_sections.clear();
+    m_subsections.clear();
+}
+
+text_parser::str text_parser::add_str(const char *s,size_t size)
+{
+    str result;
+    if(!size)
+        return result;
+
+    result.offset=(unsigned int)m_strings.size();
+    result.size=(unsigned int)size;
+    m_strings.insert(m_strings.end(),s,s+size);
+    m_strings.push_back(0);
+    return result;
+}
+
 const char *text_parser::get_section_type(int idx) const
 {
     if(idx<0 || idx>=(int)m_sections.size())
         return 0;
 
-    return m_sections[idx].type.c_str();
+    return get_str(m_sections[idx].type);
 }
 
 bool text_parser::is_section_type(int idx,const char *type) const
@@ -36,10 +181,11 @@ bool text_parser::is_section_type(int idx,const char *type) const
     if(!type || idx<0 || idx>=(int)m_sections.size())
         return false;
 
+    const char *s=get_str(m_sections[idx].type);
     if(type[0]=='@')
-        return m_sections[idx].type==type;
+        return strcmp(s,type)==0;
 
-    return m_sections[idx].type.compare(1,m_sections[idx].type.size()-1,type)==0;
+    return s[0] && strcmp(s+1,type)==0;
 }
 
 int text_parser::get_section_names_count(int idx) const
@@ -47,7 +193,7 @@ int text_parser::get_section_names_count(int idx) const
     if(idx < 0 || idx >= (int)m_sections.size())
         return 0;
 
-    return (int)m_sections[idx].names.size();
+    return (int)m_sections[idx].names_count;
 }
 
 const char *text_parser::get_section_name(int idx,int name_idx) const
@@ -55,10 +201,11 @@ const char *text_parser::get_section_name(int idx,int name_idx) const
     if(idx<0 || idx>=(int)m_sections.size())
         return 0;
 
-    if(name_idx<0 || name_idx>=(int)m_sections[idx].names.size())
+    const section &s=m_sections[idx];
+    if(name_idx<0 || name_idx>=(int)s.names_count)
         return 0;
 
-    return m_sections[idx].names[name_idx].c_str();
+    return get_str(m_names[s.names_from+name_idx]);
 }
 
 const char *text_parser::get_section_option(int idx) const
@@ -66,7 +213,7 @@ const char *text_parser::get_section_option(int idx) const
     if(idx<0 || idx>=(int)m_sections.size())
         return 0;
 
-    return m_sections[idx].option.c_str();
+    return get_str(m_sections[idx].option);
 }
 
 const char *text_parser::get_section_value(int idx) const
@@ -74,7 +221,7 @@ const char *text_parser::get_section_value(int idx) const
     if(idx<0 || idx>=(int)m_sections.size())
         return 0;
 
-    return m_sections[idx].value.c_str();
+    return get_str(m_sections[idx].value);
 }
 
 nya_math::vec4 text_parser::get_section_value_vec4(int idx) const
@@ -82,16 +229,7 @@ nya_math::vec4 text_parser::get_section_value_vec4(int idx) const
     if(idx<0 || idx>=(int)m_sections.size())
         return nya_memory::invalid_object<nya_math::vec4>();
 
-    return vec4_from_string(m_sections[idx].value.c_str());
-}
-
-inline void remove_quotes(std::string &s)
-{
-    if(s.empty())
-        return;
-
-    if(s[0]=='"' && s[s.size()-1]==s[0])
-        s=s.substr(1,s.size()-2);
+    return vec4_from_string(get_str(m_sections[idx].value));
 }
 
 int text_parser::get_subsections_count(int section_idx) const
@@ -99,55 +237,7 @@ int text_parser::get_subsections_count(int section_idx) const
     if(section_idx<0 || section_idx>=(int)m_sections.size())
         return -1;
 
-    const section &s=m_sections[section_idx];
-    if(!s.subsection_parsed)
-    {
-        // parse subsection
-        line l=line::first(s.value.c_str(),s.value.size());
-        while(l.next())
-        {
-            const char *text=l.text+l.offset;
-            const size_t off=skip_whitespaces(text,l.size,0);
-            if(off==l.size)
-                continue;
-
-            text+=off;
-            const size_t roff=skip_whitespaces_back(text,l.size-off-1);
-
-            size_t eq=std::string::npos;
-            for(size_t i=0;i<roff;++i)
-            {
-                if(text[i]=='=')
-                {
-                    eq=i;
-                    break;
-                }
-            }
-
-            if(!eq)
-                continue;
-
-            s.subsections.push_back(subsection());
-            subsection &ss=s.subsections.back();
-
-            if(eq==std::string::npos)
-            {
-                ss.type=std::string(text,roff);
-                remove_quotes(ss.type);
-                continue;
-            }
-
-            ss.type=std::string(text,skip_whitespaces_back(text,eq-1));
-            remove_quotes(ss.type);
-            eq=skip_whitespaces(text,roff,eq+1);
-            ss.value=std::string(text+eq,roff-eq);
-            remove_quotes(ss.value);
-        }
-
-        s.subsection_parsed=true;
-    }
-
-    return (int)s.subsections.size();
+    return (int)m_sections[section_idx].subsections_count;
 }
 
 const char *text_parser::get_subsection_type(int section_idx,int idx) const
@@ -155,7 +245,7 @@ const char *text_parser::get_subsection_type(int section_idx,int idx) const
     if(idx<0 || idx>=get_subsections_count(section_idx))
         return 0;
 
-    return m_sections[section_idx].subsections[idx].type.c_str();
+    return get_str(m_subsections[m_sections[section_idx].subsections_from+idx].type);
 }
 
 const char *text_parser::get_subsection_value(int section_idx,int idx) const
@@ -163,7 +253,7 @@ const char *text_parser::get_subsection_value(int section_idx,int idx) const
     if(idx<0 || idx>=get_subsections_count(section_idx))
         return 0;
 
-    return m_sections[section_idx].subsections[idx].value.c_str();
+    return get_str(m_subsections[m_sections[section_idx].subsections_from+idx].value);
 }
 
 const char *text_parser::get_subsection_value(int section_idx,const char *type) const
@@ -173,8 +263,9 @@ const char *text_parser::get_subsection_value(int section_idx,const char *type)
 
     for(int i=0;i<get_subsections_count(section_idx);++i)
     {
-        if(m_sections[section_idx].subsections[i].type==type)
-            return m_sections[section_idx].subsections[i].value.c_str();
+        const subsection &ss=m_subsections[m_sections[section_idx].subsections_from+i];
+        if(strcmp(get_str(ss.type),type)==0)
+            return get_str(ss.value);
     }
 
     return 0;
@@ -185,7 +276,7 @@ bool text_parser::get_subsection_value_bool(int section_idx,int idx) const
     if(idx<0 || idx>=get_subsections_count(section_idx))
         return 0;
 
-    return bool_from_string(m_sections[section_idx].subsections[idx].value.c_str());
+    return bool_from_string(get_subsection_value(section_idx,idx));
 }
 
 int text_parser::get_subsection_value_int(int section_idx,int idx) const
@@ -193,12 +284,14 @@ int text_parser::get_subsection_value_int(int section_idx,int idx) const
     if(idx<0 || idx>=get_subsections_count(section_idx))
         return 0;
 
-    int ret=0;
-    std::istringstream iss(m_sections[section_idx].subsections[idx].value);
-    if(iss>>ret)
-        return ret;
+    const char *value=get_subsection_value(section_idx,idx);
+    char *end;
+    errno=0;
+    const long ret=strtol(value,&end,10);
+    if(end==value || errno==ERANGE || ret<INT_MIN || ret>INT_MAX)
+        return 0;
 
-    return 0;
+    return (int)ret;
 }
 
 nya_math::vec4 text_parser::get_subsection_value_vec4(int section_idx,int idx) const
@@ -206,21 +299,16 @@ nya_math::vec4 text_parser::get_subsection_value_vec4(int section_idx,int idx) c
     if(idx<0 || idx>=get_subsections_count(section_idx))
         return nya_math::vec4();
 
-    return vec4_from_string(m_sections[section_idx].subsections[idx].value.c_str());
+    return vec4_from_string(get_subsection_value(section_idx,idx));
 }
 
 nya_math::vec4 text_parser::get_subsection_value_vec4(int section_idx,const char *type) const
 {
-    if(!type)
+    const char *value=get_subsection_value(section_idx,type);
+    if(!value)
         return nya_math::vec4();
 
-    for(int i=0;i<get_subsections_count(section_idx);++i)
-    {
-        if(m_sections[section_idx].subsections[i].type==type)
-            return vec4_from_string(m_sections[section_idx].subsections[i].value.c_str());
-    }
-
-    return nya_math::vec4();
+    return vec4_from_string(value);
 }
 
 text_parser::line text_parser::line::first(const char *text,size_t text_size)
@@ -248,20 +336,24 @@ bool text_parser::line::next()
     bool in_quotes=false;
     while(char_idx!=text_size)
     {
-        char c=text[char_idx++];
-        if(c=='\n')
+        char_idx=find_any(text,char_idx,text_size,'\n','"');
+        if(char_idx==text_size)
+            break;
+
+        if(text[char_idx++]=='"')
         {
-            ++next_line_number;
-            if(!in_quotes)
-                break;
-        }
-        else if(c=='"')
             in_quotes=!in_quotes;
+            continue;
+        }
+
+        ++next_line_number;
+        if(!in_quotes)
+            break;
     }
 
     size=char_idx-offset;
 
-    const size_t first_non_whitespace_idx=skip_whitespaces(text,text_size,offset);
+    const size_t first_non_whitespace_idx=skip_whitespaces(text,offset+size,offset);
     global=(first_non_whitespace_idx<offset+size && text[first_non_whitespace_idx]==global_marker);
     empty=(first_non_whitespace_idx>=offset+size);
 
@@ -270,6 +362,8 @@ bool text_parser::line::next()
 
 bool text_parser::load_from_data(const char *text,size_t text_size)
 {
+    clear();
+
     if(!text)
         return false;
 
@@ -277,46 +371,41 @@ bool text_parser::load_from_data(const char *text,size_t text_size)
     if(!text_size)
         return true;
 
-    //removing comments
-    std::string uncommented_text(text,text_size);
-    while(uncommented_text.find("//")!=std::string::npos)
-    {
-        const size_t from=uncommented_text.find("//");
-        uncommented_text.erase(from,uncommented_text.find_first_of("\n\r",from+1)-from);
-    }
-    while(uncommented_text.find("/*")!=std::string::npos)
-    {
-        const size_t from=uncommented_text.find("/*");
-        uncommented_text.erase(from,(uncommented_text.find("*/",from+2)-from)+2);
-    }
-    text=uncommented_text.c_str();
+    std::vector<char> uncommented_text(text,text+text_size);
+    remove_comments(uncommented_text);
+    if(uncommented_text.empty())
+        return true;
+
+    text=&uncommented_text[0];
     text_size=uncommented_text.size();
 
-    size_t global_count=0;
-    line l=line::first(text,text_size);
-    while(l.next()) if(l.global) ++global_count;
-    m_sections.resize(global_count);
+    //section values and subsections are copies of the text at most, plus terminating zeros
+    m_strings.reserve(text_size*2+text_size/8+64);
 
-    size_t subsection_start_idx=0,subsection_end_idx=0,sections_count=0;
+    std::string inline_value;
+    size_t subsection_start_idx=0,subsection_end_idx=0;
     bool subsection_empty=true;
-    l=line::first(text,text_size);
+    line l=line::first(text,text_size);
 
     while(l.next())
     {
         if(l.global)
         {
-            if(subsection_end_idx>subsection_start_idx && !subsection_empty)
+            if(!m_sections.empty())
             {
-                m_sections[sections_count-1].value=std::string(text+subsection_start_idx,subsection_end_idx-subsection_start_idx);
-                subsection_empty=true;
+                if(subsection_end_idx>subsection_start_idx && !subsection_empty)
+                    set_section_value(text+subsection_start_idx,subsection_end_idx-subsection_start_idx);
+                else
+                    set_section_value(inline_value.data(),inline_value.size());
             }
-            fill_section(m_sections[sections_count],l);
+
+            add_section(l,inline_value);
             subsection_start_idx=l.offset+l.size;
-            ++sections_count;
+            subsection_empty=true;
         }
         else
         {
-            if(sections_count>0)
+            if(!m_sections.empty())
             {
                 subsection_end_idx=l.offset+l.size;
                 if(!l.empty)
@@ -327,90 +416,160 @@ bool text_parser::load_from_data(const char *text,size_t text_size)
         }
     }
 
-    if(subsection_end_idx>subsection_start_idx && !subsection_empty)
-        m_sections[sections_count-1].value=std::string(text+subsection_start_idx,subsection_end_idx-subsection_start_idx);
+    if(!m_sections.empty())
+    {
+        if(subsection_end_idx>subsection_start_idx && !subsection_empty)
+            set_section_value(text+subsection_start_idx,subsection_end_idx-subsection_start_idx);
+        else
+            set_section_value(inline_value.data(),inline_value.size());
+    }
 
     return true;
 }
 
-void text_parser::fill_section(section &s,const line &l)
+//line comments are removed first, so block comments with // inside may end early, as before
+void text_parser::remove_comments(std::vector<char> &text)
+{
+    char *t=&text[0];
+    size_t size=text.size(),to=0;
+    for(size_t from=0;from<size;)
+    {
+        const size_t c=find_pair(t,from,size,'/','/');
+        memmove(t+to,t+from,c-from);
+        to+=c-from;
+        from=c<size?find_any(t,c+1,size,'\n','\r'):size;
+    }
+
+    size=to,to=0;
+    for(size_t from=0;from<size;)
+    {
+        const size_t c=find_pair(t,from,size,'/','*');
+        memmove(t+to,t+from,c-from);
+        to+=c-from;
+        if(c==size)
+            break;
+
+        const size_t end=find_pair(t,c+2,size,'*','/');
+        from=end<size?end+2:size;
+    }
+
+    text.resize(to);
+}
+
+void text_parser::add_section(const line &l,std::string &inline_value)
 {
-   std::list<std::string> tokens=tokenize_line(l);
-    // assert(tokens.size() > 0);
-    // assert(tokens.front().size > 0);
-    // assert(tokens.front().at(0) == global_marker);
-    std::list<std::string>::iterator iter=tokens.begin();
-    s.type.swap(*(iter++));
+    const char *text=l.text;
+    const size_t line_end=l.offset+l.size;
+
+    m_sections.resize(m_sections.size()+1);
+    section &s=m_sections.back();
+    s.names_from=(unsigned int)m_names.size();
+    s.names_count=1;
+    s.subsections_from=s.subsections_count=0;
+    m_names.resize(m_names.size()+1);
+    inline_value.clear();
+
+    size_t token_start,token_size;
+    size_t char_idx=get_next_token(text,line_end,l.offset,token_start,token_size);
+    s.type=add_str(text+token_start,token_size);
+
     bool need_option=false;
     bool need_value=false;
     bool need_name=true;
-    while(iter!=tokens.end())
+    while(true)
     {
+        char_idx=get_next_token(text,line_end,char_idx,token_start,token_size);
+        if(token_start>=line_end)
+            break;
+
+        const char *token=text+token_start;
         if(need_option)
         {
-            s.option.swap(*iter);
+            s.option=add_str(token,token_size);
             need_option=false;
         }
-        else if(*iter==":")
+        else if(token_size==1 && token[0]==':')
         {
             need_option=true;
             need_name=false;
             need_value=false;
         }
-        else if(*iter=="=")
+        else if(token_size==1 && token[0]=='=')
         {
             need_value=true;
             need_name=false;
         }
         else if(need_value)
         {
-            s.value.append(*iter);
+            inline_value.append(token,token_size);
         }
         else if(need_name)
         {
-            if(s.names.empty() || !s.names.back().empty())
-                s.names.push_back(std::string());
+            if(m_names.back().size)
+                m_names.resize(m_names.size()+1);
 
-            s.names.back().swap(*iter);
+            m_names.back()=add_str(token,token_size);
         }
         else
         {
             nya_log::log()<<"Text parser: unexpected token at lines "<<l.line_number<<"-"<<l.next_line_number<<"\n";
             break;
         }
-
-        ++iter;
     }
+
+    s.names_count=(unsigned int)(m_names.size()-s.names_from);
 }
 
-std::list<std::string> text_parser::tokenize_line(const line &l)
+void text_parser::set_section_value(const char *value,size_t value_size)
 {
-    std::list<std::string> result;
-    const size_t line_end=l.offset+l.size;
-    size_t char_idx=l.offset;
+    section &s=m_sections.back();
+    s.value=add_str(value,value_size);
+    s.subsections_from=(unsigned int)m_subsections.size();
 
-    while(true)
+    line l=line::first(value,value_size);
+    while(l.next())
     {
-        size_t token_start_idx, token_size;
-        char_idx=get_next_token(l.text,line_end,char_idx,token_start_idx,token_size);
-        if(token_start_idx<line_end)
-            result.push_back(std::string(l.text+token_start_idx,token_size));
-        else
-            break;
+        if(l.empty)
+            continue;
+
+        const char *text=l.text+l.offset;
+        const size_t off=skip_whitespaces(text,l.size,0);
+        text+=off;
+        const size_t roff=skip_whitespaces_back(text,l.size-off-1);
+
+        const char *eq=(const char *)memchr(text,'=',roff);
+        if(eq==text)
+            continue;
+
+        const char *type=text,*val=text+roff;
+        size_t type_size=roff,val_size=0;
+        if(eq)
+        {
+            type_size=skip_whitespaces_back(text,eq-text-1);
+            const size_t val_start=skip_whitespaces(text,roff,eq-text+1);
+            val=text+val_start;
+            val_size=roff-val_start;
+        }
+
+        remove_quotes(type,type_size);
+        remove_quotes(val,val_size);
+
+        subsection ss;
+        ss.type=add_str(type,type_size);
+        ss.value=add_str(val,val_size);
+        m_subsections.push_back(ss);
     }
 
-    return result;
+    s.subsections_count=(unsigned int)(m_subsections.size()-s.subsections_from);
 }
 
 size_t text_parser::get_real_text_size(const char *text,size_t supposed_size)
 {
-    const char *t=text;
-    if(supposed_size!=no_size)
-        while(*t && t<text+supposed_size) ++t;
-    else
-        while(*t) ++t;
+    if(supposed_size==no_size)
+        return strlen(text);
 
-    return t-text;
+    const char *t=(const char *)memchr(text,0,supposed_size);
+    return t?t-text:supposed_size;
 }
 
 size_t text_parser::get_next_token(const char *text,size_t text_size,size_t pos,size_t &token_start_idx_out,size_t &token_size_out)
@@ -491,18 +650,111 @@ size_t text_parser::skip_whitespaces_back(const char *text,size_t pos)
     return 0;
 }
 
-void text_parser::debug_print(nya_log::ostream_base &os) const
+uint64_t text_parser::get_compiled_key(const char *text,size_t text_size)
 {
+    uint64_t h=14695981039346656037ULL;
+    hash_append(h,compiled_sign,sizeof(compiled_sign));
+    hash_append(h,&compiled_version,sizeof(compiled_version));
+    if(text)
+        hash_append(h,text,get_real_text_size(text,text_size));
+    return h;
+}
+
+size_t text_parser::write_compiled(void *to_data,size_t to_size) const
+{
+    nya_memory::memory_writer w(to_data,to_size);
+    w.write(compiled_sign,sizeof(compiled_sign));
+    w.write_uint(compiled_version);
+    w.write_uint((unsigned int)m_sections.size());
     for(size_t i=0;i<m_sections.size();++i)
     {
         const section &s=m_sections[i];
-        os<<"section "<<i<<" '"<<s.type<<"':\n";
-        for(size_t j=0;j<s.names.size();++j)
-            os<<"  name "<<j<<" '"<<s.names[j]<<"'\n";
+        write_str(w,get_str(s.type),s.type.size);
+        w.write_uint(s.names_count);
+        for(unsigned int j=0;j<s.names_count;++j)
+            write_str(w,get_str(m_names[s.names_from+j]),m_names[s.names_from+j].size);
+        write_str(w,get_str(s.option),s.option.size);
+        write_str(w,get_str(s.value),s.value.size);
+
+        w.write_uint(s.subsections_count);
+        for(unsigned int j=0;j<s.subsections_count;++j)
+        {
+            const subsection &ss=m_subsections[s.subsections_from+j];
+            write_str(w,get_str(ss.type),ss.type.size);
+            write_str(w,get_str(ss.value),ss.value.size);
+        }
+    }
+
+    return to_data && w.get_offset()<w.get_size()?0:w.get_offset();
+}
+
+bool text_parser::load_compiled(const void *data,size_t size)
+{
+    clear();
+
+    nya_memory::memory_reader r(data,size);
+    if(!r.test(compiled_sign,sizeof(compiled_sign)) || r.read<uint32_t>()!=compiled_version)
+        return false;
+
+    uint32_t count;
+    if(!read_count(r,count))
+        return false;
+
+    m_strings.reserve(size);
+    m_sections.resize(count);
+    bool result=true;
+    for(size_t i=0;i<m_sections.size() && result;++i)
+    {
+        section &s=m_sections[i];
+        result=read_str(r,s.type) && read_count(r,count);
+        s.names_from=(unsigned int)m_names.size();
+        s.names_count=result?count:0;
+        m_names.resize(m_names.size()+s.names_count);
+        for(unsigned int j=0;j<s.names_count && result;++j)
+            result=read_str(r,m_names[s.names_from+j]);
+
+        result=result && read_str(r,s.option) && read_str(r,s.value) && read_count(r,count);
+        s.subsections_from=(unsigned int)m_subsections.size();
+        s.subsections_count=result?count:0;
+        m_subsections.resize(m_subsections.size()+s.subsections_count);
+        for(unsigned int j=0;j<s.subsections_count && result;++j)
+        {
+            subsection &ss=m_subsections[s.subsections_from+j];
+            result=read_str(r,ss.type) && read_str(r,ss.value);
+        }
+    }
+
+    if(!result || r.get_remained())
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool text_parser::read_str(nya_memory::memory_reader &r,str &s)
+{
+    const uint32_t size=r.read<uint32_t>();
+    if(!r.check_remained(size))
+        return false;
+
+    s=add_str((const char *)r.get_data(),size);
+    r.skip(size);
+    return true;
+}
+
+void text_parser::debug_print(nya_log::ostream_base &os) const
+{
+    for(int i=0;i<(int)m_sections.size();++i)
+    {
+        os<<"section "<<i<<" '"<<get_section_type(i)<<"':\n";
+        for(int j=0;j<get_section_names_count(i);++j)
+            os<<"  name "<<j<<" '"<<get_section_name(i,j)<<"'\n";
 
-        if(!s.option.empty())
-            os<<"  option '"<<s.option<<"'\n";
-        os<<"  value '"<<s.value<<"'\n\n\n";
+        if(m_sections[i].option.size)
+            os<<"  option '"<<get_section_option(i)<<"'\n";
+        os<<"  value '"<<get_section_value(i)<<"'\n\n\n";
     }
 }
 
@@ -5,9 +5,10 @@
 #include "math/vector.h"
 #include <string>
 #include <vector>
-#include <list>
+#include <stdint.h>
 
 namespace nya_log { class ostream_base; }
+namespace nya_memory { class memory_reader; }
 
 namespace nya_formats
 {
@@ -38,6 +39,14 @@ public:
     nya_math::vec4 get_subsection_value_vec4(int section_idx,int idx) const;
     nya_math::vec4 get_subsection_value_vec4(int section_idx,const char *type) const;
 
+public:
+    //binary form of parsed sections with subsections, for caching, see nya_scene::compiled_assets_provider
+    //the key is a hash of the text and the compiled format version
+    static uint64_t get_compiled_key(const char *data,size_t text_size=no_size);
+    size_t get_compiled_size() const { return write_compiled(0,0); }
+    size_t write_compiled(void *to_data,size_t to_size) const;
+    bool load_compiled(const void *data,size_t size);
+
 public:
     void debug_print(nya_log::ostream_base &os) const;
 
@@ -46,28 +55,41 @@ public:
     text_parser(const char *data,size_t size=no_size) { load_from_data(data,size); }
 
 private:
-    void clear() { m_sections.clear(); }
+    void clear();
 
-    struct subsection
+    //all strings are zero-terminated views into m_strings, sections and subsections are parsed at load
+    struct str
     {
-        std::string type;
-        std::string value;
+        unsigned int offset;
+        unsigned int size;
+
+        str(): offset(0),size(0) {} //m_strings starts with zero, so it's an empty string
     };
 
     struct section
     {
-        std::string type;
-        std::vector<std::string> names;
-        std::string option;
-        std::string value;
-        // value -> subsections conversion is done on first subsection access for this section
-        mutable bool subsection_parsed;
-        mutable std::vector<subsection> subsections;
-
-        section(): subsection_parsed(false) { names.resize(1); }
+        str type;
+        unsigned int names_from,names_count;
+        str option;
+        str value;
+        unsigned int subsections_from,subsections_count;
     };
 
+    struct subsection
+    {
+        str type;
+        str value;
+    };
+
+    std::vector<char> m_strings;
+    std::vector<str> m_names;
     std::vector<section> m_sections;
+    std::vector<subsection> m_subsections;
+
+private:
+    const char *get_str(const str &s) const { return &m_strings[s.offset]; }
+    str add_str(const char *s,size_t size);
+    bool read_str(nya_memory::memory_reader &r,str &s);
 
 private:
     struct line
@@ -85,9 +107,11 @@ private:
         bool next();
     };
 
+    void add_section(const line &l,std::string &inline_value);
+    void set_section_value(const char *value,size_t value_size); //and parse subsections
+
     static size_t get_real_text_size(const char *text,size_t supposed_size);
-    static std::list<std::string> tokenize_line(const line &l);
-    static void fill_section(section &s, const line &l);
+    static void remove_comments(std::vector<char> &text);
     // As text is NOT null-terminated but size-constrained string we should provide following output parameters:
     // 1) start index and size of found token.
     // 2) idx of last symbol processed during this token processing, which can be used for the following text processing (this number is not necessary equals token_start_idx + token_size due to quotes magic).
@@ -0,0 +1,211 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "rect_packer.h"
+
+namespace nya_math
+{
+
+rect_packer::rect_packer(int width,int height): m_width(width),m_height(height),m_used_area(0) { clear(); }
+
+void rect_packer::clear()
+{
+    m_skyline.clear();
+    m_free.clear();
+    m_used_area=0;
+    if(m_width<=0 || m_height<=0)
+        return;
+
+    const segment s={0,0,m_width};
+    m_skyline.push_back(s);
+}
+
+bool rect_packer::add(int width,int height,int &x,int &y)
+{
+    if(width<=0 || height<=0 || width>m_width || height>m_height)
+        return false;
+
+    if(!add_free(width,height,x,y) && !add_skyline(width,height,x,y))
+        return false;
+
+    m_used_area+=width*height;
+    return true;
+}
+
+bool rect_packer::add_free(int width,int height,int &x,int &y)
+{
+    int best= -1,best_fit=0;
+    for(int i=0;i<(int)m_free.size();++i)
+    {
+        const rect &r=m_free[i];
+        if(r.width<width || r.height<height)
+            continue;
+
+        const int fit=r.width-width<r.height-height?r.width-width:r.height-height;
+        if(best<0 || fit<best_fit)
+            best=i,best_fit=fit;
+    }
+
+    if(best<0)
+        return false;
+
+    const rect r=m_free[best];
+    m_free[best]=m_free.back();
+    m_free.pop_back();
+
+    x=r.x,y=r.y;
+
+    //guillotine split along the shorter leftover side
+    rect right={r.x+width,r.y,r.width-width,0};
+    rect bottom={r.x,r.y+height,0,r.height-height};
+    if(r.width-width<r.height-height)
+        right.height=height,bottom.width=r.width;
+    else
+        right.height=r.height,bottom.width=width;
+
+    if(right.width>0 && right.height>0)
+        m_free.push_back(right);
+    if(bottom.width>0 && bottom.height>0)
+        m_free.push_back(bottom);
+
+    return true;
+}
+
+bool rect_packer::add_skyline(int width,int height,int &x,int &y)
+{
+    int best= -1,best_y=0,best_width=0;
+    for(int i=0;i<(int)m_skyline.size();++i)
+    {
+        const int left=m_skyline[i].x;
+        if(left+width>m_width)
+            break;
+
+        int top=0;
+        for(int j=i,remain=width;remain>0;++j)
+        {
+            if(m_skyline[j].y>top)
+                top=m_skyline[j].y;
+            remain-=m_skyline[j].width;
+        }
+
+        if(top+height>m_height)
+            continue;
+
+        if(best<0 || top<best_y || (top==best_y && m_skyline[i].width<best_width))
+            best=i,best_y=top,best_width=m_skyline[i].width;
+    }
+
+    if(best<0)
+        return false;
+
+    x=m_skyline[best].x,y=best_y;
+
+    //space below the new rect is no longer reachable by the skyline
+    rect wasted[16];
+    int wasted_count=0;
+    for(int j=best,remain=width;remain>0;++j)
+    {
+        const segment &s=m_skyline[j];
+        const int w=s.width<remain?s.width:remain;
+        if(s.y<best_y && wasted_count<16)
+        {
+            const rect r={s.x,s.y,w,best_y-s.y};
+            wasted[wasted_count++]=r;
+        }
+        remain-=w;
+    }
+
+    const segment added={x,best_y+height,width};
+    m_skyline.insert(m_skyline.begin()+best,added);
+
+    for(int i=best+1;i<(int)m_skyline.size();)
+    {
+        segment &s=m_skyline[i];
+        const int shrink=added.x+added.width-s.x;
+        if(shrink<=0)
+            break;
+
+        if(shrink<s.width)
+        {
+            s.x+=shrink,s.width-=shrink;
+            break;
+        }
+
+        m_skyline.erase(m_skyline.begin()+i);
+    }
+
+    merge_skyline();
+
+    for(int i=0;i<wasted_count;++i)
+        add_free_rect(wasted[i]);
+
+    return true;
+}
+
+void rect_packer::remove(int x,int y,int width,int height)
+{
+    if(width<=0 || height<=0)
+        return;
+
+    m_used_area-=width*height;
+
+    const rect r={x,y,width,height};
+    add_free_rect(r);
+}
+
+void rect_packer::add_free_rect(rect r)
+{
+    //merge with free neighbours sharing a whole edge
+    for(int i=0;i<(int)m_free.size();)
+    {
+        const rect &f=m_free[i];
+        if(f.y==r.y && f.height==r.height && (f.x+f.width==r.x || r.x+r.width==f.x))
+        {
+            r.x=f.x<r.x?f.x:r.x;
+            r.width+=f.width;
+        }
+        else if(f.x==r.x && f.width==r.width && (f.y+f.height==r.y || r.y+r.height==f.y))
+        {
+            r.y=f.y<r.y?f.y:r.y;
+            r.height+=f.height;
+        }
+        else
+        {
+            ++i;
+            continue;
+        }
+
+        m_free[i]=m_free.back();
+        m_free.pop_back();
+        i=0;
+    }
+
+    //free space at the top of the skyline lowers it back
+    for(int i=0;i<(int)m_skyline.size();++i)
+    {
+        segment &s=m_skyline[i];
+        if(s.x==r.x && s.width==r.width && s.y==r.y+r.height)
+        {
+            s.y=r.y;
+            merge_skyline();
+            return;
+        }
+    }
+
+    m_free.push_back(r);
+}
+
+void rect_packer::merge_skyline()
+{
+    for(int i=0;i+1<(int)m_skyline.size();)
+    {
+        if(m_skyline[i].y==m_skyline[i+1].y)
+        {
+            m_skyline[i].width+=m_skyline[i+1].width;
+            m_skyline.erase(m_skyline.begin()+i+1);
+        }
+        else
+            ++i;
+    }
+}
+
+}
@@ -0,0 +1,45 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include <vector>
+
+namespace nya_math
+{
+
+//skyline bottom-left allocator of rectangles inside a fixed area
+//removed rects are kept in a free list and reused by later adds
+class rect_packer
+{
+public:
+    bool add(int width,int height,int &x,int &y); //false if doesn't fit
+    void remove(int x,int y,int width,int height);
+    void clear();
+
+public:
+    int get_width() const { return m_width; }
+    int get_height() const { return m_height; }
+    int get_used_area() const { return m_used_area; }
+
+public:
+    rect_packer(): m_width(0),m_height(0),m_used_area(0) {}
+    rect_packer(int width,int height);
+
+private:
+    bool add_free(int width,int height,int &x,int &y);
+    bool add_skyline(int width,int height,int &x,int &y);
+    struct rect { int x,y,width,height; };
+    void add_free_rect(rect r);
+    void merge_skyline();
+
+private:
+    struct segment { int x,y,width; };
+    std::vector<segment> m_skyline;
+
+    std::vector<rect> m_free;
+
+    int m_width,m_height;
+    int m_used_area;
+};
+
+}
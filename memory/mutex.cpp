@@ -37,6 +37,62 @@ mutex::~mutex()
 #endif
 }
 
+void condition_variable::wait(mutex &m)
+{
+#ifdef _MSC_VER
+    m_cond.wait(m.m_mutex);
+#else
+    pthread_cond_wait(&m_cond,&m.m_mutex);
+#endif
+}
+
+void condition_variable::notify_all()
+{
+#ifdef _MSC_VER
+    m_cond.notify_all();
+#else
+    pthread_cond_broadcast(&m_cond);
+#endif
+}
+
+condition_variable::condition_variable()
+{
+#ifndef _MSC_VER
+    pthread_cond_init(&m_cond,0);
+#endif
+}
+
+condition_variable::~condition_variable()
+{
+#ifndef _MSC_VER
+    pthread_cond_destroy(&m_cond);
+#endif
+}
+
+thread_id thread_id::current()
+{
+    thread_id id;
+#ifdef _MSC_VER
+    id.m_id=std::this_thread::get_id();
+#else
+    id.m_id=pthread_self();
+#endif
+    id.m_valid=true;
+    return id;
+}
+
+bool thread_id::operator == (const thread_id &other) const
+{
+    if(!m_valid || !other.m_valid)
+        return m_valid==other.m_valid;
+
+#ifdef _MSC_VER
+    return m_id==other.m_id;
+#else
+    return pthread_equal(m_id,other.m_id)!=0;
+#endif
+}
+
 void mutex_rw::lock_read()
 {
 #ifdef _MSC_VER
@@ -9,6 +9,8 @@
 #ifdef _MSC_VER
     #include <mutex>
     #include <atomic>
+    #include <thread>
+    #include <condition_variable>
 #else
     #include <pthread.h>
 #endif
@@ -18,6 +20,8 @@ namespace nya_memory
 
 class mutex: public non_copyable
 {
+    friend class condition_variable;
+
 public:
     void lock();
     void unlock();
@@ -34,6 +38,44 @@ private:
 #endif
 };
 
+class condition_variable: public non_copyable
+{
+public:
+    void wait(mutex &m); //m should be locked by calling thread
+    void notify_all();
+
+public:
+    condition_variable();
+    ~condition_variable();
+
+private:
+#ifdef _MSC_VER
+    std::condition_variable_any m_cond;
+#else
+    pthread_cond_t m_cond;
+#endif
+};
+
+class thread_id
+{
+public:
+    static thread_id current();
+
+    bool operator == (const thread_id &other) const;
+    bool operator != (const thread_id &other) const { return !(*this==other); }
+
+public:
+    thread_id(): m_valid(false) {}
+
+private:
+#ifdef _MSC_VER
+    std::thread::id m_id;
+#else
+    pthread_t m_id;
+#endif
+    bool m_valid;
+};
+
 class mutex_rw: public non_copyable
 {
 public:
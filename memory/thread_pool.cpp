@@ -0,0 +1,223 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "thread_pool.h"
+
+#if !defined _MSC_VER && !defined EMSCRIPTEN
+    #include <unistd.h>
+#endif
+
+namespace nya_memory
+{
+
+void thread_pool::finish_task(task_group *group)
+{
+    lock_guard lock(m_mutex);
+    if(group)
+        --group->m_pending;
+    m_cond.notify_all();
+}
+
+void *thread_pool::thread_func(void *pool_ptr)
+{
+    thread_pool &pool=*(thread_pool *)pool_ptr;
+    while(true)
+    {
+        queued_task q;
+        {
+            lock_guard lock(pool.m_mutex);
+            while(pool.m_tasks.empty() && !pool.m_exit)
+                pool.m_cond.wait(pool.m_mutex);
+
+            if(pool.m_tasks.empty())
+                break;
+
+            q=pool.m_tasks.front();
+            pool.m_tasks.pop_front();
+        }
+
+        q.t->run();
+        pool.finish_task(q.group);
+    }
+    return 0;
+}
+
+void thread_pool::add_task(task *t,task_group *group)
+{
+    if(!t)
+        return;
+
+    if(m_threads.empty())
+    {
+        t->run();
+        return;
+    }
+
+    queued_task q;
+    q.t=t;
+    q.group=group;
+
+    lock_guard lock(m_mutex);
+    if(group)
+        ++group->m_pending;
+    m_tasks.push_back(q);
+    m_cond.notify_all();
+}
+
+void thread_pool::wait(task_group &group)
+{
+    m_mutex.lock();
+    while(group.m_pending>0)
+    {
+        //only group's own tasks are executed here, unrelated ones are left to the threads
+        size_t idx=0;
+        while(idx<m_tasks.size() && m_tasks[idx].group!=&group)
+            ++idx;
+
+        if(idx==m_tasks.size())
+        {
+            m_cond.wait(m_mutex);
+            continue;
+        }
+
+        task *t=m_tasks[idx].t;
+        m_tasks.erase(m_tasks.begin()+idx);
+        m_mutex.unlock();
+        t->run();
+        finish_task(&group);
+        m_mutex.lock();
+    }
+    m_mutex.unlock();
+}
+
+struct thread_pool::parallel_state
+{
+    parallel_job *job;
+    int count,chunk,next;
+    mutex next_mutex;
+};
+
+class thread_pool::parallel_task: public thread_pool::task
+{
+public:
+    void run()
+    {
+        int from,to;
+        while(grab(from,to))
+            state->job->run(from,to);
+    }
+
+    bool grab(int &from,int &to)
+    {
+        lock_guard lock(state->next_mutex);
+        from=state->next;
+        to=from+state->chunk;
+        if(to>state->count)
+            to=state->count;
+        state->next=to;
+        return from<to;
+    }
+
+public:
+    parallel_state *state;
+};
+
+void thread_pool::run_parallel(parallel_job &job,int count,int min_chunk)
+{
+    if(count<=0)
+        return;
+
+    if(min_chunk<1)
+        min_chunk=1;
+
+    const int threads=(int)m_threads.size()+1;
+    int chunk=(count+threads*4-1)/(threads*4);
+    if(chunk<min_chunk)
+        chunk=min_chunk;
+
+    const int chunks_count=(count+chunk-1)/chunk;
+    if(chunks_count<=1 || m_threads.empty())
+    {
+        job.run(0,count);
+        return;
+    }
+
+    parallel_state state;
+    state.job=&job;
+    state.count=count;
+    state.chunk=chunk;
+    state.next=0;
+
+    const int helpers_count=(chunks_count<threads?chunks_count:threads)-1;
+    std::vector<parallel_task> helpers(helpers_count+1);
+    for(int i=0;i<=helpers_count;++i)
+        helpers[i].state=&state;
+
+    task_group group;
+    for(int i=0;i<helpers_count;++i)
+        add_task(&helpers[i],&group);
+
+    helpers.back().run();
+
+    //helpers that weren't picked yet are executed here, so nested calls can't deadlock
+    wait(group);
+}
+
+void parallel_for(parallel_job &job,int count,int min_chunk)
+{
+    thread_pool::get().run_parallel(job,count,min_chunk);
+}
+
+thread_pool &thread_pool::get()
+{
+    static thread_pool pool(get_cpu_count()-1);
+    return pool;
+}
+
+int thread_pool::get_cpu_count()
+{
+#ifdef _MSC_VER
+    const int count=(int)std::thread::hardware_concurrency();
+#elif defined EMSCRIPTEN
+    const int count=1;
+#else
+    const int count=(int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count>0?count:1;
+}
+
+thread_pool::thread_pool(int threads_count): m_exit(false)
+{
+#ifdef _MSC_VER
+    for(int i=0;i<threads_count;++i)
+        m_threads.push_back(new std::thread(thread_func,this));
+#elif !defined EMSCRIPTEN
+    for(int i=0;i<threads_count;++i)
+    {
+        pthread_t t;
+        if(pthread_create(&t,0,thread_func,this)==0)
+            m_threads.push_back(t);
+    }
+#endif
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        lock_guard lock(m_mutex);
+        m_exit=true;
+        m_cond.notify_all();
+    }
+
+#ifdef _MSC_VER
+    for(size_t i=0;i<m_threads.size();++i)
+    {
+        m_threads[i]->join();
+        delete m_threads[i];
+    }
+#elif !defined EMSCRIPTEN
+    for(size_t i=0;i<m_threads.size();++i)
+        pthread_join(m_threads[i],0);
+#endif
+}
+
+}
@@ -0,0 +1,99 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "non_copyable.h"
+#include "mutex.h"
+#include <vector>
+#include <deque>
+
+#ifdef _MSC_VER
+    #include <thread>
+#endif
+
+namespace nya_memory
+{
+
+class parallel_job;
+
+class thread_pool: public non_copyable
+{
+public:
+    class task
+    {
+    public:
+        virtual void run()=0;
+        virtual ~task() {}
+    };
+
+    //counts pending tasks added with it, so callers wait for their own tasks only
+    class task_group: public non_copyable
+    {
+    public:
+        task_group(): m_pending(0) {}
+
+    private:
+        friend class thread_pool;
+        int m_pending;
+    };
+
+public:
+    //task is not owned by pool and must be valid until executed
+    //executed immediately if pool has no threads
+    void add_task(task *t,task_group *group=0);
+
+    //waits until group's tasks are finished, calling thread executes the ones that weren't started yet
+    void wait(task_group &group);
+
+    int get_threads_count() const { return (int)m_threads.size(); }
+
+public:
+    static thread_pool &get(); //shared pool, one thread per cpu core minus one
+    static int get_cpu_count();
+
+public:
+    thread_pool(int threads_count);
+    ~thread_pool();
+
+private:
+    static void *thread_func(void *pool);
+    void finish_task(task_group *group);
+
+    friend void parallel_for(parallel_job &job,int count,int min_chunk);
+    void run_parallel(parallel_job &job,int count,int min_chunk);
+    struct parallel_state;
+    class parallel_task;
+
+private:
+    struct queued_task
+    {
+        task *t;
+        task_group *group;
+    };
+
+    std::deque<queued_task> m_tasks;
+    bool m_exit;
+    mutex m_mutex;
+    condition_variable m_cond;
+
+#ifdef _MSC_VER
+    std::vector<std::thread *> m_threads;
+#elif !defined EMSCRIPTEN
+    std::vector<pthread_t> m_threads;
+#else
+    std::vector<int> m_threads;
+#endif
+};
+
+class parallel_job
+{
+public:
+    virtual void run(int from,int to)=0;
+    virtual ~parallel_job() {}
+};
+
+//splits [0,count) into chunks of at least min_chunk and runs them on the shared thread pool
+//blocks until all chunks are processed, calling thread takes part in execution
+void parallel_for(parallel_job &job,int count,int min_chunk=1);
+
+}
@@ -108,8 +108,10 @@ public:
                 max_buf=&buffer;
         }
 
+        //marked as used before unlock, so other threads don't pick the same buffer
         if(min_suit_buf)
         {
+            min_suit_buf->m_used=true;
             m_mutex.unlock();
             min_suit_buf->allocate(size);
             return min_suit_buf;
@@ -117,6 +119,7 @@ public:
 
         if(max_buf)
         {
+            max_buf->m_used=true;
             m_mutex.unlock();
             max_buf->allocate(size);
             return max_buf;
@@ -124,8 +127,9 @@ public:
 
         m_buffers.push_back(tmp_buffer());
         tmp_buffer* result=&m_buffers.back();
+        result->m_used=true;
         m_mutex.unlock();
-        m_buffers.back().allocate(size);
+        result->allocate(size);
 
         if(m_allocate_log_enabled) log()<<"new tmp buf allocated ("<<m_buffers.size()<<" total)\n";
 
@@ -1,24 +1,119 @@
 //nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
 
 #include "bitmap.h"
+#include "bitmap_simd.h"
 #include "memory/align_alloc.h"
 #include "memory/tmp_buffer.h"
+#include "memory/thread_pool.h"
 #include <string.h>
 #include <vector>
 
 namespace nya_render
 {
 
-inline uint32_t average(uint32_t a, uint32_t b) { return (((a^b) & 0xfefefefeL)>>1) + (a&b); }
+namespace
+{
+    const int parallel_min_pixels=256*256;
+    const int parallel_chunk_pixels=16*1024;
+
+    //runs job over rows, in parallel for large images
+    void for_rows(nya_memory::parallel_job &job,int rows,int row_pixels)
+    {
+        if(rows<=1 || rows*row_pixels<parallel_min_pixels)
+        {
+            job.run(0,rows);
+            return;
+        }
+
+        const int chunk=parallel_chunk_pixels/(row_pixels>0?row_pixels:1);
+        nya_memory::parallel_for(job,rows,chunk>0?chunk:1);
+    }
+
+    bool overlaps(const uint8_t *a,size_t a_size,const uint8_t *b,size_t b_size) { return a<b+b_size && b<a+a_size; }
+
+    //same-size per-pixel conversion, safe in place
+    class convert_job: public nya_memory::parallel_job
+    {
+    public:
+        void run(int from,int to)
+        {
+            const size_t offset=size_t(from)*width*bpp;
+            kernel(src+offset,dst+offset,(to-from)*width);
+        }
+
+        convert_job(void (*kernel)(const uint8_t *,uint8_t *,int),const uint8_t *src,uint8_t *dst,int width,int bpp):
+                    kernel(kernel),src(src),dst(dst),width(width),bpp(bpp) {}
+
+    private:
+        void (*kernel)(const uint8_t *,uint8_t *,int);
+        const uint8_t *src;
+        uint8_t *dst;
+        int width,bpp;
+    };
+
+    void convert(void (*kernel)(const uint8_t *,uint8_t *,int),const uint8_t *src,uint8_t *dst,int width,int height,int bpp)
+    {
+        convert_job job(kernel,src,dst,width,bpp);
+        for_rows(job,height,width);
+    }
+
+    //4 to 3 channels, parallel only if not in place
+    void convert_4_to_3(void (*kernel)(const uint8_t *,uint8_t *,int),const uint8_t *src,uint8_t *dst,int width,int height)
+    {
+        if(overlaps(src,size_t(width)*height*4,dst,size_t(width)*height*3))
+        {
+            kernel(src,dst,width*height);
+            return;
+        }
+
+        class job: public nya_memory::parallel_job
+        {
+        public:
+            void run(int from,int to) { k(s+size_t(from)*w*4,d+size_t(from)*w*3,(to-from)*w); }
+            job(void (*k)(const uint8_t *,uint8_t *,int),const uint8_t *s,uint8_t *d,int w): k(k),s(s),d(d),w(w) {}
+
+        private:
+            void (*k)(const uint8_t *,uint8_t *,int);
+            const uint8_t *s;
+            uint8_t *d;
+            int w;
+        } j(kernel,src,dst,width);
+
+        for_rows(j,height,width);
+    }
+
+    //3 to 4 channels, returns false if in place
+    bool convert_3_to_4(void (*kernel)(const uint8_t *,uint8_t *,int,uint8_t),const uint8_t *src,uint8_t *dst,int width,int height,uint8_t alpha)
+    {
+        if(overlaps(src,size_t(width)*height*3,dst,size_t(width)*height*4))
+            return false;
+
+        class job: public nya_memory::parallel_job
+        {
+        public:
+            void run(int from,int to) { k(s+size_t(from)*w*3,d+size_t(from)*w*4,(to-from)*w,a); }
+            job(void (*k)(const uint8_t *,uint8_t *,int,uint8_t),const uint8_t *s,uint8_t *d,int w,uint8_t a): k(k),s(s),d(d),w(w),a(a) {}
+
+        private:
+            void (*k)(const uint8_t *,uint8_t *,int,uint8_t);
+            const uint8_t *s;
+            uint8_t *d;
+            int w;
+            uint8_t a;
+        } j(kernel,src,dst,width,alpha);
+
+        for_rows(j,height,width);
+        return true;
+    }
+}
 
 void bitmap_downsample_x(const uint32_t *data32,int width,int height,int channels,uint32_t *out32)
 {
+    const bitmap_kernels &k=get_bitmap_kernels();
+    const uint8_t *data=(const uint8_t *)data32;
+    uint8_t *out=(uint8_t *)out32;
     for(int h=0;h<height;++h)
-    {
-        const uint32_t *hdata=data32+h*width;
-        for(int w=0;w<width/2;++w,hdata+=2)
-            *out32++ = average(hdata[0],hdata[1]);
-    }
+        k.downsample_rgba_x(data+size_t(h)*width*4,width/2,out+size_t(h)*(width/2)*4);
 }
 
 void bitmap_downsample_x(const uint8_t *data,int width,int height,int channels,uint8_t *out)
@@ -37,12 +132,12 @@ void bitmap_downsample_x(const uint8_t *data,int width,int height,int channels,u
 
 void bitmap_downsample_y(const uint32_t *data32,int width,int height,int channels,uint32_t *out32)
 {
+    const bitmap_kernels &k=get_bitmap_kernels();
+    const uint8_t *data=(const uint8_t *)data32;
+    uint8_t *out=(uint8_t *)out32;
+    const size_t stride=size_t(width)*4;
     for(int h=0;h<height/2;++h)
-    {
-        const uint32_t *hdata=data32+h*width*2;
-        for(int w=0;w<width;++w,++hdata)
-            *out32++ = average(hdata[0],hdata[width]);
-    }
+        k.downsample_rgba_y(data+stride*h*2,data+stride*(h*2+1),width,out+stride*h);
 }
 
 void bitmap_downsample_y(const uint8_t *data,int width,int height,int channels,uint8_t *out)
@@ -102,14 +197,29 @@ void bitmap_downsample2x(const uint8_t *data,int width,int height,int channels,u
 
     if(channels==4 && nya_memory::is_aligned(data,4))
     {
-        const uint32_t *data32=(uint32_t *)data;
-        uint32_t *out32=(uint32_t *)out;
-        for(int h=0;h<height/2;++h)
+        class job: public nya_memory::parallel_job
         {
-            const uint32_t *hdata=data32+(h*2)*width;
-            for(int w=0;w<width/2;++w,hdata+=2)
-                *out32++ = average(average(hdata[0],hdata[1]),average(hdata[width],hdata[width+1]));
-        }
+        public:
+            void run(int from,int to)
+            {
+                const size_t stride=size_t(width)*4;
+                for(int h=from;h<to;++h)
+                    k.downsample_rgba_2x2(data+stride*h*2,data+stride*(h*2+1),width/2,out+size_t(width/2)*4*h);
+            }
+
+            job(const uint8_t *data,int width,uint8_t *out): k(get_bitmap_kernels()),data(data),out(out),width(width) {}
+
+        private:
+            const bitmap_kernels &k;
+            const uint8_t *data;
+            uint8_t *out;
+            int width;
+        } j(data,width,out);
+
+        if(data==out)
+            j.run(0,height/2);
+        else
+            for_rows(j,height/2,width);
         return;
     }
 
@@ -162,8 +272,46 @@ void bitmap_flip_vertical(const uint8_t *data,int width,int height,int channels,
         memcpy(out,data,line_size);
 }
 
+namespace
+{
+    class flip_rgba_job: public nya_memory::parallel_job
+    {
+    public:
+        void run(int from,int to)
+        {
+            std::vector<uint8_t> line(src==dst?width*4:0);
+            for(int y=from;y<to;++y)
+            {
+                const size_t offset=size_t(y)*width*4;
+                if(src==dst)
+                {
+                    k.reverse_rgba(src+offset,&line[0],width);
+                    memcpy(dst+offset,&line[0],width*4);
+                }
+                else
+                    k.reverse_rgba(src+offset,dst+offset,width);
+            }
+        }
+
+        flip_rgba_job(const uint8_t *src,uint8_t *dst,int width): k(get_bitmap_kernels()),src(src),dst(dst),width(width) {}
+
+    private:
+        const bitmap_kernels &k;
+        const uint8_t *src;
+        uint8_t *dst;
+        int width;
+    };
+}
+
 void bitmap_flip_horisontal(uint8_t *data,int width,int height,int channels)
 {
+    if(channels==4)
+    {
+        flip_rgba_job job(data,data,width);
+        for_rows(job,height,width);
+        return;
+    }
+
     const int line_size=width*channels;
     const int size=width*height*channels;
     const int half=line_size/2;
@@ -180,6 +328,13 @@ void bitmap_flip_horisontal(uint8_t *data,int width,int height,int channels)
 
 void bitmap_flip_horisontal(const uint8_t *data,int width,int height,int channels,uint8_t *out)
 {
+    if(channels==4 && !overlaps(data,size_t(width)*height*4,out,size_t(width)*height*4))
+    {
+        flip_rgba_job job(data,out,width);
+        for_rows(job,height,width);
+        return;
+    }
+
     const int line_size=width*channels;
     out+=(width-1)*channels;
     for(int y=0;y<height;++y,data+=line_size,out+=line_size)
@@ -208,13 +363,39 @@ void bitmap_rotate_90_left(uint8_t *data,int width,int height,int channels)
     bitmap_flip_horisontal(data,width,height,channels);
 }
 
-void bitmap_rotate_90_left(const uint8_t *data,int width,int height,int channels,uint8_t *out)
+namespace
 {
-    for(int x=0;x<height;++x)
+    class rotate_job: public nya_memory::parallel_job
     {
-        for(int y=0;y<width;++y,data+=channels)
-            memcpy(out+(y*height+height-x-1)*channels,data,channels);
-    }
+    public:
+        void run(int from,int to)
+        {
+            for(int x=from;x<to;++x)
+            {
+                const uint8_t *d=data+size_t(x)*width*channels;
+                for(int y=0;y<width;++y,d+=channels)
+                {
+                    const int idx=left?(y*height+height-x-1):((width-y-1)*height+x);
+                    memcpy(out+size_t(idx)*channels,d,channels);
+                }
+            }
+        }
+
+        rotate_job(const uint8_t *data,int width,int height,int channels,uint8_t *out,bool left):
+                   data(data),out(out),width(width),height(height),channels(channels),left(left) {}
+
+    private:
+        const uint8_t *data;
+        uint8_t *out;
+        int width,height,channels;
+        bool left;
+    };
+}
+
+void bitmap_rotate_90_left(const uint8_t *data,int width,int height,int channels,uint8_t *out)
+{
+    rotate_job job(data,width,height,channels,out,true);
+    for_rows(job,height,width);
 }
 
 void bitmap_rotate_90_right(uint8_t *data,int width,int height,int channels)
@@ -238,11 +419,8 @@ void bitmap_rotate_90_right(uint8_t *data,int width,int height,int channels)
 
 void bitmap_rotate_90_right(const uint8_t *data,int width,int height,int channels,uint8_t *out)
 {
-    for(int x=0;x<height;++x)
-    {
-        for(int y=0;y<width;++y,data+=channels)
-            memcpy(out+((width-y-1)*height+x)*channels,data,channels);
-    }
+    rotate_job job(data,width,height,channels,out,false);
+    for_rows(job,height,width);
 }
 
 void bitmap_rotate_180(uint8_t *data,int width,int height,int channels)
@@ -270,6 +448,30 @@ void bitmap_rotate_180(uint8_t *data,int width,int height,int channels)
 
 void bitmap_rotate_180(const uint8_t *data,int width,int height,int channels,uint8_t *out)
 {
+    if(channels==4 && !overlaps(data,size_t(width)*height*4,out,size_t(width)*height*4))
+    {
+        class job: public nya_memory::parallel_job
+        {
+        public:
+            void run(int from,int to)
+            {
+                for(int y=from;y<to;++y)
+                    k.reverse_rgba(data+size_t(y)*width*4,out+size_t(height-y-1)*width*4,width);
+            }
+
+            job(const uint8_t *data,int width,int height,uint8_t *out): k(get_bitmap_kernels()),data(data),out(out),width(width),height(height) {}
+
+        private:
+            const bitmap_kernels &k;
+            const uint8_t *data;
+            uint8_t *out;
+            int width,height;
+        } j(data,width,height,out);
+
+        for_rows(j,height,width);
+        return;
+    }
+
     out+=(height-1)*width*channels+(width-1)*channels;
     for(int i=0;i<width*height;++i,out-=channels,data+=channels)
         memcpy(out,data,channels);
@@ -335,10 +537,15 @@ void bitmap_rgb_to_bgr(uint8_t *data,int width,int height,int channels)
     if(channels<3)
         return;
 
-    if(channels==4 && nya_memory::is_aligned(data,4))
+    if(channels==4)
     {
-        for(const uint8_t *to=data+width*height*4;data<to;data+=4)
-            *(uint32_t*)(data) =(data[0]<<16)|(data[1]<<8)|data[2]|(data[3]<<24);
+        convert(get_bitmap_kernels().swap_rb_rgba,data,data,width,height,4);
+        return;
+    }
+
+    if(channels==3)
+    {
+        convert(get_bitmap_kernels().swap_rb_rgb,data,data,width,height,3);
         return;
     }
 
@@ -353,28 +560,9 @@ void bitmap_rgb_to_bgr(uint8_t *data,int width,int height,int channels)
 void bitmap_rgb_to_bgr(const uint8_t *data,int width,int height,int channels,uint8_t *out)
 {
     if(channels==3)
-    {
-        for(int i=0;i<width*height;++i,data+=3,out+=3)
-            out[0]=data[2],out[1]=data[1],out[2]=data[0];
-    }
+        convert(get_bitmap_kernels().swap_rb_rgb,data,out,width,height,3);
     else if(channels==4)
-    {
-        if(nya_memory::is_aligned(out,4))
-        {
-            uint32_t *out32=(uint32_t *)out;
-            for(const uint8_t *to=data+width*height*4;data<to;data+=4)
-                *out32++ =(data[0]<<16)|(data[1]<<8)|data[2]|(data[3]<<24);
-            return;
-        }
-
-        for(int i=0;i<width*height;++i,data+=4,out+=4)
-        {
-            out[0]=data[2];
-            out[1]=data[1];
-            out[2]=data[0];
-            out[3]=data[3];
-        }
-    }
+        convert(get_bitmap_kernels().swap_rb_rgba,data,out,width,height,4);
     else
         memcpy(out,data,width*height*channels);
 }
@@ -386,47 +574,24 @@ void bitmap_rgba_to_rgb(uint8_t *data,int width,int height)
 
 void bitmap_rgba_to_rgb(const uint8_t *data,int width,int height,uint8_t *out)
 {
-    for(const uint8_t *to=data+width*height*4;data<to;data+=4,out+=3)
-    {
-        out[0]=data[0];
-        out[1]=data[1];
-        out[2]=data[2];
-    }
+    convert_4_to_3(get_bitmap_kernels().rgba_to_rgb,data,out,width,height);
 }
 
 void bitmap_bgra_to_rgb(uint8_t *data,int width,int height)
 {
-    const uint8_t *to=data+width*height*4;
-    uint8_t *out=data;
-
-    for(int i=0;i<2 && data<to;++i,data+=4,out+=3)
-    {
-        const uint8_t r=data[0];
-        out[0]=data[2];
-        out[1]=data[1];
-        out[2]=r;
-    }
-
-    for(;data<to;data+=4,out+=3)
-    {
-        out[0]=data[2];
-        out[1]=data[1];
-        out[2]=data[0];
-    }
+    bitmap_bgra_to_rgb(data,width,height,data);
 }
 
 void bitmap_bgra_to_rgb(const uint8_t *data,int width,int height,uint8_t *out)
 {
-    for(const uint8_t *to=data+width*height*4;data<to;data+=4,out+=3)
-    {
-        out[0]=data[2];
-        out[1]=data[1];
-        out[2]=data[0];
-    }
+    convert_4_to_3(get_bitmap_kernels().bgra_to_rgb,data,out,width,height);
 }
 
 void bitmap_rgb_to_rgba(const uint8_t *data,int width,int height,uint8_t alpha,uint8_t *out)
 {
+    if(convert_3_to_4(get_bitmap_kernels().rgb_to_rgba,data,out,width,height,alpha))
+        return;
+
     data+=width*height*3;
     out+=width*height*4;
     for(int i=0;i<width*height;++i)
@@ -441,6 +606,9 @@ void bitmap_rgb_to_rgba(const uint8_t *data,int width,int height,uint8_t alpha,u
 
 void bitmap_rgb_to_bgra(const uint8_t *data,int width,int height,uint8_t alpha,uint8_t *out)
 {
+    if(convert_3_to_4(get_bitmap_kernels().rgb_to_bgra,data,out,width,height,alpha))
+        return;
+
     data+=width*height*3;
     out+=width*height*4;
     for(int i=0;i<width*height;++i)
@@ -460,14 +628,7 @@ void bitmap_argb_to_rgba(uint8_t *data,int width,int height)
 
 void bitmap_argb_to_rgba(const uint8_t *data,int width,int height,uint8_t *out)
 {
-    const uint32_t *data32=(uint32_t *)data;
-    uint32_t *out32=(uint32_t *)out;
-    const uint32_t *to=data32+width*height;
-    while(data32<to)
-    {
-        const uint32_t c= *data32++;
-        *out32++ =c<<24|c>>8;
-    }
+    convert(get_bitmap_kernels().argb_to_rgba,data,out,width,height,4);
 }
 
 void bitmap_argb_to_bgra(uint8_t *data,int width,int height)
@@ -477,37 +638,49 @@ void bitmap_argb_to_bgra(uint8_t *data,int width,int height)
 
 void bitmap_argb_to_bgra(const uint8_t *data,int width,int height,uint8_t *out)
 {
-    const uint32_t *data32=(uint32_t *)data;
-    uint32_t *out32=(uint32_t *)out;
-    const uint32_t *to=data32+width*height;
-    while(data32<to)
-    {
-        const uint32_t c= *data32++;
-        *out32++ =c<<24|(c<<8 & 0x00FF0000)|(c>>8 & 0x0000FF00)|c>>24;
-    }
+    convert(get_bitmap_kernels().argb_to_bgra,data,out,width,height,4);
 }
 
-inline void color_to_yuv420(const uint8_t *data[3],int width,int height,int channels,uint8_t *out)
+class color_to_yuv420_job: public nya_memory::parallel_job
 {
-    int image_size=width*height;
-    uint8_t *dst_y=out;
-    uint8_t *dst_u=dst_y+image_size;
-    uint8_t *dst_v=dst_u+image_size/4;
-    image_size*=channels;
-
-    for(int i=0;i<image_size;i+=channels)
-        *dst_y++ =((66*data[0][i] + 129*data[1][i] + 25*data[2][i])>>8)+16;
-
-    const int stride=width*channels;
-    const int channels2=channels*2;
-    for(int y=0,i=0;y<height;y+=2,i+=stride)
+public:
+    //one job row is two image rows and one chroma row
+    void run(int from,int to)
     {
-        for(int x=0;x<width;x+=2,i+=channels2)
+        const int image_size=width*height;
+        const int stride=width*channels;
+        const int channels2=channels*2;
+        const int half_width=(width+1)/2;
+        for(int k=from;k<to;++k)
         {
-            *dst_u++ =((-38*data[0][i] - 74*data[1][i] + 112*data[2][i])>>8)+128;
-            *dst_v++ =((112*data[0][i] - 94*data[1][i] -  18*data[2][i])>>8)+128;
+            uint8_t *dst_y=out+k*2*width;
+            const int y_to=(k*2+2<height?k*2+2:height)*stride;
+            for(int i=k*2*stride;i<y_to;i+=channels)
+                *dst_y++ =((66*data[0][i] + 129*data[1][i] + 25*data[2][i])>>8)+16;
+
+            uint8_t *dst_u=out+image_size+k*half_width;
+            uint8_t *dst_v=out+image_size+image_size/4+k*half_width;
+            for(int x=0,i=k*(stride+half_width*channels2);x<width;x+=2,i+=channels2)
+            {
+                *dst_u++ =((-38*data[0][i] - 74*data[1][i] + 112*data[2][i])>>8)+128;
+                *dst_v++ =((112*data[0][i] - 94*data[1][i] -  18*data[2][i])>>8)+128;
+            }
         }
     }
+
+    color_to_yuv420_job(const uint8_t *data[3],int width,int height,int channels,uint8_t *out):
+                        width(width),height(height),channels(channels),out(out) { for(int i=0;i<3;++i) this->data[i]=data[i]; }
+
+private:
+    const uint8_t *data[3];
+    int width,height,channels;
+    uint8_t *out;
+};
+
+inline void color_to_yuv420(const uint8_t *data[3],int width,int height,int channels,uint8_t *out)
+{
+    color_to_yuv420_job job(data,width,height,channels,out);
+    for_rows(job,(height+1)/2,width*2);
 }
 
 void bitmap_rgb_to_yuv420(const uint8_t *data,int width,int height,int channels,uint8_t *out)
@@ -530,30 +703,48 @@ inline uint8_t clamp(int c) { return c<0?0:(c>255?255:c); }
 
 void bitmap_yuv420_to_rgb(const uint8_t *data,int width,int height,uint8_t *out)
 {
-    const size_t image_size=width*height;
-    const uint8_t *udata=data+image_size;
-    const uint8_t *vdata=udata+image_size/4;
-    const int half_width=width/2;
-
-    for(int y=0;y<height;++y)
+    class job: public nya_memory::parallel_job
     {
-        const int hidx=y/2*half_width;
-        for(int x=0;x<width;++x)
+    public:
+        void run(int from,int to)
         {
-            const int y0=(int)*data++;
-            const int idx=hidx+x/2;
-            const int u0=(int)udata[idx]-128;
-            const int v0=(int)vdata[idx]-128;
-
-            const int y1=1192*(y0>16?y0-16:0);
-            const int u1=400*u0, u2=2066*u0;
-            const int v1=1634*v0, v2=832*v0;
-
-            *out++ =clamp((y1+v1)>>10);
-            *out++ =clamp((y1-v2-u1)>>10);
-            *out++ =clamp((y1+u2)>>10);
+            const size_t image_size=width*height;
+            const uint8_t *udata=data+image_size;
+            const uint8_t *vdata=udata+image_size/4;
+            const int half_width=width/2;
+
+            for(int y=from;y<to;++y)
+            {
+                const uint8_t *ydata=data+size_t(y)*width;
+                uint8_t *o=out+size_t(y)*width*3;
+                const int hidx=y/2*half_width;
+                for(int x=0;x<width;++x)
+                {
+                    const int y0=(int)*ydata++;
+                    const int idx=hidx+x/2;
+                    const int u0=(int)udata[idx]-128;
+                    const int v0=(int)vdata[idx]-128;
+
+                    const int y1=1192*(y0>16?y0-16:0);
+                    const int u1=400*u0, u2=2066*u0;
+                    const int v1=1634*v0, v2=832*v0;
+
+                    *o++ =clamp((y1+v1)>>10);
+                    *o++ =clamp((y1-v2-u1)>>10);
+                    *o++ =clamp((y1+u2)>>10);
+                }
+            }
         }
-    }
+
+        job(const uint8_t *data,int width,int height,uint8_t *out): data(data),out(out),width(width),height(height) {}
+
+    private:
+        const uint8_t *data;
+        uint8_t *out;
+        int width,height;
+    } j(data,width,height,out);
+
+    for_rows(j,height,width);
 }
     
 bool bitmap_is_full_alpha(const uint8_t *data,int width,int height)
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 namespace nya_render
 {
@@ -52,4 +53,37 @@ void bitmap_yuv420_to_rgb(const uint8_t *data,int width,int height,uint8_t *out)
 
 bool bitmap_is_full_alpha(const uint8_t *data,int width,int height);
 
+enum bitmap_mip_filter
+{
+    bitmap_mip_filter_box,
+    bitmap_mip_filter_kaiser,
+    bitmap_mip_filter_lanczos
+};
+
+struct bitmap_mip_settings
+{
+    bitmap_mip_filter filter;
+    bool srgb; //color channels are averaged in linear space
+    bool wrap; //filter samples wrap around edges instead of clamping
+    float alpha_coverage; //if >0, keeps the share of pixels with alpha above this value in every mip
+
+    bitmap_mip_settings(): filter(bitmap_mip_filter_box),srgb(false),wrap(false),alpha_coverage(0.0f) {}
+};
+
+int bitmap_get_mip_count(int width,int height); //full chain down to 1x1
+size_t bitmap_get_mip_chain_size(int width,int height,int channels,int mip_count);
+
+//out receives mip_count levels one after another, beginning with a copy of data; mip_count= -1 for the full chain
+//alpha is the last channel for 2 and 4 channels, levels are tiled across the shared thread pool
+void bitmap_build_mip_chain(const uint8_t *data,int width,int height,int channels,int mip_count,
+                            const bitmap_mip_settings &settings,uint8_t *out);
+
+//rgba input, blocks are encoded in parallel on the shared thread pool
+//out size is bitmap_compressed_size(), block size is 8 for dxt1 and etc1, 16 for dxt5 and etc2_eac
+void bitmap_compress_dxt1(const uint8_t *data,int width,int height,uint8_t *out);
+void bitmap_compress_dxt5(const uint8_t *data,int width,int height,uint8_t *out);
+void bitmap_compress_etc1(const uint8_t *data,int width,int height,uint8_t *out); //also valid etc2 rgb
+void bitmap_compress_etc2_eac(const uint8_t *data,int width,int height,uint8_t *out);
+size_t bitmap_compressed_size(int width,int height,int block_size);
+
 }
@@ -0,0 +1,432 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "bitmap.h"
+#include "bitmap_simd.h"
+#include "memory/thread_pool.h"
+#include <string.h>
+
+namespace nya_render
+{
+
+namespace
+{
+
+typedef unsigned char uchar;
+
+inline int clamp255(int c) { return c<0?0:(c>255?255:c); }
+
+//reads 4x4 block, repeating edge pixels for partial blocks
+void fetch_block(const uint8_t *rgba,int width,int height,int bx,int by,uchar block[16][4])
+{
+    for(int y=0;y<4;++y)
+    {
+        const int sy=by+y<height?by+y:height-1;
+        for(int x=0;x<4;++x)
+        {
+            const int sx=bx+x<width?bx+x:width-1;
+            memcpy(block[y*4+x],rgba+(sy*width+sx)*4,4);
+        }
+    }
+}
+
+//planar rgb for the block kernels
+void get_planar(const uchar block[16][4],const int *pixels,int count,int16_t *rgb)
+{
+    for(int i=0;i<count;++i)
+    {
+        const uchar *p=block[pixels?pixels[i]:i];
+        rgb[i]=p[0], rgb[count+i]=p[1], rgb[count*2+i]=p[2];
+    }
+}
+
+//dxt
+
+inline int to565(int r,int g,int b) { return ((r*31+127)/255)<<11 | ((g*63+127)/255)<<5 | ((b*31+127)/255); }
+
+inline void from565(int c,int *rgb)
+{
+    const int r=(c>>11)&0x1f, g=(c>>5)&0x3f, b=c&0x1f;
+    rgb[0]=(r<<3)|(r>>2);
+    rgb[1]=(g<<2)|(g>>4);
+    rgb[2]=(b<<3)|(b>>2);
+}
+
+//range fit: endpoints are the extremes of block colors projected on the principal axis
+void compress_dxt_color(const bitmap_kernels &k,const uchar block[16][4],uchar *out)
+{
+    float mean[3]={0.0f,0.0f,0.0f};
+    int mn[3]={255,255,255},mx[3]={0,0,0};
+    for(int i=0;i<16;++i)
+    {
+        for(int c=0;c<3;++c)
+        {
+            mean[c]+=block[i][c];
+            if(block[i][c]<mn[c]) mn[c]=block[i][c];
+            if(block[i][c]>mx[c]) mx[c]=block[i][c];
+        }
+    }
+
+    for(int c=0;c<3;++c)
+        mean[c]*=1.0f/16.0f;
+
+    float cov[6]={0.0f};
+    for(int i=0;i<16;++i)
+    {
+        const float r=block[i][0]-mean[0], g=block[i][1]-mean[1], b=block[i][2]-mean[2];
+        cov[0]+=r*r, cov[1]+=r*g, cov[2]+=r*b;
+        cov[3]+=g*g, cov[4]+=g*b, cov[5]+=b*b;
+    }
+
+    float axis[3]={float(mx[0]-mn[0]),float(mx[1]-mn[1]),float(mx[2]-mn[2])};
+    for(int i=0;i<4;++i)
+    {
+        const float x=axis[0]*cov[0]+axis[1]*cov[1]+axis[2]*cov[2];
+        const float y=axis[0]*cov[1]+axis[1]*cov[3]+axis[2]*cov[4];
+        const float z=axis[0]*cov[2]+axis[1]*cov[4]+axis[2]*cov[5];
+        float m=x>0?x:-x;
+        if((y>0?y:-y)>m) m=y>0?y:-y;
+        if((z>0?z:-z)>m) m=z>0?z:-z;
+        if(m<0.0001f)
+            break;
+
+        axis[0]=x/m, axis[1]=y/m, axis[2]=z/m;
+    }
+
+    int min_idx=0,max_idx=0;
+    float min_dot=1e+30f,max_dot=-1e+30f;
+    for(int i=0;i<16;++i)
+    {
+        const float d=block[i][0]*axis[0]+block[i][1]*axis[1]+block[i][2]*axis[2];
+        if(d<min_dot) min_dot=d,min_idx=i;
+        if(d>max_dot) max_dot=d,max_idx=i;
+    }
+
+    int c0[3],c1[3];
+    for(int c=0;c<3;++c)
+    {
+        const int inset=(block[max_idx][c]-block[min_idx][c])/16;
+        c0[c]=clamp255(block[max_idx][c]-inset);
+        c1[c]=clamp255(block[min_idx][c]+inset);
+    }
+
+    int a=to565(c0[0],c0[1],c0[2]), b=to565(c1[0],c1[1],c1[2]);
+    uint32_t indices=0;
+    if(a!=b)
+    {
+        if(a<b)
+        {
+            const int t=a; a=b; b=t;
+        }
+
+        int palette[4][3];
+        from565(a,palette[0]);
+        from565(b,palette[1]);
+        for(int c=0;c<3;++c)
+        {
+            palette[2][c]=(palette[0][c]*2+palette[1][c])/3;
+            palette[3][c]=(palette[0][c]+palette[1][c]*2)/3;
+        }
+
+        int16_t rgb[48];
+        get_planar(block,0,16,rgb);
+        indices=k.dxt_color_indices(rgb,palette[0]);
+    }
+
+    out[0]=a&0xff, out[1]=a>>8;
+    out[2]=b&0xff, out[3]=b>>8;
+    for(int i=0;i<4;++i)
+        out[4+i]=(indices>>(i*8))&0xff;
+}
+
+void compress_dxt5_alpha(const uchar block[16][4],uchar *out)
+{
+    int mn=255,mx=0;
+    for(int i=0;i<16;++i)
+    {
+        if(block[i][3]<mn) mn=block[i][3];
+        if(block[i][3]>mx) mx=block[i][3];
+    }
+
+    out[0]=mx, out[1]=mn;
+    memset(out+2,0,6);
+    if(mx==mn)
+        return;
+
+    int codes[8];
+    codes[0]=mx, codes[1]=mn;
+    for(int i=1;i<7;++i)
+        codes[i+1]=((7-i)*mx+i*mn)/7;
+
+    uint64_t indices=0;
+    for(int i=15;i>=0;--i)
+    {
+        int best=0,best_err=256;
+        for(int j=0;j<8;++j)
+        {
+            const int err=block[i][3]>codes[j]?block[i][3]-codes[j]:codes[j]-block[i][3];
+            if(err<best_err)
+                best_err=err,best=j;
+        }
+        indices=(indices<<3)|best;
+    }
+
+    for(int i=0;i<6;++i)
+        out[2+i]=(indices>>(i*8))&0xff;
+}
+
+//etc
+
+const int etc_modifiers[8][2]={{2,8},{5,17},{9,29},{13,42},{18,60},{24,80},{33,106},{47,183}};
+
+//returns error, fills table index and per-pixel 2-bit selectors
+int fit_etc_subblock(const bitmap_kernels &k,const uchar block[16][4],const int *pixels,const int *base,int &table,int *selectors)
+{
+    int16_t rgb[24];
+    get_planar(block,pixels,8,rgb);
+
+    int best_err=0x7fffffff;
+    for(int t=0;t<8;++t)
+    {
+        const int mods[4]={etc_modifiers[t][0],etc_modifiers[t][1],-etc_modifiers[t][0],-etc_modifiers[t][1]};
+        int colors[4][3];
+        for(int m=0;m<4;++m)
+        {
+            for(int c=0;c<3;++c)
+                colors[m][c]=clamp255(base[c]+mods[m]);
+        }
+
+        int sel[8];
+        const int err=k.etc_subblock_error(rgb,colors[0],sel);
+        if(err<best_err)
+        {
+            best_err=err;
+            table=t;
+            memcpy(selectors,sel,sizeof(sel));
+        }
+    }
+
+    return best_err;
+}
+
+inline void write_be64(uint64_t v,uchar *out)
+{
+    for(int i=0;i<8;++i)
+        out[i]=(v>>(56-i*8))&0xff;
+}
+
+void compress_etc1(const bitmap_kernels &k,const uchar block[16][4],uchar *out)
+{
+    uint64_t best_block=0;
+    int best_err=0x7fffffff;
+
+    for(int flip=0;flip<2;++flip)
+    {
+        int pixels[2][8];
+        for(int s=0;s<2;++s)
+        {
+            for(int i=0;i<8;++i)
+            {
+                //flip=0: 2x4 side by side, flip=1: 4x2 one above another
+                const int x=flip?i%4:s*2+i%2;
+                const int y=flip?s*2+i/4:i/2;
+                pixels[s][i]=y*4+x;
+            }
+        }
+
+        int avg[2][3];
+        for(int s=0;s<2;++s)
+        {
+            for(int c=0;c<3;++c)
+            {
+                int sum=0;
+                for(int i=0;i<8;++i)
+                    sum+=block[pixels[s][i]][c];
+                avg[s][c]=(sum+4)/8;
+            }
+        }
+
+        int q[2][3],base[2][3];
+        bool diff=true;
+        for(int c=0;c<3;++c)
+        {
+            q[0][c]=(avg[0][c]*31+127)/255;
+            q[1][c]=(avg[1][c]*31+127)/255;
+            const int d=q[1][c]-q[0][c];
+            if(d<-4 || d>3)
+                diff=false;
+        }
+
+        for(int s=0;s<2;++s)
+        {
+            for(int c=0;c<3;++c)
+            {
+                if(diff)
+                    base[s][c]=(q[s][c]<<3)|(q[s][c]>>2);
+                else
+                {
+                    q[s][c]=(avg[s][c]*15+127)/255;
+                    base[s][c]=(q[s][c]<<4)|q[s][c];
+                }
+            }
+        }
+
+        int tables[2],selectors[2][8];
+        int err=0;
+        for(int s=0;s<2;++s)
+            err+=fit_etc_subblock(k,block,pixels[s],base[s],tables[s],selectors[s]);
+
+        if(err>=best_err)
+            continue;
+
+        best_err=err;
+        uint64_t b=0;
+        for(int c=0;c<3;++c)
+        {
+            const int shift=59-c*8;
+            if(diff)
+                b|=uint64_t(q[0][c])<<shift | uint64_t((q[1][c]-q[0][c])&7)<<(shift-3);
+            else
+                b|=uint64_t(q[0][c])<<(shift+1) | uint64_t(q[1][c])<<(shift-3);
+        }
+
+        b|=uint64_t(tables[0])<<37 | uint64_t(tables[1])<<34;
+        b|=uint64_t(diff?1:0)<<33 | uint64_t(flip)<<32;
+
+        for(int s=0;s<2;++s)
+        {
+            for(int i=0;i<8;++i)
+            {
+                //selector is msb,lsb pair: +a,+b,-a,-b
+                const int p=pixels[s][i], bit=(p%4)*4+p/4, code=selectors[s][i];
+                b|=uint64_t(code>>1)<<(bit+16) | uint64_t(code&1)<<bit;
+            }
+        }
+
+        best_block=b;
+    }
+
+    write_be64(best_block,out);
+}
+
+const int eac_modifiers[16][8]=
+{
+    {-3,-6,-9,-15,2,5,8,14},{-3,-7,-10,-13,2,6,9,12},{-2,-5,-8,-13,1,4,7,12},{-2,-4,-6,-13,1,3,5,12},
+    {-3,-6,-8,-12,2,5,7,11},{-3,-7,-9,-11,2,6,8,10},{-4,-7,-8,-11,3,6,7,10},{-3,-5,-8,-11,2,4,7,10},
+    {-2,-6,-8,-10,1,5,7,9},{-2,-5,-8,-10,1,4,7,9},{-2,-4,-8,-10,1,3,7,9},{-2,-5,-7,-10,1,4,6,9},
+    {-3,-4,-7,-10,2,3,6,9},{-1,-2,-3,-10,0,1,2,9},{-4,-6,-8,-9,3,5,7,8},{-3,-5,-7,-9,2,4,6,8}
+};
+
+void compress_eac_alpha(const bitmap_kernels &k,const uchar block[16][4],uchar *out)
+{
+    int mn=255,mx=0;
+    for(int i=0;i<16;++i)
+    {
+        if(block[i][3]<mn) mn=block[i][3];
+        if(block[i][3]>mx) mx=block[i][3];
+    }
+
+    //column-major, the order of the indices
+    uint8_t alpha[16];
+    for(int x=0;x<4;++x) for(int y=0;y<4;++y)
+        alpha[x*4+y]=block[y*4+x][3];
+
+    const int base=(mn+mx+1)/2;
+    int best_err=0x7fffffff,best_table=13,best_mul=1;
+    uint64_t best_indices=0;
+
+    for(int t=0;t<16 && best_err>0;++t)
+    {
+        const int range=eac_modifiers[t][7]-eac_modifiers[t][3];
+        const int mul0=(mx-mn+range/2)/range;
+        for(int mul=mul0-1;mul<=mul0+1;++mul)
+        {
+            if(mul<1 || mul>15)
+                continue;
+
+            uint8_t values[8],sel[16];
+            for(int m=0;m<8;++m)
+                values[m]=clamp255(base+eac_modifiers[t][m]*mul);
+
+            const int err=k.eac_alpha_error(alpha,values,sel);
+            if(err>=best_err)
+                continue;
+
+            uint64_t indices=0;
+            for(int i=0;i<16;++i)
+                indices=(indices<<3)|sel[i];
+
+            best_err=err,best_table=t,best_mul=mul,best_indices=indices;
+        }
+    }
+
+    write_be64(uint64_t(base)<<56 | uint64_t(best_mul)<<52 | uint64_t(best_table)<<48 | best_indices,out);
+}
+
+enum block_format
+{
+    block_dxt1,
+    block_dxt5,
+    block_etc1,
+    block_etc2_eac
+};
+
+class compress_job: public nya_memory::parallel_job
+{
+public:
+    void run(int from,int to)
+    {
+        const int blocks_x=(width+3)/4;
+        const int block_size=(format==block_dxt1 || format==block_etc1)?8:16;
+        const bitmap_kernels &k=get_bitmap_kernels();
+        uchar block[16][4];
+        for(int by=from;by<to;++by)
+        {
+            uint8_t *o=out+by*blocks_x*block_size;
+            for(int bx=0;bx<blocks_x;++bx,o+=block_size)
+            {
+                fetch_block(data,width,height,bx*4,by*4,block);
+                switch(format)
+                {
+                    case block_dxt1: compress_dxt_color(k,block,o); break;
+                    case block_dxt5: compress_dxt5_alpha(block,o); compress_dxt_color(k,block,o+8); break;
+                    case block_etc1: compress_etc1(k,block,o); break;
+                    case block_etc2_eac: compress_eac_alpha(k,block,o); compress_etc1(k,block,o+8); break;
+                }
+            }
+        }
+    }
+
+public:
+    const uint8_t *data;
+    int width,height;
+    block_format format;
+    uint8_t *out;
+};
+
+void compress(const uint8_t *data,int width,int height,block_format format,uint8_t *out)
+{
+    if(!data || !out || width<=0 || height<=0)
+        return;
+
+    compress_job job;
+    job.data=data;
+    job.width=width;
+    job.height=height;
+    job.format=format;
+    job.out=out;
+    nya_memory::parallel_for(job,(height+3)/4,4);
+}
+
+}
+
+void bitmap_compress_dxt1(const uint8_t *data,int width,int height,uint8_t *out) { compress(data,width,height,block_dxt1,out); }
+void bitmap_compress_dxt5(const uint8_t *data,int width,int height,uint8_t *out) { compress(data,width,height,block_dxt5,out); }
+void bitmap_compress_etc1(const uint8_t *data,int width,int height,uint8_t *out) { compress(data,width,height,block_etc1,out); }
+void bitmap_compress_etc2_eac(const uint8_t *data,int width,int height,uint8_t *out) { compress(data,width,height,block_etc2_eac,out); }
+
+size_t bitmap_compressed_size(int width,int height,int block_size)
+{
+    return size_t((width+3)/4)*size_t((height+3)/4)*block_size;
+}
+
+}
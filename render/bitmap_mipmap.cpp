@@ -0,0 +1,429 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "bitmap.h"
+#include "memory/thread_pool.h"
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+namespace nya_render
+{
+
+namespace
+{
+    const int tile_size=64;
+    const float filter_radius=3.0f; //kaiser and lanczos, in destination pixels
+    const float kaiser_alpha=4.0f;
+    const int coverage_bins=4096;
+
+    struct srgb_tables
+    {
+        float to_linear[256];
+        float thresholds[255]; //linear value between neighbour srgb codes
+
+        srgb_tables()
+        {
+            for(int i=0;i<256;++i)
+                to_linear[i]=decode(i/255.0f);
+            for(int i=0;i<255;++i)
+                thresholds[i]=decode((i+0.5f)/255.0f);
+        }
+
+        static float decode(float c) { return c<=0.04045f?c/12.92f:powf((c+0.055f)/1.055f,2.4f); }
+    };
+
+    const srgb_tables &get_srgb_tables()
+    {
+        static srgb_tables tables;
+        return tables;
+    }
+
+    struct unorm_table
+    {
+        float to_float[256];
+        unorm_table() { for(int i=0;i<256;++i) to_float[i]=i/255.0f; }
+    };
+
+    const float *get_unorm_table()
+    {
+        static unorm_table table;
+        return table.to_float;
+    }
+
+    inline uint8_t encode_srgb(float v,const float *thresholds)
+    {
+        int lo=0,hi=255;
+        while(lo<hi)
+        {
+            const int mid=(lo+hi)/2;
+            if(v>thresholds[mid])
+                lo=mid+1;
+            else
+                hi=mid;
+        }
+        return (uint8_t)lo;
+    }
+
+    inline uint8_t encode_unorm(float v)
+    {
+        if(v<=0.0f)
+            return 0;
+        if(v>=1.0f)
+            return 255;
+        return (uint8_t)(v*255.0f+0.5f);
+    }
+
+    inline float sinc(float x)
+    {
+        if(fabsf(x)<1e-5f)
+            return 1.0f;
+        x*=3.14159265f;
+        return sinf(x)/x;
+    }
+
+    inline float bessel_i0(float x)
+    {
+        float sum=1.0f,term=1.0f;
+        const float x2=x*x*0.25f;
+        for(int k=1;k<32;++k)
+        {
+            term*=x2/float(k*k);
+            sum+=term;
+            if(term<sum*1e-7f)
+                break;
+        }
+        return sum;
+    }
+
+    float filter_weight(bitmap_mip_filter filter,float t)
+    {
+        t=fabsf(t);
+        if(t>=filter_radius)
+            return 0.0f;
+
+        if(filter==bitmap_mip_filter_lanczos)
+            return sinc(t)*sinc(t/filter_radius);
+
+        const float r=t/filter_radius;
+        return sinc(t)*bessel_i0(kaiser_alpha*sqrtf(1.0f-r*r))/bessel_i0(kaiser_alpha);
+    }
+
+    inline int resolve(int idx,int size,bool wrap)
+    {
+        if(wrap)
+            return ((idx%size)+size)%size;
+
+        return idx<0?0:(idx>=size?size-1:idx);
+    }
+
+    //per destination pixel weights along one axis
+    struct filter_taps
+    {
+        int taps;
+        std::vector<int> first; //unresolved source index of the first tap
+        std::vector<int> index; //resolved source indices
+        std::vector<float> weights;
+
+        void build(int src_size,int dst_size,bitmap_mip_filter filter,bool wrap)
+        {
+            const float scale=float(src_size)/dst_size;
+            const float support=filter==bitmap_mip_filter_box?0.5f*scale:filter_radius*scale;
+            taps=int(ceilf(support*2.0f))+1;
+
+            first.resize(dst_size);
+            index.resize(size_t(dst_size)*taps);
+            weights.resize(size_t(dst_size)*taps);
+
+            for(int x=0;x<dst_size;++x)
+            {
+                const float center=(x+0.5f)*scale;
+                const int f=int(floorf(center-support));
+                first[x]=f;
+
+                float *w=&weights[size_t(x)*taps];
+                float sum=0.0f;
+                for(int i=0;i<taps;++i)
+                {
+                    const float s=float(f+i);
+                    if(filter==bitmap_mip_filter_box)
+                    {
+                        const float from=s>center-support?s:center-support;
+                        const float to=s+1.0f<center+support?s+1.0f:center+support;
+                        w[i]=to>from?to-from:0.0f;
+                    }
+                    else
+                        w[i]=filter_weight(filter,(s+0.5f-center)/scale);
+
+                    sum+=w[i];
+                    index[size_t(x)*taps+i]=resolve(f+i,src_size,wrap);
+                }
+
+                if(sum!=0.0f)
+                {
+                    for(int i=0;i<taps;++i)
+                        w[i]/=sum;
+                }
+            }
+        }
+    };
+
+    struct level_desc
+    {
+        int width,height,channels;
+        int alpha_channel; //-1 if none
+        bool wrap;
+    };
+
+    //source level is either 8-bit with per-channel decode tables or float, the channel only selects the table
+    struct source_bytes
+    {
+        const uint8_t *data;
+        const float *tables[4];
+
+        float get(size_t idx,int c) const { return tables[c][data[idx]]; }
+    };
+
+    struct source_floats
+    {
+        const float *data;
+
+        float get(size_t idx,int) const { return data[idx]; }
+    };
+
+    //filters one level into dst floats tile by tile, each tile keeps its horizontal pass in a local buffer
+    template<typename source> class filter_job: public nya_memory::parallel_job
+    {
+    public:
+        void run(int from,int to)
+        {
+            std::vector<float> rows;
+            for(int t=from;t<to;++t)
+                filter_tile(t%tiles_x*tile_size,t/tiles_x*tile_size,rows);
+        }
+
+        void filter_tile(int x0,int y0,std::vector<float> &rows)
+        {
+            const int x1=x0+tile_size<dst.width?x0+tile_size:dst.width;
+            const int y1=y0+tile_size<dst.height?y0+tile_size:dst.height;
+            const int ch=src.channels;
+            const int tile_w=x1-x0;
+
+            const int ry0=vtaps.first[y0];
+            const int ry1=vtaps.first[y1-1]+vtaps.taps;
+            rows.resize(size_t(ry1-ry0)*tile_w*ch);
+
+            for(int ry=ry0;ry<ry1;++ry)
+            {
+                const size_t src_row=size_t(resolve(ry,src.height,src.wrap))*src.width;
+                float *out=&rows[size_t(ry-ry0)*tile_w*ch];
+                for(int x=x0;x<x1;++x,out+=ch)
+                {
+                    const int *idx=&htaps.index[size_t(x)*htaps.taps];
+                    const float *w=&htaps.weights[size_t(x)*htaps.taps];
+                    for(int c=0;c<ch;++c)
+                        out[c]=0.0f;
+
+                    for(int i=0;i<htaps.taps;++i)
+                    {
+                        if(w[i]==0.0f)
+                            continue;
+
+                        const size_t s=(src_row+idx[i])*ch;
+                        for(int c=0;c<ch;++c)
+                            out[c]+=w[i]*data.get(s+c,c);
+                    }
+                }
+            }
+
+            for(int y=y0;y<y1;++y)
+            {
+                const float *w=&vtaps.weights[size_t(y)*vtaps.taps];
+                const int r=vtaps.first[y]-ry0;
+                float *out=dst_data+(size_t(y)*dst.width+x0)*ch;
+                for(int i=0;i<tile_w*ch;++i)
+                {
+                    float sum=0.0f;
+                    for(int j=0;j<vtaps.taps;++j)
+                        sum+=w[j]*rows[size_t(r+j)*tile_w*ch+i];
+                    out[i]=sum;
+                }
+            }
+        }
+
+        filter_job(const source &data,const level_desc &src,const level_desc &dst,const filter_taps &htaps,
+                   const filter_taps &vtaps,float *dst_data): data(data),src(src),dst(dst),htaps(htaps),vtaps(vtaps),
+                   dst_data(dst_data),tiles_x((dst.width+tile_size-1)/tile_size) {}
+
+    private:
+        const source &data;
+        const level_desc &src,&dst;
+        const filter_taps &htaps,&vtaps;
+        float *dst_data;
+        const int tiles_x;
+    };
+
+    class encode_job: public nya_memory::parallel_job
+    {
+    public:
+        void run(int from,int to)
+        {
+            const size_t stride=size_t(desc.width)*desc.channels;
+            for(size_t i=from*stride;i<to*stride;++i)
+            {
+                const int c=int(i%desc.channels);
+                if(c==desc.alpha_channel)
+                    out[i]=encode_unorm(data[i]*alpha_scale);
+                else if(srgb)
+                    out[i]=encode_srgb(data[i],thresholds);
+                else
+                    out[i]=encode_unorm(data[i]);
+            }
+        }
+
+        encode_job(const float *data,const level_desc &desc,bool srgb,float alpha_scale,uint8_t *out):
+                   data(data),desc(desc),srgb(srgb),alpha_scale(alpha_scale),
+                   thresholds(get_srgb_tables().thresholds),out(out) {}
+
+    private:
+        const float *data;
+        const level_desc &desc;
+        const bool srgb;
+        const float alpha_scale;
+        const float *thresholds;
+        uint8_t *out;
+    };
+
+    //scale that keeps the count of pixels with alpha above cutoff close to the base level
+    float get_alpha_scale(const float *data,const level_desc &desc,float cutoff,float coverage)
+    {
+        std::vector<int> bins(coverage_bins+1,0);
+        const size_t count=size_t(desc.width)*desc.height;
+        for(size_t i=0;i<count;++i)
+        {
+            float a=data[i*desc.channels+desc.alpha_channel];
+            a=a<0.0f?0.0f:(a>1.0f?1.0f:a);
+            ++bins[int(a*coverage_bins)];
+        }
+
+        const float target=coverage*count;
+        float above=0.0f;
+        for(int i=coverage_bins;i>0;--i)
+        {
+            above+=bins[i];
+            if(above>=target)
+            {
+                const float threshold=float(i)/coverage_bins;
+                return cutoff/threshold;
+            }
+        }
+
+        return 1.0f;
+    }
+}
+
+int bitmap_get_mip_count(int width,int height)
+{
+    int count=1;
+    for(;width>1 || height>1;width=width>1?width/2:1,height=height>1?height/2:1)
+        ++count;
+
+    return count;
+}
+
+size_t bitmap_get_mip_chain_size(int width,int height,int channels,int mip_count)
+{
+    if(mip_count<0)
+        mip_count=bitmap_get_mip_count(width,height);
+
+    size_t size=0;
+    for(int i=0;i<mip_count;++i,width=width>1?width/2:1,height=height>1?height/2:1)
+        size+=size_t(width)*height*channels;
+
+    return size;
+}
+
+void bitmap_build_mip_chain(const uint8_t *data,int width,int height,int channels,int mip_count,
+                            const bitmap_mip_settings &settings,uint8_t *out)
+{
+    if(!data || !out || width<=0 || height<=0 || channels<1 || channels>4)
+        return;
+
+    const int max_count=bitmap_get_mip_count(width,height);
+    if(mip_count<0 || mip_count>max_count)
+        mip_count=max_count;
+
+    const size_t base_size=size_t(width)*height*channels;
+    if(out!=data)
+        memcpy(out,data,base_size);
+
+    if(mip_count<2)
+        return;
+
+    level_desc src;
+    src.width=width,src.height=height,src.channels=channels;
+    src.alpha_channel=(channels==2 || channels==4)?channels-1:-1;
+    src.wrap=settings.wrap;
+
+    source_bytes base;
+    base.data=data;
+    for(int c=0;c<4;++c)
+        base.tables[c]=settings.srgb && c!=src.alpha_channel?get_srgb_tables().to_linear:get_unorm_table();
+
+    const bool preserve_coverage=settings.alpha_coverage>0.0f && src.alpha_channel>=0;
+    float coverage=0.0f;
+    if(preserve_coverage)
+    {
+        const size_t count=size_t(width)*height;
+        size_t above=0;
+        for(size_t i=0;i<count;++i)
+        {
+            if(base.get(i*channels+src.alpha_channel,src.alpha_channel)>settings.alpha_coverage)
+                ++above;
+        }
+        coverage=float(above)/count;
+    }
+
+    //levels are filtered from the previous unquantized level
+    std::vector<float> levels[2];
+    uint8_t *level_out=out+base_size;
+    for(int i=1;i<mip_count;++i)
+    {
+        level_desc dst=src;
+        dst.width=src.width>1?src.width/2:1;
+        dst.height=src.height>1?src.height/2:1;
+
+        filter_taps htaps,vtaps;
+        htaps.build(src.width,dst.width,settings.filter,settings.wrap);
+        vtaps.build(src.height,dst.height,settings.filter,settings.wrap);
+
+        std::vector<float> &dst_data=levels[i%2];
+        dst_data.resize(size_t(dst.width)*dst.height*channels);
+
+        const int tiles=((dst.width+tile_size-1)/tile_size)*((dst.height+tile_size-1)/tile_size);
+        if(i==1)
+        {
+            filter_job<source_bytes> job(base,src,dst,htaps,vtaps,&dst_data[0]);
+            nya_memory::parallel_for(job,tiles);
+        }
+        else
+        {
+            source_floats prev;
+            prev.data=&levels[(i+1)%2][0];
+            filter_job<source_floats> job(prev,src,dst,htaps,vtaps,&dst_data[0]);
+            nya_memory::parallel_for(job,tiles);
+        }
+
+        float alpha_scale=1.0f;
+        if(preserve_coverage)
+            alpha_scale=get_alpha_scale(&dst_data[0],dst,settings.alpha_coverage,coverage);
+
+        encode_job job(&dst_data[0],dst,settings.srgb,alpha_scale,level_out);
+        const int chunk=16*1024/dst.width;
+        nya_memory::parallel_for(job,dst.height,chunk>0?chunk:1);
+
+        level_out+=size_t(dst.width)*dst.height*channels;
+        src=dst;
+    }
+}
+
+}
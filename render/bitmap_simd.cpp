@@ -0,0 +1,661 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "bitmap_simd.h"
+#include <string.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP>=2)
+    #define BITMAP_SSE2
+    #include <emmintrin.h>
+    #if !defined EMSCRIPTEN
+        #define BITMAP_SSSE3
+        #include <tmmintrin.h>
+        #ifdef _MSC_VER
+            #include <intrin.h>
+            #define TARGET_SSSE3
+        #else
+            #include <cpuid.h>
+            #define TARGET_SSSE3 __attribute__((target("ssse3")))
+        #endif
+    #endif
+#elif defined __ARM_NEON__ || defined __ARM_NEON
+    #define BITMAP_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace nya_render
+{
+
+namespace
+{
+
+inline uint32_t load32(const uint8_t *p) { uint32_t v; memcpy(&v,p,4); return v; }
+inline void store32(uint8_t *p,uint32_t v) { memcpy(p,&v,4); }
+inline uint32_t average(uint32_t a,uint32_t b) { return (((a^b) & 0xfefefefeL)>>1) + (a&b); }
+
+//scalar
+
+void downsample_rgba_2x2_c(const uint8_t *row0,const uint8_t *row1,int out_count,uint8_t *out)
+{
+    for(int i=0;i<out_count;++i,row0+=8,row1+=8,out+=4)
+        store32(out,average(average(load32(row0),load32(row0+4)),average(load32(row1),load32(row1+4))));
+}
+
+void downsample_rgba_x_c(const uint8_t *row,int out_count,uint8_t *out)
+{
+    for(int i=0;i<out_count;++i,row+=8,out+=4)
+        store32(out,average(load32(row),load32(row+4)));
+}
+
+void downsample_rgba_y_c(const uint8_t *row0,const uint8_t *row1,int count,uint8_t *out)
+{
+    for(int i=0;i<count;++i,row0+=4,row1+=4,out+=4)
+        store32(out,average(load32(row0),load32(row1)));
+}
+
+void swap_rb_rgba_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=4,dst+=4)
+    {
+        const uint8_t r=src[0],g=src[1],b=src[2],a=src[3];
+        dst[0]=b,dst[1]=g,dst[2]=r,dst[3]=a;
+    }
+}
+
+void swap_rb_rgb_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=3,dst+=3)
+    {
+        const uint8_t r=src[0],g=src[1],b=src[2];
+        dst[0]=b,dst[1]=g,dst[2]=r;
+    }
+}
+
+void argb_to_rgba_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=4,dst+=4)
+    {
+        const uint32_t c=load32(src);
+        store32(dst,c<<24|c>>8);
+    }
+}
+
+void argb_to_bgra_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=4,dst+=4)
+    {
+        const uint32_t c=load32(src);
+        store32(dst,c<<24|(c<<8 & 0x00FF0000)|(c>>8 & 0x0000FF00)|c>>24);
+    }
+}
+
+void rgba_to_rgb_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=4,dst+=3)
+    {
+        const uint8_t r=src[0],g=src[1],b=src[2];
+        dst[0]=r,dst[1]=g,dst[2]=b;
+    }
+}
+
+void bgra_to_rgb_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    for(int i=0;i<count;++i,src+=4,dst+=3)
+    {
+        const uint8_t b=src[0],g=src[1],r=src[2];
+        dst[0]=r,dst[1]=g,dst[2]=b;
+    }
+}
+
+void rgb_to_rgba_c(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    for(int i=0;i<count;++i,src+=3,dst+=4)
+        dst[0]=src[0],dst[1]=src[1],dst[2]=src[2],dst[3]=alpha;
+}
+
+void rgb_to_bgra_c(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    for(int i=0;i<count;++i,src+=3,dst+=4)
+        dst[0]=src[2],dst[1]=src[1],dst[2]=src[0],dst[3]=alpha;
+}
+
+void reverse_rgba_c(const uint8_t *src,uint8_t *dst,int count)
+{
+    dst+=(count-1)*4;
+    for(int i=0;i<count;++i,src+=4,dst-=4)
+        memcpy(dst,src,4);
+}
+
+inline int sqr(int a) { return a*a; }
+
+uint32_t dxt_color_indices_c(const int16_t *rgb,const int *palette)
+{
+    uint32_t indices=0;
+    for(int i=15;i>=0;--i)
+    {
+        int best=0,best_err=0x7fffffff;
+        for(int j=0;j<4;++j)
+        {
+            const int *p=palette+j*3;
+            const int err=sqr(rgb[i]-p[0])+sqr(rgb[16+i]-p[1])+sqr(rgb[32+i]-p[2]);
+            if(err<best_err)
+                best_err=err,best=j;
+        }
+        indices=(indices<<2)|best;
+    }
+    return indices;
+}
+
+int etc_subblock_error_c(const int16_t *rgb,const int *colors,int *selectors)
+{
+    int err=0;
+    for(int i=0;i<8;++i)
+    {
+        int best=0x7fffffff;
+        for(int m=0;m<4;++m)
+        {
+            const int *c=colors+m*3;
+            const int e=sqr(c[0]-rgb[i])+sqr(c[1]-rgb[8+i])+sqr(c[2]-rgb[16+i]);
+            if(e<best)
+                best=e,selectors[i]=m;
+        }
+        err+=best;
+    }
+    return err;
+}
+
+int eac_alpha_error_c(const uint8_t *alpha,const uint8_t *values,uint8_t *selectors)
+{
+    int err=0;
+    for(int i=0;i<16;++i)
+    {
+        int best=0x7fffffff;
+        for(int m=0;m<8;++m)
+        {
+            const int e=sqr(values[m]-alpha[i]);
+            if(e<best)
+                best=e,selectors[i]=m;
+        }
+        err+=best;
+    }
+    return err;
+}
+
+const bitmap_kernels kernels_c=
+{
+    downsample_rgba_2x2_c,downsample_rgba_x_c,downsample_rgba_y_c,
+    swap_rb_rgba_c,swap_rb_rgb_c,argb_to_rgba_c,argb_to_bgra_c,
+    rgba_to_rgb_c,bgra_to_rgb_c,rgb_to_rgba_c,rgb_to_bgra_c,reverse_rgba_c,
+    dxt_color_indices_c,etc_subblock_error_c,eac_alpha_error_c,
+    "scalar"
+};
+
+#ifdef BITMAP_SSE2
+
+inline __m128i load(const uint8_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline void store(uint8_t *p,__m128i v) { _mm_storeu_si128((__m128i *)p,v); }
+
+inline __m128i average_floor(__m128i a,__m128i b)
+{
+    return _mm_sub_epi8(_mm_avg_epu8(a,b),_mm_and_si128(_mm_xor_si128(a,b),_mm_set1_epi8(1)));
+}
+
+//4 pixels of even and odd positions from 8 pixels
+inline void deinterleave(const uint8_t *p,__m128i &even,__m128i &odd)
+{
+    const __m128 a=_mm_castsi128_ps(load(p)), b=_mm_castsi128_ps(load(p+16));
+    even=_mm_castps_si128(_mm_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0)));
+    odd=_mm_castps_si128(_mm_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1)));
+}
+
+void downsample_rgba_2x2_sse2(const uint8_t *row0,const uint8_t *row1,int out_count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=out_count;i+=4,row0+=32,row1+=32,out+=16)
+    {
+        __m128i e0,o0,e1,o1;
+        deinterleave(row0,e0,o0);
+        deinterleave(row1,e1,o1);
+        store(out,average_floor(average_floor(e0,o0),average_floor(e1,o1)));
+    }
+    downsample_rgba_2x2_c(row0,row1,out_count-i,out);
+}
+
+void downsample_rgba_x_sse2(const uint8_t *row,int out_count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=out_count;i+=4,row+=32,out+=16)
+    {
+        __m128i e,o;
+        deinterleave(row,e,o);
+        store(out,average_floor(e,o));
+    }
+    downsample_rgba_x_c(row,out_count-i,out);
+}
+
+void downsample_rgba_y_sse2(const uint8_t *row0,const uint8_t *row1,int count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=count;i+=4,row0+=16,row1+=16,out+=16)
+        store(out,average_floor(load(row0),load(row1)));
+    downsample_rgba_y_c(row0,row1,count-i,out);
+}
+
+void swap_rb_rgba_sse2(const uint8_t *src,uint8_t *dst,int count)
+{
+    const __m128i ga_mask=_mm_set1_epi32((int)0xff00ff00), rb_mask=_mm_set1_epi32(0x00ff00ff);
+    int i=0;
+    for(;i+4<=count;i+=4,src+=16,dst+=16)
+    {
+        const __m128i c=load(src), rb=_mm_and_si128(c,rb_mask);
+        store(dst,_mm_or_si128(_mm_and_si128(c,ga_mask),_mm_or_si128(_mm_slli_epi32(rb,16),_mm_srli_epi32(rb,16))));
+    }
+    swap_rb_rgba_c(src,dst,count-i);
+}
+
+void argb_to_rgba_sse2(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+4<=count;i+=4,src+=16,dst+=16)
+    {
+        const __m128i c=load(src);
+        store(dst,_mm_or_si128(_mm_slli_epi32(c,24),_mm_srli_epi32(c,8)));
+    }
+    argb_to_rgba_c(src,dst,count-i);
+}
+
+void argb_to_bgra_sse2(const uint8_t *src,uint8_t *dst,int count)
+{
+    const __m128i mask2=_mm_set1_epi32(0x00ff0000), mask1=_mm_set1_epi32(0x0000ff00);
+    int i=0;
+    for(;i+4<=count;i+=4,src+=16,dst+=16)
+    {
+        const __m128i c=load(src);
+        const __m128i outer=_mm_or_si128(_mm_slli_epi32(c,24),_mm_srli_epi32(c,24));
+        const __m128i inner=_mm_or_si128(_mm_and_si128(_mm_slli_epi32(c,8),mask2),_mm_and_si128(_mm_srli_epi32(c,8),mask1));
+        store(dst,_mm_or_si128(outer,inner));
+    }
+    argb_to_bgra_c(src,dst,count-i);
+}
+
+void reverse_rgba_sse2(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    dst+=count*4;
+    for(;i+4<=count;i+=4,src+=16)
+    {
+        dst-=16;
+        store(dst,_mm_shuffle_epi32(load(src),_MM_SHUFFLE(0,1,2,3)));
+    }
+    reverse_rgba_c(src,dst-(count-i)*4,count-i);
+}
+
+//squared rgb distance to one color, 8 planar pixels, two halves of 4
+inline void rgb_error_sse2(__m128i r,__m128i g,__m128i b,const int *c,__m128i &lo,__m128i &hi)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i dr=_mm_sub_epi16(r,_mm_set1_epi16((short)c[0]));
+    const __m128i dg=_mm_sub_epi16(g,_mm_set1_epi16((short)c[1]));
+    const __m128i db=_mm_sub_epi16(b,_mm_set1_epi16((short)c[2]));
+    const __m128i rg_lo=_mm_unpacklo_epi16(dr,dg), rg_hi=_mm_unpackhi_epi16(dr,dg);
+    const __m128i b_lo=_mm_unpacklo_epi16(db,zero), b_hi=_mm_unpackhi_epi16(db,zero);
+    lo=_mm_add_epi32(_mm_madd_epi16(rg_lo,rg_lo),_mm_madd_epi16(b_lo,b_lo));
+    hi=_mm_add_epi32(_mm_madd_epi16(rg_hi,rg_hi),_mm_madd_epi16(b_hi,b_hi));
+}
+
+//keeps err and its candidate index where err is strictly less, so the first best candidate wins
+inline void select_sse2(__m128i err,__m128i idx,__m128i &best,__m128i &sel)
+{
+    const __m128i less=_mm_cmplt_epi32(err,best);
+    best=_mm_or_si128(_mm_and_si128(less,err),_mm_andnot_si128(less,best));
+    sel=_mm_or_si128(_mm_and_si128(less,idx),_mm_andnot_si128(less,sel));
+}
+
+inline int sum_epi32(__m128i v)
+{
+    v=_mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(1,0,3,2)));
+    v=_mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+uint32_t dxt_color_indices_sse2(const int16_t *rgb,const int *palette)
+{
+    __m128i best[4],sel[4];
+    for(int i=0;i<4;++i)
+        best[i]=_mm_set1_epi32(0x7fffffff), sel[i]=_mm_setzero_si128();
+
+    for(int j=0;j<4;++j)
+    {
+        const __m128i idx=_mm_set1_epi32(j);
+        for(int h=0;h<2;++h)
+        {
+            const __m128i r=load((const uint8_t *)(rgb+h*8));
+            const __m128i g=load((const uint8_t *)(rgb+16+h*8));
+            const __m128i b=load((const uint8_t *)(rgb+32+h*8));
+            __m128i lo,hi;
+            rgb_error_sse2(r,g,b,palette+j*3,lo,hi);
+            select_sse2(lo,idx,best[h*2],sel[h*2]);
+            select_sse2(hi,idx,best[h*2+1],sel[h*2+1]);
+        }
+    }
+
+    int selectors[16];
+    for(int i=0;i<4;++i)
+        _mm_storeu_si128((__m128i *)(selectors+i*4),sel[i]);
+
+    uint32_t indices=0;
+    for(int i=15;i>=0;--i)
+        indices=(indices<<2)|selectors[i];
+    return indices;
+}
+
+int etc_subblock_error_sse2(const int16_t *rgb,const int *colors,int *selectors)
+{
+    const __m128i r=load((const uint8_t *)rgb), g=load((const uint8_t *)(rgb+8)), b=load((const uint8_t *)(rgb+16));
+    __m128i best_lo=_mm_set1_epi32(0x7fffffff), best_hi=best_lo;
+    __m128i sel_lo=_mm_setzero_si128(), sel_hi=sel_lo;
+    for(int m=0;m<4;++m)
+    {
+        __m128i lo,hi;
+        rgb_error_sse2(r,g,b,colors+m*3,lo,hi);
+        const __m128i idx=_mm_set1_epi32(m);
+        select_sse2(lo,idx,best_lo,sel_lo);
+        select_sse2(hi,idx,best_hi,sel_hi);
+    }
+
+    _mm_storeu_si128((__m128i *)selectors,sel_lo);
+    _mm_storeu_si128((__m128i *)(selectors+4),sel_hi);
+    return sum_epi32(_mm_add_epi32(best_lo,best_hi));
+}
+
+int eac_alpha_error_sse2(const uint8_t *alpha,const uint8_t *values,uint8_t *selectors)
+{
+    //the least absolute difference is also the least squared one
+    const __m128i a=load(alpha);
+    //starts from the largest difference, so the first value is selected even if it's 255 away
+    __m128i best=_mm_set1_epi8((char)0xff), sel=_mm_setzero_si128();
+    for(int m=0;m<8;++m)
+    {
+        const __m128i v=_mm_set1_epi8((char)values[m]);
+        const __m128i d=_mm_or_si128(_mm_subs_epu8(a,v),_mm_subs_epu8(v,a));
+        const __m128i not_less=_mm_cmpeq_epi8(_mm_min_epu8(best,d),best);
+        best=_mm_or_si128(_mm_andnot_si128(not_less,d),_mm_and_si128(not_less,best));
+        sel=_mm_or_si128(_mm_andnot_si128(not_less,_mm_set1_epi8((char)m)),_mm_and_si128(not_less,sel));
+    }
+
+    store(selectors,sel);
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i lo=_mm_unpacklo_epi8(best,zero), hi=_mm_unpackhi_epi8(best,zero);
+    return sum_epi32(_mm_add_epi32(_mm_madd_epi16(lo,lo),_mm_madd_epi16(hi,hi)));
+}
+
+#ifdef BITMAP_SSSE3
+
+//3-byte kernels process 4 pixels per iteration but touch 16 bytes, so they stop 2 pixels before the end
+
+TARGET_SSSE3 void swap_rb_rgb_ssse3(const uint8_t *src,uint8_t *dst,int count)
+{
+    const __m128i shuffle=_mm_setr_epi8(2,1,0,5,4,3,8,7,6,11,10,9,12,13,14,15);
+    int i=0;
+    for(;i+6<=count;i+=4,src+=12,dst+=12)
+        _mm_storeu_si128((__m128i *)dst,_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),shuffle));
+    swap_rb_rgb_c(src,dst,count-i);
+}
+
+TARGET_SSSE3 void rgba_to_rgb_ssse3(const uint8_t *src,uint8_t *dst,int count)
+{
+    const __m128i shuffle=_mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+    int i=0;
+    for(;i+6<=count;i+=4,src+=16,dst+=12)
+        _mm_storeu_si128((__m128i *)dst,_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),shuffle));
+    rgba_to_rgb_c(src,dst,count-i);
+}
+
+TARGET_SSSE3 void bgra_to_rgb_ssse3(const uint8_t *src,uint8_t *dst,int count)
+{
+    const __m128i shuffle=_mm_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+    int i=0;
+    for(;i+6<=count;i+=4,src+=16,dst+=12)
+        _mm_storeu_si128((__m128i *)dst,_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),shuffle));
+    bgra_to_rgb_c(src,dst,count-i);
+}
+
+TARGET_SSSE3 void rgb_to_rgba_ssse3(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    const __m128i shuffle=_mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m128i a=_mm_set1_epi32(int(uint32_t(alpha)<<24));
+    int i=0;
+    for(;i+6<=count;i+=4,src+=12,dst+=16)
+        _mm_storeu_si128((__m128i *)dst,_mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),shuffle),a));
+    rgb_to_rgba_c(src,dst,count-i,alpha);
+}
+
+TARGET_SSSE3 void rgb_to_bgra_ssse3(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    const __m128i shuffle=_mm_setr_epi8(2,1,0,-1,5,4,3,-1,8,7,6,-1,11,10,9,-1);
+    const __m128i a=_mm_set1_epi32(int(uint32_t(alpha)<<24));
+    int i=0;
+    for(;i+6<=count;i+=4,src+=12,dst+=16)
+        _mm_storeu_si128((__m128i *)dst,_mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src),shuffle),a));
+    rgb_to_bgra_c(src,dst,count-i,alpha);
+}
+
+bool has_ssse3()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info,1);
+    return (info[2] & (1<<9))!=0;
+#else
+    unsigned int eax,ebx,ecx,edx;
+    if(!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
+        return false;
+    return (ecx & (1<<9))!=0;
+#endif
+}
+
+#endif
+
+const bitmap_kernels kernels_sse2=
+{
+    downsample_rgba_2x2_sse2,downsample_rgba_x_sse2,downsample_rgba_y_sse2,
+    swap_rb_rgba_sse2,swap_rb_rgb_c,argb_to_rgba_sse2,argb_to_bgra_sse2,
+    rgba_to_rgb_c,bgra_to_rgb_c,rgb_to_rgba_c,rgb_to_bgra_c,reverse_rgba_sse2,
+    dxt_color_indices_sse2,etc_subblock_error_sse2,eac_alpha_error_sse2,
+    "sse2"
+};
+
+#ifdef BITMAP_SSSE3
+const bitmap_kernels kernels_ssse3=
+{
+    downsample_rgba_2x2_sse2,downsample_rgba_x_sse2,downsample_rgba_y_sse2,
+    swap_rb_rgba_sse2,swap_rb_rgb_ssse3,argb_to_rgba_sse2,argb_to_bgra_sse2,
+    rgba_to_rgb_ssse3,bgra_to_rgb_ssse3,rgb_to_rgba_ssse3,rgb_to_bgra_ssse3,reverse_rgba_sse2,
+    dxt_color_indices_sse2,etc_subblock_error_sse2,eac_alpha_error_sse2,
+    "ssse3"
+};
+#endif
+
+#endif
+
+#ifdef BITMAP_NEON
+
+void downsample_rgba_2x2_neon(const uint8_t *row0,const uint8_t *row1,int out_count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=out_count;i+=4,row0+=32,row1+=32,out+=16)
+    {
+        const uint32x4x2_t a=vld2q_u32((const uint32_t *)row0), b=vld2q_u32((const uint32_t *)row1);
+        const uint8x16_t ax=vhaddq_u8(vreinterpretq_u8_u32(a.val[0]),vreinterpretq_u8_u32(a.val[1]));
+        const uint8x16_t bx=vhaddq_u8(vreinterpretq_u8_u32(b.val[0]),vreinterpretq_u8_u32(b.val[1]));
+        vst1q_u8(out,vhaddq_u8(ax,bx));
+    }
+    downsample_rgba_2x2_c(row0,row1,out_count-i,out);
+}
+
+void downsample_rgba_x_neon(const uint8_t *row,int out_count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=out_count;i+=4,row+=32,out+=16)
+    {
+        const uint32x4x2_t a=vld2q_u32((const uint32_t *)row);
+        vst1q_u8(out,vhaddq_u8(vreinterpretq_u8_u32(a.val[0]),vreinterpretq_u8_u32(a.val[1])));
+    }
+    downsample_rgba_x_c(row,out_count-i,out);
+}
+
+void downsample_rgba_y_neon(const uint8_t *row0,const uint8_t *row1,int count,uint8_t *out)
+{
+    int i=0;
+    for(;i+4<=count;i+=4,row0+=16,row1+=16,out+=16)
+        vst1q_u8(out,vhaddq_u8(vld1q_u8(row0),vld1q_u8(row1)));
+    downsample_rgba_y_c(row0,row1,count-i,out);
+}
+
+void swap_rb_rgba_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=64,dst+=64)
+    {
+        uint8x16x4_t c=vld4q_u8(src);
+        const uint8x16_t t=c.val[0]; c.val[0]=c.val[2]; c.val[2]=t;
+        vst4q_u8(dst,c);
+    }
+    swap_rb_rgba_c(src,dst,count-i);
+}
+
+void swap_rb_rgb_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=48,dst+=48)
+    {
+        uint8x16x3_t c=vld3q_u8(src);
+        const uint8x16_t t=c.val[0]; c.val[0]=c.val[2]; c.val[2]=t;
+        vst3q_u8(dst,c);
+    }
+    swap_rb_rgb_c(src,dst,count-i);
+}
+
+void argb_to_rgba_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=64,dst+=64)
+    {
+        const uint8x16x4_t c=vld4q_u8(src);
+        uint8x16x4_t o;
+        o.val[0]=c.val[1], o.val[1]=c.val[2], o.val[2]=c.val[3], o.val[3]=c.val[0];
+        vst4q_u8(dst,o);
+    }
+    argb_to_rgba_c(src,dst,count-i);
+}
+
+void argb_to_bgra_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+4<=count;i+=4,src+=16,dst+=16)
+        vst1q_u8(dst,vrev32q_u8(vld1q_u8(src)));
+    argb_to_bgra_c(src,dst,count-i);
+}
+
+void rgba_to_rgb_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=64,dst+=48)
+    {
+        const uint8x16x4_t c=vld4q_u8(src);
+        uint8x16x3_t o;
+        o.val[0]=c.val[0], o.val[1]=c.val[1], o.val[2]=c.val[2];
+        vst3q_u8(dst,o);
+    }
+    rgba_to_rgb_c(src,dst,count-i);
+}
+
+void bgra_to_rgb_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=64,dst+=48)
+    {
+        const uint8x16x4_t c=vld4q_u8(src);
+        uint8x16x3_t o;
+        o.val[0]=c.val[2], o.val[1]=c.val[1], o.val[2]=c.val[0];
+        vst3q_u8(dst,o);
+    }
+    bgra_to_rgb_c(src,dst,count-i);
+}
+
+void rgb_to_rgba_neon(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=48,dst+=64)
+    {
+        const uint8x16x3_t c=vld3q_u8(src);
+        uint8x16x4_t o;
+        o.val[0]=c.val[0], o.val[1]=c.val[1], o.val[2]=c.val[2], o.val[3]=vdupq_n_u8(alpha);
+        vst4q_u8(dst,o);
+    }
+    rgb_to_rgba_c(src,dst,count-i,alpha);
+}
+
+void rgb_to_bgra_neon(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha)
+{
+    int i=0;
+    for(;i+16<=count;i+=16,src+=48,dst+=64)
+    {
+        const uint8x16x3_t c=vld3q_u8(src);
+        uint8x16x4_t o;
+        o.val[0]=c.val[2], o.val[1]=c.val[1], o.val[2]=c.val[0], o.val[3]=vdupq_n_u8(alpha);
+        vst4q_u8(dst,o);
+    }
+    rgb_to_bgra_c(src,dst,count-i,alpha);
+}
+
+void reverse_rgba_neon(const uint8_t *src,uint8_t *dst,int count)
+{
+    int i=0;
+    dst+=count*4;
+    for(;i+4<=count;i+=4,src+=16)
+    {
+        dst-=16;
+        const uint32x4_t r=vrev64q_u32(vld1q_u32((const uint32_t *)src));
+        vst1q_u32((uint32_t *)dst,vcombine_u32(vget_high_u32(r),vget_low_u32(r)));
+    }
+    reverse_rgba_c(src,dst-(count-i)*4,count-i);
+}
+
+const bitmap_kernels kernels_neon=
+{
+    downsample_rgba_2x2_neon,downsample_rgba_x_neon,downsample_rgba_y_neon,
+    swap_rb_rgba_neon,swap_rb_rgb_neon,argb_to_rgba_neon,argb_to_bgra_neon,
+    rgba_to_rgb_neon,bgra_to_rgb_neon,rgb_to_rgba_neon,rgb_to_bgra_neon,reverse_rgba_neon,
+    dxt_color_indices_c,etc_subblock_error_c,eac_alpha_error_c,
+    "neon"
+};
+
+#endif
+
+const bitmap_kernels &select_kernels()
+{
+#if defined BITMAP_SSSE3
+    if(has_ssse3())
+        return kernels_ssse3;
+#endif
+
+#if defined BITMAP_SSE2
+    return kernels_sse2;
+#elif defined BITMAP_NEON
+    return kernels_neon;
+#else
+    return kernels_c;
+#endif
+}
+
+}
+
+const bitmap_kernels &get_bitmap_kernels()
+{
+    static const bitmap_kernels &k=select_kernels();
+    return k;
+}
+
+const bitmap_kernels &get_bitmap_kernels_scalar() { return kernels_c; }
+
+}
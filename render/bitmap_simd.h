@@ -0,0 +1,46 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include <stdint.h>
+
+namespace nya_render
+{
+
+//per-row kernels used by bitmap.cpp, count is in pixels
+//all implementations are bit-exact with the scalar ones
+struct bitmap_kernels
+{
+    //average(average(a,b),average(c,d)) per byte, rounding down
+    void (*downsample_rgba_2x2)(const uint8_t *row0,const uint8_t *row1,int out_count,uint8_t *out);
+    void (*downsample_rgba_x)(const uint8_t *row,int out_count,uint8_t *out); //out may be equal to row
+    void (*downsample_rgba_y)(const uint8_t *row0,const uint8_t *row1,int count,uint8_t *out); //out may be equal to row0
+
+    //src may be equal to dst
+    void (*swap_rb_rgba)(const uint8_t *src,uint8_t *dst,int count);
+    void (*swap_rb_rgb)(const uint8_t *src,uint8_t *dst,int count);
+    void (*argb_to_rgba)(const uint8_t *src,uint8_t *dst,int count);
+    void (*argb_to_bgra)(const uint8_t *src,uint8_t *dst,int count);
+
+    //dst may be equal to src
+    void (*rgba_to_rgb)(const uint8_t *src,uint8_t *dst,int count);
+    void (*bgra_to_rgb)(const uint8_t *src,uint8_t *dst,int count);
+
+    //src and dst must not overlap
+    void (*rgb_to_rgba)(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha);
+    void (*rgb_to_bgra)(const uint8_t *src,uint8_t *dst,int count,uint8_t alpha);
+    void (*reverse_rgba)(const uint8_t *src,uint8_t *dst,int count);
+
+    //block encoder kernels used by bitmap_compress.cpp, pixels are planar r[n],g[n],b[n]
+    //each pixel gets the first candidate with the least squared error
+    uint32_t (*dxt_color_indices)(const int16_t *rgb,const int *palette); //16 pixels, 4 rgb palette colors, 2 bits per pixel
+    int (*etc_subblock_error)(const int16_t *rgb,const int *colors,int *selectors); //8 pixels, 4 rgb colors, returns error sum
+    int (*eac_alpha_error)(const uint8_t *alpha,const uint8_t *values,uint8_t *selectors); //16 pixels, 8 values, returns error sum
+
+    const char *name;
+};
+
+const bitmap_kernels &get_bitmap_kernels();
+const bitmap_kernels &get_bitmap_kernels_scalar();
+
+}
@@ -0,0 +1,627 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "mesh_optimize.h"
+#include "math/vector.h"
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+namespace nya_render
+{
+
+namespace
+{
+
+template<typename t> bool check_indices(const t *indices,unsigned int count,unsigned int verts_count)
+{
+    if(!indices)
+        return false;
+
+    for(unsigned int i=0;i<count;++i)
+    {
+        if(indices[i]>=verts_count)
+            return false;
+    }
+
+    return true;
+}
+
+template<typename t> vertex_cache_stats analyze(const t *indices,unsigned int count,unsigned int verts_count,unsigned int cache_size)
+{
+    vertex_cache_stats stats;
+    if(count<3 || !cache_size || !check_indices(indices,count,verts_count))
+        return stats;
+
+    std::vector<unsigned int> cache_time(verts_count,0); //time of insertion+1, 0 if never
+    std::vector<char> used(verts_count,0);
+    unsigned int time=0,transformed=0,used_count=0;
+    for(unsigned int i=0;i<count;++i)
+    {
+        const t idx=indices[i];
+        if(!cache_time[idx] || time-(cache_time[idx]-1)>=cache_size)
+        {
+            cache_time[idx]=++time;
+            ++transformed;
+        }
+
+        if(!used[idx])
+            used[idx]=1,++used_count;
+    }
+
+    stats.acmr=float(transformed)/(count/3);
+    stats.atvr=used_count?float(transformed)/used_count:0.0f;
+    return stats;
+}
+
+const int forsyth_cache_size=32;
+
+float forsyth_vertex_score(int cache_pos,unsigned int remaining)
+{
+    if(!remaining)
+        return -1.0f;
+
+    float score=0.0f;
+    if(cache_pos>=0)
+    {
+        if(cache_pos<3)
+            score=0.75f; //last triangle verts, avoid sharing an edge with it too much
+        else
+            score=powf(1.0f-float(cache_pos-3)/(forsyth_cache_size-3),1.5f);
+    }
+
+    return score+2.0f/sqrtf(float(remaining)); //valence boost
+}
+
+template<typename t> void forsyth(t *indices,unsigned int count,unsigned int verts_count)
+{
+    const unsigned int tris_count=count/3;
+    if(tris_count<2 || !check_indices(indices,tris_count*3,verts_count))
+        return;
+
+    std::vector<unsigned int> offsets(verts_count+1,0);
+    for(unsigned int i=0;i<tris_count*3;++i)
+        ++offsets[indices[i]+1];
+    for(unsigned int i=0;i<verts_count;++i)
+        offsets[i+1]+=offsets[i];
+
+    std::vector<unsigned int> remaining(verts_count);
+    std::vector<unsigned int> adjacency(tris_count*3);
+    for(unsigned int i=0;i<verts_count;++i)
+        remaining[i]=0;
+    for(unsigned int i=0;i<tris_count*3;++i)
+    {
+        const t v=indices[i];
+        adjacency[offsets[v]+remaining[v]++]=i/3;
+    }
+
+    std::vector<int> cache_pos(verts_count,-1);
+    std::vector<float> vert_score(verts_count);
+    for(unsigned int i=0;i<verts_count;++i)
+        vert_score[i]=forsyth_vertex_score(-1,remaining[i]);
+
+    std::vector<float> tri_score(tris_count);
+    int best= -1;
+    for(unsigned int i=0;i<tris_count;++i)
+    {
+        tri_score[i]=vert_score[indices[i*3]]+vert_score[indices[i*3+1]]+vert_score[indices[i*3+2]];
+        if(best<0 || tri_score[i]>tri_score[best])
+            best=i;
+    }
+
+    std::vector<char> emitted(tris_count,0);
+    std::vector<t> result(tris_count*3);
+
+    int cache[forsyth_cache_size+3];
+    int cache_count=0;
+    unsigned int scan=0;
+
+    for(unsigned int out=0;out<tris_count;++out)
+    {
+        if(best<0)
+        {
+            while(emitted[scan])
+                ++scan;
+            best=scan;
+        }
+
+        emitted[best]=1;
+        const t *tri=&indices[best*3];
+        memcpy(&result[out*3],tri,3*sizeof(t));
+
+        int new_cache[forsyth_cache_size+3];
+        int new_count=0;
+        for(int i=0;i<3;++i)
+        {
+            const t v=tri[i];
+            unsigned int *adj=&adjacency[offsets[v]];
+            for(unsigned int j=0;j<remaining[v];++j)
+            {
+                if(adj[j]!=(unsigned int)best)
+                    continue;
+
+                adj[j]=adj[--remaining[v]];
+                break;
+            }
+
+            bool found=false;
+            for(int j=0;j<new_count && !found;++j)
+                found=new_cache[j]==(int)v;
+            if(!found)
+                new_cache[new_count++]=v;
+        }
+
+        for(int i=0;i<cache_count;++i)
+        {
+            const int v=cache[i];
+            if(v!=(int)tri[0] && v!=(int)tri[1] && v!=(int)tri[2])
+                new_cache[new_count++]=v;
+        }
+
+        for(int i=0;i<new_count;++i)
+        {
+            const int v=new_cache[i];
+            cache_pos[v]=i<forsyth_cache_size?i:-1;
+            vert_score[v]=forsyth_vertex_score(cache_pos[v],remaining[v]);
+        }
+
+        best= -1;
+        for(int i=0;i<new_count;++i)
+        {
+            const int v=new_cache[i];
+            for(unsigned int j=0;j<remaining[v];++j)
+            {
+                const unsigned int tidx=adjacency[offsets[v]+j];
+                const t *adj_tri=&indices[tidx*3];
+                tri_score[tidx]=vert_score[adj_tri[0]]+vert_score[adj_tri[1]]+vert_score[adj_tri[2]];
+                if(best<0 || tri_score[tidx]>tri_score[best])
+                    best=tidx;
+            }
+        }
+
+        cache_count=new_count<forsyth_cache_size?new_count:forsyth_cache_size;
+        memcpy(cache,new_cache,cache_count*sizeof(int));
+    }
+
+    memcpy(indices,&result[0],tris_count*3*sizeof(t));
+}
+
+//fifo cache misses per triangle
+template<typename t> class fifo_cache
+{
+public:
+    unsigned int add_triangle(const t *tri)
+    {
+        unsigned int misses=0;
+        for(int i=0;i<3;++i)
+        {
+            const t v=tri[i];
+            if(m_time[v] && m_now-(m_time[v]-1)<m_size)
+                continue;
+
+            m_time[v]=++m_now;
+            ++misses;
+        }
+
+        return misses;
+    }
+
+    void reset() { m_now+=m_size; }
+
+    fifo_cache(unsigned int verts_count,unsigned int size): m_time(verts_count,0),m_now(0),m_size(size) {}
+
+private:
+    std::vector<unsigned int> m_time;
+    unsigned int m_now;
+    unsigned int m_size;
+};
+
+struct cluster
+{
+    unsigned int from,to;
+    float sort_key;
+
+    bool operator < (const cluster &c) const { return sort_key>c.sort_key; }
+};
+
+inline nya_math::vec3 get_pos(const char *positions,unsigned int stride,unsigned int idx)
+{
+    float f[3];
+    memcpy(f,positions+size_t(idx)*stride,sizeof(f));
+    return nya_math::vec3(f[0],f[1],f[2]);
+}
+
+template<typename t> void overdraw(t *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,float threshold)
+{
+    const unsigned int tris_count=count/3;
+    if(tris_count<2 || !positions || !check_indices(indices,tris_count*3,verts_count))
+        return;
+
+    const unsigned int cache_size=16;
+
+    //hard boundaries where the cache restarts, all triangle verts are missed
+    std::vector<unsigned int> hard;
+    std::vector<unsigned int> misses(tris_count);
+    fifo_cache<t> cache(verts_count,cache_size);
+    for(unsigned int i=0;i<tris_count;++i)
+    {
+        misses[i]=cache.add_triangle(&indices[i*3]);
+        if(!i || misses[i]==3)
+            hard.push_back(i);
+    }
+    hard.push_back(tris_count);
+
+    //soft boundaries inside of them, while cluster acmr stays within threshold
+    std::vector<cluster> clusters;
+    for(size_t i=0;i+1<hard.size();++i)
+    {
+        const unsigned int from=hard[i],to=hard[i+1];
+        unsigned int cluster_misses=0;
+        for(unsigned int j=from;j<to;++j)
+            cluster_misses+=misses[j];
+
+        const float cluster_threshold=threshold*cluster_misses/(to-from);
+
+        cache.reset();
+        cluster c;
+        c.from=from;
+        unsigned int local_misses=0;
+        for(unsigned int j=from;j<to;++j)
+        {
+            local_misses+=cache.add_triangle(&indices[j*3]);
+            if(j+1<to && local_misses<=cluster_threshold*(j+1-c.from))
+            {
+                c.to=j+1;
+                clusters.push_back(c);
+                c.from=j+1;
+                local_misses=0;
+                cache.reset();
+            }
+        }
+
+        c.to=to;
+        clusters.push_back(c);
+    }
+
+    if(clusters.size()<2)
+        return;
+
+    //outward-facing clusters far from the center go first, as they likely occlude the rest
+    const char *pos=(const char *)positions;
+    nya_math::vec3 mesh_center;
+    float mesh_area=0.0f;
+    std::vector<nya_math::vec3> centers(clusters.size()),normals(clusters.size());
+    for(size_t i=0;i<clusters.size();++i)
+    {
+        nya_math::vec3 center,normal;
+        float area=0.0f;
+        for(unsigned int j=clusters[i].from;j<clusters[i].to;++j)
+        {
+            const nya_math::vec3 a=get_pos(pos,stride,indices[j*3]);
+            const nya_math::vec3 b=get_pos(pos,stride,indices[j*3+1]);
+            const nya_math::vec3 c=get_pos(pos,stride,indices[j*3+2]);
+            const nya_math::vec3 n=nya_math::vec3::cross(b-a,c-a);
+            const float tri_area=n.length();
+            center+=(a+b+c)*(tri_area/3.0f);
+            normal+=n;
+            area+=tri_area;
+        }
+
+        mesh_center+=center;
+        mesh_area+=area;
+        centers[i]=area>0.0f?center/area:center;
+        normals[i]=normal.normalize();
+    }
+
+    if(mesh_area>0.0f)
+        mesh_center/=mesh_area;
+
+    for(size_t i=0;i<clusters.size();++i)
+        clusters[i].sort_key=(centers[i]-mesh_center).dot(normals[i]);
+
+    std::stable_sort(clusters.begin(),clusters.end());
+
+    std::vector<t> result;
+    result.reserve(tris_count*3);
+    for(size_t i=0;i<clusters.size();++i)
+        result.insert(result.end(),indices+clusters[i].from*3,indices+clusters[i].to*3);
+
+    memcpy(indices,&result[0],result.size()*sizeof(t));
+}
+
+template<typename t> unsigned int vertex_fetch(void *verts,unsigned int stride,unsigned int verts_count,t *indices,unsigned int count)
+{
+    if(!verts || !stride || !check_indices(indices,count,verts_count))
+        return verts_count;
+
+    const unsigned int invalid=(unsigned int)-1;
+    std::vector<unsigned int> remap(verts_count,invalid);
+    unsigned int used=0;
+    for(unsigned int i=0;i<count;++i)
+    {
+        unsigned int &r=remap[indices[i]];
+        if(r==invalid)
+            r=used++;
+        indices[i]=t(r);
+    }
+
+    unsigned int next=used;
+    for(unsigned int i=0;i<verts_count;++i)
+    {
+        if(remap[i]==invalid)
+            remap[i]=next++;
+    }
+
+    std::vector<char> buf(size_t(verts_count)*stride);
+    const char *from=(const char *)verts;
+    for(unsigned int i=0;i<verts_count;++i)
+        memcpy(&buf[size_t(remap[i])*stride],from+size_t(i)*stride,stride);
+
+    memcpy(verts,&buf[0],buf.size());
+    return used;
+}
+
+struct quadric
+{
+    double a2,ab,ac,ad,b2,bc,bd,c2,cd,d2,w;
+
+    void add_plane(const nya_math::vec3 &n,float d,float weight)
+    {
+        a2+=weight*n.x*n.x; ab+=weight*n.x*n.y; ac+=weight*n.x*n.z; ad+=weight*n.x*d;
+        b2+=weight*n.y*n.y; bc+=weight*n.y*n.z; bd+=weight*n.y*d;
+        c2+=weight*n.z*n.z; cd+=weight*n.z*d;
+        d2+=weight*d*d;
+        w+=weight;
+    }
+
+    void add(const quadric &q)
+    {
+        a2+=q.a2; ab+=q.ab; ac+=q.ac; ad+=q.ad; b2+=q.b2; bc+=q.bc; bd+=q.bd; c2+=q.c2; cd+=q.cd; d2+=q.d2; w+=q.w;
+    }
+
+    //area weighted squared distance to the planes
+    double error(const nya_math::vec3 &p) const
+    {
+        const double x=p.x,y=p.y,z=p.z;
+        const double e=a2*x*x+b2*y*y+c2*z*z+2.0*(ab*x*y+ac*x*z+bc*y*z+ad*x+bd*y+cd*z)+d2;
+        return e>0.0?e:0.0;
+    }
+
+    quadric(): a2(0),ab(0),ac(0),ad(0),b2(0),bc(0),bd(0),c2(0),cd(0),d2(0),w(0) {}
+};
+
+struct collapse
+{
+    unsigned int from,to;
+    double cost;
+
+    bool operator < (const collapse &c) const { return cost<c.cost; }
+};
+
+template<typename t> unsigned int simplify(const t *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,
+                                           unsigned int target_count,float max_error,t *out,const unsigned int *vertex_class)
+{
+    count=count/3*3;
+    if(!out || !positions || !check_indices(indices,count,verts_count))
+        return 0;
+
+    std::vector<unsigned int> tris(indices,indices+count);
+    const char *pos_data=(const char *)positions;
+    std::vector<nya_math::vec3> pos(verts_count);
+    std::vector<char> used(verts_count,0);
+    for(unsigned int i=0;i<count;++i)
+    {
+        if(!used[tris[i]])
+            used[tris[i]]=1,pos[tris[i]]=get_pos(pos_data,stride,tris[i]);
+    }
+
+    nya_math::vec3 min,max;
+    if(count)
+        min=max=pos[tris[0]];
+    for(unsigned int i=0;i<count;++i)
+        min=nya_math::vec3::min(min,pos[tris[i]]),max=nya_math::vec3::max(max,pos[tris[i]]);
+
+    const nya_math::vec3 extent=max-min;
+    const double max_dist=max_error*std::max(extent.x,std::max(extent.y,extent.z));
+    const double max_cost=max_dist*max_dist;
+
+    std::vector<quadric> quadrics(verts_count);
+    for(unsigned int i=0;i<count;i+=3)
+    {
+        const nya_math::vec3 &a=pos[tris[i]],&b=pos[tris[i+1]],&c=pos[tris[i+2]];
+        nya_math::vec3 n=nya_math::vec3::cross(b-a,c-a);
+        const float area=n.length();
+        if(area<=0.0f)
+            continue;
+
+        n/=area;
+        const float d= -n.dot(a);
+        for(int j=0;j<3;++j)
+            quadrics[tris[i+j]].add_plane(n,d,area);
+    }
+
+    //edges used by a single triangle are borders
+    std::vector<unsigned long long> edges(count);
+    for(unsigned int i=0;i<count;++i)
+    {
+        const unsigned long long a=tris[i],b=tris[i-i%3+(i+1)%3];
+        edges[i]=a<b?(a<<32|b):(b<<32|a);
+    }
+    std::sort(edges.begin(),edges.end());
+
+    std::vector<char> locked(verts_count,0);
+    for(size_t i=0;i<edges.size();)
+    {
+        size_t j=i+1;
+        while(j<edges.size() && edges[j]==edges[i])
+            ++j;
+
+        if(j-i==1)
+            locked[edges[i]>>32]=locked[edges[i]&0xffffffff]=1;
+        i=j;
+    }
+
+    std::vector<unsigned int> offsets(verts_count+1),adjacency,remap(verts_count);
+    std::vector<char> touched(verts_count);
+    std::vector<collapse> collapses;
+    for(unsigned int i=0;i<verts_count;++i)
+        remap[i]=i;
+
+    while(tris.size()>target_count)
+    {
+        const unsigned int tris_count=(unsigned int)tris.size()/3;
+
+        std::fill(offsets.begin(),offsets.end(),0);
+        for(size_t i=0;i<tris.size();++i)
+            ++offsets[tris[i]+1];
+        for(unsigned int i=0;i<verts_count;++i)
+            offsets[i+1]+=offsets[i];
+        adjacency.resize(tris.size());
+        std::vector<unsigned int> fill(offsets.begin(),offsets.end()-1);
+        for(size_t i=0;i<tris.size();++i)
+            adjacency[fill[tris[i]]++]=(unsigned int)i/3;
+
+        collapses.clear();
+        for(size_t i=0;i<tris.size();++i)
+        {
+            const unsigned int a=tris[i],b=tris[i-i%3+(i+1)%3];
+            if(a>b)
+                continue; //the same edge of the neighbour triangle, or a locked border one
+
+            collapse c;
+            c.cost= -1.0;
+            for(int dir=0;dir<2;++dir)
+            {
+                const unsigned int from=dir?b:a,to=dir?a:b;
+                if(locked[from] || (vertex_class && vertex_class[from]!=vertex_class[to]))
+                    continue;
+
+                quadric q=quadrics[from];
+                q.add(quadrics[to]);
+                const double cost=q.w>0.0?q.error(pos[to])/q.w:0.0;
+                if(c.cost<0.0 || cost<c.cost)
+                    c.from=from,c.to=to,c.cost=cost;
+            }
+
+            if(c.cost>=0.0 && c.cost<=max_cost)
+                collapses.push_back(c);
+        }
+
+        if(collapses.empty())
+            break;
+
+        std::sort(collapses.begin(),collapses.end());
+
+        //each collapse removes about two triangles
+        const size_t max_collapses=(tris_count-target_count/3)/2+1;
+        std::fill(touched.begin(),touched.end(),0);
+        size_t collapsed=0;
+        for(size_t i=0;i<collapses.size() && collapsed<max_collapses;++i)
+        {
+            const collapse &c=collapses[i];
+            if(touched[c.from] || touched[c.to])
+                continue;
+
+            //reject collapses that flip triangles around
+            bool flip=false;
+            for(unsigned int j=offsets[c.from];j<offsets[c.from+1] && !flip;++j)
+            {
+                const unsigned int *tri=&tris[adjacency[j]*3];
+                if(tri[0]==c.to || tri[1]==c.to || tri[2]==c.to)
+                    continue;
+
+                nya_math::vec3 p[3],np[3];
+                for(int k=0;k<3;++k)
+                    p[k]=np[k]=pos[tri[k]],np[k]=tri[k]==c.from?pos[c.to]:p[k];
+
+                const nya_math::vec3 n=nya_math::vec3::cross(p[1]-p[0],p[2]-p[0]);
+                const nya_math::vec3 nn=nya_math::vec3::cross(np[1]-np[0],np[2]-np[0]);
+                flip=n.dot(nn)<=0.25f*n.length()*nn.length();
+            }
+
+            if(flip)
+                continue;
+
+            remap[c.from]=c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            for(unsigned int j=offsets[c.from];j<offsets[c.from+1];++j)
+            {
+                const unsigned int *tri=&tris[adjacency[j]*3];
+                touched[tri[0]]=touched[tri[1]]=touched[tri[2]]=1;
+            }
+            touched[c.to]=1;
+            ++collapsed;
+        }
+
+        if(!collapsed)
+            break;
+
+        size_t to=0;
+        for(size_t i=0;i<tris.size();i+=3)
+        {
+            const unsigned int a=remap[tris[i]],b=remap[tris[i+1]],c=remap[tris[i+2]];
+            if(a==b || b==c || a==c)
+                continue;
+
+            tris[to++]=a,tris[to++]=b,tris[to++]=c;
+        }
+        tris.resize(to);
+
+        for(unsigned int i=0;i<verts_count;++i)
+            remap[i]=i;
+    }
+
+    for(size_t i=0;i<tris.size();++i)
+        out[i]=t(tris[i]);
+
+    return (unsigned int)tris.size();
+}
+
+}
+
+vertex_cache_stats analyze_vertex_cache(const unsigned short *indices,unsigned int count,unsigned int verts_count,unsigned int cache_size)
+{
+    return analyze(indices,count,verts_count,cache_size);
+}
+
+vertex_cache_stats analyze_vertex_cache(const unsigned int *indices,unsigned int count,unsigned int verts_count,unsigned int cache_size)
+{
+    return analyze(indices,count,verts_count,cache_size);
+}
+
+void optimize_vertex_cache(unsigned short *indices,unsigned int count,unsigned int verts_count) { forsyth(indices,count,verts_count); }
+void optimize_vertex_cache(unsigned int *indices,unsigned int count,unsigned int verts_count) { forsyth(indices,count,verts_count); }
+
+void optimize_overdraw(unsigned short *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,float threshold)
+{
+    overdraw(indices,count,positions,stride,verts_count,threshold);
+}
+
+void optimize_overdraw(unsigned int *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,float threshold)
+{
+    overdraw(indices,count,positions,stride,verts_count,threshold);
+}
+
+unsigned int optimize_vertex_fetch(void *verts,unsigned int stride,unsigned int verts_count,unsigned short *indices,unsigned int count)
+{
+    return vertex_fetch(verts,stride,verts_count,indices,count);
+}
+
+unsigned int optimize_vertex_fetch(void *verts,unsigned int stride,unsigned int verts_count,unsigned int *indices,unsigned int count)
+{
+    return vertex_fetch(verts,stride,verts_count,indices,count);
+}
+
+unsigned int simplify_mesh(const unsigned short *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,
+                           unsigned int target_count,float max_error,unsigned short *out,const unsigned int *vertex_class)
+{
+    return simplify(indices,count,positions,stride,verts_count,target_count,max_error,out,vertex_class);
+}
+
+unsigned int simplify_mesh(const unsigned int *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,
+                           unsigned int target_count,float max_error,unsigned int *out,const unsigned int *vertex_class)
+{
+    return simplify(indices,count,positions,stride,verts_count,target_count,max_error,out,vertex_class);
+}
+
+}
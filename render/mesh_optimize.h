@@ -0,0 +1,44 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+namespace nya_render
+{
+
+//index buffer optimizations for triangle lists, for offline tools or at load time
+
+struct vertex_cache_stats
+{
+    float acmr; //transformed vertices per triangle, 0.5-3.0
+    float atvr; //transformed vertices per used vertex, 1.0 is optimal
+
+    vertex_cache_stats(): acmr(0.0f),atvr(0.0f) {}
+};
+
+//simulates a fifo post-transform cache
+vertex_cache_stats analyze_vertex_cache(const unsigned short *indices,unsigned int count,unsigned int verts_count,unsigned int cache_size=16);
+vertex_cache_stats analyze_vertex_cache(const unsigned int *indices,unsigned int count,unsigned int verts_count,unsigned int cache_size=16);
+
+//reorders triangles for post-transform cache hits, Tom Forsyth's linear-speed algorithm
+void optimize_vertex_cache(unsigned short *indices,unsigned int count,unsigned int verts_count);
+void optimize_vertex_cache(unsigned int *indices,unsigned int count,unsigned int verts_count);
+
+//after optimize_vertex_cache: splits triangles into clusters, keeping acmr within threshold times the original,
+//and draws outward-facing clusters first, positions are float xyz
+void optimize_overdraw(unsigned short *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,float threshold=1.05f);
+void optimize_overdraw(unsigned int *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,float threshold=1.05f);
+
+//reorders vertices in the order of first use and remaps indices, unused vertices go to the end
+//returns used vertices count
+unsigned int optimize_vertex_fetch(void *verts,unsigned int stride,unsigned int verts_count,unsigned short *indices,unsigned int count);
+unsigned int optimize_vertex_fetch(void *verts,unsigned int stride,unsigned int verts_count,unsigned int *indices,unsigned int count);
+
+//quadric error metric edge collapses onto existing vertices, so lods share the vertex buffer
+//open edges, like group borders and uv seams, are kept, vertices collapse only within the same vertex_class if set
+//max_error is relative to the mesh extent, out should fit count indices, returns the new indices count
+unsigned int simplify_mesh(const unsigned short *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,
+                           unsigned int target_count,float max_error,unsigned short *out,const unsigned int *vertex_class=0);
+unsigned int simplify_mesh(const unsigned int *indices,unsigned int count,const void *positions,unsigned int stride,unsigned int verts_count,
+                           unsigned int target_count,float max_error,unsigned int *out,const unsigned int *vertex_class=0);
+
+}
@@ -169,7 +169,11 @@ bool set_render_api(render_api_interface *api)
 {
     if (!api || !api->is_available())
         return false;
-    
+
+    //state applied through the previous api is unknown to the new one
+    if (api != render_interface)
+        api->invalidate_cached_state();
+
     render_interface = api;
     return true;
 }
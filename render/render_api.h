@@ -67,7 +67,7 @@ public:
     };
 
 public:
-    virtual int create_shader(const char *vertex,const char *fragment) { return -1; }
+    virtual int create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies) { return -1; }
     virtual uint get_uniforms_count(int shader) { return 0; }
     virtual shader::uniform get_uniform(int shader,int idx) { return shader::uniform(); }
     virtual void remove_shader(int shader) {}
@@ -80,6 +80,7 @@ public:
     virtual int create_vertex_buffer(const void *data,uint stride,uint count,vbo::usage_hint usage=vbo::static_draw) { return -1; }
     virtual void set_vertex_layout(int idx,vbo::layout layout) {}
     virtual void update_vertex_buffer(int idx,const void *data) {}
+    virtual bool update_vertex_buffer_range(int idx,const void *data,uint offset,uint size) { return false; } //data points to the range
     virtual bool get_vertex_data(int idx,void *data) { return false; }
     virtual void remove_vertex_buffer(int idx) {}
 
@@ -51,7 +51,7 @@ void render_buffered::draw(const state &s) { m_current.write(cmd_draw,s); }
 void render_buffered::apply_state(const state &s) { m_current.write(cmd_apply,s); }
 void render_buffered::resolve_target(int idx) { m_current.write(cmd_resolve,idx); }
 
-int render_buffered::create_shader(const char *vertex,const char *fragment)
+int render_buffered::create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies)
 {
     //ToDo
     std::vector<shader::uniform> uniforms;
@@ -85,16 +85,23 @@ int render_buffered::create_shader(const char *vertex,const char *fragment)
         }
     }
 
+    //frequency digit and name per line
+    std::string frequencies_str;
+    for(size_t i=0;i<frequencies.size();++i)
+        frequencies_str.append(1,char('0'+frequencies[i].second)).append(frequencies[i].first).append("\n");
+
     shader_create_data d;
     d.idx=new_idx();
     d.vs_size=(int)strlen(vertex)+1;
     d.ps_size=(int)strlen(fragment)+1;
+    d.frequencies_size=(int)frequencies_str.size()+1;
 
     m_uniform_info[d.idx]=uniforms;
 
     m_current.write(cmd_shdr_create,d);
     m_current.write(d.vs_size,vertex);
     m_current.write(d.ps_size,fragment);
+    m_current.write(d.frequencies_size,frequencies_str.c_str());
     return d.idx;
 }
 
@@ -450,7 +457,11 @@ void render_buffered::execute()
                 const shader_create_data d=m_processing.get_cmd_data<shader_create_data>();
                 const char *vs=(char *)m_processing.get_cbuf(d.vs_size);
                 const char *ps=(char *)m_processing.get_cbuf(d.ps_size);
-                m_processing.remap[d.idx]=m_backend.create_shader(vs,ps);
+                const char *f=(char *)m_processing.get_cbuf(d.frequencies_size);
+                shader::uniform_frequencies frequencies;
+                for(const char *end=strchr(f,'\n');end;f=end+1,end=strchr(f,'\n'))
+                    frequencies.push_back(std::make_pair(std::string(f+1,end),shader::uniform_frequency(f[0]-'0')));
+                m_processing.remap[d.idx]=m_backend.create_shader(vs,ps,frequencies);
                 m_processing.update_remap=true;
                 break;
             }
@@ -508,6 +519,16 @@ void render_buffered::execute()
                 break;
             }
 
+            case cmd_vbuf_update:
+            {
+                buf_update d=m_processing.get_cmd_data<buf_update>();
+                const void *data=m_processing.get_cbuf(d.size);
+                remap_idx(d.idx);
+                if(d.idx>=0)
+                    m_backend.update_vertex_buffer(d.idx,data);
+                break;
+            }
+
             case cmd_vbuf_remove:
             {
                 const int idx=m_processing.get_cmd_data<int>();
@@ -530,6 +551,16 @@ void render_buffered::execute()
                 break;
             }
 
+            case cmd_ibuf_update:
+            {
+                buf_update d=m_processing.get_cmd_data<buf_update>();
+                const void *data=m_processing.get_cbuf(d.size);
+                remap_idx(d.idx);
+                if(d.idx>=0)
+                    m_backend.update_index_buffer(d.idx,data);
+                break;
+            }
+
             case cmd_ibuf_remove:
             {
                 const int idx=m_processing.get_cmd_data<int>();
@@ -631,6 +662,8 @@ void render_buffered::execute()
                 break;
             }
 
+            case cmd_invalidate: m_backend.invalidate_cached_state(); break;
+
             default:
                 log()<<"unsupported render command: "<<cmd<<"\n"; m_processing.buffer.clear(); return;
         }
@@ -11,7 +11,7 @@ namespace nya_render
 class render_buffered: public render_api_interface
 {
 public:
-    int create_shader(const char *vertex,const char *fragment) override;
+    int create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies) override;
     uint get_uniforms_count(int shader) override;
     shader::uniform get_uniform(int shader,int idx) override;
     void remove_shader(int shader) override;
@@ -182,7 +182,7 @@ private:
     struct uniform_data { int buf_idx,idx;uint count; };
     struct clear_data { viewport_state vp; bool color,depth,stencil,reserved; };
     struct camera_data { nya_math::mat4 mv,p; };
-    struct shader_create_data { int idx,vs_size,ps_size; };
+    struct shader_create_data { int idx,vs_size,ps_size,frequencies_size; };
     struct ubuf_create_data { int idx,shader_idx; };
     struct vbuf_create_data { int idx;uint stride,count;vbo::usage_hint usage; };
     struct vbuf_layout { int idx; vbo::layout layout; };
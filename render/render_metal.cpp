@@ -194,7 +194,7 @@ public:
 render_objects<shader_buf> shader_bufs;
 }
 
-int render_metal::create_shader(const char *vertex,const char *fragment)
+int render_metal::create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies)
 {
     MTLCompileOptions *compile_options = [[MTLCompileOptions alloc] init];
     compile_options.fastMathEnabled = true;
@@ -883,7 +883,8 @@ namespace
                 {
                     case vbo::float32: vd.attributes[idx].format=MTLVertexFormat(MTLVertexFormatFloat+a->dimension-1); break;
                     case vbo::float16: vd.attributes[idx].format=MTLVertexFormat(MTLVertexFormatHalf2+(a->dimension>1?a->dimension:2)-2); break;
-                    case vbo::uint8: vd.attributes[idx].format=MTLVertexFormat(MTLVertexFormatUChar2+(a->dimension>1?a->dimension:2)-2); break;
+                    case vbo::uint8: vd.attributes[idx].format=MTLVertexFormat(MTLVertexFormatUChar2Normalized+(a->dimension>1?a->dimension:2)-2); break;
+                    case vbo::uint16: vd.attributes[idx].format=MTLVertexFormat(MTLVertexFormatUShort2Normalized+(a->dimension>1?a->dimension:2)-2); break;
                 }
             }
             vd.layouts[0].stride=vdescs.get_stride(d.vdesc);
@@ -18,7 +18,7 @@ public:
 
 #ifdef __APPLE__
 public:
-    int create_shader(const char *vertex,const char *fragment) override;
+    int create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies) override;
     uint get_uniforms_count(int shader) override;
     shader::uniform get_uniform(int shader,int idx) override;
     int create_uniform_buffer(int shader) override;
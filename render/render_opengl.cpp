@@ -6,6 +6,7 @@
 #include "render_objects.h"
 #include "bitmap.h"
 #include "fbo.h"
+#include "statistics.h"
 
 namespace nya_render
 {
@@ -21,8 +22,26 @@ namespace
     bool ignore_cache = true;
 	bool ignore_cache_vp = true;
     vbo::layout applied_layout;
-    bool was_fbo_without_color=false;
     int default_fbo_idx=-1;
+    bool uniform_buffers_enabled=true;
+
+    //one block per shader::uniform_frequency, block index is its binding point
+    const int uniform_blocks_count=3;
+    const char *uniform_block_names[uniform_blocks_count]={"_nya_material","_nya_frame","_nya_object"};
+    typedef std::vector<shader_code_parser::variable> block_uniforms_list;
+
+    //blocks are appended to a ring buffer before the draw and the buffer is orphaned when full,
+    //so a draw never waits for the gpu to finish reading the data of the previous ones
+    struct uniform_stream
+    {
+        GLuint buf;
+        int size,offset,alignment;
+        unsigned int version; //incremented on orphaning, ranges written before are no longer valid
+        struct range { GLuint buf; int offset,size; } bound[uniform_blocks_count];
+
+        uniform_stream(): buf(0),size(0),offset(0),alignment(0),version(1) { reset_bound(); }
+        void reset_bound() { memset(bound,0,sizeof(bound)); }
+    } ubo_stream;
 
     enum
     {
@@ -52,7 +71,7 @@ namespace
     struct shader_obj
     {
     public:
-        shader_obj(): program(0)
+        shader_obj(): program(0),has_blocks(false),camera_version(0)
         {
             memset(objects,0,sizeof(objects));
             mat_mvp=mat_mv=mat_p= -1;
@@ -60,11 +79,28 @@ namespace
 
         GLuint program,objects[shader::program_types_count];
 
-        struct uniform: public shader::uniform { int handler,cache_idx; };
+        struct uniform: public shader::uniform { int handler,cache_idx,block,block_offset,block_stride; };
         std::vector<uniform> uniforms;
         std::vector<float> uniform_cache;
         int mat_mvp,mat_mv,mat_p;
 
+        //non-sampler uniforms live in blocks by update frequency if has_blocks is set,
+        //a changed block is streamed whole before the draw, an unchanged one keeps its range
+        struct block
+        {
+            std::vector<char> data;
+            bool dirty;
+            int stream_offset;
+            unsigned int stream_version;
+
+            block(): dirty(true),stream_offset(0),stream_version(0) {}
+        };
+
+        block blocks[uniform_blocks_count];
+        bool has_blocks;
+
+        unsigned int camera_version; //of applied predefined matrices
+
         void release()
         {
             for(int i=0;i<shader::program_types_count;++i)
@@ -104,6 +140,19 @@ namespace
             applied_state.shader=idx;
     }
 
+    //counts filtered state at draw time, returns changed
+    inline bool state_changed(bool changed)
+    {
+        if(statistics::enabled())
+        {
+            if(changed)
+                ++statistics::get().state_changes;
+            else
+                ++statistics::get().state_changes_skipped;
+        }
+        return changed;
+    }
+
     int active_layer=-1;
     void gl_select_multitex_layer(int idx)
     {
@@ -147,10 +196,129 @@ GLuint compile_shader(nya_render::shader::program_type type,const char *src)
     return shader;
 }
 
-int render_opengl::create_shader(const char *vertex,const char *fragment)
+namespace
+{
+#ifdef USE_PROGRAM_BINARY
+    bool is_program_binary_supported() { return glProgramBinary!=0 && glGetProgramBinary!=0 && glProgramParameteri!=0; }
+
+    //binaries depend on driver, so it is a part of the cache key
+    std::string program_cache_key(const char *vertex,const char *fragment,const block_uniforms_list *blocks)
+    {
+        const char *renderer=(const char *)glGetString(GL_RENDERER);
+        const char *version=(const char *)glGetString(GL_VERSION);
+
+        std::string key="gl program\n";
+        key.append(renderer?renderer:"").append("\n").append(version?version:"").append("\n");
+        for(int i=0;blocks && i<uniform_blocks_count;++i)
+        {
+            key.append(uniform_block_names[i]);
+            for(size_t j=0;j<blocks[i].size();++j)
+                key.append(" ").append(blocks[i][j].name);
+            key.append("\n");
+        }
+        key.append("\n");
+        key.append(vertex).append("\n@fragment\n").append(fragment);
+        return key;
+    }
+
+    bool load_program_binary(GLuint program,const std::string &key)
+    {
+        compiled_shader cs;
+        if(!get_compiled_shaders_provider()->get(key.c_str(),cs) || cs.get_size()<=sizeof(GLenum))
+            return false;
+
+        GLenum format;
+        memcpy(&format,cs.get_data(),sizeof(format));
+        glProgramBinary(program,format,(const char *)cs.get_data()+sizeof(format),GLsizei(cs.get_size()-sizeof(format)));
+
+        GLint result=0;
+        glGetProgramiv(program,GL_LINK_STATUS,&result); //rejected after driver update
+        return result!=0;
+    }
+
+    void save_program_binary(GLuint program,const std::string &key)
+    {
+        GLint size=0;
+        glGetProgramiv(program,GL_PROGRAM_BINARY_LENGTH,&size);
+        if(size<=0)
+            return;
+
+        compiled_shader cs(sizeof(GLenum)+size);
+        GLenum format=0;
+        glGetProgramBinary(program,size,&size,&format,(char *)cs.get_data()+sizeof(format));
+        memcpy(cs.get_data(),&format,sizeof(format));
+        get_compiled_shaders_provider()->set(key.c_str(),cs);
+    }
+#endif
+
+    bool is_uniform_buffer_supported()
+    {
+#ifndef USE_UNIFORM_BUFFERS
+        return false;
+#elif defined NO_EXTENSIONS_INIT
+        return true;
+#else
+        return glGetUniformBlockIndex!=0 && glBindBufferRange!=0;
+#endif
+    }
+}
+
+int render_opengl::create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies)
 {
     init_extensions();
 
+    if(uniform_buffers_enabled && is_uniform_buffer_supported())
+    {
+        block_uniforms_list blocks[uniform_blocks_count];
+        bool empty=true;
+        for(int i=0;i<2;++i)
+        {
+            shader_code_parser parser(i==0?vertex:fragment);
+            for(int j=0;j<parser.get_uniforms_count();++j)
+            {
+                const shader_code_parser::variable v=parser.get_uniform(j);
+                if(v.type!=shader_code_parser::type_float && v.type!=shader_code_parser::type_vec2 &&
+                   v.type!=shader_code_parser::type_vec3 && v.type!=shader_code_parser::type_vec4 &&
+                   v.type!=shader_code_parser::type_mat4)
+                    continue;
+
+                if(v.name.compare(0,5,"_nya_")==0) //predefined
+                    continue;
+
+                int block=shader::frequency_material;
+                for(size_t k=0;k<frequencies.size();++k)
+                {
+                    if(frequencies[k].first==v.name)
+                        block=frequencies[k].second;
+                }
+
+                bool found=false;
+                for(int b=0;b<uniform_blocks_count && !found;++b)
+                {
+                    for(size_t k=0;k<blocks[b].size() && !found;++k)
+                        found=blocks[b][k].name==v.name;
+                }
+
+                if(!found)
+                    blocks[block].push_back(v),empty=false;
+            }
+        }
+
+        if(!empty)
+        {
+            const int idx=create_shader(vertex,fragment,blocks);
+            if(idx>=0)
+                return idx;
+
+            log()<<"Unable to create shader with uniform buffer, trying plain uniforms\n";
+        }
+    }
+
+    return create_shader(vertex,fragment,0);
+}
+
+int render_opengl::create_shader(const char *vertex,const char *fragment,const block_uniforms_list *blocks)
+{
     const int idx=shaders.add();
     shader_obj &shdr=shaders.get(idx);
 
@@ -162,6 +330,18 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
         return -1;
     }
 
+    bool from_binary=false;
+#ifdef USE_PROGRAM_BINARY
+    std::string binary_key;
+    if(get_compiled_shaders_provider() && is_program_binary_supported())
+    {
+        binary_key=program_cache_key(vertex,fragment,blocks);
+        from_binary=load_program_binary(shdr.program,binary_key);
+        if(!from_binary)
+            glProgramParameteri(shdr.program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+    }
+#endif
+
     std::vector<std::string> ft_vars;
 
     for(int i=0;i<2;++i)
@@ -195,18 +375,30 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
             shaders.remove(idx);
             return -1;
         }
-  #endif
-        GLuint object=compile_shader(type,parser.get_code());
-        if(!object)
+
+        for(int j=0;blocks && j<uniform_blocks_count;++j)
         {
-            shaders.remove(idx);
-            return -1;
+            if(!blocks[j].empty() && !parser.convert_uniforms_to_block(uniform_block_names[j],blocks[j]))
+            {
+                shaders.remove(idx);
+                return -1;
+            }
         }
+  #endif
+        if(!from_binary)
+        {
+            GLuint object=compile_shader(type,parser.get_code());
+            if(!object)
+            {
+                shaders.remove(idx);
+                return -1;
+            }
 
-        glAttachShader(shdr.program,object);
-        shdr.objects[type]=object;
+            glAttachShader(shdr.program,object);
+            shdr.objects[type]=object;
+        }
 
-        if(i==0)
+        if(i==0 && !from_binary)
         {
             for(int i=0;i<parser.get_attributes_count();++i)
             {
@@ -251,7 +443,7 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
         }
     }
 
-    if(!ft_vars.empty() && is_transform_feedback_supported())
+    if(!ft_vars.empty() && is_transform_feedback_supported() && !from_binary)
     {
         std::vector<const GLchar *> vars;
         for(int i=0;i<(int)ft_vars.size();++i)
@@ -259,9 +451,13 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
         glTransformFeedbackVaryings(shdr.program,(GLsizei)vars.size(),vars.data(),GL_INTERLEAVED_ATTRIBS);
     }
 
-    glLinkProgram(shdr.program);
     GLint result=1;
-    glGetProgramiv(shdr.program,GL_LINK_STATUS,&result);
+    if(!from_binary)
+    {
+        glLinkProgram(shdr.program);
+        glGetProgramiv(shdr.program,GL_LINK_STATUS,&result);
+    }
+
     if(!result)
     {
         log()<<"Can't link shader\n";
@@ -278,6 +474,11 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
         return -1;
     }
 
+#ifdef USE_PROGRAM_BINARY
+    if(!from_binary && !binary_key.empty())
+        save_program_binary(shdr.program,binary_key);
+#endif
+
     set_shader(idx);
 
     for(size_t i=0,layer=0;i<shdr.uniforms.size();++i)
@@ -305,13 +506,59 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
 
     if(shdr.mat_mvp>0)
         shdr.mat_mvp=glGetUniformLocation(shdr.program,"_nya_ModelViewProjectionMatrix");
-    else if(shdr.mat_mv>0)
+    if(shdr.mat_mv>0)
         shdr.mat_mv=glGetUniformLocation(shdr.program,"_nya_ModelViewMatrix");
-    else if(shdr.mat_p>0)
+    if(shdr.mat_p>0)
         shdr.mat_p=glGetUniformLocation(shdr.program,"_nya_ProjectionMatrix");
 
     for(int i=0;i<(int)shdr.uniforms.size();++i)
+    {
         shdr.uniforms[i].handler=glGetUniformLocation(shdr.program,shdr.uniforms[i].name.c_str());
+        shdr.uniforms[i].block=shdr.uniforms[i].block_offset=shdr.uniforms[i].block_stride= -1;
+    }
+
+#ifdef USE_UNIFORM_BUFFERS
+    for(int b=0;blocks && b<uniform_blocks_count;++b)
+    {
+        const GLuint block_idx=blocks[b].empty()?GL_INVALID_INDEX:glGetUniformBlockIndex(shdr.program,uniform_block_names[b]);
+        if(block_idx==GL_INVALID_INDEX)
+            continue;
+
+        glUniformBlockBinding(shdr.program,block_idx,b);
+
+        GLint block_size=0;
+        glGetActiveUniformBlockiv(shdr.program,block_idx,GL_UNIFORM_BLOCK_DATA_SIZE,&block_size);
+        if(block_size<=0)
+            continue;
+
+        shdr.blocks[b].data.resize(block_size,0);
+        shdr.has_blocks=true;
+
+        for(int i=0;i<(int)shdr.uniforms.size();++i)
+        {
+            shader_obj::uniform &u=shdr.uniforms[i];
+            bool in_block=false;
+            for(size_t j=0;j<blocks[b].size() && !in_block;++j)
+                in_block=blocks[b][j].name==u.name;
+            if(!in_block)
+                continue;
+
+            const std::string name=u.array_size>1?u.name+"[0]":u.name;
+            const GLchar *names[]={name.c_str()};
+            GLuint uniform_idx=GL_INVALID_INDEX;
+            glGetUniformIndices(shdr.program,1,names,&uniform_idx);
+            if(uniform_idx==GL_INVALID_INDEX)
+                continue;
+
+            GLint offset= -1,stride=0;
+            glGetActiveUniformsiv(shdr.program,1,&uniform_idx,GL_UNIFORM_OFFSET,&offset);
+            glGetActiveUniformsiv(shdr.program,1,&uniform_idx,GL_UNIFORM_ARRAY_STRIDE,&stride);
+            u.block=b;
+            u.block_offset=offset;
+            u.block_stride=stride;
+        }
+    }
+#endif
 
     int cache_size=0;
     for(int i=0;i<(int)shdr.uniforms.size();++i)
@@ -322,7 +569,7 @@ int render_opengl::create_shader(const char *vertex,const char *fragment)
         u.cache_idx=cache_size;
         cache_size+=u.array_size*(u.type==shader::uniform_mat4?16:4);
 
-        if(u.handler<0)
+        if(u.handler<0 && u.block_offset<0)
             u.type=shader::uniform_not_found;
     }
     shdr.uniform_cache.resize(cache_size);
@@ -342,22 +589,121 @@ void render_opengl::remove_shader(int shader)
         glUseProgram(0);
         applied_state.shader=-1;
     }
+
+    //the index is reused by the next created shader
+    if(applied_state.uniform_buffer==shader)
+        applied_state.uniform_buffer=-1;
     shaders.remove(shader);
 }
 
-//ToDo: uniform buffers
-
 int render_opengl::create_uniform_buffer(int shader) { return shader; }
 
+namespace
+{
+    //vec3 arrays are tightly packed, other types are set with a vec4 or mat4 per element
+    void set_block_uniform(shader_obj &s,const shader_obj::uniform &u,const float *buf,unsigned int count)
+    {
+        shader_obj::block &b=s.blocks[u.block];
+        int components=4,src_stride=4;
+        switch(u.type)
+        {
+            case shader::uniform_float: components=1; break;
+            case shader::uniform_vec2: components=2; break;
+            case shader::uniform_vec3: components=src_stride=3; break;
+            case shader::uniform_mat4: components=src_stride=16; break;
+            default: break;
+        }
+
+        unsigned int elements=count/src_stride;
+        if(elements>u.array_size)
+            elements=u.array_size;
+
+        const int size=components*sizeof(float);
+        for(unsigned int i=0;i<elements;++i,buf+=src_stride)
+        {
+            const int offset=u.block_offset+i*u.block_stride;
+            if(offset+size>(int)b.data.size())
+                break;
+
+            char *to=&b.data[offset];
+            if(memcmp(to,buf,size)==0)
+                continue;
+
+            memcpy(to,buf,size);
+            b.dirty=true;
+        }
+    }
+
+#ifdef USE_UNIFORM_BUFFERS
+    void stream_uniform_block(shader_obj::block &b)
+    {
+        uniform_stream &s=ubo_stream;
+        const int size=(int)b.data.size();
+        if(!s.buf)
+        {
+            glGenBuffers(1,&s.buf);
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,&s.alignment);
+            if(s.alignment<=0)
+                s.alignment=256;
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER,s.buf);
+
+        int offset=(s.offset+s.alignment-1)/s.alignment*s.alignment;
+        if(offset+size>s.size)
+        {
+            const int default_size=256*1024;
+            if(size>s.size)
+                s.size=size>default_size?size:default_size;
+
+            glBufferData(GL_UNIFORM_BUFFER,s.size,0,GL_STREAM_DRAW);
+            ++s.version;
+            offset=0;
+        }
+
+        glBufferSubData(GL_UNIFORM_BUFFER,offset,size,&b.data[0]);
+        s.offset=offset+size;
+
+        b.stream_offset=offset;
+        b.stream_version=s.version;
+        b.dirty=false;
+
+        if(statistics::enabled())
+            statistics::get().uniform_upload_bytes+=size;
+    }
+
+    void bind_uniform_block(int binding,const shader_obj::block &b)
+    {
+        uniform_stream::range &r=ubo_stream.bound[binding];
+        const int size=(int)b.data.size();
+        if(r.buf==ubo_stream.buf && r.offset==b.stream_offset && r.size==size)
+            return;
+
+        glBindBufferRange(GL_UNIFORM_BUFFER,binding,ubo_stream.buf,b.stream_offset,size);
+        r.buf=ubo_stream.buf,r.offset=b.stream_offset,r.size=size;
+    }
+#endif
+}
+
 void render_opengl::set_uniform(int shader,int idx,const float *buf,uint count)
 {
     shader_obj &s=shaders.get(shader);
 
+    const shader_obj::uniform &u=s.uniforms[idx];
+    if(u.block_offset>=0)
+    {
+        set_block_uniform(s,u,buf,count);
+        return;
+    }
+
     float *cache=&s.uniform_cache[s.uniforms[idx].cache_idx];
     if(memcmp(cache,buf,count*sizeof(float))==0)
         return;
     memcpy(cache,buf,count*sizeof(float));
 
+    if(statistics::enabled())
+        statistics::get().uniform_upload_bytes+=count*sizeof(float);
+
     set_shader(shader);
 
     const int handler=s.uniforms[idx].handler;
@@ -400,6 +746,7 @@ namespace
             case vbo::float16: return GL_HALF_FLOAT;
             case vbo::float32: return GL_FLOAT;
             case vbo::uint8: return GL_UNSIGNED_BYTE;
+            case vbo::uint16: return GL_UNSIGNED_SHORT;
         }
 
         return GL_FLOAT;
@@ -516,6 +863,22 @@ void render_opengl::update_vertex_buffer(int idx,const void *data)
 #endif
 }
 
+bool render_opengl::update_vertex_buffer_range(int idx,const void *data,uint offset,uint size)
+{
+    vert_buf &v=vert_bufs.get(idx);
+#ifdef USE_VAO
+    glBindVertexArray(0);
+#endif
+    glBindBuffer(GL_ARRAY_BUFFER,v.id);
+    applied_state.vertex_buffer=-1;
+    glBufferSubData(GL_ARRAY_BUFFER,offset,size,data);
+
+#ifdef USE_VAO
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+#endif
+    return true;
+}
+
 bool render_opengl::get_vertex_data(int idx,void *data)
 {
     const vert_buf &v=vert_bufs.get(idx);
@@ -801,6 +1164,23 @@ namespace
         glBindTexture(t.gl_type,t.tex_id);
     }
 
+    //unbound layers keep their previous texture, it is harmless while not sampled and often rebound by the next draw
+    void apply_textures(const render_api_interface::render_state &s)
+    {
+        for(int i=0;i<s.max_layers;++i)
+        {
+            if(s.textures[i]<0)
+            {
+                if(applied_state.textures[i]>=0)
+                    state_changed(false);
+                continue;
+            }
+
+            if(state_changed(s.textures[i]!=applied_state.textures[i]))
+                set_texture(s.textures[i],i);
+        }
+    }
+
     int create_texture_(const void *data_a[6],bool is_cubemap,unsigned int width,unsigned int height,texture::color_format &format,int mip_count)
     {
         const int idx=textures.add();
@@ -1276,6 +1656,15 @@ int render_opengl::create_target(uint width,uint height,uint samples,const int *
 
     f.depth_only=!has_color && depth_texture>=0;
 
+#ifndef OPENGL_ES
+    //draw and read buffers are framebuffer state, so they are set once and not cached across targets
+    if(f.depth_only)
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+#endif
+
     glBindFramebuffer(GL_FRAMEBUFFER,applied_state.target>=0?fbos.get(applied_state.target).id:default_fbo_idx);
     return idx;
 }
@@ -1296,7 +1685,7 @@ void render_opengl::resolve_target(int idx)
         {
             gl_select_multitex_layer(0);
             glBindTexture(tex.gl_type, tex.tex_id);
-            applied_state.textures[0]=tex.tex_id;
+            applied_state.textures[0]=a.tex_idx;
             glGenerateMipmap(tex.gl_type);
         }
     }
@@ -1348,23 +1737,10 @@ static void apply_viewport_state(render_api_interface::viewport_state s)
         init_extensions();
     }
 
-    if(s.target!=applied_state.target || ignore_cache_vp)
-    {
+    if(state_changed(s.target!=applied_state.target || ignore_cache_vp))
         glBindFramebuffer(GL_FRAMEBUFFER,s.target>=0?fbos.get(s.target).id:default_fbo_idx);
 
-#ifndef OPENGL_ES
-        const bool no_color=s.target>=0 && fbos.get(s.target).depth_only;
-        if(s.target>=0 && (no_color!=was_fbo_without_color || ignore_cache_vp))
-        {
-            const int buffer=no_color?GL_NONE:GL_COLOR_ATTACHMENT0;
-            glDrawBuffer(buffer);
-            glReadBuffer(buffer);
-            was_fbo_without_color=no_color;
-        }
-#endif
-    }
-
-    if(applied_state.viewport!=s.viewport || ignore_cache_vp)
+    if(state_changed(applied_state.viewport!=s.viewport || ignore_cache_vp))
         glViewport(s.viewport.x,s.viewport.y,s.viewport.width,s.viewport.height);
 
     if(memcmp(applied_state.clear_color,s.clear_color,sizeof(applied_state.clear_color))!=0 || ignore_cache_vp)
@@ -1379,7 +1755,7 @@ static void apply_viewport_state(render_api_interface::viewport_state s)
 #endif
     }
 
-    if(s.scissor_enabled!=applied_state.scissor_enabled || ignore_cache_vp)
+    if(state_changed(s.scissor_enabled!=applied_state.scissor_enabled || ignore_cache_vp))
     {
         if(s.scissor_enabled)
             glEnable(GL_SCISSOR_TEST);
@@ -1387,11 +1763,15 @@ static void apply_viewport_state(render_api_interface::viewport_state s)
             glDisable(GL_SCISSOR_TEST);
     }
 
-    if(s.scissor!=applied_state.scissor)
+    if(s.scissor_enabled && state_changed(s.scissor!=applied_state.scissor || ignore_cache_vp))
         glScissor(s.scissor.x,s.scissor.y,s.scissor.width,s.scissor.height);
 
+    const rect applied_scissor=applied_state.scissor;
     *(render_api_interface::viewport_state*)&applied_state=s;
-	ignore_cache_vp=false;
+    if(!s.scissor_enabled)
+        applied_state.scissor=applied_scissor; //not applied while disabled
+
+    ignore_cache_vp=false;
 }
 
 inline GLenum gl_blend_mode(blend::mode m)
@@ -1444,21 +1824,17 @@ void render_opengl::clear(const viewport_state &s,bool color,bool depth,bool ste
     glClear(mode);
 }
 
+//doesn't call gl, so it's safe without a current context, e.g. when the render api is switched
+//texture layers are reset by the next apply_state
 void render_opengl::invalidate_cached_state()
 {
     ignore_cache = true;
-	ignore_cache_vp = true;
+    ignore_cache_vp = true;
 
     applied_state.index_buffer=applied_state.vertex_buffer= -1;
     applied_state.shader=applied_state.uniform_buffer= -1;
+    ubo_stream.reset_bound();
     active_layer=-1;
-    for(int i=0;i<state::max_layers;++i)
-    {
-        applied_state.textures[i]=-1;
-        gl_select_multitex_layer(i);
-        glBindTexture(GL_TEXTURE_2D,0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP,0);
-    }
 
 #ifndef USE_VAO
     applied_layout=vbo::layout();
@@ -1466,12 +1842,16 @@ void render_opengl::invalidate_cached_state()
 #endif
 }
 
-namespace { nya_math::mat4 modelview, projection; }
+namespace { nya_math::mat4 modelview, projection; unsigned int camera_version=1; }
 
 void render_opengl::set_camera(const nya_math::mat4 &mv,const nya_math::mat4 &p)
 {
+    if(memcmp(modelview[0],mv[0],sizeof(modelview))==0 && memcmp(projection[0],p[0],sizeof(projection))==0)
+        return;
+
     modelview=mv;
     projection=p;
+    ++camera_version;
 }
 
 void render_opengl::apply_state(const state &c)
@@ -1480,7 +1860,7 @@ void render_opengl::apply_state(const state &c)
 
     apply_viewport_state(c);
 
-    if(c.blend!=a.blend || ignore_cache)
+    if(state_changed(c.blend!=a.blend || ignore_cache))
     {
         if(c.blend)
             glEnable(GL_BLEND);
@@ -1489,13 +1869,13 @@ void render_opengl::apply_state(const state &c)
         a.blend=c.blend;
     }
 
-    if(c.blend_src!=a.blend_src || c.blend_dst!=a.blend_dst || ignore_cache)
+    if(state_changed(c.blend_src!=a.blend_src || c.blend_dst!=a.blend_dst || ignore_cache))
     {
         glBlendFuncSeparate(gl_blend_mode(c.blend_src),gl_blend_mode(c.blend_dst),GL_ONE,GL_ONE);
         a.blend_src=c.blend_src,a.blend_dst=c.blend_dst;
     }
 
-    if(c.cull_face!=a.cull_face || ignore_cache)
+    if(state_changed(c.cull_face!=a.cull_face || ignore_cache))
     {
         if(c.cull_face)
             glEnable(GL_CULL_FACE);
@@ -1504,7 +1884,7 @@ void render_opengl::apply_state(const state &c)
         a.cull_face=c.cull_face;
     }
 
-    if(c.cull_order!=a.cull_order || ignore_cache)
+    if(state_changed(c.cull_order!=a.cull_order || ignore_cache))
     {
         if(c.cull_order==cull_face::cw)
             glFrontFace(GL_CW);
@@ -1513,7 +1893,7 @@ void render_opengl::apply_state(const state &c)
         a.cull_order=c.cull_order;
     }
 
-    if(c.depth_test!=a.depth_test || ignore_cache)
+    if(state_changed(c.depth_test!=a.depth_test || ignore_cache))
     {
         if(c.depth_test)
             glEnable(GL_DEPTH_TEST);
@@ -1522,7 +1902,7 @@ void render_opengl::apply_state(const state &c)
         a.depth_test=c.depth_test;
     }
 
-    if(c.depth_comparsion!=a.depth_comparsion || ignore_cache)
+    if(state_changed(c.depth_comparsion!=a.depth_comparsion || ignore_cache))
     {
         switch(c.depth_comparsion)
         {
@@ -1538,24 +1918,30 @@ void render_opengl::apply_state(const state &c)
         a.depth_comparsion=c.depth_comparsion;
     }
 
-    if(c.zwrite!=a.zwrite || ignore_cache)
+    if(state_changed(c.zwrite!=a.zwrite || ignore_cache))
     {
         glDepthMask(c.zwrite);
         a.zwrite=c.zwrite;
     }
 
-    if(c.color_write!=a.color_write || ignore_cache)
+    if(state_changed(c.color_write!=a.color_write || ignore_cache))
     {
         glColorMask(c.color_write,c.color_write,c.color_write,c.color_write);
         a.color_write=c.color_write;
     }
 
-    for(int i=0;i<c.max_layers;++i)
+    if(ignore_cache)
     {
-        if(c.textures[i]!=a.textures[i])
-            set_texture(c.textures[i],i);
+        for(int i=0;i<state::max_layers;++i)
+        {
+            a.textures[i]=-1;
+            gl_select_multitex_layer(i);
+            glBindTexture(GL_TEXTURE_2D,0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP,0);
+        }
     }
 
+    apply_textures(c);
     ignore_cache = false;
 }
 
@@ -1564,22 +1950,48 @@ template<bool transform_feedback>void draw_(const nya_render::render_api_interfa
     if(s.vertex_buffer<0 || s.shader<0)
         return;
 
-    set_shader(s.shader);
+    if(state_changed(s.shader!=applied_state.shader))
+        set_shader(s.shader);
 
     shader_obj &shdr=shaders.get(s.shader);
-    if(shdr.mat_mvp>=0)
+    if(shdr.camera_version!=camera_version)
     {
-        const nya_math::mat4 mvp=modelview*projection;
-        glUniformMatrix4fv(shdr.mat_mvp,1,false,mvp[0]);
+        int matrices_count=0;
+        if(shdr.mat_mvp>=0)
+        {
+            const nya_math::mat4 mvp=modelview*projection;
+            glUniformMatrix4fv(shdr.mat_mvp,1,false,mvp[0]);
+            ++matrices_count;
+        }
+        if(shdr.mat_mv>=0)
+            glUniformMatrix4fv(shdr.mat_mv,1,false,modelview[0]),++matrices_count;
+        if(shdr.mat_p>=0)
+            glUniformMatrix4fv(shdr.mat_p,1,false,projection[0]),++matrices_count;
+
+        shdr.camera_version=camera_version;
+        if(statistics::enabled())
+            statistics::get().uniform_upload_bytes+=matrices_count*sizeof(nya_math::mat4);
+    }
+
+#ifdef USE_UNIFORM_BUFFERS
+    if(shdr.has_blocks)
+    {
+        for(int i=0;i<uniform_blocks_count;++i)
+        {
+            shader_obj::block &b=shdr.blocks[i];
+            if(b.data.empty())
+                continue;
+
+            if(b.dirty || b.stream_version!=ubo_stream.version)
+                stream_uniform_block(b);
+            bind_uniform_block(i,b);
+        }
     }
-    if(shdr.mat_mv>=0)
-        glUniformMatrix4fv(shdr.mat_mv,1,false,modelview[0]);
-    if(shdr.mat_p>=0)
-        glUniformMatrix4fv(shdr.mat_p,1,false,projection[0]);
+#endif
 
     vert_buf &v=vert_bufs.get(s.vertex_buffer);
 
-    if(s.vertex_buffer!=applied_state.vertex_buffer)
+    if(state_changed(s.vertex_buffer!=applied_state.vertex_buffer))
     {
 #ifdef USE_VAO
         if(v.vertex_array_object>0)
@@ -1654,13 +2066,13 @@ template<bool transform_feedback>void draw_(const nya_render::render_api_interfa
         ind_buf &i=ind_bufs.get(s.index_buffer);
 
 #ifdef USE_VAO
-        if(i.id!=v.active_vao_ibuf)
+        if(state_changed(i.id!=v.active_vao_ibuf))
         {
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,i.id);
             v.active_vao_ibuf=i.id;
         }
 #else
-        if(s.index_buffer!=applied_state.index_buffer)
+        if(state_changed(s.index_buffer!=applied_state.index_buffer))
         {
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,i.id);
             applied_state.index_buffer=s.index_buffer;
@@ -1720,11 +2132,7 @@ void render_opengl::transform_feedback(const tf_state &s)
 
     state ss=applied_state;
     (render_state &)ss=s;
-    for(int i=0;i<s.max_layers;++i)
-    {
-        if(s.textures[i]!=applied_state.textures[i])
-            set_texture(s.textures[i],i);
-    }
+    apply_textures(s);
     draw_<true>(ss);
     //glDisable(GL_RASTERIZER_DISCARD);
 }
@@ -1838,6 +2246,8 @@ namespace
     bool log_set=false;
 }
 
+void render_opengl::enable_uniform_buffers(bool enable) { uniform_buffers_enabled=enable; }
+
 void render_opengl::enable_debug(bool synchronous)
 {
     if(log_set)
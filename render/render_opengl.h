@@ -17,7 +17,7 @@ public:
     void apply_state(const state &s) override;
 
 public:
-    int create_shader(const char *vertex,const char *fragment) override;
+    int create_shader(const char *vertex,const char *fragment,const shader::uniform_frequencies &frequencies) override;
     uint get_uniforms_count(int shader) override;
     shader::uniform get_uniform(int shader,int idx) override;
     void remove_shader(int shader) override;
@@ -30,6 +30,7 @@ public:
     int create_vertex_buffer(const void *data,uint stride,uint count,vbo::usage_hint usage) override;
     void set_vertex_layout(int idx,vbo::layout layout) override;
     void update_vertex_buffer(int idx,const void *data) override;
+    bool update_vertex_buffer_range(int idx,const void *data,uint offset,uint size) override;
     bool get_vertex_data(int idx,void *data) override;
     void remove_vertex_buffer(int idx) override;
 
@@ -68,6 +69,9 @@ public:
     static void log_errors(const char *place=0);
     static void enable_debug(bool synchronous);
 
+    //shaders created after this call keep non-sampler uniforms in a uniform buffer, gl3 only, enabled by default
+    static void enable_uniform_buffers(bool enable);
+
     static bool has_extension(const char *name);
     static void *get_extension(const char *name);
 
@@ -82,6 +86,7 @@ public:
 
 private:
     render_opengl() {}
+    int create_shader(const char *vertex,const char *fragment,const std::vector<shader_code_parser::variable> *blocks); //per shader::uniform_frequency
 };
 
 }
@@ -65,6 +65,10 @@ namespace
     #define USE_INSTANCING
 #endif
 
+#if !defined NO_EXTENSIONS_INIT && defined GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    #define USE_PROGRAM_BINARY
+#endif
+
 #ifdef OPENGL_ES
     #define glGenVertexArrays glGenVertexArraysOES
     #define glBindVertexArray glBindVertexArrayOES
@@ -111,6 +115,10 @@ namespace
     #define GL_TRANSFORM_FEEDBACK_BUFFER GL_TRANSFORM_FEEDBACK_BUFFER_EXT
 #endif
 
+#if !defined OPENGL_ES
+    #define USE_UNIFORM_BUFFERS
+#endif
+
 #ifndef GL_RASTERIZER_DISCARD
     #define GL_RASTERIZER_DISCARD GL_RASTERIZER_DISCARD_EXT
 #endif
@@ -237,6 +245,12 @@ namespace
     PFNGLENDTRANSFORMFEEDBACKEXTPROC glEndTransformFeedback=NULL;
     PFNGLTRANSFORMFEEDBACKVARYINGSPROC glTransformFeedbackVaryings=NULL;
 
+    PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex=NULL;
+    PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding=NULL;
+    PFNGLGETACTIVEUNIFORMBLOCKIVPROC glGetActiveUniformBlockiv=NULL;
+    PFNGLGETUNIFORMINDICESPROC glGetUniformIndices=NULL;
+    PFNGLGETACTIVEUNIFORMSIVPROC glGetActiveUniformsiv=NULL;
+
     PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers=NULL;
     PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer=NULL;
     PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers=NULL;
@@ -278,6 +292,12 @@ namespace
     PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate=NULL;
 
     PFNGLDEBUGMESSAGECALLBACKARBPROC glDebugMessageCallback=NULL;
+
+  #ifdef USE_PROGRAM_BINARY
+    PFNGLGETPROGRAMBINARYPROC glGetProgramBinary=NULL;
+    PFNGLPROGRAMBINARYPROC glProgramBinary=NULL;
+    PFNGLPROGRAMPARAMETERIPROC glProgramParameteri=NULL;
+  #endif
 #endif
 
     static void init_extensions()
@@ -347,6 +367,17 @@ namespace
             glTransformFeedbackVaryings=(PFNGLTRANSFORMFEEDBACKVARYINGSPROC)get_extension("glTransformFeedbackVaryings");
         }
 
+        if(has_extension("GL_ARB_uniform_buffer_object"))
+        {
+            glGetUniformBlockIndex=(PFNGLGETUNIFORMBLOCKINDEXPROC)get_extension("glGetUniformBlockIndex");
+            glUniformBlockBinding=(PFNGLUNIFORMBLOCKBINDINGPROC)get_extension("glUniformBlockBinding");
+            glGetActiveUniformBlockiv=(PFNGLGETACTIVEUNIFORMBLOCKIVPROC)get_extension("glGetActiveUniformBlockiv");
+            glGetUniformIndices=(PFNGLGETUNIFORMINDICESPROC)get_extension("glGetUniformIndices");
+            glGetActiveUniformsiv=(PFNGLGETACTIVEUNIFORMSIVPROC)get_extension("glGetActiveUniformsiv");
+            if(!glBindBufferBase)
+                glBindBufferBase=(PFNGLBINDBUFFERBASEEXTPROC)get_extension("glBindBufferBase");
+        }
+
 #ifdef _WIN32
         glCompressedTexImage2D=(PFNGLCOMPRESSEDTEXIMAGE2DARBPROC)get_extension("glCompressedTexImage2DARB");
         glActiveTexture=(PFNGLACTIVETEXTUREARBPROC)get_extension("glActiveTextureARB");
@@ -357,6 +388,15 @@ namespace
         if(has_extension("GL_ARB_debug_output"))
             glDebugMessageCallback=(PFNGLDEBUGMESSAGECALLBACKARBPROC)get_extension("glDebugMessageCallbackARB");
 
+      #ifdef USE_PROGRAM_BINARY
+        if(has_extension("GL_ARB_get_program_binary"))
+        {
+            glGetProgramBinary=(PFNGLGETPROGRAMBINARYPROC)get_extension("glGetProgramBinary");
+            glProgramBinary=(PFNGLPROGRAMBINARYPROC)get_extension("glProgramBinary");
+            glProgramParameteri=(PFNGLPROGRAMPARAMETERIPROC)get_extension("glProgramParameteri");
+        }
+      #endif
+
         glBlitFramebuffer=(PFNGLBLITFRAMEBUFFERPROC)get_extension("glBlitFramebuffer");
         glGenRenderbuffers=(PFNGLGENRENDERBUFFERSPROC)get_extension("glGenRenderbuffers");
         glBindRenderbuffer=(PFNGLBINDRENDERBUFFERPROC)get_extension("glBindRenderbuffer");
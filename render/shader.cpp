@@ -26,7 +26,7 @@ bool shader::add_program(program_type type,const char*code)
     if(!m_code[vertex].empty() && !m_code[pixel].empty())
     {
         release();
-        m_shdr=get_api_interface().create_shader(m_code[vertex].c_str(), m_code[pixel].c_str());
+        m_shdr=get_api_interface().create_shader(m_code[vertex].c_str(),m_code[pixel].c_str(),m_frequencies);
         if(m_shdr<0)
             return false;
 
@@ -41,6 +41,23 @@ bool shader::add_program(program_type type,const char*code)
     return true;
 }
 
+void shader::set_uniform_frequency(const char *name,uniform_frequency frequency)
+{
+    if(!name || !name[0])
+        return;
+
+    for(size_t i=0;i<m_frequencies.size();++i)
+    {
+        if(m_frequencies[i].first==name)
+        {
+            m_frequencies[i].second=frequency;
+            return;
+        }
+    }
+
+    m_frequencies.push_back(std::make_pair(std::string(name),frequency));
+}
+
 void shader::bind() const { get_api_state().shader=m_shdr; get_api_state().uniform_buffer=m_buf; }
 void shader::unbind() { get_api_state().shader= -1; get_api_state().uniform_buffer= -1; }
 
@@ -183,4 +200,9 @@ void shader::release()
     m_uniforms.clear();
 }
 
+namespace { compiled_shaders_provider *shaders_provider=0; }
+
+void set_compiled_shaders_provider(compiled_shaders_provider *provider) { shaders_provider=provider; }
+compiled_shaders_provider *get_compiled_shaders_provider() { return shaders_provider; }
+
 }
@@ -57,6 +57,19 @@ public:
     uniform_type get_uniform_type(int idx) const;
     unsigned int get_uniform_array_size(int idx) const;
 
+public:
+    enum uniform_frequency
+    {
+        frequency_material, //default
+        frequency_frame,
+        frequency_object
+    };
+
+    typedef std::vector<std::pair<std::string,uniform_frequency> > uniform_frequencies;
+
+    //backends with uniform buffers keep uniforms changed together in one block, should be set before add_program
+    void set_uniform_frequency(const char *name,uniform_frequency frequency);
+
 public:
     void set_uniform(int idx,float f0,float f1=0.0f,float f2=0.0f,float f3=0.0f) const;
     void set_uniform3_array(int idx,const float *f,unsigned int count) const;
@@ -74,6 +87,7 @@ private:
     int m_buf;
     std::vector<uniform> m_uniforms;
     std::string m_code[program_types_count];
+    uniform_frequencies m_frequencies;
 };
 
 class compiled_shader
@@ -91,6 +105,7 @@ private:
     std::vector<char> m_data;
 };
 
+//text is a backend-specific key, opengl passes sources with renderer info and caches linked program binaries
 class compiled_shaders_provider
 {
 public:
@@ -99,5 +114,6 @@ public:
 };
 
 void set_compiled_shaders_provider(compiled_shaders_provider *provider);
+compiled_shaders_provider *get_compiled_shaders_provider();
 
 }
@@ -1,10 +1,12 @@
 //nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
 
 #include "shader_code_parser.h"
+#include "memory/mutex.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <algorithm>
+#include <stdint.h>
 
 namespace nya_render
 {
@@ -33,7 +35,338 @@ inline int type_regsize(shader_code_parser::variable_type type)
 
 static bool is_name_char(char c) { return isalnum(c) || c=='_'; }
 
-bool shader_code_parser::convert_to_hlsl()
+namespace
+{
+    //two independent 64-bit hashes of the same input, the second one is compared on a hit
+    struct translation_key
+    {
+        uint64_t h,check;
+
+        translation_key(): h(14695981039346656037ULL),check(0x9e3779b97f4a7c15ULL) {}
+
+        void append(const void *data,size_t size)
+        {
+            const char *c=(const char *)data;
+            for(;size>=sizeof(uint64_t);c+=sizeof(uint64_t),size-=sizeof(uint64_t))
+            {
+                uint64_t w;
+                memcpy(&w,c,sizeof(w));
+                h^=w;
+                h*=1099511628211ULL;
+                h^=h>>32;
+                check+=w;
+                check*=0xff51afd7ed558ccdULL;
+                check^=check>>29;
+            }
+
+            for(;size>0;++c,--size)
+            {
+                h^=(unsigned char)*c;
+                h*=1099511628211ULL;
+                check+=(unsigned char)*c;
+                check*=0xc4ceb9fe1a85ec53ULL;
+            }
+        }
+
+        void append(const std::string &s)
+        {
+            const uint32_t size=uint32_t(s.size());
+            append(&size,sizeof(size));
+            append(s.data(),s.size());
+        }
+    };
+
+    struct packed_variable { uint32_t type,array_size,name_size; const char *name; };
+
+    struct translation
+    {
+        uint64_t check;
+        const char *code;
+        uint32_t code_size;
+        const packed_variable *vars;
+        uint32_t vars_count[4]; //uniforms, attributes, varying, out
+    };
+
+    //translations are copied into fixed chunks that never move or grow,
+    //so storing one costs a bump allocation instead of scattered heap allocations
+    struct translation_cache
+    {
+        typedef std::map<uint64_t,translation> entries_map;
+        entries_map entries;
+        std::vector<char *> chunks;
+        size_t chunk_left;
+        char *chunk_pos;
+        nya_memory::mutex mutex;
+
+        translation_cache(): chunk_left(0),chunk_pos(0) {}
+        ~translation_cache() { clear(); }
+
+        char *alloc(size_t size)
+        {
+            size=(size+7)&~size_t(7);
+            if(size>chunk_left)
+            {
+                const size_t chunk_size=64*1024;
+                chunk_left=size>chunk_size?size:chunk_size;
+                chunk_pos=new char[chunk_left];
+                chunks.push_back(chunk_pos);
+            }
+
+            char *result=chunk_pos;
+            chunk_pos+=size;
+            chunk_left-=size;
+            return result;
+        }
+
+        const char *add_text(const std::string &s)
+        {
+            char *to=alloc(s.size());
+            if(!s.empty())
+                memcpy(to,s.data(),s.size());
+            return to;
+        }
+
+        void add(uint64_t h,uint64_t check,const std::string &code,const std::vector<shader_code_parser::variable> *const *src)
+        {
+            if(entries.find(h)!=entries.end())
+                return;
+
+            translation &t=entries[h];
+            t.check=check;
+            t.code=add_text(code);
+            t.code_size=uint32_t(code.size());
+
+            size_t count=0;
+            for(int i=0;i<4;++i)
+                count+=(t.vars_count[i]=uint32_t(src[i]->size()));
+
+            packed_variable *pv=(packed_variable *)alloc(count*sizeof(packed_variable));
+            t.vars=pv;
+            for(int i=0;i<4;++i)
+            {
+                for(size_t j=0;j<src[i]->size();++j,++pv)
+                {
+                    const shader_code_parser::variable &v=(*src[i])[j];
+                    pv->type=uint32_t(v.type);
+                    pv->array_size=v.array_size;
+                    pv->name_size=uint32_t(v.name.size());
+                    pv->name=add_text(v.name);
+                }
+            }
+        }
+
+        static void get(const translation &t,std::string &code,std::vector<shader_code_parser::variable> *const *dst)
+        {
+            code.assign(t.code,t.code_size);
+            const packed_variable *pv=t.vars;
+            for(int i=0;i<4;++i)
+            {
+                dst[i]->resize(t.vars_count[i]);
+                for(uint32_t j=0;j<t.vars_count[i];++j,++pv)
+                {
+                    shader_code_parser::variable &v=(*dst[i])[j];
+                    v.type=shader_code_parser::variable_type(pv->type);
+                    v.name.assign(pv->name,pv->name_size);
+                    v.array_size=pv->array_size;
+                }
+            }
+        }
+
+        void clear()
+        {
+            entries.clear();
+            for(size_t i=0;i<chunks.size();++i)
+                delete []chunks[i];
+            chunks.clear();
+            chunk_left=0;
+            chunk_pos=0;
+        }
+    };
+
+    translation_cache &get_translation_cache() { static translation_cache cache; return cache; }
+
+    const char cache_sign[]={'n','t','c','1'};
+    const uint32_t cache_version=2; //increase when translation output or file layout changes
+
+    void write_uint(FILE *f,uint32_t v) { fwrite(&v,sizeof(v),1,f); }
+    void write_str(FILE *f,const std::string &s) { write_uint(f,uint32_t(s.size())); if(!s.empty()) fwrite(s.data(),s.size(),1,f); }
+    void write_str(FILE *f,const char *s,uint32_t size) { write_uint(f,size); if(size) fwrite(s,size,1,f); }
+
+    bool read_uint(FILE *f,uint32_t &v) { return fread(&v,sizeof(v),1,f)==1; }
+    bool read_str(FILE *f,std::string &s)
+    {
+        uint32_t size;
+        if(!read_uint(f,size) || size>64*1024*1024)
+            return false;
+
+        s.resize(size);
+        return !size || fread(&s[0],size,1,f)==1;
+    }
+}
+
+bool shader_code_parser::convert_cached(int target,const char *option)
+{
+    std::vector<variable> *const vars[]={&m_uniforms,&m_attributes,&m_varying,&m_out};
+    for(int i=0;i<4;++i)
+    {
+        if(!vars[i]->empty()) //results depend on previously parsed variables
+            return translate(target,option);
+    }
+
+    translation_key key;
+    key.append(&cache_version,sizeof(cache_version));
+    key.append(&target,sizeof(target));
+    key.append(std::string(option?option:""));
+    key.append(m_replace_str);
+    key.append(m_flip_y_uniform);
+    key.append(m_code);
+
+    translation_cache &cache=get_translation_cache();
+    {
+        nya_memory::lock_guard lock(cache.mutex);
+        translation_cache::entries_map::const_iterator it=cache.entries.find(key.h);
+        if(it!=cache.entries.end() && it->second.check==key.check)
+        {
+            cache.get(it->second,m_code,vars);
+            return true;
+        }
+    }
+
+    if(!translate(target,option))
+        return false;
+
+    nya_memory::lock_guard lock(cache.mutex);
+    cache.add(key.h,key.check,m_code,vars);
+    return true;
+}
+
+bool shader_code_parser::translate(int target,const char *option)
+{
+    switch(target)
+    {
+        case target_hlsl: return translate_hlsl();
+        case target_glsl: return translate_glsl();
+        case target_glsl_es2: return translate_glsl_es2(option);
+        case target_glsl3: return translate_glsl3();
+        case target_metal: return translate_metal();
+    }
+
+    return false;
+}
+
+bool shader_code_parser::load_translation_cache(const char *filename)
+{
+    if(!filename)
+        return false;
+
+    FILE *f=fopen(filename,"rb");
+    if(!f)
+        return false;
+
+    char sign[sizeof(cache_sign)];
+    uint32_t version=0,count=0;
+    if(fread(sign,sizeof(sign),1,f)!=1 || memcmp(sign,cache_sign,sizeof(sign))!=0 ||
+       !read_uint(f,version) || version!=cache_version || !read_uint(f,count))
+    {
+        fclose(f);
+        return false;
+    }
+
+    translation_cache loaded;
+    bool result=true;
+    std::string code;
+    std::vector<variable> vars[4];
+    std::vector<variable> *const vars_ptr[]={&vars[0],&vars[1],&vars[2],&vars[3]};
+    for(uint32_t i=0;i<count && result;++i)
+    {
+        uint64_t h,check;
+        result=fread(&h,sizeof(h),1,f)==1 && fread(&check,sizeof(check),1,f)==1 && read_str(f,code);
+        for(int j=0;j<4 && result;++j)
+        {
+            uint32_t vars_count=0;
+            result=read_uint(f,vars_count) && vars_count<=64*1024;
+            vars[j].resize(result?vars_count:0);
+            for(uint32_t k=0;k<vars[j].size() && result;++k)
+            {
+                uint32_t type=0;
+                variable &v=vars[j][k];
+                result=read_uint(f,type) && type<=uint32_t(type_sampler_cube) && read_uint(f,v.array_size) && read_str(f,v.name);
+                v.type=variable_type(type);
+            }
+        }
+
+        if(result)
+            loaded.add(h,check,code,vars_ptr);
+    }
+    fclose(f);
+
+    if(!result)
+        return false;
+
+    translation_cache &cache=get_translation_cache();
+    nya_memory::lock_guard lock(cache.mutex);
+    for(translation_cache::entries_map::const_iterator it=loaded.entries.begin();it!=loaded.entries.end();++it)
+    {
+        loaded.get(it->second,code,vars_ptr);
+        cache.add(it->first,it->second.check,code,vars_ptr);
+    }
+
+    return true;
+}
+
+bool shader_code_parser::save_translation_cache(const char *filename)
+{
+    if(!filename)
+        return false;
+
+    FILE *f=fopen(filename,"wb");
+    if(!f)
+        return false;
+
+    translation_cache &cache=get_translation_cache();
+    nya_memory::lock_guard lock(cache.mutex);
+
+    fwrite(cache_sign,sizeof(cache_sign),1,f);
+    write_uint(f,cache_version);
+    write_uint(f,uint32_t(cache.entries.size()));
+    for(translation_cache::entries_map::const_iterator it=cache.entries.begin();it!=cache.entries.end();++it)
+    {
+        const translation &t=it->second;
+        fwrite(&it->first,sizeof(it->first),1,f);
+        fwrite(&t.check,sizeof(t.check),1,f);
+        write_str(f,t.code,t.code_size);
+        const packed_variable *pv=t.vars;
+        for(int j=0;j<4;++j)
+        {
+            write_uint(f,t.vars_count[j]);
+            for(uint32_t k=0;k<t.vars_count[j];++k,++pv)
+            {
+                write_uint(f,pv->type);
+                write_uint(f,pv->array_size);
+                write_str(f,pv->name,pv->name_size);
+            }
+        }
+    }
+
+    const bool result=ferror(f)==0;
+    fclose(f);
+    return result;
+}
+
+void shader_code_parser::clear_translation_cache()
+{
+    translation_cache &cache=get_translation_cache();
+    nya_memory::lock_guard lock(cache.mutex);
+    cache.clear();
+}
+
+bool shader_code_parser::convert_to_hlsl() { return convert_cached(target_hlsl,0); }
+bool shader_code_parser::convert_to_glsl() { return convert_cached(target_glsl,0); }
+bool shader_code_parser::convert_to_glsl_es2(const char *precision) { return convert_cached(target_glsl_es2,precision?precision:"mediump"); }
+bool shader_code_parser::convert_to_glsl3() { return convert_cached(target_glsl3,0); }
+bool shader_code_parser::convert_to_metal() { return convert_cached(target_metal,0); }
+
+bool shader_code_parser::translate_hlsl()
 {
     m_uniforms.clear();
     m_attributes.clear();
@@ -129,7 +462,7 @@ bool shader_code_parser::convert_to_hlsl()
         if(v.type==type_invalid)
             return false;
 
-        if(v.type-1>=sizeof(type_names)/sizeof(type_names[0]))
+        if(size_t(v.type)>=sizeof(type_names)/sizeof(type_names[0]))
             continue;
 
         char buf[255];
@@ -163,7 +496,7 @@ bool shader_code_parser::convert_to_hlsl()
                 return false;
             }
 
-            if(v.type-1>=sizeof(type_names)/sizeof(type_names[0]))
+            if(size_t(v.type)>=sizeof(type_names)/sizeof(type_names[0]))
                 continue;
 
             prefix.append("static "+std::string(type_names[v.type])+" "+m_varying[i].name+";");
@@ -229,7 +562,7 @@ bool shader_code_parser::convert_to_hlsl()
             if(v.type==type_invalid)
                 return false;
 
-            if(v.type-1>=sizeof(type_names)/sizeof(type_names[0]))
+            if(size_t(v.type)>=sizeof(type_names)/sizeof(type_names[0]))
                 continue;
 
             prefix.append("static "+std::string(type_names[v.type])+" "+m_varying[i].name+";");
@@ -255,7 +588,7 @@ bool shader_code_parser::convert_to_hlsl()
             if(v.type==type_invalid)
                 return false;
 
-            if(v.type-1>=sizeof(type_names)/sizeof(type_names[0]))
+            if(size_t(v.type)>=sizeof(type_names)/sizeof(type_names[0]))
                 continue;
 
             prefix.append(type_names[v.type]),prefix.append(" "+v.name);
@@ -295,7 +628,7 @@ inline bool has_args(std::string &code,size_t pos)
     return false;
 }
 
-bool shader_code_parser::convert_to_metal()
+bool shader_code_parser::translate_metal()
 {
     m_uniforms.clear();
     m_attributes.clear();
@@ -366,7 +699,7 @@ bool shader_code_parser::convert_to_metal()
                 return false;
             }
 
-            if(v.type-1>=sizeof(type_names)/sizeof(type_names[0]))
+            if(size_t(v.type)>=sizeof(type_names)/sizeof(type_names[0]))
                 continue;
 
             prefix.append(std::string(type_names[v.type])+' '+m_varying[i].name+';');
@@ -609,7 +942,7 @@ bool shader_code_parser::convert_to_metal()
     return true;
 }
 
-bool shader_code_parser::convert_to_glsl()
+bool shader_code_parser::translate_glsl()
 {
     if(replace_variable("gl_InstanceID","gl_InstanceIDARB"))
         m_code.insert(0,"#extension GL_ARB_draw_instanced:enable\n");
@@ -618,7 +951,7 @@ bool shader_code_parser::convert_to_glsl()
     return true;
 }
 
-bool shader_code_parser::convert_to_glsl_es2(const char *precision)
+bool shader_code_parser::translate_glsl_es2(const char *precision)
 {
     m_uniforms.clear();
     m_attributes.clear();
@@ -660,7 +993,7 @@ bool shader_code_parser::convert_to_glsl_es2(const char *precision)
     return true;
 }
 
-bool shader_code_parser::convert_to_glsl3()
+bool shader_code_parser::translate_glsl3()
 {
     m_uniforms.clear();
     m_attributes.clear();
@@ -718,6 +1051,125 @@ bool shader_code_parser::convert_to_glsl3()
     return true;
 }
 
+bool shader_code_parser::convert_uniforms_to_block(const char *block_name,const std::vector<variable> &uniforms)
+{
+    if(!block_name || !block_name[0] || uniforms.empty())
+        return false;
+
+    const char *type_names[]={"float","vec2","vec3","vec4","mat2","mat3","mat4"};
+
+    std::string block="layout(std140) uniform "+std::string(block_name)+"{";
+    for(size_t i=0;i<uniforms.size();++i)
+    {
+        const variable &v=uniforms[i];
+        if(v.type!=type_float && v.type!=type_vec2 && v.type!=type_vec3 && v.type!=type_vec4 && v.type!=type_mat4)
+            return false;
+
+        block.append(type_names[v.type]),block.append(" "+v.name);
+        if(v.array_size>1)
+        {
+            char buf[32];
+            sprintf(buf,"[%d];",v.array_size);
+            block.append(buf);
+        }
+        else
+            block.append(";");
+    }
+    block.append("};\n");
+
+    const char *str="uniform";
+    const size_t str_len=strlen(str);
+    for(size_t i=m_code.find(str);i!=std::string::npos;i=m_code.find(str,i))
+    {
+        if((i>0 && is_name_char(m_code[i-1])) || i+str_len>=m_code.length() || m_code[i+str_len]>' ')
+        {
+            i+=str_len;
+            continue;
+        }
+
+        size_t type_from=i+str_len;
+        while(type_from<m_code.length() && m_code[type_from]<=' ') ++type_from;
+        size_t type_to=type_from;
+        while(type_to<m_code.length() && m_code[type_to]>' ') ++type_to;
+
+        //precision qualifier goes with the type
+        const std::string qualifier=m_code.substr(type_from,type_to-type_from);
+        if(qualifier=="lowp" || qualifier=="mediump" || qualifier=="highp")
+        {
+            while(type_to<m_code.length() && m_code[type_to]<=' ') ++type_to;
+            while(type_to<m_code.length() && m_code[type_to]>' ') ++type_to;
+        }
+
+        const size_t last=m_code.find(';',type_to);
+        if(last==std::string::npos)
+        {
+            m_error.append("unclosed ; on variable declaration\n");
+            return false;
+        }
+
+        //declarators are split by commas outside of initializer brackets, like in uniform vec4 a,b=vec4(0,0,0,1);
+        std::vector<std::string> kept;
+        bool any_moved=false;
+        for(size_t from=type_to,depth=0,j=type_to;j<=last;++j)
+        {
+            const char c=m_code[j];
+            if(c=='(' || c=='[')
+                ++depth;
+            else if((c==')' || c==']') && depth>0)
+                --depth;
+
+            if(j<last && (c!=',' || depth>0))
+                continue;
+
+            const std::string declarator=m_code.substr(from,j-from);
+            from=j+1;
+
+            size_t name_from=0;
+            while(name_from<declarator.length() && declarator[name_from]<=' ') ++name_from;
+            size_t name_to=name_from;
+            while(name_to<declarator.length() && is_name_char(declarator[name_to])) ++name_to;
+            const std::string name=declarator.substr(name_from,name_to-name_from);
+
+            bool moved=false;
+            for(size_t k=0;k<uniforms.size() && !moved;++k)
+                moved=uniforms[k].name==name;
+
+            if(moved)
+                any_moved=true;
+            else
+                kept.push_back(declarator.substr(name_from));
+        }
+
+        if(!any_moved)
+        {
+            i=last+1;
+            continue;
+        }
+
+        std::string rest;
+        if(!kept.empty())
+        {
+            rest=m_code.substr(i,type_to-i);
+            for(size_t k=0;k<kept.size();++k)
+                rest.append(k?",":" ").append(kept[k]);
+            rest.append(";");
+        }
+
+        m_code.replace(i,last-i+1,rest);
+        i+=rest.length();
+    }
+
+    size_t insert_pos=0;
+    if(m_code.compare(0,8,"#version")==0)
+    {
+        insert_pos=m_code.find('\n');
+        insert_pos=insert_pos==std::string::npos?m_code.length():insert_pos+1;
+    }
+
+    m_code.insert(insert_pos,block);
+    return true;
+}
+
 int shader_code_parser::get_uniforms_count()
 {
     if(m_uniforms.empty())
@@ -813,18 +1265,202 @@ bool shader_code_parser::fix_per_component_functions()
     return true;
 }
 
+bool shader_code_parser::resolve_features(const std::vector<std::string> &keys,unsigned int enabled_mask)
+{
+    if(keys.empty())
+        return true;
+
+    struct block { bool feature,enabled,in_else; };
+    std::vector<block> blocks;
+    int disabled_depth=0; //feature blocks on stack with inactive branch
+
+    std::string result;
+    result.reserve(m_code.size());
+
+    for(size_t line_from=0;line_from<m_code.size();)
+    {
+        size_t line_to=m_code.find('\n',line_from);
+        if(line_to==std::string::npos)
+            line_to=m_code.size();
+        else
+            ++line_to;
+
+        size_t i=line_from;
+        while(i<line_to && (m_code[i]==' ' || m_code[i]=='\t'))
+            ++i;
+
+        bool keep=disabled_depth==0;
+        if(i<line_to && m_code[i]=='#')
+        {
+            ++i;
+            while(i<line_to && (m_code[i]==' ' || m_code[i]=='\t'))
+                ++i;
+            size_t word_to=i;
+            while(word_to<line_to && is_name_char(m_code[word_to]))
+                ++word_to;
+            const std::string directive=m_code.substr(i,word_to-i);
+
+            if(directive=="ifdef" || directive=="ifndef")
+            {
+                size_t key_from=word_to;
+                while(key_from<line_to && (m_code[key_from]==' ' || m_code[key_from]=='\t'))
+                    ++key_from;
+                size_t key_to=key_from;
+                while(key_to<line_to && is_name_char(m_code[key_to]))
+                    ++key_to;
+                const std::string key=m_code.substr(key_from,key_to-key_from);
+
+                block b;
+                b.feature=false,b.enabled=true,b.in_else=false;
+                for(size_t k=0;k<keys.size() && k<32;++k)
+                {
+                    if(keys[k]!=key)
+                        continue;
+
+                    b.feature=true;
+                    b.enabled=((enabled_mask>>k)&1)==(directive=="ifdef"?1u:0u);
+                    break;
+                }
+
+                if(b.feature)
+                {
+                    keep=false;
+                    if(!b.enabled)
+                        ++disabled_depth;
+                }
+                blocks.push_back(b);
+            }
+            else if(directive=="if")
+            {
+                block b;
+                b.feature=false,b.enabled=true,b.in_else=false;
+                blocks.push_back(b);
+            }
+            else if(directive=="else" || directive=="elif" || directive=="endif")
+            {
+                if(blocks.empty())
+                {
+                    m_error.append("unmatched #"+directive+"\n");
+                    return false;
+                }
+
+                block &b=blocks.back();
+                if(b.feature)
+                {
+                    keep=false;
+                    if(directive=="elif" || (directive=="else" && b.in_else))
+                    {
+                        m_error.append("unsupported #"+directive+" in feature block\n");
+                        return false;
+                    }
+
+                    const bool was_active=b.enabled!=b.in_else;
+                    if(directive=="else")
+                    {
+                        b.in_else=true;
+                        disabled_depth+=was_active?1:-1;
+                    }
+                    else
+                    {
+                        if(!was_active)
+                            --disabled_depth;
+                        blocks.pop_back();
+                    }
+                }
+                else if(directive=="endif")
+                    blocks.pop_back();
+            }
+        }
+
+        if(keep)
+            result.append(m_code,line_from,line_to-line_from);
+        else if(m_code[line_to-1]=='\n')
+            result.push_back('\n');
+
+        line_from=line_to;
+    }
+
+    if(!blocks.empty())
+    {
+        m_error.append("unclosed #if block\n");
+        return false;
+    }
+
+    m_code.swap(result);
+    return true;
+}
+
 void shader_code_parser::remove_comments()
 {
-    while(m_code.find("//")!=std::string::npos)
+    std::string result;
+    size_t copied=0;
+
+    //single pass, line comments keep their line break
+    for(size_t from=m_code.find('/');from!=std::string::npos && from+1<m_code.size();from=m_code.find('/',from))
     {
-        const size_t from=m_code.find("//");
-        m_code.erase(from,m_code.find_first_of("\n\r",from+1)-from);
+        size_t to;
+        if(m_code[from+1]=='/')
+            to=m_code.find_first_of("\n\r",from+2);
+        else if(m_code[from+1]=='*')
+        {
+            to=m_code.find("*/",from+2);
+            if(to!=std::string::npos)
+                to+=2;
+        }
+        else
+        {
+            ++from;
+            continue;
+        }
+
+        if(result.empty())
+            result.reserve(m_code.size());
+
+        result.append(m_code,copied,from-copied);
+        copied=from=(to==std::string::npos?m_code.size():to);
     }
-    while(m_code.find("/*")!=std::string::npos)
+
+    if(!copied)
+        return;
+
+    result.append(m_code,copied,std::string::npos);
+    m_code.swap(result);
+}
+
+template<typename t> static bool push_var(t &vars,const std::string &type_name,const std::string &name,int count)
+{
+    if(type_name.compare(0,3,"vec")==0)
     {
-        const size_t from=m_code.find("/*");
-        m_code.erase(from,(m_code.find("*/",from+2)-from)+2);
+        char dim=(type_name.length()==4)?type_name[3]:'\0';
+        switch(dim)
+        {
+            case '2': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec2,name.c_str(),count)); break;
+            case '3': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec3,name.c_str(),count)); break;
+            case '4': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec4,name.c_str(),count)); break;
+            default: return false;
+        };
     }
+    else if(type_name.compare(0,3,"mat")==0)
+    {
+        char dim=(type_name.length()==4)?type_name[3]:'\0';
+        switch(dim)
+        {
+            case '2': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat2,name.c_str(),count)); break;
+            case '3': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat3,name.c_str(),count)); break;
+            case '4': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat4,name.c_str(),count)); break;
+            default: return false;
+        };
+    }
+    else if(type_name=="float")
+        vars.push_back(shader_code_parser::variable(shader_code_parser::type_float,name.c_str(),count));
+    else if(type_name=="sampler2D")
+        vars.push_back(shader_code_parser::variable(shader_code_parser::type_sampler2d,name.c_str(),count));
+    else if(type_name=="samplerCube")
+        vars.push_back(shader_code_parser::variable(shader_code_parser::type_sampler_cube,name.c_str(),count));
+    else
+        return false;
+
+    return true;
 }
 
 template<typename t> static bool parse_vars(std::string &code,std::string &error,t& vars,const char *str,bool remove)
@@ -837,15 +1473,9 @@ template<typename t> static bool parse_vars(std::string &code,std::string &error
         size_t type_to=type_from;
         while(code[type_to]>' ') if(++type_to>=code.length()) return false;
 
-        size_t name_from=type_to+1;
-        while(code[name_from]<=' ') if(++name_from>=code.length()) return false;
-        size_t name_to=name_from;
-        while(code[name_to]>' ' && code[name_to]!=';' && code[name_to]!='[') if(++name_to>=code.length()) return false;
-
-        const std::string name=code.substr(name_from,name_to-name_from);
         const std::string type_name=code.substr(type_from,type_to-type_from);
 
-        size_t last=name_to;
+        size_t last=type_to;
         while(code[last]!=';')
         {
             if(++last>=code.length())
@@ -855,44 +1485,35 @@ template<typename t> static bool parse_vars(std::string &code,std::string &error
             }
         }
 
-        int count=1;
-        size_t array_from=code.find('[',name_to);
-        if(array_from<last)
-            count=atoi(&code[array_from+1]);
-
-        if(count<=0)
-            return false;
-
-        if(type_name.compare(0,3,"vec")==0)
+        //several names may share a declaration: vec4 a,b[2];
+        for(size_t name_from=type_to+1;name_from<last;)
         {
-            char dim=(type_name.length()==4)?type_name[3]:'\0';
-            switch(dim)
+            while(code[name_from]<=' ') if(++name_from>=last) return false;
+            size_t name_to=name_from;
+            while(code[name_to]>' ' && code[name_to]!=';' && code[name_to]!='[' && code[name_to]!=',' && code[name_to]!='=') ++name_to;
+
+            size_t decl_to=name_to;
+            for(int brackets=0;decl_to<last && (brackets>0 || code[decl_to]!=',');++decl_to)
             {
-                case '2': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec2,name.c_str(),count)); break;
-                case '3': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec3,name.c_str(),count)); break;
-                case '4': vars.push_back(shader_code_parser::variable(shader_code_parser::type_vec4,name.c_str(),count)); break;
-                default: return false;
-            };
+                if(code[decl_to]=='[' || code[decl_to]=='(')
+                    ++brackets;
+                else if(code[decl_to]==']' || code[decl_to]==')')
+                    --brackets;
+            }
+
+            int count=1;
+            size_t array_from=code.find('[',name_to);
+            if(array_from<decl_to)
+                count=atoi(&code[array_from+1]);
+
+            if(count<=0 || name_to==name_from)
+                return false;
+
+            if(!push_var(vars,type_name,code.substr(name_from,name_to-name_from),count))
+                return false;
+
+            name_from=decl_to+1;
         }
-        else if(type_name.compare(0,3,"mat")==0)
-        {
-            char dim=(type_name.length()==4)?type_name[3]:'\0';
-            switch(dim)
-            {
-                case '2': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat2,name.c_str(),count)); break;
-                case '3': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat3,name.c_str(),count)); break;
-                case '4': vars.push_back(shader_code_parser::variable(shader_code_parser::type_mat4,name.c_str(),count)); break;
-                default: return false;
-            };
-        }
-        else if(type_name=="float")
-            vars.push_back(shader_code_parser::variable(shader_code_parser::type_float,name.c_str(),count));
-        else if(type_name=="sampler2D")
-            vars.push_back(shader_code_parser::variable(shader_code_parser::type_sampler2d,name.c_str(),count));
-        else if(type_name=="samplerCube")
-            vars.push_back(shader_code_parser::variable(shader_code_parser::type_sampler_cube,name.c_str(),count));
-        else
-            return false;
 
         if(remove)
             code.erase(i,last-i+1);
@@ -1261,8 +1882,12 @@ bool shader_code_parser::replace_variable(const char *from,const char *to,size_t
     if(!from || !from[0] || !to)
         return false;
 
-    bool result=false;
-    const size_t from_len=strlen(from);
+    //first matches are replaced in place, the string is rebuilt once if there are many
+    const int max_in_place=4;
+    int replaced=0;
+    std::string result;
+    size_t copied=0;
+    const size_t from_len=strlen(from),to_len=strlen(to);
     while((start_pos=m_code.find(from,start_pos))!=std::string::npos)
     {
         if((start_pos!=0 && is_name_char(m_code[start_pos-1])) ||
@@ -1272,12 +1897,29 @@ bool shader_code_parser::replace_variable(const char *from,const char *to,size_t
             continue;
         }
 
-        m_code.replace(start_pos,from_len,to);
-        start_pos+=strlen(to);
-        result=true;
+        if(replaced++<max_in_place)
+        {
+            m_code.replace(start_pos,from_len,to);
+            start_pos+=to_len;
+            continue;
+        }
+
+        if(!copied)
+            result.reserve(m_code.size()+64);
+
+        result.append(m_code,copied,start_pos-copied);
+        result.append(to);
+        start_pos+=from_len;
+        copied=start_pos;
     }
 
-    return result;
+    if(copied)
+    {
+        result.append(m_code,copied,std::string::npos);
+        m_code.swap(result);
+    }
+
+    return replaced>0;
 }
 
 bool shader_code_parser::find_variable(const char *str,size_t start_pos)
@@ -22,6 +22,15 @@ public:
     bool convert_to_glsl3();
     bool convert_to_metal();
 
+public:
+    //translations are cached in memory, keyed by a hash of the source, target and options,
+    //a second hash of the same input is compared on a hit
+    //parser instances are independent, so shaders may be translated on several threads
+    //the cache may be saved after a run and loaded at startup to skip translation
+    static bool load_translation_cache(const char *filename);
+    static bool save_translation_cache(const char *filename);
+    static void clear_translation_cache();
+
 public:
     enum variable_type
     {
@@ -58,14 +67,40 @@ public:
     int get_out_count();
     variable get_out(int idx) const;
 
+public:
+    //strips #ifdef and #ifndef blocks of listed feature keys, bit i of enabled_mask enables keys[i]
+    //backend independent, other preprocessor blocks are kept, stripped lines are left empty to keep line numbers
+    bool resolve_features(const std::vector<std::string> &keys,unsigned int enabled_mask);
+
 public:
     bool fix_per_component_functions();
 
+    //after convert_to_glsl3, replaces plain declarations with a std140 block of float/vec/mat4 uniforms
+    //every stage of a program should get the same list
+    bool convert_uniforms_to_block(const char *block_name,const std::vector<variable> &uniforms);
+
 public:
     shader_code_parser(const char *text,const char *replace_prefix_str="_nya_",const char *flip_y_uniform=0):
                        m_code(text?text:""),m_replace_str(replace_prefix_str?replace_prefix_str:""),
                        m_flip_y_uniform(flip_y_uniform?flip_y_uniform:"") { remove_comments(); }
 private:
+    enum translation_target
+    {
+        target_hlsl,
+        target_glsl,
+        target_glsl_es2,
+        target_glsl3,
+        target_metal
+    };
+
+    bool convert_cached(int target,const char *option);
+    bool translate(int target,const char *option);
+    bool translate_hlsl();
+    bool translate_glsl();
+    bool translate_glsl_es2(const char *precision);
+    bool translate_glsl3();
+    bool translate_metal();
+
     void remove_comments();
 
     bool parse_uniforms(bool remove);
@@ -1,6 +1,7 @@
 //nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
 
 #include "skeleton.h"
+#include <atomic>
 
 namespace nya_render
 {
@@ -55,6 +56,7 @@ int skeleton::add_bone(const char *name,const nya_math::vec3 &pos,const nya_math
     }
 
     update_bone(bone_idx);
+    update_version();
     return bone_idx;
 }
 
@@ -388,6 +390,19 @@ void skeleton::update()
         for(int i=0,count=(int)m_bones.size();i<count;++i)
             update_bone(i);
     }
+
+    update_version();
+}
+
+void skeleton::update_version()
+{
+    //global counter, so a skeleton reallocated at the same address never matches an old version
+    //different skeletons may be updated from several threads
+    static std::atomic<unsigned int> last_version(0);
+    unsigned int version=++last_version;
+    if(!version)
+        version=++last_version;
+    m_version=version;
 }
 
 nya_math::vec3 skeleton::transform(int bone_idx,const nya_math::vec3 &point) const
@@ -414,4 +429,92 @@ const float *skeleton::get_rot_buffer() const
     return &m_rot_tr[0].v.x;
 }
 
+const float *skeleton::get_skinning_pos_buffer() const
+{
+    if(m_pos_tr.empty())
+        return 0;
+
+    if(m_skin_pos.version==m_version && !m_skin_pos.buf.empty())
+        return &m_skin_pos.buf[0];
+
+    m_skin_pos.buf.resize(m_pos_tr.size()*3);
+    nya_math::vec3 *pos=(nya_math::vec3 *)&m_skin_pos.buf[0];
+    const nya_math::quat *rot=(const nya_math::quat *)get_skinning_rot_buffer();
+    for(size_t i=0;i<m_pos_tr.size();++i)
+        pos[i]=m_pos_tr[i]+rot[i].rotate(-m_bones[i].pos_org);
+
+    m_skin_pos.version=m_version;
+    return &m_skin_pos.buf[0];
+}
+
+const float *skeleton::get_skinning_rot_buffer() const
+{
+    if(m_rot_org.empty())
+        return get_rot_buffer();
+
+    if(m_skin_rot.version==m_version && !m_skin_rot.buf.empty())
+        return &m_skin_rot.buf[0];
+
+    m_skin_rot.buf.resize(m_rot_tr.size()*4);
+    nya_math::quat *rot=(nya_math::quat *)&m_skin_rot.buf[0];
+    for(size_t i=0;i<m_rot_tr.size();++i)
+        rot[i]=m_rot_tr[i]*nya_math::quat::invert(m_rot_org[i].rot_org);
+
+    m_skin_rot.version=m_version;
+    return &m_skin_rot.buf[0];
+}
+
+const float *skeleton::get_skinning_dq_buffer() const
+{
+    if(m_pos_tr.empty())
+        return 0;
+
+    if(m_skin_dq.version==m_version && !m_skin_dq.buf.empty())
+        return &m_skin_dq.buf[0];
+
+    m_skin_dq.buf.resize(m_pos_tr.size()*8);
+    const nya_math::vec3 *pos=(const nya_math::vec3 *)get_skinning_pos_buffer();
+    const nya_math::quat *rot=(const nya_math::quat *)get_skinning_rot_buffer();
+    for(size_t i=0;i<m_pos_tr.size();++i)
+    {
+        const nya_math::quat &r=rot[i];
+        const nya_math::vec3 &t=pos[i];
+        float *dq=&m_skin_dq.buf[i*8];
+        dq[0]=r.v.x,dq[1]=r.v.y,dq[2]=r.v.z,dq[3]=r.w;
+
+        //dual=0.5*quat(t,0)*r
+        const nya_math::vec3 d=(t*r.w+nya_math::vec3::cross(t,r.v))*0.5f;
+        dq[4]=d.x,dq[5]=d.y,dq[6]=d.z,dq[7]= -0.5f*nya_math::vec3::dot(t,r.v);
+    }
+
+    m_skin_dq.version=m_version;
+    return &m_skin_dq.buf[0];
+}
+
+const float *skeleton::get_skinning_mat34_buffer() const
+{
+    if(m_pos_tr.empty())
+        return 0;
+
+    if(m_skin_mat34.version==m_version && !m_skin_mat34.buf.empty())
+        return &m_skin_mat34.buf[0];
+
+    m_skin_mat34.buf.resize(m_pos_tr.size()*12);
+    const nya_math::vec3 *pos=(const nya_math::vec3 *)get_skinning_pos_buffer();
+    const nya_math::quat *rot=(const nya_math::quat *)get_skinning_rot_buffer();
+    for(size_t i=0;i<m_pos_tr.size();++i)
+    {
+        const nya_math::quat &r=rot[i];
+        const float x=r.v.x,y=r.v.y,z=r.v.z,w=r.w;
+        float *m=&m_skin_mat34.buf[i*12];
+
+        m[0]=1.0f-2.0f*(y*y+z*z), m[1]=2.0f*(x*y-z*w), m[2]=2.0f*(x*z+y*w), m[3]=pos[i].x;
+        m[4]=2.0f*(x*y+z*w), m[5]=1.0f-2.0f*(x*x+z*z), m[6]=2.0f*(y*z-x*w), m[7]=pos[i].y;
+        m[8]=2.0f*(x*z-y*w), m[9]=2.0f*(y*z+x*w), m[10]=1.0f-2.0f*(x*x+y*y), m[11]=pos[i].z;
+    }
+
+    m_skin_mat34.version=m_version;
+    return &m_skin_mat34.buf[0];
+}
+
 }
@@ -38,6 +38,18 @@ public:
     const float *get_pos_buffer() const;
     const float *get_rot_buffer() const;
 
+public:
+    //skinning palettes, bone transforms relative to the bind pose
+    //cached and recomputed lazily once per update(), so not thread-safe even though const:
+    //a skeleton's palettes shouldn't be requested from several threads at once
+    const float *get_skinning_pos_buffer() const; //vec3 per bone
+    const float *get_skinning_rot_buffer() const; //quat per bone
+    const float *get_skinning_dq_buffer() const; //real and dual quat per bone, 8 floats
+    const float *get_skinning_mat34_buffer() const; //3 rows of 3x4 matrix per bone, 12 floats
+
+    //changes on every update, unique among all skeletons
+    unsigned int get_version() const { return m_version; }
+
 public:
     int add_bone(const char *name,const nya_math::vec3 &pos,
                  const nya_math::quat &rot=nya_math::quat(),int parent_bone_idx= -1,bool allow_doublicate=false);
@@ -50,10 +62,14 @@ public:
 public:
     bool add_bound(int bone_idx,int src_bone_idx,float k,bool bound_pos,bool bound_rot,bool allow_invalid=false);
 
+public:
+    skeleton(): m_version(0) {}
+
 private:
     void update_bone(int idx);
     void base_update_bone(int idx);
     void update_ik(int idx);
+    void update_version();
 
 private:
     typedef std::map<std::string,unsigned int> index_map;
@@ -88,6 +104,22 @@ private:
     std::vector<nya_math::vec3> m_pos_tr;
     std::vector<nya_math::quat> m_rot_tr;
 
+    unsigned int m_version;
+
+    struct palette
+    {
+        std::vector<float> buf;
+        unsigned int version;
+
+        palette(): version(0) {}
+    };
+
+    //written by the const getters, single-threaded like the rest of the skeleton
+    mutable palette m_skin_pos;
+    mutable palette m_skin_rot;
+    mutable palette m_skin_dq;
+    mutable palette m_skin_mat34;
+
     enum limit_mode
     {
         limit_no,
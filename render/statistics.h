@@ -16,8 +16,15 @@ public:
     unsigned int verts_count;
     unsigned int opaque_poly_count;
     unsigned int transparent_poly_count;
+    unsigned int texture_bind_count; //texture changes between draws
+    unsigned int uniform_upload_bytes; //shader constants sent to the driver
+    unsigned int vertex_upload_bytes; //vertex buffer updates
+    unsigned int state_changes; //state calls issued by backend at draw time
+    unsigned int state_changes_skipped; //redundant state calls filtered by backend
 
-    statistics(): draw_count(0),verts_count(0),opaque_poly_count(0),transparent_poly_count(0) {}
+    statistics(): draw_count(0),verts_count(0),opaque_poly_count(0),transparent_poly_count(0),
+                  texture_bind_count(0),uniform_upload_bytes(0),vertex_upload_bytes(0),
+                  state_changes(0),state_changes_skipped(0) {}
 
 public:
     static bool enabled();
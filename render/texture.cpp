@@ -16,6 +16,28 @@ namespace
     texture::filter default_mag_filter=texture::filter_linear;
     texture::filter default_mip_filter=texture::filter_linear;
     unsigned int default_aniso=0;
+    texture::mip_generation default_mip_gen=texture::mip_generation_hardware;
+    bool default_mip_gen_srgb=false;
+    float default_mip_gen_alpha_coverage=0.0f;
+    unsigned int used_vmem_size=0;
+
+    unsigned int get_mips_size(unsigned int width,unsigned int height,texture::color_format format,int mip_count)
+    {
+        const unsigned int bpp=texture::get_format_bpp(format);
+        const int count=mip_count<=0?1:mip_count;
+        unsigned int size=0;
+        for(int i=0,w=width,h=height;i<count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
+        {
+            if(format>=texture::pvr_rgb2b)
+                size+=w*h*bpp/8;
+            else if(format>=texture::dxt1)
+                size+=((w+3)/4)*((h+3)/4)*bpp*2;
+            else
+                size+=w*h*bpp/8;
+        }
+
+        return mip_count<0?size*4/3:size;
+    }
 }
 
 bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int width,unsigned int height,
@@ -79,6 +101,39 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
     else if(!pot)
         mip_count=1;
 
+    nya_memory::tmp_buffer_ref mip_buf;
+    const void *mip_data[6];
+    const mip_generation mip_gen=m_mip_gen_set?m_mip_gen:default_mip_gen;
+    if(mip_count<0 && format<=greyscale && mip_gen!=mip_generation_hardware)
+    {
+        bitmap_mip_settings settings;
+        switch(mip_gen)
+        {
+            case mip_generation_kaiser: settings.filter=bitmap_mip_filter_kaiser; break;
+            case mip_generation_lanczos: settings.filter=bitmap_mip_filter_lanczos; break;
+            default: settings.filter=bitmap_mip_filter_box; break;
+        }
+
+        settings.srgb=m_mip_gen_set?m_mip_gen_srgb:default_mip_gen_srgb;
+        settings.alpha_coverage=m_mip_gen_set?m_mip_gen_alpha_coverage:default_mip_gen_alpha_coverage;
+        wrap s,t;
+        get_wrap(s,t);
+        settings.wrap=!is_cubemap && s==wrap_repeat && t==wrap_repeat;
+
+        const int channels=get_format_bpp(format)/8;
+        mip_count=bitmap_get_mip_count(width,height);
+        const size_t size=bitmap_get_mip_chain_size(width,height,channels,mip_count);
+        mip_buf.allocate(is_cubemap?size*6:size);
+        for(int i=0;i<(is_cubemap?6:1);++i)
+        {
+            mip_data[i]=mip_buf.get_data(i*size);
+            bitmap_build_mip_chain((const uint8_t *)data_a[i],width,height,channels,mip_count,settings,(uint8_t *)mip_buf.get_data(i*size));
+        }
+
+        data_a=mip_data;
+        data=mip_data[0];
+    }
+
     nya_memory::tmp_buffer_ref tmp_buf;
 
     if(!get_api_interface().is_texture_format_supported(format))
@@ -93,13 +148,16 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
         else if(format==color_bgra || format==color_rgb)
         {
             if(!get_api_interface().is_texture_format_supported(color_rgba))
+            {
+                mip_buf.free();
                 return false;
+            }
 
             if(data)
             {
                 size_t size=0;
                 for(int i=0,w=width,h=height;i<(mip_count>=0?mip_count:1);w>1?w=w/2:w=1,h>1?h/=2:h=1,++i)
-                    size+=width*height*4;
+                    size+=w*h*4;
 
                 tmp_buf.allocate(is_cubemap?size*6:size);
                 for(int i=0;i<(is_cubemap?6:1);++i)
@@ -132,6 +190,7 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
         else
         {
             log()<<"Unable to build texture: unsupported format\n";
+            mip_buf.free();
             return false;
         }
     }
@@ -142,6 +201,7 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
         m_tex=get_api_interface().create_texture(data,width,height,format,mip_count);
 
     tmp_buf.free();
+    mip_buf.free();
 
     if(m_tex<0)
         return false;
@@ -149,6 +209,8 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
     m_width=width,m_height=height;
     m_format=format;
     m_is_cubemap=is_cubemap;
+    m_vmem_size=get_mips_size(width,height,format,mip_count)*(is_cubemap?6:1);
+    used_vmem_size+=m_vmem_size;
     if(!m_filter_set)
     {
         m_filter_min=default_min_filter;
@@ -162,7 +224,9 @@ bool texture::build_texture(const void *data_a[6],bool is_cubemap,unsigned int w
     if(!is_cubemap)
     {
         const bool force_clamp=!pot && !is_platform_restrictions_ignored();
-        get_api_interface().set_texture_wrap(m_tex,force_clamp?wrap_clamp:default_wrap_s,force_clamp?wrap_clamp:default_wrap_t);
+        wrap s,t;
+        get_wrap(s,t);
+        get_api_interface().set_texture_wrap(m_tex,force_clamp?wrap_clamp:s,force_clamp?wrap_clamp:t);
     }
     return true;
 }
@@ -283,6 +347,10 @@ bool texture::is_cubemap() const { return m_is_cubemap; }
 
 void texture::set_wrap(wrap s,wrap t)
 {
+    m_wrap_s=s;
+    m_wrap_t=t;
+    m_wrap_set=true;
+
     if(m_tex<0 || m_is_cubemap)
         return;
 
@@ -293,6 +361,12 @@ void texture::set_wrap(wrap s,wrap t)
     get_api_interface().set_texture_wrap(m_tex,s,t);
 }
 
+void texture::get_wrap(wrap &s,wrap &t) const
+{
+    s=m_wrap_set?m_wrap_s:default_wrap_s;
+    t=m_wrap_set?m_wrap_t:default_wrap_t;
+}
+
 void texture::set_aniso(unsigned int level)
 {
     m_aniso=level;
@@ -332,6 +406,21 @@ void texture::set_default_filter(filter minification,filter magnification,filter
 
 void texture::set_default_aniso(unsigned int level) { default_aniso=level; }
 
+void texture::set_mip_generation(mip_generation gen,bool srgb,float alpha_coverage)
+{
+    m_mip_gen=gen;
+    m_mip_gen_srgb=srgb;
+    m_mip_gen_alpha_coverage=alpha_coverage;
+    m_mip_gen_set=true;
+}
+
+void texture::set_default_mip_generation(mip_generation gen,bool srgb,float alpha_coverage)
+{
+    default_mip_gen=gen;
+    default_mip_gen_srgb=srgb;
+    default_mip_gen_alpha_coverage=alpha_coverage;
+}
+
 void texture::get_default_wrap(wrap &s,wrap &t)
 {
     s=default_wrap_s;
@@ -345,9 +434,17 @@ void texture::get_default_filter(filter &minification,filter &magnification,filt
     mipmap=default_mip_filter;
 }
 
+void texture::get_default_mip_generation(mip_generation &gen,bool &srgb,float &alpha_coverage)
+{
+    gen=default_mip_gen;
+    srgb=default_mip_gen_srgb;
+    alpha_coverage=default_mip_gen_alpha_coverage;
+}
+
 unsigned int texture::get_default_aniso() { return default_aniso; }
 unsigned int texture::get_max_dimension() { return get_api_interface().get_max_texture_dimention(); }
 bool texture::is_dxt_supported() { return get_api_interface().is_texture_format_supported(dxt1); }
+bool texture::is_format_supported(color_format format) { return get_api_interface().is_texture_format_supported(format); }
 
 unsigned int texture::get_format_bpp(texture::color_format format)
 {
@@ -402,12 +499,8 @@ unsigned int texture::get_gl_tex_id() const
     return 0;
 }
 
-unsigned int texture::get_used_vmem_size()
-{
-    //renderapi
-
-    return 0;
-}
+unsigned int texture::get_vmem_size() const { return m_vmem_size; }
+unsigned int texture::get_used_vmem_size() { return used_vmem_size; }
 
 void texture::release()
 {
@@ -415,6 +508,7 @@ void texture::release()
         return;
 
     get_api_interface().remove_texture(m_tex);
+    used_vmem_size-=m_vmem_size<used_vmem_size?m_vmem_size:used_vmem_size;
     render_api_interface::state &s=get_api_state();
     for(int i=0;i<s.max_layers;++i)
     {
@@ -422,7 +516,12 @@ void texture::release()
             s.textures[i]=-1;
     }
 
+    const texture settings(*this);
     *this=texture();
+    if(settings.m_mip_gen_set)
+        set_mip_generation(settings.m_mip_gen,settings.m_mip_gen_srgb,settings.m_mip_gen_alpha_coverage);
+    if(settings.m_wrap_set)
+        set_wrap(settings.m_wrap_s,settings.m_wrap_t);
 }
 
 }
@@ -49,6 +49,7 @@ public:
     };
 
     static bool is_dxt_supported();
+    static bool is_format_supported(color_format format);
 
     typedef unsigned int uint;
 
@@ -79,7 +80,8 @@ public:
         wrap_repeat_mirror
     };
 
-    void set_wrap(wrap s,wrap t);
+    void set_wrap(wrap s,wrap t); //kept after release, may be set before build
+    void get_wrap(wrap &s,wrap &t) const; //default wrap if not set
 
     enum filter
     {
@@ -94,6 +96,20 @@ public:
     static void set_default_filter(filter minification,filter magnification,filter mipmap);
     static void set_default_aniso(uint level);
 
+public:
+    enum mip_generation
+    {
+        mip_generation_hardware,
+        mip_generation_box,
+        mip_generation_kaiser,
+        mip_generation_lanczos
+    };
+
+    //used by build_texture with mip_count= -1 for 8-bit pot textures, should be set before build
+    //srgb averages color in linear space, alpha_coverage>0 keeps alpha tested coverage in every mip
+    void set_mip_generation(mip_generation gen,bool srgb=false,float alpha_coverage=0.0f);
+    static void set_default_mip_generation(mip_generation gen,bool srgb=false,float alpha_coverage=0.0f);
+
 public:
     bool get_data(nya_memory::tmp_buffer_ref &data) const;
     bool get_data(nya_memory::tmp_buffer_ref &data,uint x,uint y,uint w,uint h) const;
@@ -105,6 +121,7 @@ public:
     static void get_default_wrap(wrap &s,wrap &t);
     static void get_default_filter(filter &minification,filter &magnification,filter &mipmap);
     static uint get_default_aniso();
+    static void get_default_mip_generation(mip_generation &gen,bool &srgb,float &alpha_coverage);
 
     static unsigned int get_max_dimension();
 
@@ -114,6 +131,7 @@ public:
     void release();
 
 public:
+    uint get_vmem_size() const; //approximate, includes mipmaps
     static uint get_used_vmem_size();
 
 public:
@@ -121,8 +139,11 @@ public:
     ID3D11Texture2D *get_dx11_tex_id() const;
 
 public:
-    texture(): m_tex(-1),m_width(0),m_height(0),m_is_cubemap(false),m_filter_set(false),m_aniso_set(false),
-               m_aniso(0),m_filter_min(filter_linear),m_filter_mag(filter_linear),m_filter_mip(filter_linear) {}
+    texture(): m_tex(-1),m_width(0),m_height(0),m_is_cubemap(false),m_wrap_set(false),m_wrap_s(wrap_repeat),m_wrap_t(wrap_repeat),
+               m_filter_set(false),m_aniso_set(false),
+               m_aniso(0),m_filter_min(filter_linear),m_filter_mag(filter_linear),m_filter_mip(filter_linear),
+               m_mip_gen_set(false),m_mip_gen(mip_generation_hardware),m_mip_gen_srgb(false),m_mip_gen_alpha_coverage(0.0f),
+               m_vmem_size(0) {}
 
 private:
     bool build_texture(const void *data[6],bool is_cubemap,uint width,uint height,
@@ -132,10 +153,17 @@ private:
     uint m_width,m_height;
     color_format m_format;
     bool m_is_cubemap;
+    bool m_wrap_set;
+    wrap m_wrap_s,m_wrap_t;
     bool m_filter_set;
     bool m_aniso_set;
     unsigned int m_aniso;
     filter m_filter_min,m_filter_mag,m_filter_mip;
+    bool m_mip_gen_set;
+    mip_generation m_mip_gen;
+    bool m_mip_gen_srgb;
+    float m_mip_gen_alpha_coverage;
+    uint m_vmem_size;
 };
 
 }
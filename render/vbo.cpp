@@ -15,6 +15,7 @@ namespace
     uint active_vert_count=0;
     uint active_ind_count=0;
     vbo::element_type active_element_type=vbo::triangles;
+    int drawn_textures[render_api_interface::state::max_layers];
 }
 
 void vbo::bind_verts() const
@@ -59,6 +60,16 @@ void vbo::draw(uint offset,uint count,element_type el_type,uint instances)
             statistics::get().transparent_poly_count+=tri_count;
         else
             statistics::get().opaque_poly_count+=tri_count;
+
+        for(uint i=0;i<render_api_interface::state::max_layers;++i)
+        {
+            if(s.textures[i]==drawn_textures[i])
+                continue;
+
+            drawn_textures[i]=s.textures[i];
+            if(s.textures[i]>=0)
+                ++statistics::get().texture_bind_count;
+        }
     }
 }
 
@@ -100,6 +111,8 @@ bool vbo::set_vertex_data(const void*data,uint vert_stride,uint vert_count,usage
         if(vert_stride==m_stride && vert_count==m_vert_count)
         {
             api.update_vertex_buffer(m_verts,data);
+            if(statistics::enabled())
+                statistics::get().vertex_upload_bytes+=vert_stride*vert_count;
             return true;
         }
 
@@ -109,7 +122,7 @@ bool vbo::set_vertex_data(const void*data,uint vert_stride,uint vert_count,usage
     if(!vert_count || !vert_stride)
         return false;
 
-    m_verts=api.create_vertex_buffer(data,vert_stride,vert_count);
+    m_verts=api.create_vertex_buffer(data,vert_stride,vert_count,usage);
     if(m_verts<0)
         return false;
 
@@ -119,6 +132,35 @@ bool vbo::set_vertex_data(const void*data,uint vert_stride,uint vert_count,usage
     return true;
 }
 
+bool vbo::update_vertex_data(const void*data,uint first_vert,uint vert_count)
+{
+    if(m_verts<0 || !data)
+        return false;
+
+    if(first_vert>=(uint)m_vert_count)
+        return vert_count==0;
+
+    if(first_vert+vert_count>(uint)m_vert_count)
+        vert_count=m_vert_count-first_vert;
+
+    if(!vert_count)
+        return true;
+
+    render_api_interface &api=get_api_interface();
+    const uint offset=first_vert*m_stride,size=vert_count*m_stride;
+    if(!api.update_vertex_buffer_range(m_verts,(const char *)data+offset,offset,size))
+    {
+        api.update_vertex_buffer(m_verts,data);
+        if(statistics::enabled())
+            statistics::get().vertex_upload_bytes+=m_vert_count*m_stride;
+        return true;
+    }
+
+    if(statistics::enabled())
+        statistics::get().vertex_upload_bytes+=size;
+    return true;
+}
+
 bool vbo::set_index_data(const void*data,index_size size,uint indices_count,usage_hint usage)
 {
     render_api_interface &api=get_api_interface();
@@ -240,6 +282,8 @@ uint vbo::get_colors_dimension() const { return m_layout.color.dimension; }
 uint vbo::get_verts_count() const { return m_vert_count; }
 uint vbo::get_indices_count() const { return m_ind_count; }
 
+uint vbo::get_vmem_size() const { return m_vert_count*m_stride+m_ind_count*m_ind_size; }
+
 uint vbo::get_used_vmem_size()
 {
      //ToDo
@@ -25,11 +25,12 @@ public:
         index4b=4
     };
 
-    enum vertex_atrib_type
+    enum vertex_atrib_type //integer types are normalized to [0,1]
     {
         float16,
         float32,
-        uint8
+        uint8,
+        uint16
     };
 
     enum usage_hint
@@ -54,6 +55,8 @@ public:
 
 public:
     bool set_vertex_data(const void*data,uint vert_stride,uint vert_count,usage_hint usage=static_draw);
+    //data is the whole vertex array, only verts in [first_vert,first_vert+vert_count) are uploaded if backend allows
+    bool update_vertex_data(const void*data,uint first_vert,uint vert_count);
     bool set_index_data(const void*data,index_size size,uint indices_count,usage_hint usage=static_draw);
     void set_element_type(element_type type);
     void set_vertices(uint offset,uint dimension,vertex_atrib_type=float32);
@@ -102,6 +105,7 @@ private:
     void release_indices();
 
 public:
+    uint get_vmem_size() const; //vertex and index buffers
     static uint get_used_vmem_size();
     
 public:
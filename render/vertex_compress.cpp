@@ -0,0 +1,335 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "vertex_compress.h"
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+namespace nya_render
+{
+
+namespace
+{
+    enum attribute_role
+    {
+        role_pos,
+        role_normal,
+        role_color,
+        role_tc,
+        role_indices,
+        role_weights,
+        role_keep
+    };
+
+    struct attribute_info
+    {
+        const vbo::layout::attribute *from;
+        vbo::layout::attribute *to;
+        attribute_role role;
+    };
+
+    inline float get_float(const char *data,unsigned int stride,unsigned int vert,unsigned int offset,unsigned int comp)
+    {
+        float f;
+        memcpy(&f,data+size_t(vert)*stride+offset+comp*sizeof(float),sizeof(float));
+        return f;
+    }
+
+    float half_error(const char *data,unsigned int stride,unsigned int count,const vbo::layout::attribute &a)
+    {
+        float error=0.0f;
+        for(unsigned int i=0;i<count;++i)
+        {
+            for(unsigned int j=0;j<a.dimension;++j)
+            {
+                const float f=get_float(data,stride,i,a.offset,j);
+                const float e=fabsf(vertex_compression::half_to_float(vertex_compression::float_to_half(f))-f);
+                if(!(e<=error)) //also catches nan and inf
+                    error=e;
+            }
+        }
+
+        return error;
+    }
+
+    //returns -1 if any value is out of [0,1]
+    float unorm_error(const char *data,unsigned int stride,unsigned int count,const vbo::layout::attribute &a,float scale)
+    {
+        float error=0.0f;
+        for(unsigned int i=0;i<count;++i)
+        {
+            for(unsigned int j=0;j<a.dimension;++j)
+            {
+                const float f=get_float(data,stride,i,a.offset,j);
+                if(!(f>=0.0f && f<=1.0f))
+                    return -1.0f;
+
+                const float e=fabsf(floorf(f*scale+0.5f)/scale-f);
+                if(e>error)
+                    error=e;
+            }
+        }
+
+        return error;
+    }
+
+    vbo::vertex_atrib_type choose_type(const char *data,unsigned int stride,unsigned int count,
+                                       const attribute_info &a,const vertex_compression &c,float pos_scale)
+    {
+        const vbo::layout::attribute &from=*a.from;
+        if(from.type!=vbo::float32 || a.role==role_keep)
+            return from.type;
+
+        switch(a.role)
+        {
+            case role_pos: return half_error(data,stride,count,from)<=c.pos_error*pos_scale?vbo::float16:vbo::float32;
+            case role_normal: return half_error(data,stride,count,from)<=c.normal_error?vbo::float16:vbo::float32;
+            case role_tc: return half_error(data,stride,count,from)<=c.tc_error?vbo::float16:vbo::float32;
+            case role_indices: return half_error(data,stride,count,from)==0.0f?vbo::float16:vbo::float32;
+
+            case role_color:
+            case role_weights:
+            {
+                const float bound=a.role==role_color?c.color_error:c.weight_error;
+                const float e8=unorm_error(data,stride,count,from,255.0f);
+                if(e8>=0.0f && e8<=bound)
+                    return vbo::uint8;
+
+                const float e16=unorm_error(data,stride,count,from,65535.0f);
+                if(e16>=0.0f && e16<=bound)
+                    return vbo::uint16;
+
+                if(a.role==role_color && half_error(data,stride,count,from)<=bound)
+                    return vbo::float16;
+            }
+            break;
+
+            case role_keep: break;
+        }
+
+        return vbo::float32;
+    }
+
+    void convert(const char *data,unsigned int stride,unsigned int count,const vbo::layout::attribute &from,
+                 char *out,unsigned int out_stride,const vbo::layout::attribute &to)
+    {
+        const unsigned int size=from.dimension*vertex_compression::get_type_size(from.type);
+        for(unsigned int i=0;i<count;++i)
+        {
+            const char *src=data+size_t(i)*stride+from.offset;
+            char *dst=out+size_t(i)*out_stride+to.offset;
+            if(from.type==to.type)
+            {
+                memcpy(dst,src,size);
+                continue;
+            }
+
+            for(unsigned int j=0;j<from.dimension;++j)
+            {
+                float f;
+                memcpy(&f,src+j*sizeof(float),sizeof(float));
+                switch(to.type)
+                {
+                    case vbo::float16:
+                    {
+                        const uint16_t h=vertex_compression::float_to_half(f);
+                        memcpy(dst+j*sizeof(h),&h,sizeof(h));
+                    }
+                    break;
+
+                    case vbo::uint8: dst[j]=(char)(uint8_t)floorf(f*255.0f+0.5f); break;
+
+                    case vbo::uint16:
+                    {
+                        const uint16_t u=(uint16_t)floorf(f*65535.0f+0.5f);
+                        memcpy(dst+j*sizeof(u),&u,sizeof(u));
+                    }
+                    break;
+
+                    case vbo::float32: break;
+                }
+            }
+        }
+    }
+}
+
+bool vertex_compression::compress(const void *data,unsigned int stride,unsigned int count,const vbo::layout &layout,
+                                  std::vector<char> &out,unsigned int &out_stride,vbo::layout &out_layout) const
+{
+    out_layout=layout;
+    out_stride=stride;
+    if(!data || !count || !stride)
+    {
+        out.clear();
+        return false;
+    }
+
+    const char *src=(const char *)data;
+
+    std::vector<attribute_info> attributes;
+    attribute_info a;
+    a.from=&layout.pos,a.to=&out_layout.pos,a.role=role_pos;
+    attributes.push_back(a);
+    a.from=&layout.normal,a.to=&out_layout.normal,a.role=role_normal;
+    attributes.push_back(a);
+    a.from=&layout.color,a.to=&out_layout.color,a.role=role_color;
+    attributes.push_back(a);
+    for(unsigned int i=0;i<vbo::max_tex_coord;++i)
+    {
+        a.from=&layout.tc[i],a.to=&out_layout.tc[i];
+        switch(tc_hints[i])
+        {
+            case hint_keep: a.role=role_keep; break;
+            case hint_indices: a.role=role_indices; break;
+            case hint_weights: a.role=role_weights; break;
+            default: a.role=role_tc; break;
+        }
+        attributes.push_back(a);
+    }
+
+    for(size_t i=0;i<attributes.size();++i)
+    {
+        const vbo::layout::attribute &from=*attributes[i].from;
+        if(!from.dimension)
+            continue;
+
+        if(from.offset+from.dimension*get_type_size(from.type)>stride)
+        {
+            out.assign(src,src+size_t(stride)*count);
+            return false;
+        }
+    }
+
+    //position error is relative to the bounding box size
+    float pos_scale=0.0f;
+    if(layout.pos.type==vbo::float32 && layout.pos.dimension>0)
+    {
+        const unsigned int dim=layout.pos.dimension<3?layout.pos.dimension:3;
+        for(unsigned int j=0;j<dim;++j)
+        {
+            float min=get_float(src,stride,0,layout.pos.offset,j),max=min;
+            for(unsigned int i=1;i<count;++i)
+            {
+                const float f=get_float(src,stride,i,layout.pos.offset,j);
+                if(f<min) min=f;
+                if(f>max) max=f;
+            }
+
+            if(max-min>pos_scale)
+                pos_scale=max-min;
+        }
+    }
+
+    bool changed=false;
+    unsigned int offset=0;
+    for(size_t i=0;i<attributes.size();++i)
+    {
+        const attribute_info &ai=attributes[i];
+        if(!ai.from->dimension)
+            continue;
+
+        ai.to->type=choose_type(src,stride,count,ai,*this,pos_scale);
+        ai.to->offset=offset;
+        offset+=(ai.from->dimension*get_type_size(ai.to->type)+3)/4*4;
+        changed=changed || ai.to->type!=ai.from->type;
+    }
+
+    if(!changed || offset>=stride)
+    {
+        out_layout=layout;
+        out.assign(src,src+size_t(stride)*count);
+        return false;
+    }
+
+    out_stride=offset;
+    out.assign(size_t(out_stride)*count,0);
+    for(size_t i=0;i<attributes.size();++i)
+    {
+        const attribute_info &ai=attributes[i];
+        if(ai.from->dimension>0)
+            convert(src,stride,count,*ai.from,&out[0],out_stride,*ai.to);
+    }
+
+    return true;
+}
+
+unsigned int vertex_compression::get_type_size(vbo::vertex_atrib_type type)
+{
+    switch(type)
+    {
+        case vbo::float16: return 2;
+        case vbo::float32: return 4;
+        case vbo::uint8: return 1;
+        case vbo::uint16: return 2;
+    }
+
+    return 4;
+}
+
+unsigned short vertex_compression::float_to_half(float f)
+{
+    uint32_t u;
+    memcpy(&u,&f,sizeof(u));
+
+    const uint32_t sign=(u>>16)&0x8000;
+    const uint32_t abs=u&0x7fffffff;
+
+    if(abs>=0x7f800000) //inf, nan
+        return uint16_t(sign|0x7c00|(abs>0x7f800000?0x200:0));
+
+    if(abs>=0x477ff000) //rounds to inf
+        return uint16_t(sign|0x7c00);
+
+    if(abs<0x38800000) //denormal, round to nearest even
+    {
+        if(abs<0x33000000)
+            return uint16_t(sign);
+
+        const uint32_t shift=126-(abs>>23);
+        const uint32_t mantissa=(abs&0x7fffff)|0x800000;
+        uint32_t h=mantissa>>shift;
+        const uint32_t rem=mantissa&((1u<<shift)-1);
+        const uint32_t half=1u<<(shift-1);
+        if(rem>half || (rem==half && (h&1)))
+            ++h;
+        return uint16_t(sign|h);
+    }
+
+    uint32_t h=((abs-0x38000000)>>13);
+    const uint32_t rem=abs&0x1fff;
+    if(rem>0x1000 || (rem==0x1000 && (h&1)))
+        ++h;
+
+    return uint16_t(sign|h);
+}
+
+float vertex_compression::half_to_float(unsigned short h)
+{
+    const uint32_t sign=uint32_t(h&0x8000)<<16;
+    const uint32_t exp=(h>>10)&0x1f;
+    uint32_t mantissa=h&0x3ff;
+
+    uint32_t u;
+    if(exp==0x1f)
+        u=sign|0x7f800000|(mantissa<<13);
+    else if(exp)
+        u=sign|((exp+112)<<23)|(mantissa<<13);
+    else if(!mantissa)
+        u=sign;
+    else
+    {
+        int e=113;
+        while(!(mantissa&0x400))
+        {
+            mantissa<<=1;
+            --e;
+        }
+        u=sign|(uint32_t(e)<<23)|((mantissa&0x3ff)<<13);
+    }
+
+    float f;
+    memcpy(&f,&u,sizeof(f));
+    return f;
+}
+
+}
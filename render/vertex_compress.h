@@ -0,0 +1,47 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "vbo.h"
+#include <vector>
+
+namespace nya_render
+{
+
+//repacks float32 vertex attributes into smaller types decoded by the vbo layout itself, so shaders stay the same:
+//float16 positions, normals and tcs, float16 indices (exact below 2048), unorm8/16 weights and colors
+//an attribute is converted only if its largest error over all vertices is within the bound
+struct vertex_compression
+{
+    enum hint
+    {
+        hint_auto,    //float16 within tc_error
+        hint_keep,
+        hint_indices, //integer values, exact only
+        hint_weights  //values in [0,1], unorm8 or unorm16 within weight_error
+    };
+
+    float pos_error; //relative to the largest bounding box extent
+    float normal_error;
+    float tc_error;
+    float weight_error;
+    float color_error;
+    hint tc_hints[vbo::max_tex_coord];
+
+    //attributes are aligned to 4 bytes, returns false if nothing was converted, out is valid anyway
+    bool compress(const void *data,unsigned int stride,unsigned int count,const vbo::layout &layout,
+                  std::vector<char> &out,unsigned int &out_stride,vbo::layout &out_layout) const;
+
+    static unsigned int get_type_size(vbo::vertex_atrib_type type);
+    static unsigned short float_to_half(float f);
+    static float half_to_float(unsigned short h);
+
+    vertex_compression(): pos_error(1.0f/2048.0f),normal_error(0.002f),tc_error(1.0f/4096.0f),
+                          weight_error(1.0f/256.0f),color_error(1.0f/255.0f)
+    {
+        for(unsigned int i=0;i<vbo::max_tex_coord;++i)
+            tc_hints[i]=hint_auto;
+    }
+};
+
+}
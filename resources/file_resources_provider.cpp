@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 #ifdef _WIN32
     #include <Windows.h>
@@ -14,6 +15,11 @@
 	#include <dirent.h>
 #endif
 
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
 #include <sys/stat.h>
 
 #ifndef S_ISDIR
@@ -28,9 +34,21 @@ class file_ref
 public:
     void init(const char *name) { m_name.assign(name?name:""); }
 
-    FILE *access() { nya_memory::lock_guard lock(m_mutex); return get_lru().access(m_name.c_str()); }
+    void free() { nya_memory::lock_guard lock(get_mutex()); get_lru().free(m_name.c_str()); }
+
+    //lru is shared by all files and may close any handle on access, file is valid while it's locked
+    class locked: public nya_memory::non_copyable
+    {
+    public:
+        FILE *get() const { return m_file; }
+
+    public:
+        locked(file_ref &f): m_lock(get_mutex()),m_file(get_lru().access(f.m_name.c_str())) {}
 
-    void free() { nya_memory::lock_guard lock(m_mutex); get_lru().free(m_name.c_str()); }
+    private:
+        nya_memory::lock_guard m_lock;
+        FILE *m_file;
+    };
 
     class lru: public nya_memory::lru<FILE *,64>
     {
@@ -62,9 +80,14 @@ public:
         return *cache;
     }
 
+    static nya_memory::mutex &get_mutex()
+    {
+        static nya_memory::mutex *m=new nya_memory::mutex();
+        return *m;
+    }
+
 private:
     std::string m_name;
-    nya_memory::mutex m_mutex;
 };
 
 class file_resource: public resource_data
@@ -317,6 +340,127 @@ void file_resources_provider::lock()
     }
 }
 
+bool file_resources_provider::watch(bool enable)
+{
+#ifdef __linux__
+    nya_memory::lock_guard lock(m_watch_mutex);
+
+    if(!enable)
+    {
+        if(m_watch_fd>=0)
+            close(m_watch_fd);
+        m_watch_fd=-1;
+        m_watch_folders.clear();
+        return true;
+    }
+
+    if(m_watch_fd>=0)
+        return true;
+
+    m_watch_fd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if(m_watch_fd<0)
+    {
+        log()<<"unable to watch folder "<<m_path.c_str()<<": inotify init failed\n";
+        return false;
+    }
+
+    nya_memory::lock_guard_read lock_path(m_mutex);
+    add_watch("");
+    return true;
+#else
+    if(enable)
+        log()<<"unable to watch folder: not supported on this platform\n";
+    return !enable;
+#endif
+}
+
+void file_resources_provider::add_watch(const std::string &folder)
+{
+#ifdef __linux__
+    const std::string path=(m_path+folder).empty()?std::string("."):m_path+folder;
+    const int wd=inotify_add_watch(m_watch_fd,path.c_str(),IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE);
+    if(wd<0)
+    {
+        log()<<"unable to watch folder "<<path.c_str()<<"\n";
+        return;
+    }
+
+    m_watch_folders[wd]=folder;
+    if(!m_recursive)
+        return;
+
+    DIR *dirp=opendir(path.c_str());
+    if(!dirp)
+        return;
+
+    while(dirent *dp=readdir(dirp))
+    {
+        if(dp->d_type==DT_DIR && strcmp(dp->d_name,".")!=0 && strcmp(dp->d_name,"..")!=0)
+            add_watch(folder+dp->d_name+"/");
+    }
+    closedir(dirp);
+#endif
+}
+
+bool file_resources_provider::get_changed(std::vector<std::string> &names)
+{
+    names.clear();
+
+#ifdef __linux__
+    nya_memory::lock_guard lock(m_watch_mutex);
+    if(m_watch_fd<0)
+        return false;
+
+    bool names_changed=false;
+    long buf[1024]; //aligned for inotify_event
+    ssize_t size;
+    while((size=read(m_watch_fd,buf,sizeof(buf)))>0)
+    {
+        for(const char *p=(const char *)buf;p<(const char *)buf+size;)
+        {
+            const inotify_event *e=(const inotify_event *)p;
+            p+=sizeof(inotify_event)+e->len;
+
+            if(e->mask&IN_Q_OVERFLOW)
+                log()<<"warning: too many changes in watched folder "<<m_path.c_str()<<", some are missed\n";
+
+            std::map<int,std::string>::const_iterator it=m_watch_folders.find(e->wd);
+            if(!e->len || it==m_watch_folders.end())
+                continue;
+
+            const std::string name=it->second+e->name;
+            if(e->mask&IN_ISDIR)
+            {
+                if(m_recursive)
+                {
+                    nya_memory::lock_guard_read lock_path(m_mutex);
+                    add_watch(name+"/");
+                }
+                names_changed=true;
+                continue;
+            }
+
+            if(e->mask&(IN_CREATE|IN_MOVED_TO))
+                names_changed=true;
+
+            if(e->mask&IN_CREATE) //written content is reported on close
+                continue;
+
+            if(std::find(names.begin(),names.end(),name)==names.end())
+                names.push_back(name);
+        }
+    }
+
+    if(names_changed)
+    {
+        nya_memory::lock_guard_write lock_names(m_mutex);
+        m_update_names=true;
+    }
+#endif
+
+    return !names.empty();
+}
+
 bool file_resource::read_all(void*data)
 {
     if(!data)
@@ -326,7 +470,8 @@ bool file_resource::read_all(void*data)
         return false;
     }
 
-    FILE *file=m_file.access();
+    file_ref::locked lock(m_file);
+    FILE *file=lock.get();
     if(!file)
     {
         log()<<"unable to read file data: no such file\n";
@@ -357,7 +502,8 @@ bool file_resource::read_chunk(void *data,size_t size,size_t offset)
         return false;
     }
 
-    FILE *file=m_file.access();
+    file_ref::locked lock(m_file);
+    FILE *file=lock.get();
     if(!file)
     {
         log()<<"unable to read file data: no such file\n";
@@ -395,7 +541,8 @@ bool file_resource::open(const char*filename)
         return false;
 
     m_file.init(filename);
-    FILE *file=m_file.access();
+    file_ref::locked lock(m_file);
+    FILE *file=lock.get();
     if(!file)
         return false;
 
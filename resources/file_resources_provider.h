@@ -5,6 +5,7 @@
 #include "resources.h"
 #include <string>
 #include <vector>
+#include <map>
 
 namespace nya_resources
 {
@@ -26,17 +27,29 @@ public:
     virtual void lock();
 
 public:
-    file_resources_provider(const char *folder="") { set_folder(folder); }
+    //linux only, watches the folder for written, created or moved in files
+    bool watch(bool enable);
+    //resources changed since the last call, named as get_resource_name returns them
+    bool get_changed(std::vector<std::string> &names);
+
+public:
+    file_resources_provider(const char *folder=""): m_watch_fd(-1) { set_folder(folder); }
+    ~file_resources_provider() { watch(false); }
 
 private:
     void enumerate_folder(const char *folder_name);
     void update_names();
+    void add_watch(const std::string &folder);
 
 private:
     std::string m_path;
     bool m_recursive;
     bool m_update_names;
     std::vector<std::string> m_resource_names;
+
+    int m_watch_fd;
+    std::map<int,std::string> m_watch_folders; //by watch descriptor, relative to path with trailing slash
+    nya_memory::mutex m_watch_mutex;
 };
 
 }
@@ -77,40 +77,25 @@ bool memory_resources_provider::remove(const char *name)
     return false;
 }
 
-namespace
+bool memory_resource_data::read_all(void *data)
 {
-    struct resource: public resource_data
-    {
-        const char *data;
-        size_t size;
-
-        resource(const char *data,size_t size): data(data),size(size) {}
-
-        size_t get_size() { return size; }
-
-        virtual bool read_all(void *out_data)
-        {
-            if(!out_data)
-                return false;
-
-            memcpy(out_data,data,size);
-            return true;
-        }
+    if(!data)
+        return false;
 
-        virtual bool read_chunk(void *out_data,size_t out_size,size_t offset)
-        {
-            if(!out_data)
-                return false;
+    memcpy(data,m_data,m_size);
+    return true;
+}
 
-            if(out_size+offset>size || out_size>size)
-                return false;
+bool memory_resource_data::read_chunk(void *data,size_t size,size_t offset)
+{
+    if(!data)
+        return false;
 
-            memcpy(out_data,data+offset,size);
-            return true;
-        }
+    if(size+offset>m_size || size>m_size)
+        return false;
 
-        void release() { delete this; }
-    };
+    memcpy(data,m_data+offset,size);
+    return true;
 }
 
 resource_data *memory_resources_provider::access(const char *name)
@@ -125,7 +110,7 @@ resource_data *memory_resources_provider::access(const char *name)
         if(m_entries[i].name!=name)
             continue;
 
-        return new resource(m_entries[i].data,m_entries[i].size);
+        return new memory_resource_data(m_entries[i].data,m_entries[i].size);
     }
 
     return 0;
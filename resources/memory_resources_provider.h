@@ -9,6 +9,28 @@
 namespace nya_resources
 {
 
+//resource data over memory owned by the caller, which should stay valid until release()
+class memory_resource_data: public resource_data
+{
+public:
+    size_t get_size() { return m_size; }
+
+public:
+    bool read_all(void *data);
+    bool read_chunk(void *data,size_t size,size_t offset=0);
+
+public:
+    void release() { delete this; }
+
+public:
+    memory_resource_data(const void *data,size_t size): m_data((const char *)data),m_size(size) {}
+    virtual ~memory_resource_data() {}
+
+private:
+    const char *m_data;
+    size_t m_size;
+};
+
 class memory_resources_provider: public resources_provider
 {
 public:
@@ -4,18 +4,42 @@
 
 #include "resources.h"
 #include "memory/pool.h"
+#include "memory/mutex.h"
 #include <map>
 #include <string>
+#include <vector>
+#include <list>
 #include <algorithm>
+#include <atomic>
 
 namespace nya_resources
 {
 
+//thread-safe: resources may be accessed, referenced and freed from any thread
+//names are split between shards by hash, each shard has its own lock, map and pool
+//a resource is loaded once, concurrent access() of the same name waits for the first one to finish loading
+//refs copying is lock-free, only releasing the last ref locks the shard
+//with a cache budget unused resources stay loaded and are revived by access(), least recently used are released first
 template<typename t_res,int block_count> class shared_resources: public nya_memory::non_copyable
 {
+public:
+    struct cache_stats
+    {
+        unsigned int hits; //accessed while cached
+        unsigned int misses; //loaded
+        unsigned int cached_count;
+        size_t cached_size;
+        unsigned int evicted_count;
+        size_t evicted_size;
+
+        cache_stats(): hits(0),misses(0),cached_count(0),cached_size(0),evicted_count(0),evicted_size(0) {}
+    };
+
 private:
     virtual bool fill_resource(const char *name,t_res &res) { return false; }
     virtual bool release_resource(t_res &res) { return false; }
+    virtual size_t get_resource_size(const t_res &res) { return sizeof(t_res); } //memory held by a loaded resource
+    virtual void replace_resource(t_res &res,t_res &reloaded) { res=reloaded; } //res is released, reloaded is filled
 
 private:
     class shared_resources_creator
@@ -132,48 +156,107 @@ private:
             if(m_force_lowercase)
                 std::transform(name_str.begin(),name_str.end(),name_str.begin(),::tolower);
 
-            std::pair<resources_map_iterator,bool> ir = m_res_map.insert(std::make_pair(name_str,(res_holder*)0));
-            if(ir.second)
+            const int shard_idx=get_shard_idx(name_str);
+            shard &s=m_shards[shard_idx];
+            const nya_memory::thread_id thread=nya_memory::thread_id::current();
+
+            s.mutex.lock();
+            while(true)
             {
-                res_holder *holder=m_res_pool.allocate();
-                if(!holder)
-                    return shared_resource_ref();
+                resources_map_iterator it=s.map.find(name_str);
+                if(it==s.map.end())
+                    break;
+
+                res_holder *holder=it->second;
 
-                ir.first->second = holder;
-                if(!m_base->fill_resource(name,holder->res))
+                //access from the loading resource itself gets it unfinished, as it can't wait for itself
+                if(holder->loading && holder->loading_thread!=thread)
                 {
-                    m_res_map.erase(ir.first);
-                    return shared_resource_ref();
+                    s.loaded.wait(s.mutex);
+                    continue; //might be already released or failed
                 }
-                holder->ref_count=1;
-                holder->map_it=ir.first;
 
-                ++m_ref_count;
+                if(holder->ref_count==0)
+                {
+                    m_cache_mutex.lock();
+                    if(holder->cached)
+                    {
+                        m_cache.erase(holder->cache_it);
+                        holder->cached=false;
+                        m_cached_size-=holder->cached_size;
+                        ++m_stats.hits;
+                    }
+                    m_cache_mutex.unlock();
+                }
 
+                ++holder->ref_count;
+                s.mutex.unlock();
                 return shared_resource_ref(&(holder->res),holder,this);
             }
-            else
+
+            res_holder *holder=s.pool.allocate();
+            if(!holder)
             {
-                res_holder *holder=ir.first->second;
-                if(holder)
-                {
-                    ++holder->ref_count;
+                s.mutex.unlock();
+                return shared_resource_ref();
+            }
 
-                    return shared_resource_ref(&(holder->res),holder,this);
-                }
+            holder->ref_count=1;
+            holder->shard_idx=shard_idx;
+            holder->map_it=s.map.insert(std::make_pair(name_str,holder)).first;
+            holder->named=true;
+            holder->loading=true;
+            holder->loading_thread=thread;
+            ++m_ref_count;
+            s.mutex.unlock();
+
+            m_cache_mutex.lock();
+            ++m_stats.misses;
+            m_cache_mutex.unlock();
+
+            const bool result=m_base->fill_resource(name,holder->res);
+
+            s.mutex.lock();
+            holder->loading=false;
+            s.loaded.notify_all();
+
+            if(result)
+            {
+                s.mutex.unlock();
+                return shared_resource_ref(&(holder->res),holder,this);
             }
 
+            s.map.erase(holder->map_it);
+            holder->named=false;
+            if(--holder->ref_count>0) //referenced while loading, freed with the last ref
+            {
+                s.mutex.unlock();
+                return shared_resource_ref();
+            }
+
+            s.pool.free(holder);
+            s.mutex.unlock();
+            release_ref();
             return shared_resource_ref();
         }
 
         shared_resource_mutable_ref create()
         {
-            res_holder *holder=m_res_pool.allocate();
+            const int shard_idx=int(m_next_shard++%shards_count);
+            shard &s=m_shards[shard_idx];
+
+            s.mutex.lock();
+            res_holder *holder=s.pool.allocate();
             if(!holder)
+            {
+                s.mutex.unlock();
                 return shared_resource_mutable_ref();
+            }
 
             holder->ref_count=1;
-            holder->map_it=m_res_map.end();
+            holder->shard_idx=shard_idx;
+            holder->named=false;
+            s.mutex.unlock();
 
             ++m_ref_count;
 
@@ -202,16 +285,25 @@ private:
             if(!m_base)
                 return 0;
 
-            int count=0;
-
-            for(resources_map_iterator it=m_res_map.begin();
-                it!=m_res_map.end();++it)
+            std::vector<shared_resource_ref> refs;
+            for(int i=0;i<shards_count;++i)
             {
-                if(!it->second || it->first.empty())
-                    continue;
+                shard &s=m_shards[i];
+                nya_memory::lock_guard lock(s.mutex);
+                for(resources_map_iterator it=s.map.begin();it!=s.map.end();++it)
+                {
+                    if(it->first.empty() || it->second->loading)
+                        continue;
+
+                    ++it->second->ref_count;
+                    refs.push_back(shared_resource_ref(&(it->second->res),it->second,this));
+                }
+            }
 
-                m_base->release_resource(it->second->res);
-                if(m_base->fill_resource(it->first.c_str(),it->second->res))
+            int count=0;
+            for(size_t i=0;i<refs.size();++i)
+            {
+                if(reload(refs[i]))
                     ++count;
             }
 
@@ -227,12 +319,35 @@ private:
             if(m_force_lowercase)
                 std::transform(name_str.begin(),name_str.end(),name_str.begin(),::tolower);
 
-            resources_map_iterator it=m_res_map.find(name_str);
-            if(it==m_res_map.end() || !it->second)
+            shard &s=m_shards[get_shard_idx(name_str)];
+            shared_resource_ref ref;
+            {
+                nya_memory::lock_guard lock(s.mutex);
+                resources_map_iterator it=s.map.find(name_str);
+                if(it==s.map.end() || it->second->loading)
+                    return false;
+
+                ++it->second->ref_count;
+                ref=shared_resource_ref(&(it->second->res),it->second,this);
+            }
+
+            return reload(ref);
+        }
+
+        //loaded into a separate resource, so a failed reload keeps the previous data
+        bool reload(const shared_resource_ref &ref)
+        {
+            t_res reloaded;
+            if(!m_base->fill_resource(ref.m_res_holder->map_it->first.c_str(),reloaded))
+            {
+                m_base->release_resource(reloaded);
                 return false;
+            }
 
-            m_base->release_resource(it->second->res);
-            return m_base->fill_resource(it->first.c_str(),it->second->res);
+            t_res &res=ref.m_res_holder->res;
+            m_base->release_resource(res);
+            m_base->replace_resource(res,reloaded);
+            return true;
         }
 
         const char *get_res_name(const shared_resource_ref&ref)
@@ -243,7 +358,7 @@ private:
             if(ref.m_creator!=this)
                 return 0;
 
-            if(ref.m_res_holder->map_it==m_res_map.end())
+            if(!ref.m_res_holder->named)
                 return 0;
 
             return ref.m_res_holder->map_it->first.c_str();
@@ -251,47 +366,88 @@ private:
 
         void free(shared_resource_ref&ref)
         {
-            if(!ref.m_res_holder)
+            res_holder *holder=ref.m_res_holder;
+            if(!holder)
                 return;
 
             if(ref.m_creator!=this)
                 return;
 
-            --ref.m_res_holder->ref_count;
+            //not the last ref, no lock needed
+            int count=holder->ref_count;
+            while(count>1)
+            {
+                if(holder->ref_count.compare_exchange_weak(count,count-1))
+                    return;
+            }
 
-            if(ref.m_res_holder->ref_count>0)
+            //the last ref is released under lock, so access() can't take the resource meanwhile
+            shard &s=m_shards[holder->shard_idx];
+            s.mutex.lock();
+            if(--holder->ref_count>0)
+            {
+                s.mutex.unlock();
                 return;
-
-            ref.m_res_holder->ref_count=0;
+            }
 
             if(!m_should_unload_unused)
+            {
+                s.mutex.unlock();
                 return;
+            }
 
-            if(m_ref_count>0)
-                --m_ref_count;
-            else
-                nya_log::log()<<"resource system failure\n";
+            if(holder->named && m_base)
+            {
+                std::vector<res_holder*> evicted;
+                m_cache_mutex.lock();
+                if(holder->evicting) //released by evict()
+                {
+                    m_cache_mutex.unlock();
+                    s.mutex.unlock();
+                    return;
+                }
 
-            if(ref.m_res && m_base)
-                m_base->release_resource(*ref.m_res);
+                if(holder->cached) //referenced without access(), by reload or iteration
+                {
+                    m_cache.erase(holder->cache_it);
+                    holder->cached=false;
+                    m_cached_size-=holder->cached_size;
+                }
 
-            if(ref.m_res_holder->map_it!=m_res_map.end())
+                const size_t size=m_cache_budget>0?m_base->get_resource_size(holder->res):0;
+                if(m_cache_budget>0 && size<=m_cache_budget)
+                {
+                    holder->cached=true;
+                    holder->cached_size=size;
+                    holder->cache_it=m_cache.insert(m_cache.begin(),holder);
+                    m_cached_size+=size;
+                    trim_cache(evicted);
+                    m_cache_mutex.unlock();
+                    s.mutex.unlock();
+                    evict(evicted);
+                    return;
+                }
+                m_cache_mutex.unlock();
+            }
+
+            if(holder->named)
             {
                 if(!m_base)
-                    nya_log::log()<<"warning: unreleased resource "<<ref.m_res_holder->map_it->first.c_str()<<"\n";
+                    nya_log::log()<<"warning: unreleased resource "<<holder->map_it->first.c_str()<<"\n";
 
-                m_res_map.erase(ref.m_res_holder->map_it);
+                s.map.erase(holder->map_it);
+                holder->named=false;
             }
+            s.mutex.unlock();
 
-            m_res_pool.free(ref.m_res_holder);
+            if(m_base)
+                m_base->release_resource(holder->res);
 
-            if(!m_ref_count)
-            {
-                if(!m_base)
-                    delete this;
-                else
-                    nya_log::log()<<"resource system failure\n";
-            }
+            s.mutex.lock();
+            s.pool.free(holder);
+            s.mutex.unlock();
+
+            release_ref();
         }
 
         static void res_ref_count_inc(const shared_resource_ref &ref)
@@ -312,46 +468,119 @@ private:
 
         void free_unused()
         {
-            resources_map_iterator it=m_res_map.begin();
-            while(it!=m_res_map.end())
+            for(int i=0;i<shards_count;++i)
             {
-                if(it->second)
+                shard &s=m_shards[i];
+
+                std::vector<res_holder *> unused;
                 {
-                    if(it->second->ref_count>0)
+                    nya_memory::lock_guard lock(s.mutex);
+                    resources_map_iterator it=s.map.begin();
+                    while(it!=s.map.end())
                     {
-                        ++it;
-                        continue;
+                        res_holder *holder=it->second;
+                        if(holder->ref_count>0 || holder->loading)
+                        {
+                            ++it;
+                            continue;
+                        }
+
+                        nya_memory::lock_guard cache_lock(m_cache_mutex);
+                        if(holder->evicting)
+                        {
+                            ++it;
+                            continue;
+                        }
+
+                        if(holder->cached)
+                        {
+                            m_cache.erase(holder->cache_it);
+                            holder->cached=false;
+                            m_cached_size-=holder->cached_size;
+                        }
+
+                        holder->named=false;
+                        unused.push_back(holder);
+                        s.map.erase(it++);
                     }
+                }
 
+                for(size_t j=0;j<unused.size();++j)
+                {
                     if(m_base)
-                        m_base->release_resource(it->second->res);
+                        m_base->release_resource(unused[j]->res);
+
+                    s.mutex.lock();
+                    s.pool.free(unused[j]);
+                    s.mutex.unlock();
 
-                    m_res_pool.free(it->second);
+                    release_ref();
                 }
+            }
+        }
+
+        void set_cache_budget(size_t bytes)
+        {
+            std::vector<res_holder*> evicted;
+            m_cache_mutex.lock();
+            m_cache_budget=bytes;
+            trim_cache(evicted);
+            m_cache_mutex.unlock();
+            evict(evicted);
+        }
 
-                resources_map_iterator er = it;
-                ++it;
+        //releases all cached resources, the budget is kept
+        void flush_cache()
+        {
+            std::vector<res_holder*> evicted;
+            m_cache_mutex.lock();
+            const size_t budget=m_cache_budget;
+            m_cache_budget=0;
+            trim_cache(evicted);
+            m_cache_budget=budget;
+            m_cache_mutex.unlock();
+            evict(evicted);
+        }
 
-                m_res_map.erase(er);
-            }
+        cache_stats get_cache_stats()
+        {
+            nya_memory::lock_guard lock(m_cache_mutex);
+            cache_stats stats=m_stats;
+            stats.cached_count=(unsigned int)m_cache.size();
+            stats.cached_size=m_cached_size;
+            return stats;
+        }
+
+        void reset_cache_stats()
+        {
+            nya_memory::lock_guard lock(m_cache_mutex);
+            m_stats=cache_stats();
         }
 
         void free_all()
         {
-            resources_map_iterator it;
-            for(it=m_res_map.begin();it!=m_res_map.end();++it)
+            //cached holders are released with their refs while they are still in the maps
+            flush_cache();
+
+            for(int i=0;i<shards_count;++i)
             {
-                if(!it->second)
-                    continue;
+                shard &s=m_shards[i];
+                nya_memory::lock_guard lock(s.mutex);
+                for(resources_map_iterator it=s.map.begin();it!=s.map.end();++it)
+                {
+                    if(m_base)
+                        m_base->release_resource(it->second->res);
 
-                if(m_base)
-                    m_base->release_resource(it->second->res);
+                    it->second->named=false;
+                }
 
-                it->second->map_it=m_res_map.end();
+                s.map.clear();
+                s.pool.clear();
             }
 
-            m_res_map.clear();
-            m_res_pool.clear();
+            nya_memory::lock_guard lock(m_cache_mutex);
+            m_cache.clear();
+            m_cached_size=0;
         }
 
         void base_released()
@@ -367,31 +596,169 @@ private:
 
         bool has_refs() { return m_ref_count>0; }
 
+        //one ref from the base and one per resource, creator is deleted with the last one after the base
+        void release_ref()
+        {
+            const int count=--m_ref_count;
+            if(count>0)
+                return;
+
+            if(count<0 || m_base)
+            {
+                nya_log::log()<<"resource system failure\n";
+                return;
+            }
+
+            delete this;
+        }
+
+        shared_resource_ref get_first_resource() { return get_next_resource(0,m_shards[0].map.end()); }
+
+        shared_resource_ref get_next_resource(const shared_resource_ref &curr)
+        {
+            if(curr.m_creator!=this || !curr.m_res_holder || !curr.m_res_holder->named)
+                return shared_resource_ref();
+
+            return get_next_resource(curr.m_res_holder->shard_idx,curr.m_res_holder->map_it);
+        }
+
     public:
         shared_resources_creator(shared_resources *base): m_base(base),m_should_unload_unused(true),
-                                                          m_force_lowercase(true), m_ref_count(1) {}
+                                                          m_force_lowercase(true), m_ref_count(1), m_next_shard(0),
+                                                          m_cache_budget(0), m_cached_size(0) {}
     private:
         typedef std::map<std::string,res_holder*> resources_map;
         typedef typename resources_map::iterator resources_map_iterator;
 
+        static const int shards_count=16;
+
+        static int get_shard_idx(const std::string &name)
+        {
+            unsigned int hash=2166136261u;
+            for(size_t i=0;i<name.size();++i)
+                hash=(hash^(unsigned char)name[i])*16777619u;
+            return int(hash%shards_count);
+        }
+
+        //m_cache_mutex should be locked, least recently used go first
+        void trim_cache(std::vector<res_holder*> &evicted)
+        {
+            while(m_cached_size>m_cache_budget && !m_cache.empty())
+            {
+                res_holder *holder=m_cache.back();
+                m_cache.pop_back();
+                holder->cached=false;
+                holder->evicting=true;
+                m_cached_size-=holder->cached_size;
+                ++m_stats.evicted_count;
+                m_stats.evicted_size+=holder->cached_size;
+                evicted.push_back(holder);
+            }
+        }
+
+        //no locks should be held, resources revived meanwhile are kept
+        void evict(const std::vector<res_holder*> &evicted)
+        {
+            for(size_t i=0;i<evicted.size();++i)
+            {
+                res_holder *holder=evicted[i];
+                shard &s=m_shards[holder->shard_idx];
+
+                s.mutex.lock();
+                m_cache_mutex.lock();
+                holder->evicting=false;
+                m_cache_mutex.unlock();
+                if(holder->ref_count>0)
+                {
+                    s.mutex.unlock();
+                    continue;
+                }
+
+                s.map.erase(holder->map_it);
+                holder->named=false;
+                s.mutex.unlock();
+
+                if(m_base)
+                    m_base->release_resource(holder->res);
+
+                s.mutex.lock();
+                s.pool.free(holder);
+                s.mutex.unlock();
+
+                release_ref();
+            }
+        }
+
+        //from the element after prev in the shard, or from the shard beginning if prev is its end
+        shared_resource_ref get_next_resource(int shard_idx,resources_map_iterator prev)
+        {
+            for(;shard_idx<shards_count;++shard_idx)
+            {
+                shard &s=m_shards[shard_idx];
+                nya_memory::lock_guard lock(s.mutex);
+                resources_map_iterator it=prev;
+                it=it==s.map.end()?s.map.begin():++it;
+                for(;it!=s.map.end();++it)
+                {
+                    if(it->second->loading)
+                        continue;
+
+                    ++it->second->ref_count;
+                    return shared_resource_ref(&(it->second->res),it->second,this);
+                }
+
+                if(shard_idx+1<shards_count)
+                    prev=m_shards[shard_idx+1].map.end();
+            }
+
+            return shared_resource_ref();
+        }
+
     private:
+        typedef std::list<res_holder*> cache_list;
+
         struct res_holder
         {
             t_res res;
-            int ref_count;
-            resources_map_iterator map_it;
+            std::atomic<int> ref_count;
+            int shard_idx;
+            resources_map_iterator map_it; //valid if named
+            bool named;
+            bool loading;
+            nya_memory::thread_id loading_thread;
+
+            //guarded by m_cache_mutex
+            typename cache_list::iterator cache_it; //valid if cached
+            size_t cached_size;
+            bool cached;
+            bool evicting; //removed from the cache, will be released by evict() unless referenced
+
+            res_holder(): ref_count(0),shard_idx(0),named(false),loading(false),cached_size(0),cached(false),evicting(false) {}
+        };
 
-            res_holder(): ref_count(0) {}
+        struct shard
+        {
+            nya_memory::mutex mutex;
+            nya_memory::condition_variable loaded;
+            resources_map map;
+            nya_memory::pool<res_holder,block_count> pool;
         };
 
-        resources_map m_res_map;
-        nya_memory::pool<res_holder,block_count> m_res_pool;
+        shard m_shards[shards_count];
 
     private:
         shared_resources *m_base;
         bool m_should_unload_unused;
         bool m_force_lowercase;
-        size_t m_ref_count;
+        std::atomic<int> m_ref_count;
+        std::atomic<unsigned int> m_next_shard;
+
+        //unused named resources, most recently used first
+        nya_memory::mutex m_cache_mutex;
+        cache_list m_cache;
+        size_t m_cache_budget;
+        size_t m_cached_size;
+        cache_stats m_stats;
     };
 
 public:
@@ -414,39 +781,22 @@ public:
     int reload_resources() { return m_creator->reload_resources(); }
 
 public:
-    shared_resource_ref get_first_resource()
-    {
-        if(m_creator->m_res_map.empty())
-            return shared_resource_ref();
+    //unused resources are kept loaded up to the budget in bytes, see get_resource_size
+    //0 by default, unused resources are released right away
+    void set_cache_budget(size_t bytes) { m_creator->set_cache_budget(bytes); }
+    void flush_cache() { m_creator->flush_cache(); }
+    cache_stats get_cache_stats() { return m_creator->get_cache_stats(); }
+    void reset_cache_stats() { m_creator->reset_cache_stats(); }
 
-        struct shared_resources_creator::res_holder *holder=m_creator->m_res_map.begin()->second;
-        if(!holder)
-            return shared_resource_ref();
-
-        ++holder->ref_count;
-        return shared_resource_ref(&(holder->res),holder,m_creator);
-    }
-
-    shared_resource_ref get_next_resource(shared_resource_ref &curr)
-    {
-        if(curr.m_creator!=m_creator || !curr.m_res_holder)
-            return shared_resource_ref();
-
-        typename shared_resources_creator::resources_map_iterator it=curr.m_res_holder->map_it;
-        if(++it==m_creator->m_res_map.end())
-            return shared_resource_ref();
-
-        struct shared_resources_creator::res_holder *holder=it->second;
-        if(!holder)
-            return shared_resource_ref();
-
-        ++holder->ref_count;
-        return shared_resource_ref(&(holder->res),holder,m_creator);
-    }
+public:
+    shared_resource_ref get_first_resource() { return m_creator->get_first_resource(); }
+    shared_resource_ref get_next_resource(shared_resource_ref &curr) { return m_creator->get_next_resource(curr); }
 
 public:
+    //derived classes should flush the cache in their destructor, release_resource isn't overloaded here anymore
     virtual ~shared_resources()
     {
+        m_creator->flush_cache();
         m_creator->base_released();
         if(!m_creator->has_refs())
             delete m_creator;
@@ -0,0 +1,336 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "cpu_skinning.h"
+#include "scene.h"
+#include "memory/thread_pool.h"
+#include <math.h>
+#include <string.h>
+
+#if defined __SSE__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP>=1)
+    #define SKINNING_SSE
+    #include <xmmintrin.h>
+#endif
+
+namespace nya_scene
+{
+
+namespace
+{
+
+const int deform_chunk=2048;
+
+inline void normalize(float *n)
+{
+    const float len_sq=n[0]*n[0]+n[1]*n[1]+n[2]*n[2];
+    if(len_sq<1.0e-12f)
+        return;
+
+    const float inv_len=1.0f/sqrtf(len_sq);
+    n[0]*=inv_len,n[1]*=inv_len,n[2]*=inv_len;
+}
+
+class deform_job: public nya_memory::parallel_job
+{
+public:
+    void run(int from,int to)
+    {
+        from+=offset,to+=offset;
+
+        if(!palette)
+        {
+            for(int i=from;i<to;++i)
+            {
+                float *out=out_data+i*stride;
+                memcpy(out,&pos[i].x,3*sizeof(float));
+                if(normals)
+                    memcpy(out+3,&normals[i].x,3*sizeof(float));
+            }
+            return;
+        }
+
+        for(int i=from;i<to;++i)
+        {
+            const int *b=bone_idx+i*cpu_skinning::max_weights;
+            const float *w=weights+i*cpu_skinning::max_weights;
+            float *out=out_data+i*stride;
+            const nya_math::vec3 &p=pos[i];
+
+#ifdef SKINNING_SSE
+            __m128 r0=_mm_setzero_ps(),r1=_mm_setzero_ps(),r2=_mm_setzero_ps(),r3=_mm_setzero_ps();
+            for(int j=0;j<cpu_skinning::max_weights;++j)
+            {
+                if(w[j]<=0.0f || b[j]>=bones_count)
+                    continue;
+
+                const float *m=palette+b[j]*12;
+                const __m128 wj=_mm_set1_ps(w[j]);
+                r0=_mm_add_ps(r0,_mm_mul_ps(_mm_loadu_ps(m),wj));
+                r1=_mm_add_ps(r1,_mm_mul_ps(_mm_loadu_ps(m+4),wj));
+                r2=_mm_add_ps(r2,_mm_mul_ps(_mm_loadu_ps(m+8),wj));
+            }
+
+            _MM_TRANSPOSE4_PS(r0,r1,r2,r3); //columns of the blended 3x4 matrix, r3 is translation
+
+            float res[4];
+            _mm_storeu_ps(res,_mm_add_ps(_mm_add_ps(_mm_mul_ps(r0,_mm_set1_ps(p.x)),_mm_mul_ps(r1,_mm_set1_ps(p.y))),
+                                         _mm_add_ps(_mm_mul_ps(r2,_mm_set1_ps(p.z)),r3)));
+            memcpy(out,res,3*sizeof(float));
+
+            if(normals)
+            {
+                const nya_math::vec3 &n=normals[i];
+                _mm_storeu_ps(res,_mm_add_ps(_mm_add_ps(_mm_mul_ps(r0,_mm_set1_ps(n.x)),_mm_mul_ps(r1,_mm_set1_ps(n.y))),
+                                             _mm_mul_ps(r2,_mm_set1_ps(n.z))));
+                normalize(res);
+                memcpy(out+3,res,3*sizeof(float));
+            }
+#else
+            float m[12]={0};
+            for(int j=0;j<cpu_skinning::max_weights;++j)
+            {
+                if(w[j]<=0.0f || b[j]>=bones_count)
+                    continue;
+
+                const float *bm=palette+b[j]*12;
+                for(int k=0;k<12;++k)
+                    m[k]+=bm[k]*w[j];
+            }
+
+            for(int k=0;k<3;++k)
+                out[k]=m[k*4]*p.x+m[k*4+1]*p.y+m[k*4+2]*p.z+m[k*4+3];
+
+            if(normals)
+            {
+                const nya_math::vec3 &n=normals[i];
+                for(int k=0;k<3;++k)
+                    out[3+k]=m[k*4]*n.x+m[k*4+1]*n.y+m[k*4+2]*n.z;
+                normalize(out+3);
+            }
+#endif
+        }
+    }
+
+public:
+    const nya_math::vec3 *pos;
+    const nya_math::vec3 *normals;
+    const int *bone_idx;
+    const float *weights;
+    const float *palette;
+    int bones_count;
+    float *out_data;
+    int stride;
+    int offset;
+};
+
+}
+
+void cpu_skinning::range::add(const range &r)
+{
+    if(r.is_empty())
+        return;
+
+    if(is_empty())
+    {
+        *this=r;
+        return;
+    }
+
+    if(r.from<from)
+        from=r.from;
+    if(r.to>to)
+        to=r.to;
+}
+
+bool cpu_skinning::init(const nya_math::vec3 *pos,const nya_math::vec3 *normals,const nya_math::vec2 *tc,uint count)
+{
+    release();
+
+    if(!pos || !count)
+        return false;
+
+    m_count=count;
+    m_stride=tc?8:6;
+    m_morphed.assign(pos,pos+count);
+    if(normals)
+        m_normals.assign(normals,normals+count);
+
+    m_out.resize(size_t(count)*m_stride);
+    for(uint i=0;i<count;++i)
+    {
+        float *out=&m_out[i*m_stride];
+        memcpy(out,&pos[i].x,3*sizeof(float));
+        if(normals)
+            memcpy(out+3,&normals[i].x,3*sizeof(float));
+        else
+            out[3]=out[4]=0.0f,out[5]=1.0f;
+        if(tc)
+            out[6]=tc[i].x,out[7]=tc[i].y;
+    }
+
+    for(int i=0;i<2;++i)
+    {
+        m_vbo[i].set_vertices(0,3);
+        m_vbo[i].set_normals(3*sizeof(float));
+        if(tc)
+            m_vbo[i].set_tc(0,6*sizeof(float),2);
+        if(!m_vbo[i].set_vertex_data(&m_out[0],get_vert_stride(),count,nya_render::vbo::dynamic_draw))
+        {
+            log()<<"unable to init cpu skinning: unable to create vbo\n";
+            release();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool cpu_skinning::set_weights(const int *bone_idx,const float *weights,int weights_per_vertex)
+{
+    if(!m_count || !bone_idx || !weights || weights_per_vertex<=0 || weights_per_vertex>max_weights)
+        return false;
+
+    m_bone_idx.assign(m_count*max_weights,0);
+    m_weights.assign(m_count*max_weights,0.0f);
+    for(uint i=0;i<m_count;++i)
+    {
+        for(int j=0;j<weights_per_vertex;++j)
+        {
+            const int idx=bone_idx[i*weights_per_vertex+j];
+            const float w=weights[i*weights_per_vertex+j];
+            if(idx<0 || w<=0.0f)
+                continue;
+
+            m_bone_idx[i*max_weights+j]=idx;
+            m_weights[i*max_weights+j]=w;
+        }
+    }
+
+    m_skeleton=0;
+    return true;
+}
+
+int cpu_skinning::add_morph(const uint *verts,const nya_math::vec3 *offsets,uint count)
+{
+    if(!verts || !offsets || !count)
+        return -1;
+
+    morph m;
+    m.verts_range=range(m_count,0);
+    for(uint i=0;i<count;++i)
+    {
+        if(verts[i]>=m_count)
+            continue;
+
+        m.verts.push_back(verts[i]);
+        m.offsets.push_back(offsets[i]);
+        if(verts[i]<m.verts_range.from)
+            m.verts_range.from=verts[i];
+        if(verts[i]+1>m.verts_range.to)
+            m.verts_range.to=verts[i]+1;
+    }
+
+    if(m.verts.empty())
+        return -1;
+
+    m_morphs.push_back(m);
+    return (int)m_morphs.size()-1;
+}
+
+void cpu_skinning::set_morph(int idx,float weight)
+{
+    if(idx<0 || idx>=(int)m_morphs.size())
+        return;
+
+    m_morphs[idx].weight=weight;
+}
+
+float cpu_skinning::get_morph(int idx) const
+{
+    if(idx<0 || idx>=(int)m_morphs.size())
+        return 0.0f;
+
+    return m_morphs[idx].weight;
+}
+
+void cpu_skinning::release()
+{
+    m_vbo[0].release();
+    m_vbo[1].release();
+    m_pending[0]=m_pending[1]=range();
+    m_front=0;
+
+    m_normals.clear();
+    m_morphed.clear();
+    m_bone_idx.clear();
+    m_weights.clear();
+    m_morphs.clear();
+    m_out.clear();
+
+    m_count=m_stride=0;
+    m_skeleton=0;
+    m_skeleton_version=0;
+}
+
+void cpu_skinning::update(const nya_render::skeleton *skeleton)
+{
+    if(!m_count)
+        return;
+
+    range dirty;
+
+    for(size_t i=0;i<m_morphs.size();++i)
+    {
+        morph &m=m_morphs[i];
+        const float d=m.weight-m.applied_weight;
+        if(d==0.0f)
+            continue;
+
+        for(size_t j=0;j<m.verts.size();++j)
+            m_morphed[m.verts[j]]+=m.offsets[j]*d;
+
+        m.applied_weight=m.weight;
+        dirty.add(m.verts_range);
+    }
+
+    if(m_weights.empty() || (skeleton && skeleton->get_bones_count()<=0))
+        skeleton=0;
+
+    if(skeleton!=m_skeleton || (skeleton && skeleton->get_version()!=m_skeleton_version))
+    {
+        m_skeleton=skeleton;
+        m_skeleton_version=skeleton?skeleton->get_version():0;
+        dirty=range(0,m_count);
+    }
+
+    if(!dirty.is_empty())
+        deform(dirty);
+
+    m_pending[0].add(dirty);
+    m_pending[1].add(dirty);
+
+    const int back=1-m_front;
+    range &r=m_pending[back];
+    if(r.is_empty())
+        return;
+
+    m_vbo[back].update_vertex_data(&m_out[0],r.from,r.to-r.from);
+    r=range();
+    m_front=back;
+}
+
+void cpu_skinning::deform(range r)
+{
+    deform_job job;
+    job.pos=&m_morphed[0];
+    job.normals=m_normals.empty()?0:&m_normals[0];
+    job.bone_idx=m_bone_idx.empty()?0:&m_bone_idx[0];
+    job.weights=m_weights.empty()?0:&m_weights[0];
+    job.palette=m_skeleton?m_skeleton->get_skinning_mat34_buffer():0;
+    job.bones_count=m_skeleton?m_skeleton->get_bones_count():0;
+    job.out_data=&m_out[0];
+    job.stride=m_stride;
+    job.offset=r.from;
+    nya_memory::parallel_for(job,r.to-r.from,deform_chunk);
+}
+
+}
@@ -0,0 +1,100 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "render/vbo.h"
+#include "render/skeleton.h"
+#include "math/vector.h"
+#include <vector>
+
+namespace nya_scene
+{
+
+//deforms vertices on cpu with bone weights and vertex morphs
+//for tools, picking against animated meshes and gpus with too few uniforms for bone palettes
+//result is kept in memory and in a double-buffered dynamic vbo with positions, normals and optional tc0
+class cpu_skinning
+{
+public:
+    typedef unsigned int uint;
+    const static int max_weights=4;
+
+public:
+    //normals and tc are optional, arrays have count elements
+    bool init(const nya_math::vec3 *pos,const nya_math::vec3 *normals,const nya_math::vec2 *tc,uint count);
+
+    //count*weights_per_vertex elements each, zero weights are skipped
+    bool set_weights(const int *bone_idx,const float *weights,int weights_per_vertex);
+
+    //sparse position offsets, returns morph idx or -1
+    int add_morph(const uint *verts,const nya_math::vec3 *offsets,uint count);
+    void set_morph(int idx,float weight);
+    float get_morph(int idx) const;
+    int get_morphs_count() const { return (int)m_morphs.size(); }
+
+    void release();
+
+public:
+    //recomputes vertices touched by changed morphs, or all of them if skeleton was updated
+    //then uploads changed range to the back buffer and makes it current
+    void update(const nya_render::skeleton *skeleton);
+
+public:
+    const nya_render::vbo &get_vbo() const { return m_vbo[m_front]; }
+
+    uint get_verts_count() const { return m_count; }
+    uint get_vert_stride() const { return m_stride*sizeof(float); }
+    const float *get_vertex_data() const { return m_out.empty()?0:&m_out[0]; } //pos, normal, tc per vertex
+    nya_math::vec3 get_pos(uint idx) const { return nya_math::vec3(&m_out[idx*m_stride]); }
+    nya_math::vec3 get_normal(uint idx) const { return nya_math::vec3(&m_out[idx*m_stride+3]); }
+
+public:
+    cpu_skinning(): m_count(0),m_stride(0),m_front(0),m_skeleton(0),m_skeleton_version(0) {}
+
+private:
+    struct range
+    {
+        uint from,to;
+
+        range(): from(0),to(0) {}
+        range(uint f,uint t): from(f),to(t) {}
+
+        bool is_empty() const { return from>=to; }
+        void add(const range &r);
+    };
+
+    void deform(range r);
+
+private:
+    uint m_count;
+    uint m_stride;
+
+    std::vector<nya_math::vec3> m_normals;
+    std::vector<nya_math::vec3> m_morphed; //source positions with applied morphs
+
+    std::vector<int> m_bone_idx;
+    std::vector<float> m_weights;
+
+    struct morph
+    {
+        std::vector<uint> verts;
+        std::vector<nya_math::vec3> offsets;
+        range verts_range;
+        float weight;
+        float applied_weight;
+
+        morph(): weight(0.0f),applied_weight(0.0f) {}
+    };
+
+    std::vector<morph> m_morphs;
+
+    std::vector<float> m_out;
+    nya_render::vbo m_vbo[2];
+    range m_pending[2];
+    int m_front;
+
+    const nya_render::skeleton *m_skeleton;
+    uint m_skeleton_version;
+};
+
+}
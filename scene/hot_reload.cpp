@@ -0,0 +1,363 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "hot_reload.h"
+#include "scene.h"
+#include "texture.h"
+#include "shader.h"
+#include "material.h"
+#include "mesh.h"
+#include "animation.h"
+#include "location.h"
+#include "resources/memory_resources_provider.h"
+#include <algorithm>
+#include <map>
+
+namespace nya_scene
+{
+
+namespace
+{
+    std::string lowercase(const char *name)
+    {
+        std::string str(name?name:"");
+        std::transform(str.begin(),str.end(),str.begin(),::tolower);
+        return str;
+    }
+
+    //lowercase name -> file name as the provider lists it
+    void get_file_names(nya_resources::resources_provider &provider,std::map<std::string,std::string> &names)
+    {
+        provider.lock();
+        for(int i=0;i<provider.get_resources_count();++i)
+        {
+            const char *name=provider.get_resource_name(i);
+            if(name)
+                names[lowercase(name)]=name;
+        }
+        provider.unlock();
+    }
+
+    template<typename t> void get_loaded(nya_resources::shared_resources<t,8> &shared,int type,std::map<std::string,int> &loaded)
+    {
+        typedef typename nya_resources::shared_resources<t,8>::shared_resource_ref ref;
+        for(ref r=shared.get_first_resource();r.is_valid();r=shared.get_next_resource(r))
+        {
+            if(r.get_name())
+                loaded[r.get_name()]=type;
+        }
+    }
+}
+
+bool hot_reload::start(nya_resources::file_resources_provider &provider)
+{
+    stop();
+
+    if(!provider.watch(true))
+        return false;
+
+    m_watched=&provider;
+    return true;
+}
+
+void hot_reload::stop()
+{
+    if(m_watched)
+        m_watched->watch(false);
+    m_watched=0;
+
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        while(m_pending_reads>0)
+            m_reads_cond.wait(m_mutex);
+    }
+
+    m_batch.clear();
+    m_changed.clear();
+}
+
+void hot_reload::add_changed(const char *name)
+{
+    if(!name || !name[0])
+        return;
+
+    if(std::find(m_changed.begin(),m_changed.end(),name)==m_changed.end())
+        m_changed.push_back(name);
+}
+
+int hot_reload::update()
+{
+    if(m_watched)
+    {
+        std::vector<std::string> names;
+        m_watched->get_changed(names);
+        for(size_t i=0;i<names.size();++i)
+            add_changed(names[i].c_str());
+    }
+
+    if(is_busy())
+        return 0;
+
+    const int count=m_batch.empty()?0:reload_batch();
+    if(!m_changed.empty())
+        start_batch();
+
+    return count;
+}
+
+bool hot_reload::is_busy()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    return m_pending_reads>0;
+}
+
+void hot_reload::start_batch()
+{
+    //loaded resources by name and their dependents by dependency name
+    std::map<std::string,int> loaded;
+    get_loaded(texture_internal::get_shared_resources(),type_texture,loaded);
+    get_loaded(material_internal::get_shared_resources(),type_material,loaded);
+    get_loaded(animation::get_shared_resources(),type_animation,loaded);
+    get_loaded(location::get_shared_resources(),type_location,loaded);
+
+    typedef std::multimap<std::string,std::string> deps_map;
+    deps_map dependents;
+    std::multimap<std::string,std::string> includes;
+
+    typedef nya_resources::shared_resources<shared_shader,8>::shared_resource_ref shader_ref;
+    nya_resources::shared_resources<shared_shader,8> &shaders=shader_internal::get_shared_resources();
+    for(shader_ref r=shaders.get_first_resource();r.is_valid();r=shaders.get_next_resource(r))
+    {
+        if(!r.get_name())
+            continue;
+
+        loaded[r.get_name()]=type_shader;
+        for(size_t i=0;i<r->includes.size();++i)
+        {
+            dependents.insert(std::make_pair(lowercase(r->includes[i].c_str()),std::string(r.get_name())));
+            includes.insert(std::make_pair(std::string(r.get_name()),r->includes[i]));
+        }
+    }
+
+    //meshes hold copies of their materials
+    typedef nya_resources::shared_resources<shared_mesh,8>::shared_resource_ref mesh_ref;
+    nya_resources::shared_resources<shared_mesh,8> &meshes=mesh_internal::get_shared_resources();
+    for(mesh_ref r=meshes.get_first_resource();r.is_valid();r=meshes.get_next_resource(r))
+    {
+        if(!r.get_name())
+            continue;
+
+        loaded[r.get_name()]=type_mesh;
+        for(size_t i=0;i<r->materials.size();++i)
+        {
+            const char *material_name=r->materials[i].internal().get_name();
+            if(material_name)
+                dependents.insert(std::make_pair(std::string(material_name),std::string(r.get_name())));
+        }
+    }
+
+    std::vector<std::pair<std::string,std::string> > queue; //name, path
+    for(size_t i=0;i<m_changed.size();++i)
+        queue.push_back(std::make_pair(lowercase(m_changed[i].c_str()),m_changed[i]));
+    m_changed.clear();
+
+    m_batch.clear();
+    for(size_t i=0;i<queue.size();++i)
+    {
+        const std::string name=queue[i].first;
+        if(find_entry(name.c_str())>=0)
+            continue;
+
+        std::pair<deps_map::const_iterator,deps_map::const_iterator> range=dependents.equal_range(name);
+        for(deps_map::const_iterator it=range.first;it!=range.second;++it)
+            queue.push_back(std::make_pair(it->second,it->second));
+
+        std::map<std::string,int>::const_iterator it=loaded.find(name);
+        if(it==loaded.end())
+            continue;
+
+        m_batch.resize(m_batch.size()+1);
+        m_batch.back().type=resource_type(it->second);
+        m_batch.back().name=name;
+        m_batch.back().path=queue[i].second;
+    }
+
+    //includes are read by reloaded shaders
+    for(size_t i=0,count=m_batch.size();i<count;++i)
+    {
+        if(m_batch[i].type!=type_shader)
+            continue;
+
+        std::pair<deps_map::const_iterator,deps_map::const_iterator> range=includes.equal_range(m_batch[i].name);
+        for(deps_map::const_iterator it=range.first;it!=range.second;++it)
+        {
+            if(find_entry(lowercase(it->second.c_str()).c_str())>=0)
+                continue;
+
+            m_batch.resize(m_batch.size()+1);
+            m_batch.back().type=type_file;
+            m_batch.back().name=lowercase(it->second.c_str());
+            m_batch.back().path=it->second;
+        }
+    }
+
+    if(m_batch.empty())
+        return;
+
+    m_provider=&nya_resources::get_resources_provider();
+
+    //dependents are known by lowercase names only, their files may be named in any case
+    std::map<std::string,std::string> file_names;
+    bool file_names_listed=false;
+    for(size_t i=0;i<m_batch.size();++i)
+    {
+        entry &e=m_batch[i];
+        if(e.path!=e.name)
+            continue;
+
+        if(!file_names_listed)
+        {
+            get_file_names(*m_provider,file_names);
+            file_names_listed=true;
+        }
+
+        std::map<std::string,std::string>::const_iterator it=file_names.find(e.name);
+        if(it!=file_names.end())
+            e.path=it->second;
+    }
+
+    m_pending_reads=(int)m_batch.size();
+    for(int i=0;i<(int)m_batch.size();++i)
+    {
+        m_batch[i].read=false;
+        m_batch[i].task.r=this;
+        m_batch[i].task.idx=i;
+    }
+
+    for(size_t i=0;i<m_batch.size();++i)
+        nya_memory::thread_pool::get().add_task(&m_batch[i].task);
+}
+
+void hot_reload::read(int idx)
+{
+    entry &e=m_batch[idx]; //batch isn't changed until all reads are finished
+
+    bool result=false;
+    nya_resources::resource_data *data=m_provider->access(e.path.c_str());
+    if(data)
+    {
+        e.data.allocate(data->get_size());
+        result=!e.data.get_size() || data->read_all(e.data.get_data());
+        data->release();
+        if(!result)
+            e.data.free();
+    }
+
+    if(!result)
+        log()<<"hot reload: unable to read "<<e.path.c_str()<<"\n";
+
+    nya_memory::lock_guard lock(m_mutex);
+    e.read=result;
+    --m_pending_reads;
+    m_reads_cond.notify_all();
+}
+
+int hot_reload::reload_batch()
+{
+    //provider may be changed since the batch was started, unread files are accessed through the current one
+    nya_resources::resources_provider *provider=&nya_resources::get_resources_provider();
+    if(provider!=&m_preloaded)
+        m_provider=provider;
+
+    nya_resources::set_resources_provider(&m_preloaded);
+
+    //dependencies first
+    int count=0;
+    for(int type=type_texture;type<=type_location;++type)
+    {
+        for(size_t i=0;i<m_batch.size();++i)
+        {
+            const entry &e=m_batch[i];
+            if(e.type!=type)
+                continue;
+
+            bool result=false;
+            if(e.read)
+            {
+                switch(e.type)
+                {
+                    case type_texture: result=texture_internal::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_shader: result=shader_internal::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_material: result=material_internal::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_mesh: result=mesh_internal::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_animation: result=animation::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_location: result=location::get_shared_resources().reload_resource(e.name.c_str()); break;
+                    case type_file: break;
+                }
+            }
+
+            if(result)
+                ++count;
+            else
+            {
+                log()<<"hot reload: unable to reload "<<e.name.c_str()<<"\n";
+                ++m_stats.failed_count;
+            }
+        }
+    }
+
+    nya_resources::set_resources_provider(provider);
+
+    for(size_t i=0;i<m_batch.size();++i)
+        m_batch[i].data.free();
+    m_batch.clear();
+
+    m_stats.reloaded_count+=count;
+    ++m_stats.batches_count;
+    return count;
+}
+
+int hot_reload::find_entry(const char *name)
+{
+    if(!name)
+        return -1;
+
+    for(int i=0;i<(int)m_batch.size();++i)
+    {
+        if(m_batch[i].name==name)
+            return i;
+    }
+
+    return -1;
+}
+
+nya_resources::resource_data *hot_reload::preloaded_provider::access(const char *resource_name)
+{
+    if(!resource_name)
+        return 0;
+
+    const int idx=r->find_entry(lowercase(resource_name).c_str());
+    if(idx>=0 && r->m_batch[idx].read)
+    {
+        const nya_memory::tmp_buffer_ref &data=r->m_batch[idx].data;
+        return new nya_resources::memory_resource_data(data.get_data(),data.get_size());
+    }
+
+    return r->m_provider->access(resource_name);
+}
+
+bool hot_reload::preloaded_provider::has(const char *resource_name)
+{
+    if(!resource_name)
+        return false;
+
+    const int idx=r->find_entry(lowercase(resource_name).c_str());
+    if(idx>=0 && r->m_batch[idx].read)
+        return true;
+
+    return r->m_provider->has(resource_name);
+}
+
+int hot_reload::preloaded_provider::get_resources_count() { return r->m_provider->get_resources_count(); }
+const char *hot_reload::preloaded_provider::get_resource_name(int idx) { return r->m_provider->get_resource_name(idx); }
+
+}
@@ -0,0 +1,111 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "resources/file_resources_provider.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
+#include "memory/tmp_buffer.h"
+#include <string>
+#include <vector>
+
+namespace nya_scene
+{
+
+//reloads loaded scene resources when their files change, with the resources depending on them:
+//shader includes -> shaders, materials -> meshes; materials rebind reloaded shaders by themselves
+//changed files are read on the shared thread pool, resources are reloaded in place between frames in update()
+//names are matched as shared resources store them, in lowercase
+class hot_reload
+{
+public:
+    //watches the provider folder, the provider should be the one resources are loaded from
+    bool start(nya_resources::file_resources_provider &provider);
+    void stop();
+
+    //files changed outside of the watched folder or on platforms without file watching
+    void add_changed(const char *name);
+
+    //render thread, once per frame, returns count of reloaded resources
+    int update();
+
+public:
+    bool is_busy(); //reading changed files
+
+    struct stats
+    {
+        int reloaded_count;
+        int failed_count;
+        int batches_count;
+    };
+
+    const stats &get_stats() const { return m_stats; }
+
+public:
+    hot_reload(): m_watched(0),m_pending_reads(0),m_provider(0) { m_stats.reloaded_count=m_stats.failed_count=m_stats.batches_count=0; m_preloaded.r=this; }
+    ~hot_reload() { stop(); }
+
+private:
+    enum resource_type
+    {
+        type_file, //read for other resources, like shader includes
+        type_texture,
+        type_shader,
+        type_material,
+        type_mesh,
+        type_animation,
+        type_location
+    };
+
+    class read_task: public nya_memory::thread_pool::task
+    {
+    public:
+        void run() { r->read(idx); }
+
+    public:
+        hot_reload *r;
+        int idx;
+    };
+
+    struct entry
+    {
+        resource_type type;
+        std::string name; //shared resource name
+        std::string path; //as the file was reported or listed by the provider
+        nya_memory::tmp_buffer_ref data;
+        bool read;
+        read_task task;
+    };
+
+    class preloaded_provider: public nya_resources::resources_provider
+    {
+    public:
+        nya_resources::resource_data *access(const char *resource_name);
+        bool has(const char *resource_name);
+        int get_resources_count();
+        const char *get_resource_name(int idx);
+
+    public:
+        hot_reload *r;
+    };
+
+private:
+    void start_batch();
+    void read(int idx);
+    int reload_batch();
+    int find_entry(const char *name);
+
+private:
+    nya_resources::file_resources_provider *m_watched;
+    std::vector<std::string> m_changed;
+    std::vector<entry> m_batch;
+    int m_pending_reads;
+    nya_memory::mutex m_mutex;
+    nya_memory::condition_variable m_reads_cond; //signaled when a batch read finishes
+
+    nya_resources::resources_provider *m_provider;
+    preloaded_provider m_preloaded;
+    stats m_stats;
+};
+
+}
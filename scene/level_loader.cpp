@@ -0,0 +1,673 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "level_loader.h"
+#include "scene.h"
+#include "formats/text_parser.h"
+#include "formats/nms.h"
+#include "resources/memory_resources_provider.h"
+#include <algorithm>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/time.h>
+#endif
+
+namespace nya_scene
+{
+
+namespace
+{
+    unsigned long long get_time_us()
+    {
+#ifdef _WIN32
+        static LARGE_INTEGER freq;
+        static bool initialised=false;
+        if(!initialised)
+        {
+            QueryPerformanceFrequency(&freq);
+            initialised=true;
+        }
+
+        LARGE_INTEGER time;
+        QueryPerformanceCounter(&time);
+
+        return (unsigned long long)(time.QuadPart*1000000/freq.QuadPart);
+#else
+        timeval tim;
+        gettimeofday(&tim,0);
+        return (unsigned long long)tim.tv_sec*1000000+tim.tv_usec;
+#endif
+    }
+
+    //small stable thread indices for the trace, the render thread registers first in start()
+    int get_thread_idx()
+    {
+        static nya_memory::mutex mutex;
+        static std::vector<nya_memory::thread_id> ids;
+
+        const nya_memory::thread_id id=nya_memory::thread_id::current();
+        nya_memory::lock_guard lock(mutex);
+        for(size_t i=0;i<ids.size();++i)
+        {
+            if(ids[i]==id)
+                return int(i);
+        }
+
+        ids.push_back(id);
+        return int(ids.size())-1;
+    }
+
+    const char *get_type_name(level_loader::resource_type type)
+    {
+        switch(type)
+        {
+            case level_loader::type_location: return "location";
+            case level_loader::type_mesh: return "mesh";
+            case level_loader::type_material: return "material";
+            case level_loader::type_shader: return "shader";
+            case level_loader::type_shader_include: return "shader include";
+            case level_loader::type_texture: return "texture";
+            case level_loader::type_animation: return "animation";
+        }
+
+        return "";
+    }
+
+    std::string get_path(level_loader::resource_type type,const char *name)
+    {
+        switch(type)
+        {
+            case level_loader::type_location: return std::string(location::get_resources_prefix())+name;
+            case level_loader::type_mesh: return std::string(mesh_internal::get_resources_prefix())+name;
+            case level_loader::type_material: return std::string(material_internal::get_resources_prefix())+name;
+            case level_loader::type_shader: return std::string(shader_internal::get_resources_prefix())+name;
+            case level_loader::type_shader_include: return name; //already a full path
+            case level_loader::type_texture: return std::string(texture_internal::get_resources_prefix())+name;
+            case level_loader::type_animation: return std::string(animation::get_resources_prefix())+name;
+        }
+
+        return name;
+    }
+
+    bool read_resource(nya_resources::resources_provider &provider,const std::string &name,nya_memory::tmp_buffer_ref &buf)
+    {
+        nya_resources::resource_data *data=provider.access(name.c_str());
+        if(!data)
+            return false;
+
+        buf.allocate(data->get_size());
+        const bool result=!buf.get_size() || data->read_all(buf.get_data());
+        data->release();
+        if(!result)
+            buf.free();
+        return result;
+    }
+
+    typedef std::vector<std::pair<level_loader::resource_type,std::string> > deps_list;
+
+    void get_location_deps(nya_memory::tmp_buffer_ref &data,const char *name,deps_list &deps)
+    {
+        shared_location l;
+        if(!location::load_text(l,data,name))
+            return;
+
+        for(size_t i=0;i<l.meshes.size();++i)
+        {
+            if(!l.meshes[i].name.empty())
+                deps.push_back(std::make_pair(level_loader::type_mesh,l.meshes[i].name));
+        }
+    }
+
+    //other mesh formats are read ahead, but their dependencies are loaded when the mesh is created
+    void get_mesh_deps(const nya_memory::tmp_buffer_ref &data,deps_list &deps)
+    {
+        if(data.get_size()<8 || memcmp(data.get_data(),"nya mesh",8)!=0)
+            return;
+
+        nya_formats::nms m;
+        if(!m.read_chunks_info(data.get_data(),data.get_size()))
+            return;
+
+        for(size_t i=0;i<m.chunks.size();++i)
+        {
+            if(m.chunks[i].type!=nya_formats::nms::materials)
+                continue;
+
+            nya_formats::nms_material_chunk c;
+            if(!c.read(m.chunks[i].data,m.chunks[i].size,m.version))
+                continue;
+
+            for(size_t j=0;j<c.materials.size();++j)
+            {
+                const nya_formats::nms_material_chunk::material_info &mi=c.materials[j];
+                for(size_t k=0;k<mi.strings.size();++k)
+                {
+                    if(mi.strings[k].name=="nya_material")
+                        deps.push_back(std::make_pair(level_loader::type_material,mi.strings[k].value));
+                    else if(mi.strings[k].name=="nya_shader")
+                        deps.push_back(std::make_pair(level_loader::type_shader,mi.strings[k].value));
+                }
+
+                for(size_t k=0;k<mi.textures.size();++k)
+                    deps.push_back(std::make_pair(level_loader::type_texture,mi.textures[k].filename));
+            }
+        }
+    }
+
+    void get_material_deps(const nya_memory::tmp_buffer_ref &data,deps_list &deps)
+    {
+        nya_formats::text_parser parser;
+        parse_text(parser,(const char *)data.get_data(),data.get_size());
+        for(int section_idx=0;section_idx<parser.get_sections_count();++section_idx)
+        {
+            const char *type=parser.get_section_type(section_idx);
+            if(strcmp(type,"@texture")==0)
+            {
+                deps.push_back(std::make_pair(level_loader::type_texture,std::string(parser.get_section_value(section_idx))));
+                continue;
+            }
+
+            if(strcmp(type,"@pass")!=0)
+                continue;
+
+            for(int subsection_idx=0;subsection_idx<parser.get_subsections_count(section_idx);++subsection_idx)
+            {
+                if(strcmp(parser.get_subsection_type(section_idx,subsection_idx),"shader")==0)
+                    deps.push_back(std::make_pair(level_loader::type_shader,std::string(parser.get_subsection_value(section_idx,subsection_idx))));
+            }
+        }
+    }
+
+    //includes are relative to the including file, as in shader loading
+    void get_shader_deps(const nya_memory::tmp_buffer_ref &data,const std::string &path,deps_list &deps)
+    {
+        nya_formats::text_parser parser;
+        parse_text(parser,(const char *)data.get_data(),data.get_size());
+
+        std::string folder(path);
+        size_t p=folder.rfind("/");
+        if(p==std::string::npos)
+            p=folder.rfind("\\");
+        folder.resize(p==std::string::npos?0:p+1);
+
+        for(int section_idx=0;section_idx<parser.get_sections_count();++section_idx)
+        {
+            if(!parser.is_section_type(section_idx,"include"))
+                continue;
+
+            const char *file=parser.get_section_name(section_idx);
+            if(file && file[0])
+                deps.push_back(std::make_pair(level_loader::type_shader_include,folder+file));
+        }
+    }
+}
+
+bool level_loader::start(const char *location_name)
+{
+    std::map<std::string,int> priorities;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        priorities.swap(m_priorities);
+    }
+
+    release();
+    m_priorities.swap(priorities);
+
+    if(!location_name || !location_name[0])
+        return false;
+
+    m_provider=&nya_resources::get_resources_provider();
+    m_start_time=get_time_us();
+    get_thread_idx(); //render thread gets index 0
+
+    std::vector<int> to_read;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        add_node(type_location,location_name,0,to_read);
+    }
+
+    schedule(to_read);
+    return true;
+}
+
+void level_loader::add(resource_type type,const char *name)
+{
+    if(!name || !name[0] || type==type_location || !m_provider)
+        return;
+
+    std::vector<int> to_read;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        add_node(type,name,0,to_read);
+    }
+
+    schedule(to_read);
+}
+
+void level_loader::set_priority(resource_type type,const char *name,int priority)
+{
+    if(!name)
+        return;
+
+    const std::string key=std::string(get_type_name(type))+":"+get_path(type,name);
+
+    nya_memory::lock_guard lock(m_mutex);
+    m_priorities[key]=priority;
+
+    std::map<std::string,int>::const_iterator it=m_nodes_map.find(key);
+    if(it!=m_nodes_map.end())
+        set_priority(it->second,priority);
+}
+
+void level_loader::set_priority(int idx,int priority)
+{
+    node &n=m_nodes[idx];
+    if(n.priority>=priority)
+        return;
+
+    n.priority=priority;
+    for(size_t i=0;i<n.deps.size();++i)
+        set_priority(n.deps[i],priority);
+}
+
+int level_loader::add_node(resource_type type,const char *name,int priority,std::vector<int> &to_read)
+{
+    const std::string path=get_path(type,name);
+    const std::string key=std::string(get_type_name(type))+":"+path;
+
+    std::map<std::string,int>::const_iterator it=m_nodes_map.find(key);
+    if(it!=m_nodes_map.end())
+    {
+        set_priority(it->second,priority);
+        return it->second;
+    }
+
+    std::map<std::string,int>::const_iterator p=m_priorities.find(key);
+    if(p!=m_priorities.end() && p->second>priority)
+        priority=p->second;
+
+    const int idx=(int)m_nodes.size();
+    m_nodes.resize(m_nodes.size()+1);
+    node &n=m_nodes.back();
+    n.type=type;
+    n.name=name;
+    n.path=path;
+    n.priority=priority;
+    n.state=state_reading;
+    n.forced=false;
+    n.task.l=this;
+    n.task.idx=idx;
+    m_nodes_map[key]=idx;
+    ++m_pending_reads;
+    to_read.push_back(idx);
+    return idx;
+}
+
+void level_loader::schedule(const std::vector<int> &to_read)
+{
+    for(size_t i=0;i<to_read.size();++i)
+    {
+        read_task *t;
+        {
+            nya_memory::lock_guard lock(m_mutex);
+            t=&m_nodes[to_read[i]].task;
+        }
+
+        nya_memory::thread_pool::get().add_task(t);
+    }
+}
+
+void level_loader::read(int idx)
+{
+    node *n;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        n=&m_nodes[idx]; //deque keeps references valid, node fields are only changed by this task until it's read
+
+        //resumed from update() when created resources free their data
+        if(m_preload_limit && m_preloaded_size>=m_preload_limit && !n->forced)
+        {
+            m_deferred.push_back(idx);
+            m_reads_cond.notify_all();
+            return;
+        }
+    }
+
+    const unsigned long long read_start=get_time_us();
+    const bool result=read_resource(get_provider(),n->path,n->data);
+    add_trace(n->path,"read",(unsigned int)(read_start-m_start_time));
+
+    deps_list deps;
+    if(result)
+    {
+        const unsigned long long parse_start=get_time_us();
+        switch(n->type)
+        {
+            case type_location: get_location_deps(n->data,n->path.c_str(),deps); break;
+            case type_mesh: get_mesh_deps(n->data,deps); break;
+            case type_material: get_material_deps(n->data,deps); break;
+            case type_shader:
+            case type_shader_include: get_shader_deps(n->data,n->path,deps); break;
+            default: break;
+        }
+
+        if(!deps.empty())
+            add_trace(n->path,"parse",(unsigned int)(parse_start-m_start_time));
+    }
+    else
+        log()<<"level loader: unable to read "<<get_type_name(n->type)<<" "<<n->path.c_str()<<"\n";
+
+    std::vector<int> to_read;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        for(size_t i=0;i<deps.size();++i)
+        {
+            if(deps[i].second.empty())
+                continue;
+
+            const int dep=add_node(deps[i].first,deps[i].second.c_str(),n->priority,to_read);
+            if(std::find(n->deps.begin(),n->deps.end(),dep)==n->deps.end())
+                n->deps.push_back(dep);
+        }
+
+        n->state=result?state_read:state_failed;
+        if(result)
+        {
+            m_paths_map[n->path]=idx;
+            m_preloaded_size+=n->data.get_size();
+            ++m_read_count;
+        }
+        --m_pending_reads;
+        m_reads_cond.notify_all();
+    }
+
+    schedule(to_read);
+}
+
+bool level_loader::update(unsigned int time_limit_ms)
+{
+    if(!m_provider)
+        return true;
+
+    const unsigned long long time_limit_end=get_time_us()+(unsigned long long)time_limit_ms*1000;
+
+    //provider may be changed between updates, reads and fallbacks use the current one
+    nya_resources::resources_provider *provider=&nya_resources::get_resources_provider();
+    if(provider!=&m_preloaded)
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        m_provider=provider;
+    }
+
+    //scene resources read files through the provider, served from preloaded data
+    nya_resources::set_resources_provider(&m_preloaded);
+
+    bool time_is_up=false;
+    while(!time_is_up)
+    {
+        std::vector<std::pair<int,int> > ready,waiting;
+        {
+            nya_memory::lock_guard lock(m_mutex);
+            for(int i=0;i<(int)m_nodes.size();++i)
+            {
+                const node &n=m_nodes[i];
+                if(n.state!=state_read)
+                    continue;
+
+                bool deps_ready=true;
+                for(size_t j=0;j<n.deps.size() && deps_ready;++j)
+                    deps_ready=m_nodes[n.deps[j]].state>=state_created;
+
+                (deps_ready?ready:waiting).push_back(std::make_pair(-n.priority,i));
+            }
+
+            //dependency cycles, like shaders including each other, are created in any order
+            if(ready.empty() && !m_pending_reads)
+                ready.swap(waiting);
+        }
+
+        if(ready.empty())
+        {
+            //preloaded data waits for deferred dependencies, read them over the limit
+            std::vector<int> to_read;
+            {
+                nya_memory::lock_guard lock(m_mutex);
+                if(m_pending_reads>0 && m_pending_reads==(int)m_deferred.size())
+                {
+                    for(size_t i=0;i<m_deferred.size();++i)
+                        m_nodes[m_deferred[i]].forced=true;
+                    to_read.swap(m_deferred);
+                }
+            }
+
+            schedule(to_read);
+            break;
+        }
+
+        std::sort(ready.begin(),ready.end());
+        for(size_t i=0;i<ready.size();++i)
+        {
+            node *n;
+            {
+                nya_memory::lock_guard lock(m_mutex);
+                n=&m_nodes[ready[i].second];
+            }
+
+            create(*n);
+
+            if(time_limit_ms && get_time_us()>=time_limit_end)
+            {
+                time_is_up=true;
+                break;
+            }
+        }
+    }
+
+    nya_resources::set_resources_provider(provider);
+
+    std::vector<int> to_read;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        if(m_preloaded_size<m_preload_limit)
+            to_read.swap(m_deferred);
+    }
+
+    schedule(to_read);
+    return is_ready();
+}
+
+void level_loader::create(node &n)
+{
+    const unsigned long long start=get_time_us();
+    const char *name=n.name.c_str();
+    switch(n.type)
+    {
+        case type_location: m_location.load(name); break;
+        case type_mesh: m_meshes.resize(m_meshes.size()+1); m_meshes.back().load(name); break;
+        case type_material: m_materials.resize(m_materials.size()+1); m_materials.back().load(name); break;
+        case type_shader: m_shaders.resize(m_shaders.size()+1); m_shaders.back().load(name); break;
+        case type_texture: m_textures.resize(m_textures.size()+1); m_textures.back().load(name); break;
+        case type_animation: m_animations.resize(m_animations.size()+1); m_animations.back().load(name); break;
+        case type_shader_include: break; //consumed by shaders
+    }
+
+    if(n.type!=type_shader_include)
+        add_trace(n.path,"create",(unsigned int)(start-m_start_time));
+
+    nya_memory::lock_guard lock(m_mutex);
+    n.state=state_created;
+    ++m_created_count;
+    if(n.type!=type_shader_include)
+    {
+        m_paths_map.erase(n.path);
+        m_preloaded_size-=n.data.get_size();
+        n.data.free();
+    }
+}
+
+nya_resources::resources_provider &level_loader::get_provider()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    return *m_provider;
+}
+
+void level_loader::finish()
+{
+    while(!update())
+        wait_reads();
+}
+
+void level_loader::wait_reads()
+{
+    //deferred reads are counted as pending but aren't queued until update() resumes them
+    nya_memory::lock_guard lock(m_mutex);
+    while(m_pending_reads>(int)m_deferred.size())
+        m_reads_cond.wait(m_mutex);
+}
+
+void level_loader::release()
+{
+    wait_reads();
+
+    m_location.unload();
+    m_meshes.clear();
+    m_materials.clear();
+    m_shaders.clear();
+    m_textures.clear();
+    m_animations.clear();
+
+    nya_memory::lock_guard lock(m_mutex);
+    for(size_t i=0;i<m_nodes.size();++i)
+        m_nodes[i].data.free();
+    m_nodes.clear();
+    m_nodes_map.clear();
+    m_paths_map.clear();
+    m_priorities.clear();
+    m_deferred.clear();
+    m_trace.clear();
+    m_pending_reads=m_created_count=m_read_count=0;
+    m_preloaded_size=0;
+    m_provider=0;
+}
+
+bool level_loader::is_ready()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    if(m_pending_reads>0)
+        return false;
+
+    for(size_t i=0;i<m_nodes.size();++i)
+    {
+        if(m_nodes[i].state==state_read)
+            return false;
+    }
+
+    return true;
+}
+
+int level_loader::get_resources_count()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    return (int)m_nodes.size();
+}
+
+int level_loader::get_loaded_count()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    return m_created_count;
+}
+
+float level_loader::get_progress()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    if(m_nodes.empty())
+        return 1.0f;
+
+    int failed=0;
+    for(size_t i=0;i<m_nodes.size();++i)
+    {
+        if(m_nodes[i].state==state_failed)
+            ++failed;
+    }
+
+    return (m_read_count+m_created_count+failed*2)*0.5f/m_nodes.size();
+}
+
+void level_loader::add_trace(const std::string &name,const char *stage,unsigned int start_us)
+{
+    trace_event e;
+    e.name=name;
+    e.stage=stage;
+    e.thread=get_thread_idx();
+    e.start_us=start_us;
+    e.duration_us=(unsigned int)(get_time_us()-m_start_time)-start_us;
+
+    nya_memory::lock_guard lock(m_mutex);
+    m_trace.push_back(e);
+}
+
+void level_loader::get_trace(std::vector<trace_event> &events)
+{
+    nya_memory::lock_guard lock(m_mutex);
+    events=m_trace;
+}
+
+void level_loader::write_trace(nya_log::ostream_base &os)
+{
+    std::vector<trace_event> events;
+    get_trace(events);
+
+    os<<"{\"traceEvents\":[\n";
+    for(size_t i=0;i<events.size();++i)
+    {
+        std::string name=events[i].name;
+        for(size_t j=0;j<name.size();++j)
+        {
+            if(name[j]=='"' || name[j]=='\\')
+                name[j]='/';
+        }
+
+        os<<"{\"name\":\""<<name.c_str()<<"\",\"cat\":\""<<events[i].stage<<"\",\"ph\":\"X\",\"pid\":0,\"tid\":"<<events[i].thread;
+        os<<",\"ts\":"<<(int)events[i].start_us<<",\"dur\":"<<(int)events[i].duration_us<<"}"<<(i+1<events.size()?",\n":"\n");
+    }
+    os<<"]}\n";
+}
+
+nya_resources::resource_data *level_loader::preloaded_provider::access(const char *resource_name)
+{
+    if(!resource_name)
+        return 0;
+
+    {
+        nya_memory::lock_guard lock(l->m_mutex);
+        std::map<std::string,int>::const_iterator it=l->m_paths_map.find(resource_name);
+        if(it!=l->m_paths_map.end())
+        {
+            const nya_memory::tmp_buffer_ref &data=l->m_nodes[it->second].data;
+            return new nya_resources::memory_resource_data(data.get_data(),data.get_size());
+        }
+    }
+
+    return l->get_provider().access(resource_name);
+}
+
+bool level_loader::preloaded_provider::has(const char *resource_name)
+{
+    if(!resource_name)
+        return false;
+
+    {
+        nya_memory::lock_guard lock(l->m_mutex);
+        if(l->m_paths_map.find(resource_name)!=l->m_paths_map.end())
+            return true;
+    }
+
+    return l->get_provider().has(resource_name);
+}
+
+int level_loader::preloaded_provider::get_resources_count() { return l->get_provider().get_resources_count(); }
+const char *level_loader::preloaded_provider::get_resource_name(int idx) { return l->get_provider().get_resource_name(idx); }
+
+}
@@ -0,0 +1,168 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "location.h"
+#include "animation.h"
+#include "resources/resources.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
+#include "memory/tmp_buffer.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+namespace nya_scene
+{
+
+//loads a location with all resources it references
+//files are read and parsed on the shared thread pool, which discovers the dependency graph:
+//location -> meshes -> materials -> shaders and textures, shaders -> includes
+//resources are created on the render thread in update(), dependencies first, so every shared resource
+//is created once from memory and dependent ones only take references
+//loaded resources are held until release(), the location is accessible via get_location()
+class level_loader
+{
+public:
+    enum resource_type
+    {
+        type_location,
+        type_mesh,
+        type_material,
+        type_shader,
+        type_shader_include,
+        type_texture,
+        type_animation
+    };
+
+public:
+    bool start(const char *location_name);
+    void add(resource_type type,const char *name); //after start, resources not referenced by the location, like animations
+
+    //resources with higher priority are created first, their dependencies inherit it, 0 by default
+    //may be set before start
+    void set_priority(resource_type type,const char *name,int priority);
+
+    //render thread, creates ready resources until time_limit_ms is spent, 0 for no limit
+    //returns true when everything is loaded
+    bool update(unsigned int time_limit_ms=0);
+
+    //render thread, waits for background reads and creates all resources
+    void finish();
+
+    void release();
+
+    //limits memory held by files read ahead, 64mb by default, 0 for no limit
+    void set_preload_limit(size_t bytes) { m_preload_limit=bytes; }
+
+public:
+    bool is_ready();
+    int get_resources_count(); //grows while dependencies are discovered
+    int get_loaded_count();
+    float get_progress(); //read and created stages count as a half each
+
+    location &get_location() { return m_location; }
+
+public:
+    //read, parse and create stages of every resource, thread 0 is the render thread
+    struct trace_event
+    {
+        std::string name;
+        const char *stage;
+        int thread;
+        unsigned int start_us;
+        unsigned int duration_us;
+    };
+
+    void get_trace(std::vector<trace_event> &events);
+    void write_trace(nya_log::ostream_base &os); //chrome://tracing json
+
+public:
+    level_loader(): m_pending_reads(0),m_created_count(0),m_read_count(0),m_preloaded_size(0),
+                    m_preload_limit(64*1024*1024),m_provider(0),m_start_time(0) { m_preloaded.l=this; }
+    ~level_loader() { release(); }
+
+private:
+    class read_task: public nya_memory::thread_pool::task
+    {
+    public:
+        void run() { l->read(idx); }
+
+    public:
+        level_loader *l;
+        int idx;
+    };
+
+    enum node_state
+    {
+        state_reading,
+        state_read,
+        state_created,
+        state_failed
+    };
+
+    struct node
+    {
+        resource_type type;
+        std::string name;
+        std::string path; //with resources prefix, as scene_shared requests it
+        nya_memory::tmp_buffer_ref data;
+        std::vector<int> deps;
+        int priority;
+        node_state state;
+        bool forced; //read over the preload limit
+        read_task task;
+    };
+
+    class preloaded_provider: public nya_resources::resources_provider
+    {
+    public:
+        nya_resources::resource_data *access(const char *resource_name);
+        bool has(const char *resource_name);
+        int get_resources_count();
+        const char *get_resource_name(int idx);
+
+    public:
+        level_loader *l;
+    };
+
+private:
+    int add_node(resource_type type,const char *name,int priority,std::vector<int> &to_read);
+    void schedule(const std::vector<int> &to_read);
+    void read(int idx);
+    void create(node &n);
+    void set_priority(int idx,int priority);
+    void add_trace(const std::string &name,const char *stage,unsigned int start_us);
+    nya_resources::resources_provider &get_provider();
+    void wait_reads();
+
+private:
+    std::deque<node> m_nodes;
+    std::map<std::string,int> m_nodes_map;
+    std::map<std::string,int> m_paths_map;
+    std::map<std::string,int> m_priorities;
+    int m_pending_reads;
+    int m_created_count;
+    int m_read_count;
+    std::vector<int> m_deferred;
+    size_t m_preloaded_size;
+    size_t m_preload_limit;
+    nya_memory::mutex m_mutex;
+    nya_memory::condition_variable m_reads_cond; //signaled when a read finishes or is deferred
+
+    nya_resources::resources_provider *m_provider;
+    preloaded_provider m_preloaded;
+
+    std::vector<trace_event> m_trace;
+    unsigned long long m_start_time;
+
+    location m_location;
+    std::vector<mesh> m_meshes;
+    std::vector<material> m_materials;
+    std::vector<shader> m_shaders;
+    std::vector<texture> m_textures;
+    std::vector<animation> m_animations;
+};
+
+}
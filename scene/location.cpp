@@ -10,7 +10,7 @@ namespace nya_scene
 bool location::load_text(shared_location &res,resource_data &data,const char* name)
 {
     nya_formats::text_parser parser;
-    if(!parser.load_from_data((char *)data.get_data(),data.get_size()))
+    if(!parse_text(parser,(const char *)data.get_data(),data.get_size()))
         return false;
 
     tags local_tags;
@@ -4,7 +4,10 @@
 #include "formats/text_parser.h"
 #include "formats/string_convert.h"
 #include "memory/invalid_object.h"
+#include "memory/mutex.h"
 #include <list>
+#include <map>
+#include <atomic>
 #include <cstring>
 
 #ifdef _WIN32
@@ -43,6 +46,11 @@ namespace
         return false;
     }
 
+    unsigned int get_shader_version(const shader &sh)
+    {
+        return sh.internal().get_shared_data().is_valid()?sh.internal().get_shared_data()->version:0;
+    }
+
     unsigned long get_time()
     {
 #ifdef _WIN32
@@ -161,7 +169,7 @@ void material_internal::skeleton_changed(const nya_render::skeleton *skeleton) c
 bool material::load_text(shared_material &res,resource_data &data,const char* name)
 {
     nya_formats::text_parser parser;
-    parser.load_from_data((const char *)data.get_data(),data.get_size());
+    parse_text(parser,(const char *)data.get_data(),data.get_size());
     for(int section_idx=0;section_idx<parser.get_sections_count();++section_idx)
     {
         const char *section_type=parser.get_section_type(section_idx);
@@ -169,6 +177,7 @@ bool material::load_text(shared_material &res,resource_data &data,const char* na
         {
             int pass_idx = res.add_pass(parser.get_section_name(section_idx));
             pass &p = res.get_pass(pass_idx);
+            const char *features=0;
 
             for(int subsection_idx=0;subsection_idx<parser.get_subsections_count(section_idx);++subsection_idx)
             {
@@ -213,8 +222,17 @@ bool material::load_text(shared_material &res,resource_data &data,const char* na
                     continue;
                 }
 
+                if(strcmp(subsection_type,"features")==0)
+                {
+                    features=subsection_value; //applied when shader is known
+                    continue;
+                }
+
                 p.set_pass_param(subsection_type,param(nya_formats::vec4_from_string(subsection_value)));
             }
+
+            if(features)
+                p.set_shader_features(features);
         }
         else if(strcmp(section_type,"@texture")==0)
         {
@@ -256,15 +274,142 @@ bool material::load_text(shared_material &res,resource_data &data,const char* na
     return true;
 }
 
+namespace
+{
+    //materials may be loaded outside of the render thread
+    //names are never removed, so lookups are lock-free: writers are serialized and publish slots with release stores
+    class pass_ids
+    {
+    public:
+        int find(const char *pass_name)
+        {
+            for(unsigned int i=hash(pass_name);;i=(i+1)%slots_count)
+            {
+                const name *n=m_slots[i].load(std::memory_order_acquire);
+                if(!n)
+                    break;
+
+                if(n->str==pass_name)
+                    return n->id;
+            }
+
+            if(!m_has_overflow.load(std::memory_order_acquire))
+                return -1;
+
+            nya_memory::lock_guard lock(m_mutex);
+            std::map<std::string,int>::const_iterator it=m_overflow.find(pass_name);
+            return it!=m_overflow.end()?it->second:-1;
+        }
+
+        int add(const char *pass_name)
+        {
+            nya_memory::lock_guard lock(m_mutex);
+            return add_locked(pass_name);
+        }
+
+        pass_ids(): m_count(0),m_has_overflow(false)
+        {
+            for(unsigned int i=0;i<slots_count;++i)
+                m_slots[i].store(0,std::memory_order_relaxed);
+            add_locked(material::default_pass);
+        }
+
+        ~pass_ids()
+        {
+            for(unsigned int i=0;i<slots_count;++i)
+                delete m_slots[i].load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct name { std::string str; int id; };
+
+        static unsigned int hash(const char *str)
+        {
+            unsigned int h=2166136261u;
+            while(*str)
+                h=(h^(unsigned char)*str++)*16777619u;
+            return h%slots_count;
+        }
+
+        int add_locked(const char *pass_name)
+        {
+            unsigned int i=hash(pass_name);
+            for(const name *n;(n=m_slots[i].load(std::memory_order_relaxed));i=(i+1)%slots_count)
+            {
+                if(n->str==pass_name)
+                    return n->id;
+            }
+
+            std::map<std::string,int>::const_iterator it=m_overflow.find(pass_name);
+            if(it!=m_overflow.end())
+                return it->second;
+
+            name *n=new name();
+            n->str=pass_name;
+            n->id=m_count++;
+
+            //probing stays short while the table is mostly empty
+            if(m_count<=int(slots_count*3/4))
+            {
+                m_slots[i].store(n,std::memory_order_release);
+                return n->id;
+            }
+
+            const int id=n->id;
+            delete n;
+            m_overflow[pass_name]=id;
+            m_has_overflow.store(true,std::memory_order_release);
+            return id;
+        }
+
+    private:
+        static const unsigned int slots_count=1024;
+        std::atomic<const name *> m_slots[slots_count];
+        int m_count;
+        std::map<std::string,int> m_overflow;
+        std::atomic<bool> m_has_overflow;
+        nya_memory::mutex m_mutex;
+    };
+
+    pass_ids &get_pass_ids()
+    {
+        static pass_ids ids;
+        return ids;
+    }
+}
+
+int material_internal::get_pass_id(const char *pass_name)
+{
+    if(!pass_name)
+        return -1;
+
+    pass_ids &p=get_pass_ids();
+    const int id=p.find(pass_name);
+    return id>=0?id:p.add(pass_name);
+}
+
+int material_internal::find_pass_id(const char *pass_name)
+{
+    if(!pass_name)
+        return -1;
+
+    return get_pass_ids().find(pass_name);
+}
+
 void material_internal::set(const char *pass_name) const
 {
     if(!pass_name)
         return;
 
+    set_pass_id(find_pass_id(pass_name));
+}
+
+void material_internal::set_pass_id(int pass_id) const
+{
     if(m_last_set_pass_idx>=0)
         unset();
 
-    m_last_set_pass_idx=get_pass_idx(pass_name);
+    m_last_set_pass_idx=get_pass_idx_by_id(pass_id);
     if(m_last_set_pass_idx<0)
         return;
 
@@ -376,6 +521,7 @@ int material_internal::get_texture_idx(const char *semantics) const
 material_internal::pass &material_internal::pass::operator=(const pass &p)
 {
     m_name=p.m_name;
+    m_id=p.m_id;
     m_render_state=p.m_render_state;
     m_shader=p.m_shader;
     m_pass_params=p.m_pass_params;
@@ -394,6 +540,15 @@ void material_internal::pass::set_shader(const shader &shader)
     update_pass_params();
 }
 
+bool material_internal::pass::set_shader_features(const char *keys)
+{
+    const bool result=m_shader.set_features(keys);
+    m_shader_changed=true;
+    m_uniforms_idxs_map.clear();
+    m_textures_slots_map.clear();
+    return result;
+}
+
 void material_internal::pass::set_pass_param(const char *name,const param &value)
 {
     if(!name)
@@ -437,6 +592,7 @@ void material_internal::pass::update_pass_params()
 
 void material_internal::pass::update_maps(const material_internal &m) const
 {
+    m_shader_version=get_shader_version(m_shader);
     m_uniforms_idxs_map.resize(m_shader.internal().get_uniforms_count());
     std::fill(m_uniforms_idxs_map.begin(),m_uniforms_idxs_map.end(),0); // params should exists if idxs_map was rebuild properly
     for(int uniform_idx=0;uniform_idx<m_shader.internal().get_uniforms_count();++uniform_idx)
@@ -487,19 +643,21 @@ int material_internal::add_pass(const char *pass_name)
 
     m_passes.push_back(pass());
     m_passes.back().m_name.assign(pass_name);
+    m_passes.back().m_id=get_pass_id(pass_name);
+    update_pass_ids_map();
     return (int)m_passes.size()-1;
 }
 
-int material_internal::get_pass_idx(const char *pass_name) const
+void material_internal::update_pass_ids_map()
 {
-    if(!pass_name)
-        return -1;
-
+    m_pass_ids_map.clear();
     for(int i=0;i<(int)m_passes.size();++i)
-        if(m_passes[i].m_name == pass_name)
-            return i;
-
-    return -1;
+    {
+        const int id=m_passes[i].m_id;
+        if(id>=(int)m_pass_ids_map.size())
+            m_pass_ids_map.resize(id+1,-1);
+        m_pass_ids_map[id]=(short)i;
+    }
 }
 
 material_internal::pass &material_internal::get_pass(int idx)
@@ -525,6 +683,7 @@ void material_internal::remove_pass(const char *pass_name)
         return;
 
     m_passes.erase(m_passes.begin()+idx);
+    update_pass_ids_map();
     m_should_rebuild_passes_maps = true;
 }
 
@@ -534,7 +693,7 @@ void material_internal::update_passes_maps() const
     {
         for(std::vector<pass>::const_iterator it=m_passes.begin();it!=m_passes.end();++it)
         {
-            if(it->m_shader_changed)
+            if(it->m_shader_changed || it->m_shader_version!=get_shader_version(it->m_shader))
             {
                 m_should_rebuild_passes_maps=true;
                 break;
@@ -659,6 +818,7 @@ void material_internal::update_passes_maps() const
 bool material_internal::release()
 {
     m_passes.clear();
+    m_pass_ids_map.clear();
     m_textures.clear();
     m_params.clear();
     m_name.clear();
@@ -683,6 +843,7 @@ bool material::load(const char *name)
 
     m_internal.m_name=m_internal.m_shared->m_name;
     m_internal.m_passes=m_internal.m_shared->m_passes;
+    m_internal.m_pass_ids_map=m_internal.m_shared->m_pass_ids_map;
     m_internal.m_params=m_internal.m_shared->m_params;
     m_internal.m_textures=m_internal.m_shared->m_textures;
 
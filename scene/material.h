@@ -18,8 +18,14 @@ class material_internal: public scene_shared<shared_material>
 public:
     static const char *default_pass;
 
+public:
+    //pass names are interned to small ids shared by all materials, default pass is 0, lookups are lock-free
+    static int get_pass_id(const char *pass_name); //-1 if null, interns unknown names
+    static int find_pass_id(const char *pass_name); //-1 if null or not interned
+
 public:
     void set(const char *pass_name=default_pass) const;
+    void set_pass_id(int pass_id) const;
     void unset() const;
     void skeleton_changed(const nya_render::skeleton *skeleton) const;
     int get_param_idx(const char *name) const;
@@ -76,10 +82,11 @@ private:
         const nya_render::state &get_state() const {return m_render_state;}
         const shader &get_shader() const {return m_shader;}
         void set_shader(const shader &shader);
+        bool set_shader_features(const char *keys); //see shader::set_features
         void set_pass_param(const char *name,const param &value); //overrides material param
 
     public:
-        pass(): m_shader_changed(false) { }
+        pass(): m_id(-1),m_shader_changed(false),m_shader_version(0) { }
         pass(const pass &p) { *this=p; }
         pass &operator=(const pass &p);
 
@@ -90,9 +97,11 @@ private:
         void update_pass_params();
 
         std::string m_name;
+        int m_id;
         nya_render::state m_render_state;
         shader m_shader;
         mutable bool m_shader_changed;
+        mutable unsigned int m_shader_version;
         mutable std::vector<int> m_uniforms_idxs_map;
         mutable std::vector<int> m_textures_slots_map;
 
@@ -109,15 +118,21 @@ private:
     };
 
     int add_pass(const char *pass_name);
-    int get_pass_idx(const char *pass_name) const;
+    int get_pass_idx(const char *pass_name) const { return get_pass_idx_by_id(find_pass_id(pass_name)); }
+    int get_pass_idx_by_id(int pass_id) const
+    {
+        return pass_id>=0 && pass_id<(int)m_pass_ids_map.size()?m_pass_ids_map[pass_id]:-1;
+    }
     pass &get_pass(int idx);
     const pass &get_pass(int idx) const;
     void remove_pass(const char *pass_name);
     void update_passes_maps() const;
+    void update_pass_ids_map();
 
 private:
     std::string m_name;
     std::vector<pass> m_passes;
+    std::vector<short> m_pass_ids_map; //pass id -> index in m_passes or -1
     mutable int m_last_set_pass_idx;
     mutable bool m_should_rebuild_passes_maps;
     mutable std::vector<param_holder> m_params;
@@ -145,6 +160,8 @@ public:
     int add_pass(const char *pass_name) { return m_internal.add_pass(pass_name); } //returns existing if already present
     int get_passes_count() const {return (int)m_internal.m_passes.size();}
     int get_pass_idx(const char *pass_name) const { return m_internal.get_pass_idx(pass_name); }
+    int get_pass_idx_by_id(int pass_id) const { return m_internal.get_pass_idx_by_id(pass_id); }
+    static int get_pass_id(const char *pass_name) { return material_internal::get_pass_id(pass_name); }
     const char *get_pass_name(int idx) const { return m_internal.m_passes[idx].m_name.c_str(); }
     pass &get_pass(const char *pass_name) { return m_internal.get_pass(m_internal.get_pass_idx(pass_name)); }
     const pass &get_pass(const char *pass_name) const { return m_internal.get_pass(m_internal.get_pass_idx(pass_name)); }
@@ -9,9 +9,11 @@
 #include "formats/nms.h"
 #include "mesh.h"
 #include "render/render.h"
+#include "render/mesh_optimize.h"
 #include "scene.h"
 #include "shader.h"
 #include <stdint.h>
+#include <stdlib.h>
 
 namespace nya_scene
 {
@@ -29,6 +31,54 @@ material::pass &material_default_pass(material &m)
 }
 
 bool frustum_cull_enabled=true;
+bool vertex_compression_enabled=false;
+nya_render::vertex_compression vertex_compression_params;
+bool mesh_optimization_enabled=false;
+bool lods_enabled=false;
+float lod_hysteresis=0.1f;
+float lod_screen_size_scale=1.0f;
+const float lod_default_screen_size=256.0f; //halves with each next lod if not set in the file
+
+void read_group(const nya_formats::nms_mesh_chunk::group &from,shared_mesh::group &to)
+{
+    to.name=from.name;
+
+    to.aabb=nya_math::aabb(from.aabb_min,from.aabb_max);
+
+    to.material_idx=from.material_idx;
+    to.offset=from.offset;
+    to.count=from.count;
+
+    to.elem_type=nya_render::vbo::element_type(from.element_type);
+}
+
+template<typename t> void optimize_mesh(const nya_formats::nms_mesh_chunk &c,std::vector<char> &verts,t *indices)
+{
+    const nya_formats::nms_mesh_chunk::element *pos=0;
+    for(size_t i=0;i<c.elements.size();++i)
+    {
+        const nya_formats::nms_mesh_chunk::element &e=c.elements[i];
+        if(e.type==nya_formats::nms_mesh_chunk::pos && e.data_type==nya_formats::nms_mesh_chunk::float32 &&
+           e.dimension>=3 && e.offset+3*sizeof(float)<=c.vertex_stride)
+            pos=&e;
+    }
+
+    for(size_t i=0;i<c.lods.size();++i)
+    {
+        for(size_t j=0;j<c.lods[i].groups.size();++j)
+        {
+            const nya_formats::nms_mesh_chunk::group &g=c.lods[i].groups[j];
+            if(g.element_type!=nya_formats::nms_mesh_chunk::triangles || g.offset+g.count>c.indices_count)
+                continue;
+
+            nya_render::optimize_vertex_cache(indices+g.offset,g.count,c.verts_count);
+            if(pos)
+                nya_render::optimize_overdraw(indices+g.offset,g.count,&verts[pos->offset],c.vertex_stride,c.verts_count);
+        }
+    }
+
+    nya_render::optimize_vertex_fetch(&verts[0],c.vertex_stride,c.verts_count,indices,c.indices_count);
+}
 
 }
 
@@ -43,20 +93,54 @@ bool mesh::load_nms_mesh_section(shared_mesh &res,const void *data,size_t size,i
 
     res.aabb=nya_math::aabb(c.aabb_min,c.aabb_max);
 
+    nya_render::vbo::layout layout;
+    nya_render::vertex_compression::hint tc_hints[nya_render::vbo::max_tex_coord];
+    for(unsigned int i=0;i<nya_render::vbo::max_tex_coord;++i)
+        tc_hints[i]=vertex_compression_params.tc_hints[i];
+
     for(size_t i=0;i<c.elements.size();++i)
     {
         const nya_formats::nms_mesh_chunk::element &e=c.elements[i];
-        const nya_render::vbo::vertex_atrib_type type=nya_render::vbo::vertex_atrib_type(e.data_type);
+        nya_render::vbo::layout::attribute a;
+        a.offset=e.offset;
+        a.dimension=e.dimension;
+        a.type=nya_render::vbo::vertex_atrib_type(e.data_type);
         switch(e.type)
         {
-            case nya_formats::nms_mesh_chunk::pos: res.vbo.set_vertices(e.offset,e.dimension,type); break;
-            case nya_formats::nms_mesh_chunk::normal: res.vbo.set_normals(e.offset,type); break;
-            case nya_formats::nms_mesh_chunk::color: res.vbo.set_colors(e.offset,e.dimension,type); break;
-            default: res.vbo.set_tc(e.type-nya_formats::nms_mesh_chunk::tc0,e.offset,e.dimension,type); break;
+            case nya_formats::nms_mesh_chunk::pos: layout.pos=a; break;
+            case nya_formats::nms_mesh_chunk::normal: a.dimension=3; layout.normal=a; break;
+            case nya_formats::nms_mesh_chunk::color: layout.color=a; break;
+            default:
+            {
+                const unsigned int tc_idx=e.type-nya_formats::nms_mesh_chunk::tc0;
+                if(tc_idx>=nya_render::vbo::max_tex_coord)
+                    break;
+
+                layout.tc[tc_idx]=a;
+                if(e.semantics=="bone_idx")
+                    tc_hints[tc_idx]=nya_render::vertex_compression::hint_indices;
+                else if(e.semantics=="bone_weight")
+                    tc_hints[tc_idx]=nya_render::vertex_compression::hint_weights;
+            }
+            break;
         };
     }
 
-    res.vbo.set_vertex_data(c.vertices_data,c.vertex_stride,c.verts_count);
+    std::vector<char> verts,indices;
+    if(mesh_optimization_enabled && c.verts_count>0 && c.indices_count>0 && (c.index_size==2 || c.index_size==4))
+    {
+        verts.assign((const char *)c.vertices_data,(const char *)c.vertices_data+size_t(c.vertex_stride)*c.verts_count);
+        indices.assign((const char *)c.indices_data,(const char *)c.indices_data+size_t(c.index_size)*c.indices_count);
+        if(c.index_size==2)
+            optimize_mesh(c,verts,(unsigned short *)&indices[0]);
+        else
+            optimize_mesh(c,verts,(unsigned int *)&indices[0]);
+
+        c.vertices_data=&verts[0];
+        c.indices_data=&indices[0];
+    }
+
+    set_vertex_data(res.vbo,c.vertices_data,c.vertex_stride,c.verts_count,layout,tc_hints);
 
     switch(c.index_size)
     {
@@ -66,26 +150,23 @@ bool mesh::load_nms_mesh_section(shared_mesh &res,const void *data,size_t size,i
         default: log()<<"nms load warning: invalid index size\n"; return false;
     }
 
+    res.lods.clear();
     for(size_t i=0;i<c.lods.size();++i)
     {
-        res.groups.resize(c.lods[i].groups.size());
-        for(size_t j=0;j<res.groups.size();++j)
+        const std::vector<nya_formats::nms_mesh_chunk::group> &from=c.lods[i].groups;
+        if(i>0 && from.size()!=res.groups.size())
         {
-            const nya_formats::nms_mesh_chunk::group &from=c.lods[i].groups[j];
-            shared_mesh::group &to=res.groups[j];
-
-            to.name=from.name;
-
-            to.aabb=nya_math::aabb(from.aabb_min,from.aabb_max);
-
-            to.material_idx=from.material_idx;
-            to.offset=from.offset;
-            to.count=from.count;
-
-            to.elem_type=nya_render::vbo::element_type(from.element_type);
+            log()<<"nms load warning: lod "<<int(i)<<" groups don't match the first lod, lod skipped\n";
+            continue;
         }
 
-        break; //ToDo: load all lods
+        if(i>0)
+            res.lods.resize(res.lods.size()+1);
+
+        std::vector<shared_mesh::group> &to=i>0?res.lods.back().groups:res.groups;
+        to.resize(from.size());
+        for(size_t j=0;j<from.size();++j)
+            read_group(from[j],to[j]);
     }
 
     return true;
@@ -224,7 +305,7 @@ bool mesh::load_nms(shared_mesh &res,resource_data &data,const char* name)
         return false;
     }
 
-    if(m.version!=1 && m.version!=2)
+    if(m.version<1 || m.version>nya_formats::nms::latest_version)
     {
         log()<<"nms load error: unsupported version: "<<m.version<<"\n";
         return false;
@@ -243,6 +324,30 @@ bool mesh::load_nms(shared_mesh &res,resource_data &data,const char* name)
         };
     }
 
+    //lod screen sizes are stored as general objects named lod1, lod2... of type lod
+    for(size_t i=0;i<res.misc.size();++i)
+    {
+        const shared_mesh::misc_info &m=res.misc[i];
+        if(m.type!="lod" || m.name.compare(0,3,"lod")!=0)
+            continue;
+
+        const int idx=atoi(m.name.c_str()+3)-1;
+        if(idx<0 || idx>=(int)res.lods.size())
+            continue;
+
+        for(size_t j=0;j<m.vec4_params.size();++j)
+        {
+            if(m.vec4_params[j].first=="screen_size")
+                res.lods[idx].screen_size=m.vec4_params[j].second.x;
+        }
+    }
+
+    for(size_t i=0;i<res.lods.size();++i)
+    {
+        if(res.lods[i].screen_size<=0.0f)
+            res.lods[i].screen_size=i>0?res.lods[i-1].screen_size*0.5f:lod_default_screen_size;
+    }
+
     return true;
 }
 
@@ -254,13 +359,26 @@ bool mesh_internal::init_from_shared()
     m_replaced_materials.clear();
     m_replaced_materials_idx.clear();
     m_anims.clear();
+    m_bone_controls.clear();
+
+    update_from_shared();
+    return true;
+}
+
+void mesh_internal::update_from_shared()
+{
+    if(m_skeleton.get_bones_count()!=m_shared->skeleton.get_bones_count())
+        m_bone_controls.clear();
 
     m_skeleton=m_shared->skeleton;
-    m_bone_controls.clear();
+    need_update_skeleton=true;
 
     for(int i=0;i<int(m_shared->materials.size());++i)
         m_shared->materials[i].internal().skeleton_changed(&m_skeleton);
 
+    for(int i=0;i<(int)m_anims.size();++i)
+        anim_update_mapping(m_anims[i]);
+
     m_recalc_aabb=true;
     m_has_aabb=m_shared->aabb.delta.length_sq()>0.0001f;
 
@@ -268,7 +386,8 @@ bool mesh_internal::init_from_shared()
     for(int i=0;i<(int)m_groups.size();++i)
         m_groups[i].has_aabb=m_shared->groups[i].aabb.delta.length_sq()>0.0001f;
 
-    return true;
+    m_lod=0;
+    m_shared_version=m_shared->version;
 }
 
 bool mesh::load(const char *name)
@@ -300,6 +419,7 @@ void mesh::unload()
     m_internal.m_skeleton=nya_render::skeleton();
     m_internal.m_aabb=nya_math::aabb();
     m_internal.m_groups.clear();
+    m_internal.m_lod=0;
 }
 
 int mesh_internal::get_materials_count() const
@@ -340,7 +460,7 @@ int mesh_internal::get_mat_idx(int group_idx) const
     return (int)g.material_idx;
 }
 
-void mesh_internal::draw_group(int idx, const char *pass_name) const
+void mesh_internal::draw_group(int idx,int pass_id) const
 {
     if(!m_shared.is_valid())
         return;
@@ -357,13 +477,19 @@ void mesh_internal::draw_group(int idx, const char *pass_name) const
         return;
     }
 
-    const shared_mesh::group &g=m_shared->groups[idx];
+    const bool use_lod=m_lod>0 && m_lod<=(int)m_shared->lods.size();
+    const shared_mesh::group &g=use_lod?m_shared->lods[m_lod-1].groups[idx]:m_shared->groups[idx];
+    if(!g.count)
+        return;
 
     transform::set(m_transform);
     shader_internal::set_skeleton(&m_skeleton);
 
     const material &m=mat(mat_idx);
-    m.internal().set(pass_name);
+    if(texture::is_streaming() && m_has_aabb)
+        request_textures_resolution(idx,m);
+
+    m.internal().set_pass_id(pass_id);
     m_shared->vbo.bind();
     m_shared->vbo.draw(g.offset,g.count,g.elem_type);
     m_shared->vbo.unbind();
@@ -372,16 +498,70 @@ void mesh_internal::draw_group(int idx, const char *pass_name) const
     shader_internal::set_skeleton(0);
 }
 
+float mesh_internal::get_screen_size(const nya_math::aabb &box) const
+{
+    const nya_math::mat4 &proj=get_camera().get_proj_matrix();
+    const float viewport_height=float(nya_render::get_viewport().height);
+    const float radius=box.delta.length();
+    const float size=radius*proj[1][1]*viewport_height;
+    if(proj[2][3]==0.0f)
+        return size;
+
+    const float dist=(box.origin-get_camera().get_pos()).length();
+    return dist>radius?size/dist:viewport_height*4.0f;
+}
+
+void mesh_internal::request_textures_resolution(int idx,const material &m) const
+{
+    update_aabb_transform();
+    const float size=get_screen_size(m_groups[idx].has_aabb?m_groups[idx].aabb:m_aabb);
+    const unsigned int screen_size=size>1.0f?(unsigned int)size:1;
+    for(int i=0;i<m.get_textures_count();++i)
+    {
+        const texture_proxy &t=m.get_texture(i);
+        if(t.is_valid())
+            t->request_resolution(screen_size);
+    }
+}
+
+void mesh_internal::update_lod() const
+{
+    if(!m_shared.is_valid() || m_shared->lods.empty() || !lods_enabled || !m_has_aabb)
+    {
+        m_lod=0;
+        return;
+    }
+
+    const int lods_count=(int)m_shared->lods.size();
+    if(m_lod>lods_count)
+        m_lod=lods_count;
+
+    update_aabb_transform();
+    const float size=get_screen_size(m_aabb)*lod_screen_size_scale;
+    while(m_lod<lods_count && size<m_shared->lods[m_lod].screen_size*(1.0f-lod_hysteresis))
+        ++m_lod;
+    while(m_lod>0 && size>m_shared->lods[m_lod-1].screen_size*(1.0f+lod_hysteresis))
+        --m_lod;
+}
+
 void mesh::draw(const char *pass_name) const
 {
     if(!pass_name)
         return;
 
+    draw_pass_id(material_internal::find_pass_id(pass_name));
+}
+
+void mesh::draw_pass_id(int pass_id) const
+{
+    if(pass_id<0)
+        return;
+
     if(internal().m_has_aabb && frustum_cull_enabled && !get_camera().get_frustum().test_intersect(get_aabb()))
         return;
 
     for(int i=0;i<get_groups_count();++i)
-        draw_group(i,pass_name);
+        draw_group_pass_id(i,pass_id);
 }
 
 void mesh::draw_group(int idx,const char *pass_name) const
@@ -389,11 +569,19 @@ void mesh::draw_group(int idx,const char *pass_name) const
     if(!pass_name)
         return;
 
+    draw_group_pass_id(idx,material_internal::find_pass_id(pass_name));
+}
+
+void mesh::draw_group_pass_id(int idx,int pass_id) const
+{
+    if(idx<0 || idx>=(int)internal().m_groups.size()) //reloaded shared mesh, until update
+        return;
+
     int mat_idx=internal().get_mat_idx(idx);
     if(mat_idx<0)
         return;
 
-    if(internal().mat(mat_idx).get_pass_idx(pass_name)<0)
+    if(internal().mat(mat_idx).get_pass_idx_by_id(pass_id)<0)
         return;
 
     if(frustum_cull_enabled)
@@ -408,7 +596,8 @@ void mesh::draw_group(int idx,const char *pass_name) const
             return;
     }
 
-    internal().draw_group(idx,pass_name);
+    internal().update_lod();
+    internal().draw_group(idx,pass_id);
 }
 
 bool mesh::has_pass(const char *pass_name) const
@@ -416,13 +605,18 @@ bool mesh::has_pass(const char *pass_name) const
     if(!pass_name)
         return false;
 
+    return has_pass_id(material_internal::find_pass_id(pass_name));
+}
+
+bool mesh::has_pass_id(int pass_id) const
+{
     for(int i=0;i<get_groups_count();++i)
     {
         int mat_idx=internal().get_mat_idx(i);
         if(mat_idx<0)
             continue;
 
-        if(internal().mat(mat_idx).get_pass_idx(pass_name)>=0)
+        if(internal().mat(mat_idx).get_pass_idx_by_id(pass_id)>=0)
             return true;
     }
 
@@ -437,6 +631,14 @@ int mesh::get_groups_count() const
     return int(internal().m_shared->groups.size());
 }
 
+int mesh::get_lods_count() const
+{
+    if(!internal().m_shared.is_valid())
+        return 0;
+
+    return int(internal().m_shared->lods.size())+1;
+}
+
 const char *mesh::get_group_name(int group_idx) const
 {
     if(group_idx<0 || group_idx>=get_groups_count())
@@ -608,7 +810,7 @@ void mesh_internal::update_aabb_transform() const
     if(m_shared->aabb_bone_extends.empty() || (m_bone_controls.empty() && m_anims.empty()))
     {
         m_aabb=m_transform.transform_aabb(m_shared->aabb);
-        for(int i=0;i<(int)m_groups.size();++i)
+        for(int i=0;i<(int)m_groups.size() && i<(int)m_shared->groups.size();++i)
         {
             if(!m_groups[i].has_aabb)
                 continue;
@@ -744,6 +946,9 @@ void mesh_internal::update(unsigned int dt)
     if(!m_shared.is_valid())
         return;
 
+    if(m_shared_version!=m_shared->version)
+        update_from_shared();
+
     if(m_anims.empty() && m_bone_controls.empty())
         return;
 
@@ -849,11 +1054,7 @@ void mesh_internal::update_skeleton() const
         m_skeleton.set_bone_transform(i,pos,rot);
     }
 
-    m_skeleton.update();
-
-    const int mat_count=get_materials_count();
-    for(int i=0;i<mat_count;++i)
-        mat(i).internal().skeleton_changed(&m_skeleton);
+    m_skeleton.update(); //bumps skeleton version, shaders reupload palettes on the next bind
 }
 
 const nya_math::aabb &mesh::get_aabb() const
@@ -870,4 +1071,50 @@ void mesh::set_rot(nya_math::angle_deg yaw,nya_math::angle_deg pitch,nya_math::a
 bool mesh::is_frustrum_cull_enabled() { return frustum_cull_enabled; }
 void mesh::set_frustum_cull(bool enable) { frustum_cull_enabled=enable; }
 
+void mesh::set_vertex_compression(bool enable,const nya_render::vertex_compression &params)
+{
+    vertex_compression_enabled=enable;
+    vertex_compression_params=params;
+}
+
+bool mesh::is_vertex_compression_enabled() { return vertex_compression_enabled; }
+
+void mesh::set_lods(bool enable,float hysteresis,float screen_size_scale)
+{
+    lods_enabled=enable;
+    lod_hysteresis=hysteresis;
+    lod_screen_size_scale=screen_size_scale;
+}
+
+bool mesh::is_lods_enabled() { return lods_enabled; }
+
+void mesh::set_mesh_optimization(bool enable) { mesh_optimization_enabled=enable; }
+bool mesh::is_mesh_optimization_enabled() { return mesh_optimization_enabled; }
+
+bool mesh::set_vertex_data(nya_render::vbo &vbo,const void *data,unsigned int stride,unsigned int count,
+                           const nya_render::vbo::layout &layout,const nya_render::vertex_compression::hint *tc_hints)
+{
+    if(!vertex_compression_enabled)
+    {
+        vbo.set_layout(layout);
+        return vbo.set_vertex_data(data,stride,count);
+    }
+
+    nya_render::vertex_compression params=vertex_compression_params;
+    for(unsigned int i=0;tc_hints && i<nya_render::vbo::max_tex_coord;++i)
+        params.tc_hints[i]=tc_hints[i];
+
+    std::vector<char> buf;
+    nya_render::vbo::layout compressed_layout;
+    unsigned int compressed_stride;
+    if(!params.compress(data,stride,count,layout,buf,compressed_stride,compressed_layout))
+    {
+        vbo.set_layout(layout);
+        return vbo.set_vertex_data(data,stride,count);
+    }
+
+    vbo.set_layout(compressed_layout);
+    return vbo.set_vertex_data(&buf[0],compressed_stride,count);
+}
+
 }
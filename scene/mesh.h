@@ -7,6 +7,7 @@
 #include "animation.h"
 #include "memory/memory_reader.h"
 #include "render/vbo.h"
+#include "render/vertex_compress.h"
 #include "render/skeleton.h"
 #include "math/aabb.h"
 #include "transform.h"
@@ -40,6 +41,18 @@ struct shared_mesh
     };
 
     std::vector<group> groups;
+
+    //lower detail versions of groups, with the same groups count and order
+    struct lod
+    {
+        std::vector<group> groups;
+        float screen_size; //used below this projected size in pixels
+
+        lod(): screen_size(0.0f) {}
+    };
+
+    std::vector<lod> lods;
+
     std::vector<material> materials;
     nya_render::skeleton skeleton;
 
@@ -51,11 +64,15 @@ struct shared_mesh
     };
     std::vector<misc_info> misc;
 
+    unsigned int version; //changes when released, so meshes update from reloaded data
+
     bool release()
     {
+        ++version;
         aabb=nya_math::aabb();
         vbo.release();
         groups.clear();
+        lods.clear();
         materials.clear();
         skeleton=nya_render::skeleton();
 
@@ -67,7 +84,7 @@ struct shared_mesh
         return true;
     }
 
-    shared_mesh(): add_data(0) {}
+    shared_mesh(): version(0),add_data(0) {}
 
     struct additional_data
     {
@@ -78,6 +95,9 @@ struct shared_mesh
     additional_data *add_data;
 };
 
+inline size_t get_shared_resource_size(const shared_mesh &res) { return sizeof(res)+res.vbo.get_vmem_size(); }
+inline void replace_shared_resource(shared_mesh &res,shared_mesh &reloaded) { const unsigned int v=res.version; res=reloaded; res.version=v; }
+
 typedef proxy<animation> animation_proxy;
 
 class mesh_internal: public scene_shared<shared_mesh>
@@ -92,10 +112,11 @@ public:
     int get_bone_idx(const char *name) const { return m_skeleton.get_bone_idx(name); }
 
 private:
-    mesh_internal(): m_recalc_aabb(true), m_has_aabb(false), need_update_skeleton(true) {}
+    mesh_internal(): m_recalc_aabb(true), m_has_aabb(false), need_update_skeleton(true), m_lod(0), m_shared_version(0) {}
 
-    void draw_group(int idx, const char *pass_name) const;
+    void draw_group(int idx,int pass_id) const;
     bool init_from_shared();
+    void update_from_shared(); //keeps animations and replaced materials
 
     int get_materials_count() const;
     const material &mat(int idx) const; //idx must be valid
@@ -122,6 +143,9 @@ private:
     void update_skeleton() const;
 
     void update_aabb_transform() const;
+    float get_screen_size(const nya_math::aabb &box) const;
+    void request_textures_resolution(int idx,const material &m) const;
+    void update_lod() const;
 
 private:
     enum bone_control_mode
@@ -165,6 +189,8 @@ private:
     };
 
     std::vector<group> m_groups;
+    mutable int m_lod;
+    unsigned int m_shared_version;
 };
 
 class mesh
@@ -182,6 +208,11 @@ public:
     void draw_group(int group_idx,const char *pass_name=material::default_pass) const;
     bool has_pass(const char *pass_name) const;
 
+    //pass_id from material::get_pass_id(), saves pass name lookups per draw
+    void draw_pass_id(int pass_id) const;
+    void draw_group_pass_id(int group_idx,int pass_id) const;
+    bool has_pass_id(int pass_id) const;
+
     const nya_math::aabb &get_aabb() const;
 
     // transform
@@ -204,6 +235,10 @@ public:
     material &modify_material(int group_idx);
     bool set_material(int group_idx,const material &mat);
 
+    // lods, selected at draw by projected size
+    int get_lods_count() const; //including the full detail one
+    int get_lod() const { return internal().m_lod; }
+
     // skeleton
     const nya_render::skeleton &get_skeleton() const { return internal().get_skeleton(); }
     int get_bones_count() const { return internal().get_bones_count(); }
@@ -233,10 +268,34 @@ public:
 public:
     static void set_resources_prefix(const char *prefix) { mesh_internal::set_resources_prefix(prefix); }
     static void register_load_function(mesh_internal::load_function function,bool clear_default=true) { mesh_internal::register_load_function(function,clear_default); }
+
+    //unloaded meshes stay in vmem up to the budget in bytes and are reused by load()
+    //materials textures are referenced by cached meshes, but not included in their size
+    static void set_cache_budget(size_t bytes) { mesh_internal::set_cache_budget(bytes); }
+    static mesh_internal::cache_stats get_cache_stats() { return mesh_internal::get_cache_stats(); }
 public:
     static bool is_frustrum_cull_enabled();
     static void set_frustum_cull(bool enable);
 
+public:
+    //off by default, hysteresis is relative to lod screen sizes, scale below 1 selects lower detail lods earlier
+    static void set_lods(bool enable,float hysteresis=0.1f,float screen_size_scale=1.0f);
+    static bool is_lods_enabled();
+
+public:
+    //repacks vertex data of meshes loaded afterwards to smaller attribute types within error bounds, off by default
+    static void set_vertex_compression(bool enable,const nya_render::vertex_compression &params=nya_render::vertex_compression());
+    static bool is_vertex_compression_enabled();
+
+    //reorders nms triangles for vertex cache and overdraw and vertices for fetch at load, off by default
+    //better done offline with tools/nms_optimizer, meshes from other loaders are not optimized
+    static void set_mesh_optimization(bool enable);
+    static bool is_mesh_optimization_enabled();
+
+    //for load functions, tc_hints replace params hints if set
+    static bool set_vertex_data(nya_render::vbo &vbo,const void *data,unsigned int stride,unsigned int count,
+                                const nya_render::vbo::layout &layout,const nya_render::vertex_compression::hint *tc_hints=0);
+
 public:
     static bool load_nms(shared_mesh &res,resource_data &data,const char* name);
     static bool load_nms_mesh_section(shared_mesh &res,const void *data,size_t size,int version);
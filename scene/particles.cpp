@@ -7,6 +7,7 @@
 #include "memory/invalid_object.h"
 #include "stdlib.h"
 #include "string.h"
+#include <list>
 
 namespace nya_scene
 {
@@ -978,7 +979,7 @@ static bool load_includes(parsers_list &list,parsers_list::iterator current,cons
             ++it;
             it=list.insert(it,nya_formats::text_parser());
 
-            if(!it->load_from_data((char *)include_data.get_data(),include_data.get_size()))
+            if(!parse_text(*it,(const char *)include_data.get_data(),include_data.get_size()))
             {
                 log()<<"unable to load include in particles "<<name<<": unknown format or invalid data in "<<path.c_str()<<"\n";
                 return false;
@@ -995,7 +996,7 @@ bool particles::load_text(shared_particles &res,resource_data &data,const char*
 {
     typedef std::list<nya_formats::text_parser> parsers_list;
     parsers_list parsers(1);
-    if(!parsers.back().load_from_data((char *)data.get_data(),data.get_size()))
+    if(!parse_text(parsers.back(),(const char *)data.get_data(),data.get_size()))
         return false;
 
     if(!load_includes(parsers,parsers.begin(),name))
@@ -1155,7 +1156,7 @@ bool particles::load_text(shared_particles &res,resource_data &data,const char*
                         }
                     }
 
-                    if(!e.parse(fvalue))
+                    if(!parse_expression(e,fvalue))
                     {
                         log()<<"invalid expression '"<<fvalue<<"' in function '"<<sname<<"' when loading particles '"<<name<<"'\n";
                         return false;
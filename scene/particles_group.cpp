@@ -95,7 +95,7 @@ const particles &particles_group::get(int idx) const
 bool particles_group::load_text(shared_particles_group &res,resource_data &data,const char* name)
 {
     nya_formats::text_parser parser;
-    if(!parser.load_from_data((char *)data.get_data(),data.get_size()))
+    if(!parse_text(parser,(const char *)data.get_data(),data.get_size()))
         return false;
 
     for(int i=0;i<parser.get_sections_count();++i)
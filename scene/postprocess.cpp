@@ -8,6 +8,7 @@
 #include "scene.h"
 #include "camera.h"
 #include <string.h>
+#include <algorithm>
 
 #ifdef min
     #undef min
@@ -189,7 +190,7 @@ void postprocess::draw(int dt)
 bool postprocess::load_text(shared_postprocess &res,resource_data &data,const char* name)
 {
     nya_formats::text_parser parser;
-    if(!parser.load_from_data((char *)data.get_data(),data.get_size()))
+    if(!parse_text(parser,(const char *)data.get_data(),data.get_size()))
         return false;
 
     res.lines.resize(parser.get_sections_count());
@@ -269,6 +270,31 @@ void postprocess::set_texture(const char *name,const texture_proxy &tex)
     set_value(m_textures,name,tex_holder(true,tex));
 }
 
+const texture_proxy &postprocess::get_texture(const char *name)
+{
+    export_texture(name);
+    return static_cast<const postprocess *>(this)->get_texture(name);
+}
+
+void postprocess::export_texture(const char *name)
+{
+    if(!name || std::find(m_exported_textures.begin(),m_exported_textures.end(),name)!=m_exported_textures.end())
+        return;
+
+    m_exported_textures.push_back(name);
+
+    //recompile if the target was transient
+    const int idx=get_idx(m_textures,name);
+    for(size_t i=0;idx>=0 && i<m_target_textures.size();++i)
+    {
+        if(m_target_textures[i].tex_idx==idx && m_target_textures[i].init_color.empty())
+        {
+            update();
+            return;
+        }
+    }
+}
+
 const texture_proxy &postprocess::get_texture(const char *name) const
 {
     const int i=get_idx(m_textures,name);
@@ -406,8 +432,6 @@ void postprocess::update()
         m_textures.erase(m_textures.begin()+i);
     }
 
-    //ToDo: don't create unused targets
-
     for(int i=0;i<(int)m_shared->lines.size();++i)
     {
         const shared_postprocess::line &l=m_shared->lines[i];
@@ -543,61 +567,7 @@ void postprocess::update()
                     log()<<"available formats: rgba, rgb, rgba32f, rgb32f, r32f\n";
                 }
 
-                texture_proxy t=get_texture(color);
-                if(t.is_valid())
-                {
-                    if(t->get_width()!=w || t->get_height()!=h)
-                        log()<<"warning: postprocess: texture "<<color<<" with different size in file "<<m_shared.get_name()<<"\n";
-                    if(t->get_format()!=f)
-                        log()<<"warning: postprocess: texture "<<color<<" with different format in file "<<m_shared.get_name()<<"\n";
-                }
-                else
-                {
-                    const char *init_color=l.get_value("init_color");
-                    nya_memory::tmp_buffer_ref color_buf;
-                    if(init_color)
-                    {
-                        typedef unsigned char uchar;
-                        const nya_math::vec4 cf=nya_formats::vec4_from_string(init_color);
-                        const nya_math::vec4 cfc=nya_math::vec4::clamp(cf,nya_math::vec4(),nya_math::vec4(1.0f,1.0f,1.0f,1.0f))*255.0;
-                        const uchar c[4]={uchar(cfc.x),uchar(cfc.y),uchar(cfc.z),uchar(cfc.w)};
-                        switch(f)
-                        {
-                            case nya_render::texture::color_rgba:
-                            case nya_render::texture::color_rgb:
-                            {
-                                unsigned int bpp=f==nya_render::texture::color_rgba?4:3;
-                                color_buf.allocate(w*h*bpp);
-                                for(unsigned int i=0;i<w*h*bpp;i+=bpp)
-                                    memcpy(color_buf.get_data(i),c,bpp);
-                            }
-                            break;
-
-                            case nya_render::texture::color_rgba32f:
-                            case nya_render::texture::color_rgb32f:
-                            {
-                                unsigned int bpp=f==nya_render::texture::color_rgba32f?4*4:3*4;
-                                color_buf.allocate(w*h*bpp);
-                                for(unsigned int i=0;i<w*h*bpp;i+=bpp)
-                                    memcpy(color_buf.get_data(i),&cf,bpp);
-                                break;
-                            }
-
-                            default:
-                                log()<<"warning: postprocess: texture "<<color<<" invalid color format initialisation "<<m_shared.get_name()<<"\n";
-                        }
-                    }
-
-                    t.create();
-                    t->build(color_buf.get_data(),w,h,f);
-                    color_buf.free();
-                    nya_render::texture tex=t->internal().get_shared_data()->tex;
-                    tex.set_wrap(nya_render::texture::wrap_clamp,nya_render::texture::wrap_clamp);
-
-                    m_textures.push_back(std::make_pair(color,tex_holder(false,t)));
-                }
-
-                m_targets.back().color_idx=get_idx(m_textures, color);
+                m_targets.back().color_idx=add_target_texture(color,w,h,f,l.get_value("init_color"));
                 m_targets.back().samples=s;
             }
 
@@ -620,24 +590,7 @@ void postprocess::update()
                     }
                 }
 
-                texture_proxy t=get_texture(depth);
-                if(t.is_valid())
-                {
-                    if(t->get_width()!=w || t->get_height()!=h)
-                        log()<<"warning: postprocess: texture "<<depth<<" with different size in file "<<m_shared.get_name()<<"\n";
-                    if(t->get_format()!=f)
-                        log()<<"warning: postprocess: texture "<<depth<<" with different format in file "<<m_shared.get_name()<<"\n";
-                }
-                else
-                {
-                    t.create();
-                    t->build(0,w,h,f);
-                    nya_render::texture tex=t->internal().get_shared_data()->tex;
-                    tex.set_wrap(nya_render::texture::wrap_clamp,nya_render::texture::wrap_clamp);
-                    m_textures.push_back(std::make_pair(depth,tex_holder(false,t)));
-                }
-
-                m_targets.back().depth_idx=get_idx(m_textures, depth);
+                m_targets.back().depth_idx=add_target_texture(depth,w,h,f,0);
             }
         }
         else if(l.type=="set_shader")
@@ -777,15 +730,344 @@ void postprocess::update()
             log()<<"warning: postprocess: unknown operation "<<l.type<<" in file "<<m_shared.get_name()<<"\n";
     }
 
+    compile();
+
     for(int i=0;i<(int)m_shader_params.size();++i)
         update_shader_param(i);
 }
 
+int postprocess::add_target_texture(const char *name,unsigned int width,unsigned int height,
+                                    nya_render::texture::color_format format,const char *init_color)
+{
+    int idx=get_idx(m_textures,name);
+    if(idx>=0 && m_textures[idx].second.tex.is_valid())
+    {
+        const texture_proxy &t=m_textures[idx].second.tex;
+        if(t->get_width()!=width || t->get_height()!=height)
+            log()<<"warning: postprocess: texture "<<name<<" with different size in file "<<m_shared.get_name()<<"\n";
+        if(t->get_format()!=format)
+            log()<<"warning: postprocess: texture "<<name<<" with different format in file "<<m_shared.get_name()<<"\n";
+        return idx;
+    }
+
+    if(idx<0)
+    {
+        idx=(int)m_textures.size();
+        m_textures.push_back(std::make_pair(name,tex_holder(false,texture_proxy())));
+    }
+
+    for(size_t i=0;i<m_target_textures.size();++i)
+    {
+        const target_texture &t=m_target_textures[i];
+        if(t.tex_idx!=idx)
+            continue;
+
+        if(t.width!=width || t.height!=height)
+            log()<<"warning: postprocess: texture "<<name<<" with different size in file "<<m_shared.get_name()<<"\n";
+        if(t.format!=format)
+            log()<<"warning: postprocess: texture "<<name<<" with different format in file "<<m_shared.get_name()<<"\n";
+        return idx;
+    }
+
+    target_texture t;
+    t.tex_idx=idx;
+    t.width=width,t.height=height;
+    t.format=format;
+    t.init_color.assign(init_color?init_color:"");
+    m_target_textures.push_back(t);
+    return idx;
+}
+
+texture_proxy postprocess::create_target_texture(int idx) const
+{
+    const target_texture &tt=m_target_textures[idx];
+    const unsigned int w=tt.width,h=tt.height;
+    const nya_render::texture::color_format f=tt.format;
+
+    nya_memory::tmp_buffer_ref color_buf;
+    if(!tt.init_color.empty())
+    {
+        typedef unsigned char uchar;
+        const nya_math::vec4 cf=nya_formats::vec4_from_string(tt.init_color.c_str());
+        const nya_math::vec4 cfc=nya_math::vec4::clamp(cf,nya_math::vec4(),nya_math::vec4(1.0f,1.0f,1.0f,1.0f))*255.0;
+        const uchar c[4]={uchar(cfc.x),uchar(cfc.y),uchar(cfc.z),uchar(cfc.w)};
+        switch(f)
+        {
+            case nya_render::texture::color_rgba:
+            case nya_render::texture::color_rgb:
+            {
+                unsigned int bpp=f==nya_render::texture::color_rgba?4:3;
+                color_buf.allocate(w*h*bpp);
+                for(unsigned int i=0;i<w*h*bpp;i+=bpp)
+                    memcpy(color_buf.get_data(i),c,bpp);
+            }
+            break;
+
+            case nya_render::texture::color_rgba32f:
+            case nya_render::texture::color_rgb32f:
+            {
+                unsigned int bpp=f==nya_render::texture::color_rgba32f?4*4:3*4;
+                color_buf.allocate(w*h*bpp);
+                for(unsigned int i=0;i<w*h*bpp;i+=bpp)
+                    memcpy(color_buf.get_data(i),&cf,bpp);
+                break;
+            }
+
+            default:
+                log()<<"warning: postprocess: texture "<<m_textures[tt.tex_idx].first<<" invalid color format initialisation "<<m_shared.get_name()<<"\n";
+        }
+    }
+
+    texture_proxy t;
+    t.create();
+    t->build(color_buf.get_data(),w,h,f);
+    color_buf.free();
+    nya_render::texture tex=t->internal().get_shared_data()->tex;
+    tex.set_wrap(nya_render::texture::wrap_clamp,nya_render::texture::wrap_clamp);
+    return t;
+}
+
+namespace
+{
+    struct graph_pass
+    {
+        size_t target,from,to;
+        bool has_draw,clear_color,clear_depth,live;
+        std::vector<size_t> reads;
+
+        graph_pass(size_t target,size_t from): target(target),from(from),to(from),
+                   has_draw(false),clear_color(false),clear_depth(false),live(false) {}
+    };
+
+    struct texture_slot
+    {
+        unsigned int width,height;
+        nya_render::texture::color_format format;
+        int last_pass;
+        texture_proxy tex;
+    };
+
+    unsigned int get_texture_size(unsigned int w,unsigned int h,nya_render::texture::color_format f)
+    {
+        return w*h*nya_render::texture::get_format_bpp(f)/8;
+    }
+}
+
+void postprocess::compile()
+{
+    //split ops into passes, each one renders to a single target
+    std::vector<graph_pass> passes(1,graph_pass(0,0));
+    bool material_set=false;
+    for(size_t i=0;i<m_op.size();++i)
+    {
+        const op &o=m_op[i];
+        if(o.type==type_set_target)
+        {
+            passes.back().to=i;
+            passes.push_back(graph_pass(o.idx,i));
+        }
+
+        graph_pass &p=passes.back();
+        switch(o.type)
+        {
+            case type_set_shader: material_set=false; break;
+            case type_set_material: material_set=true; break;
+            case type_set_texture: p.reads.push_back(m_op_set_texture[o.idx].tex_idx); break;
+
+            case type_clear:
+                if(!p.has_draw)
+                {
+                    p.clear_color=p.clear_color || m_op_clear[o.idx].color;
+                    p.clear_depth=p.clear_depth || m_op_clear[o.idx].depth;
+                }
+                p.has_draw=true;
+                break;
+
+            case type_draw_quad:
+                if(!p.has_draw && !material_set) //opaque fullscreen quad overwrites color
+                    p.clear_color=true;
+                p.has_draw=true;
+                break;
+
+            case type_draw_scene: p.has_draw=true; break;
+            default: break;
+        }
+    }
+    passes.back().to=m_op.size();
+
+    //textures not declared by targets or exported are external, their content is always needed
+    std::vector<char> transient(m_textures.size(),false);
+    for(size_t i=0;i<m_target_textures.size();++i)
+    {
+        const target_texture &tt=m_target_textures[i];
+        const std::string &name=m_textures[tt.tex_idx].first;
+        const bool exported=std::find(m_exported_textures.begin(),m_exported_textures.end(),name)!=m_exported_textures.end();
+        transient[tt.tex_idx]=tt.init_color.empty() && !exported;
+    }
+
+    //backward liveness, second iteration keeps textures read before written, as they carry previous frame content
+    std::vector<char> live(m_textures.size(),false),live_in;
+    for(int iteration=0;iteration<2;++iteration)
+    {
+        if(iteration>0)
+            live=live_in;
+
+        for(int i=(int)passes.size()-1;i>=0;--i)
+        {
+            graph_pass &p=passes[i];
+            p.live=false;
+            if(!p.has_draw)
+                continue;
+
+            const op_target &t=m_targets[p.target];
+            const int attachments[2]={t.color_idx,t.depth_idx};
+            const bool cleared[2]={p.clear_color,p.clear_depth};
+
+            p.live=p.target==0;
+            for(int j=0;j<2;++j)
+            {
+                if(attachments[j]>=0 && (!transient[attachments[j]] || live[attachments[j]]))
+                    p.live=true;
+            }
+
+            if(!p.live)
+                continue;
+
+            for(int j=0;j<2;++j)
+            {
+                if(attachments[j]>=0)
+                    live[attachments[j]]=!cleared[j];
+            }
+
+            for(size_t j=0;j<p.reads.size();++j)
+                live[p.reads[j]]=true;
+        }
+
+        live_in=live;
+    }
+
+    //transient textures live from their first to their last pass
+    std::vector<int> first_pass(m_textures.size(),-1),last_pass(m_textures.size(),-1);
+    for(int i=0;i<(int)passes.size();++i)
+    {
+        const graph_pass &p=passes[i];
+        if(!p.live)
+            continue;
+
+        const op_target &t=m_targets[p.target];
+        const int attachments[2]={t.color_idx,t.depth_idx};
+        for(int j=0;j<2;++j)
+        {
+            if(attachments[j]<0)
+                continue;
+
+            if(first_pass[attachments[j]]<0)
+                first_pass[attachments[j]]=i;
+            last_pass[attachments[j]]=i;
+        }
+
+        for(size_t j=0;j<p.reads.size();++j)
+        {
+            if(first_pass[p.reads[j]]<0)
+                first_pass[p.reads[j]]=i;
+            last_pass[p.reads[j]]=i;
+        }
+    }
+
+    //allocate in order of first use, textures of the same size and format share a slot when lifetimes don't overlap
+    std::vector<int> order;
+    for(int i=0;i<(int)m_target_textures.size();++i)
+    {
+        if(first_pass[m_target_textures[i].tex_idx]>=0)
+            order.push_back(i);
+    }
+
+    for(size_t i=1;i<order.size();++i)
+    {
+        for(size_t j=i;j>0 && first_pass[m_target_textures[order[j]].tex_idx]<first_pass[m_target_textures[order[j-1]].tex_idx];--j)
+            std::swap(order[j],order[j-1]);
+    }
+
+    m_targets_vmem=m_saved_vmem=0;
+    for(size_t i=0;i<m_target_textures.size();++i)
+    {
+        const target_texture &tt=m_target_textures[i];
+        m_saved_vmem+=get_texture_size(tt.width,tt.height,tt.format);
+    }
+
+    std::vector<texture_slot> slots;
+    for(size_t i=0;i<order.size();++i)
+    {
+        const target_texture &tt=m_target_textures[order[i]];
+        const int idx=tt.tex_idx;
+        const bool can_alias=transient[idx] && !live_in[idx];
+
+        texture_slot *slot=0;
+        for(size_t j=0;can_alias && j<slots.size() && !slot;++j)
+        {
+            texture_slot &s=slots[j];
+            if(s.last_pass>=0 && s.last_pass<first_pass[idx] && s.width==tt.width && s.height==tt.height && s.format==tt.format)
+                slot=&s;
+        }
+
+        if(!slot)
+        {
+            slots.resize(slots.size()+1);
+            slot=&slots.back();
+            slot->width=tt.width,slot->height=tt.height;
+            slot->format=tt.format;
+            slot->tex=create_target_texture(order[i]);
+            m_targets_vmem+=get_texture_size(tt.width,tt.height,tt.format);
+        }
+
+        slot->last_pass=can_alias?last_pass[idx]:-1;
+        m_textures[idx].second.tex=slot->tex;
+    }
+    m_saved_vmem-=m_targets_vmem;
+
+    //drop culled passes, keep shader and material ops as their state carries over to next passes
+    std::vector<op> ops;
+    ops.reserve(m_op.size());
+    m_culled_passes=m_merged_passes=0;
+    int bound_target= -1;
+    for(size_t i=0;i<passes.size();++i)
+    {
+        const graph_pass &p=passes[i];
+        if(!p.live && p.to>p.from)
+            ++m_culled_passes;
+
+        for(size_t j=p.from;j<p.to;++j)
+        {
+            const op &o=m_op[j];
+            if(!p.live && o.type!=type_set_shader && o.type!=type_set_material)
+                continue;
+
+            if(o.type==type_set_target)
+            {
+                //adjacent passes to the same target don't rebind it
+                if(bound_target==(int)o.idx)
+                {
+                    ++m_merged_passes;
+                    continue;
+                }
+
+                bound_target=(int)o.idx;
+            }
+            else if(o.type==type_draw_scene)
+                bound_target= -1;
+
+            ops.push_back(o);
+        }
+    }
+    m_op.swap(ops);
+}
+
 void postprocess::unload()
 {
     postprocess::unload_internal();
     m_conditions.clear();
     m_variables.clear();
+    m_exported_textures.clear();
 }
 
 void postprocess::unload_internal()
@@ -805,6 +1087,8 @@ void postprocess::clear_ops()
     m_op_draw_scene.clear();
     m_op_set_shader.clear();
     m_op_set_material.clear();
+    m_op_set_texture.clear();
+    m_target_textures.clear();
 
     for(size_t i=1;i<m_targets.size();++i)
     {
@@ -51,7 +51,11 @@ public:
     float get_variable(const char *name) const;
     
     void set_texture(const char *name,const texture_proxy &tex);
-    const texture_proxy &get_texture(const char *name) const;
+    const texture_proxy &get_texture(const char *name); //exports the texture if it is a target
+    const texture_proxy &get_texture(const char *name) const; //target may be culled or shared if not exported
+
+    //exported targets are read outside of the postprocess, so they are never culled or shared with other targets
+    void export_texture(const char *name);
 
     void set_shader_param(const char *name,const nya_math::vec4 &value);
     const nya_math::vec4 &get_shader_param(const char *name) const;
@@ -61,7 +65,17 @@ public:
     unsigned int get_height() const { return m_height; };
 
 public:
-    postprocess(): m_width(0),m_height(0),m_auto_resize(true) {}
+    //passes whose targets are not read later are culled, target textures are created only for the remaining ones
+    //textures read before written in a frame, with init_color, set by user or exported are kept, others may share a texture
+    //compiled graph stats, updated on every rebuild
+    int get_culled_passes_count() const { return m_culled_passes; }
+    int get_merged_passes_count() const { return m_merged_passes; }
+    unsigned int get_targets_vmem_size() const { return m_targets_vmem; }
+    unsigned int get_saved_vmem_size() const { return m_saved_vmem; } //compared to a texture per declared target
+
+public:
+    postprocess(): m_width(0),m_height(0),m_auto_resize(true),m_culled_passes(0),m_merged_passes(0),
+                   m_targets_vmem(0),m_saved_vmem(0) {}
     ~postprocess() { unload(); }
 
 public:
@@ -69,6 +83,10 @@ public:
 
 private:
     void update();
+    void compile();
+    int add_target_texture(const char *name,unsigned int width,unsigned int height,
+                           nya_render::texture::color_format format,const char *init_color);
+    texture_proxy create_target_texture(int idx) const;
     void update_shader_param(int idx);
     void clear_ops();
     void unload_internal();
@@ -87,6 +105,7 @@ private:
     std::vector<std::pair<std::string,bool> > m_conditions;
     std::vector<std::pair<std::string,float> > m_variables;
     std::vector<std::pair<std::string,tex_holder> > m_textures;
+    std::vector<std::string> m_exported_textures;
     std::vector<std::pair<std::string,nya_math::vec4> > m_shader_params;
 
     enum op_types
@@ -155,6 +174,19 @@ private:
         op_target(): color_idx(-1),depth_idx(-1),samples(1) {}
     };
     std::vector<op_target> m_targets;
+
+    //target textures are created after compile(), transient ones with non-overlapping lifetimes share a texture
+    struct target_texture
+    {
+        int tex_idx;
+        unsigned int width,height;
+        nya_render::texture::color_format format;
+        std::string init_color;
+    };
+    std::vector<target_texture> m_target_textures;
+
+    int m_culled_passes,m_merged_passes;
+    unsigned int m_targets_vmem,m_saved_vmem;
 };
 
 }
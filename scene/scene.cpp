@@ -1,8 +1,14 @@
 //nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
 
 #include "scene.h"
+#include "formats/text_parser.h"
+#include "formats/math_expr_parser.h"
 
-namespace { nya_log::log_base *scene_log=0; }
+namespace
+{
+    nya_log::log_base *scene_log=0;
+    nya_scene::compiled_assets_provider *assets_provider=0;
+}
 
 namespace nya_scene
 {
@@ -17,4 +23,47 @@ nya_log::log_base &log()
     return *scene_log;
 }
 
+void set_compiled_assets_provider(compiled_assets_provider *provider) { assets_provider=provider; }
+compiled_assets_provider *get_compiled_assets_provider() { return assets_provider; }
+
+bool parse_text(nya_formats::text_parser &parser,const char *data,size_t size)
+{
+    compiled_assets_provider *provider=assets_provider;
+    if(!provider || !data)
+        return parser.load_from_data(data,size);
+
+    const uint64_t key=nya_formats::text_parser::get_compiled_key(data,size);
+    std::vector<char> buf;
+    if(provider->get(key,buf) && !buf.empty() && parser.load_compiled(&buf[0],buf.size()))
+        return true;
+
+    if(!parser.load_from_data(data,size))
+        return false;
+
+    buf.resize(parser.get_compiled_size());
+    if(!buf.empty() && parser.write_compiled(&buf[0],buf.size()))
+        provider->set(key,&buf[0],buf.size());
+    return true;
+}
+
+bool parse_expression(nya_formats::math_expr_parser &parser,const char *expr)
+{
+    compiled_assets_provider *provider=assets_provider;
+    if(!provider || !expr)
+        return parser.parse(expr);
+
+    const uint64_t key=parser.get_compiled_key(expr);
+    std::vector<char> buf;
+    if(provider->get(key,buf) && !buf.empty() && parser.load_compiled(&buf[0],buf.size()))
+        return true;
+
+    if(!parser.parse(expr))
+        return false;
+
+    buf.resize(parser.get_compiled_size());
+    if(!buf.empty() && parser.write_compiled(&buf[0],buf.size()))
+        provider->set(key,&buf[0],buf.size());
+    return true;
+}
+
 }
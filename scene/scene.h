@@ -4,6 +4,11 @@
 
 #include "log/log.h"
 #include "log/warning.h"
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nya_formats { class text_parser; class math_expr_parser; }
 
 namespace nya_scene
 {
@@ -11,4 +16,20 @@ namespace nya_scene
 void set_log(nya_log::log_base *l);
 nya_log::log_base &log();
 
+//parsed text assets and compiled expressions of materials, shaders, locations, particles and postprocess
+//are kept as binary blobs, keyed by a hash of the source, so unchanged files are not parsed again
+class compiled_assets_provider
+{
+public:
+    virtual bool get(uint64_t key,std::vector<char> &data) { return false; }
+    virtual bool set(uint64_t key,const void *data,size_t size) { return false; }
+};
+
+void set_compiled_assets_provider(compiled_assets_provider *provider);
+compiled_assets_provider *get_compiled_assets_provider();
+
+//parse through the compiled assets provider if set
+bool parse_text(nya_formats::text_parser &parser,const char *data,size_t size);
+bool parse_expression(nya_formats::math_expr_parser &parser,const char *expr);
+
 }
@@ -10,9 +10,11 @@
 #include "render/fbo.h"
 #include "formats/text_parser.h"
 #include "formats/math_expr_parser.h"
+#include "render/shader_code_parser.h"
 #include <string.h>
 #include <stdio.h>
 #include <cstdlib>
+#include <algorithm>
 
 namespace nya_scene
 {
@@ -117,25 +119,15 @@ private:
 
 } skeleton_blit;
 
-struct shader_description
+inline bool skeleton_outdated(const nya_render::skeleton *s,const nya_render::skeleton *&last,unsigned int &last_version)
 {
-    struct predefined
-    {
-        std::string name;
-        shared_shader::transform_type transform;
-    };
-
-    predefined predefines[shared_shader::predefines_count];
-
-    typedef std::map<std::string,std::string> strings_map;
-    strings_map samplers;
-    strings_map uniforms;
-
-    std::vector<std::pair<std::string,nya_formats::math_expr_parser> > procedural;
+    if(!s || (s==last && s->get_version()==last_version))
+        return false;
 
-    std::string vertex;
-    std::string pixel;
-};
+    last=s;
+    last_version=s->get_version();
+    return true;
+}
 
 shared_shader::transform_type transform_from_string(const char *str)
 {
@@ -156,10 +148,12 @@ shared_shader::transform_type transform_from_string(const char *str)
 
 }
 
+bool build_nya_shader(shared_shader &res,shader_description &desc,unsigned int features_mask);
+
 bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resource_data &data,const char* name,bool include)
 {
     nya_formats::text_parser parser;
-    parser.load_from_data((const char *)data.get_data(),data.get_size());
+    parse_text(parser,(const char *)data.get_data(),data.get_size());
     for(int section_idx=0;section_idx<parser.get_sections_count();++section_idx)
     {
         if(parser.is_section_type(section_idx,"include"))
@@ -182,6 +176,7 @@ bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resour
                 path.resize(p+1);
 
             path.append(file);
+            res.includes.push_back(path);
 
             nya_resources::resource_data *file_data=nya_resources::get_resources_provider().access(path.c_str());
             if(!file_data)
@@ -256,6 +251,7 @@ bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resour
             const char *predefined_semantics[]={"nya camera pos","nya camera rot","nya camera dir",
                                                 "nya bones pos","nya bones pos transform","nya bones rot","nya bones rot transform",
                                                 "nya bones pos texture","nya bones pos transform texture","nya bones rot texture",
+                                                "nya bones dq transform","nya bones mat3x4 transform",
                                                 "nya viewport","nya model pos","nya model rot","nya model scale"};
 
             char predefined_count_static_assert[sizeof(predefined_semantics)/sizeof(predefined_semantics[0])
@@ -269,23 +265,9 @@ bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resour
                     desc.predefines[i].transform=transform_from_string(parser.get_section_option(section_idx));
 
                     if(i==shared_shader::bones_pos_tex || i==shared_shader::bones_pos_tr_tex)
-                    {
-                        skeleton_blit.init();
-                        res.texture_buffers.allocate();
-                        res.texture_buffers->skeleton_pos_max_count=int(parser.get_section_value_vec4(section_idx).x);
-                        res.texture_buffers->skeleton_pos_texture.build_texture(0,res.texture_buffers->skeleton_pos_max_count,1,nya_render::texture::color_rgb32f,1);
-                        res.texture_buffers->skeleton_pos_texture.set_filter(nya_render::texture::filter_nearest,
-                                                                             nya_render::texture::filter_nearest,nya_render::texture::filter_nearest);
-                    }
+                        desc.skeleton_pos_max_count=int(parser.get_section_value_vec4(section_idx).x);
                     else if(i==shared_shader::bones_rot_tex)
-                    {
-                        skeleton_blit.init();
-                        res.texture_buffers.allocate();
-                        res.texture_buffers->skeleton_rot_max_count=int(parser.get_section_value_vec4(section_idx).x);
-                        res.texture_buffers->skeleton_rot_texture.build_texture(0,res.texture_buffers->skeleton_rot_max_count,1,nya_render::texture::color_rgba32f,1);
-                        res.texture_buffers->skeleton_rot_texture.set_filter(nya_render::texture::filter_nearest,
-                                                                             nya_render::texture::filter_nearest,nya_render::texture::filter_nearest);
-                    }
+                        desc.skeleton_rot_max_count=int(parser.get_section_value_vec4(section_idx).x);
                     break;
                 }
             }
@@ -306,11 +288,37 @@ bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resour
             res.uniforms.back().transform=transform_from_string(parser.get_section_option(section_idx));
             res.uniforms.back().default_value=parser.get_section_value_vec4(section_idx);
         }
+        else if(parser.is_section_type(section_idx,"feature"))
+        {
+            const char *key=parser.get_section_name(section_idx,0);
+            const char *semantics=parser.get_section_name(section_idx,1);
+            if(!key || !key[0])
+            {
+                log()<<"unable to load shader "<<name<<": invalid feature syntax\n";
+                return false;
+            }
+
+            if(std::find(res.features.begin(),res.features.end(),key)!=res.features.end())
+                continue;
+
+            if(res.features.size()>=32)
+            {
+                log()<<"unable to load shader "<<name<<": too many features\n";
+                return false;
+            }
+
+            if(semantics && strcmp(semantics,"nya skeleton")==0)
+                res.skeleton_features|=1u<<res.features.size();
+            else if(semantics && semantics[0])
+                log()<<"scene shader load warning: unsupported feature semantics "<<semantics<<" in "<<name<<"\n";
+
+            res.features.push_back(key);
+        }
         else if(parser.is_section_type(section_idx,"procedural"))
         {
             const char *name=parser.get_section_name(section_idx,0);
             nya_formats::math_expr_parser p;
-            if(!name || !name[0] || !p.parse(parser.get_section_value(section_idx)))
+            if(!name || !name[0] || !parse_expression(p,parser.get_section_value(section_idx)))
             {
                 log()<<"unable to load shader "<<name<<": invalid procedural\n";
                 return false;
@@ -337,14 +345,81 @@ bool load_nya_shader_internal(shared_shader &res,shader_description &desc,resour
         return false;
     }
 
+    if(!res.features.empty())
+        res.description.create(desc);
+
+    return build_nya_shader(res,desc,0);
+}
+
+bool build_nya_shader(shared_shader &res,shader_description &desc,unsigned int features_mask)
+{
     //log()<<"vertex <"<<res.vertex.c_str()<<">\n";
     //log()<<"pixel <"<<res.pixel.c_str()<<">\n";
 
-    if(!res.shdr.add_program(nya_render::shader::vertex,desc.vertex.c_str()))
-        return false;
+    //camera values change once per frame, model transforms and skeletons per object, the rest per material
+    for(int i=0;i<shared_shader::predefines_count;++i)
+    {
+        const shader_description::predefined &p=desc.predefines[i];
+        if(p.name.empty())
+            continue;
 
-    if(!res.shdr.add_program(nya_render::shader::pixel,desc.pixel.c_str()))
-        return false;
+        const bool per_frame=(i==shared_shader::camera_pos || i==shared_shader::camera_rot || i==shared_shader::camera_dir ||
+                              i==shared_shader::viewport) && p.transform==shared_shader::none;
+        res.shdr.set_uniform_frequency(p.name.c_str(),per_frame?nya_render::shader::frequency_frame:nya_render::shader::frequency_object);
+    }
+
+    for(int i=0;i<(int)res.uniforms.size();++i)
+    {
+        if(res.uniforms[i].transform!=shared_shader::none)
+            res.shdr.set_uniform_frequency(desc.uniforms[res.uniforms[i].name].c_str(),nya_render::shader::frequency_object);
+    }
+
+    if(res.features.empty())
+    {
+        if(!res.shdr.add_program(nya_render::shader::vertex,desc.vertex.c_str()))
+            return false;
+
+        if(!res.shdr.add_program(nya_render::shader::pixel,desc.pixel.c_str()))
+            return false;
+    }
+    else
+    {
+        nya_render::shader_code_parser vertex(desc.vertex.c_str(),"");
+        nya_render::shader_code_parser pixel(desc.pixel.c_str(),"");
+        if(!vertex.resolve_features(res.features,features_mask) || !pixel.resolve_features(res.features,features_mask))
+        {
+            log()<<"unable to resolve shader features: "<<vertex.get_error()<<pixel.get_error()<<"\n";
+            return false;
+        }
+
+        if(!res.shdr.add_program(nya_render::shader::vertex,vertex.get_code()))
+            return false;
+
+        if(!res.shdr.add_program(nya_render::shader::pixel,pixel.get_code()))
+            return false;
+    }
+
+    if(desc.skeleton_pos_max_count>0 || desc.skeleton_rot_max_count>0)
+    {
+        skeleton_blit.init();
+        res.texture_buffers.allocate();
+    }
+
+    if(desc.skeleton_pos_max_count>0)
+    {
+        res.texture_buffers->skeleton_pos_max_count=desc.skeleton_pos_max_count;
+        res.texture_buffers->skeleton_pos_texture.build_texture(0,desc.skeleton_pos_max_count,1,nya_render::texture::color_rgb32f,1);
+        res.texture_buffers->skeleton_pos_texture.set_filter(nya_render::texture::filter_nearest,
+                                                             nya_render::texture::filter_nearest,nya_render::texture::filter_nearest);
+    }
+
+    if(desc.skeleton_rot_max_count>0)
+    {
+        res.texture_buffers->skeleton_rot_max_count=desc.skeleton_rot_max_count;
+        res.texture_buffers->skeleton_rot_texture.build_texture(0,desc.skeleton_rot_max_count,1,nya_render::texture::color_rgba32f,1);
+        res.texture_buffers->skeleton_rot_texture.set_filter(nya_render::texture::filter_nearest,
+                                                             nya_render::texture::filter_nearest,nya_render::texture::filter_nearest);
+    }
 
     for(int i=0;i<shared_shader::predefines_count;++i)
     {
@@ -417,6 +492,7 @@ bool shader::load(const char *name)
 {
     shader_internal::default_load_function(load_nya_shader);
     m_internal.reset_skeleton();
+    m_internal.set_features(0);
     return m_internal.load(name);
 }
 
@@ -447,16 +523,78 @@ bool shader::build(const char *code_text)
     return result;
 }
 
+bool shader::set_features(const char *keys)
+{
+    m_internal.set_features(0);
+    if(!keys || !m_internal.get_shared_data().is_valid())
+        return false;
+
+    const std::vector<std::string> &features=m_internal.get_shared_data()->features;
+    unsigned int mask=0;
+    bool result=true;
+    for(const char *c=keys;*c;)
+    {
+        while(*c==',' || *c==' ' || *c=='\t')
+            ++c;
+        const char *from=c;
+        while(*c && *c!=',' && *c!=' ' && *c!='\t')
+            ++c;
+        if(c==from)
+            break;
+
+        const std::string key(from,c-from);
+        const std::vector<std::string>::const_iterator it=std::find(features.begin(),features.end(),key);
+        if(it==features.end())
+        {
+            log()<<"unknown feature "<<key.c_str()<<" in shader "<<get_name()<<"\n";
+            result=false;
+            continue;
+        }
+
+        mask|=1u<<(it-features.begin());
+    }
+
+    m_internal.set_features(mask);
+    return result;
+}
+
+int shader::get_features_count() const
+{
+    if(!m_internal.get_shared_data().is_valid())
+        return 0;
+
+    return (int)m_internal.get_shared_data()->features.size();
+}
+
+const char *shader::get_feature_name(int idx) const
+{
+    if(idx<0 || idx>=get_features_count())
+        return 0;
+
+    return m_internal.get_shared_data()->features[idx].c_str();
+}
+
+void shader::prepare_permutations() const
+{
+    if(!m_internal.get_shared_data().is_valid())
+        return;
+
+    const unsigned int skeleton_features=m_internal.get_shared_data()->skeleton_features;
+    m_internal.get_permutation(m_internal.get_features() & ~skeleton_features);
+    m_internal.get_permutation(m_internal.get_features() | skeleton_features);
+}
+
 void shader_internal::set() const
 {
     if(!m_shared.is_valid())
         return;
 
-    m_shared->shdr.bind();
+    const shared_shader &sh=get_current_permutation();
+    sh.shdr.bind();
 
-    for(size_t i=0;i<m_shared->predefines.size();++i)
+    for(size_t i=0;i<sh.predefines.size();++i)
     {
-        const shared_shader::predefined &p=m_shared->predefines[i];
+        const shared_shader::predefined &p=sh.predefines[i];
         switch(p.type)
         {
             case shared_shader::camera_pos:
@@ -464,22 +602,22 @@ void shader_internal::set() const
                 if(p.transform==shared_shader::local)
                 {
                     const nya_math::vec3 v=transform::get().inverse_transform(get_camera().get_pos());
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
                 else if(p.transform==shared_shader::local_rot)
                 {
                     const nya_math::vec3 v=transform::get().inverse_rot(get_camera().get_pos());
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
                 else if(p.transform==shared_shader::local_rot_scale)
                 {
                     const nya_math::vec3 v=transform::get().inverse_rot_scale(get_camera().get_pos());
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
                 else
                 {
                     const nya_math::vec3 v=get_camera().get_pos();
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
             }
             break;
@@ -489,12 +627,12 @@ void shader_internal::set() const
                 if(p.transform==shared_shader::local_rot || p.transform==shared_shader::local)
                 {
                     const nya_math::vec3 v=transform::get().inverse_rot(get_camera().get_dir());
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
                 else
                 {
                     const nya_math::vec3 v=get_camera().get_dir();
-                    m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                    sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
                 }
             }
             break;
@@ -504,159 +642,115 @@ void shader_internal::set() const
                 if(p.transform==shared_shader::local_rot || p.transform==shared_shader::local)
                 {
                     const nya_math::quat v=transform::get().inverse_transform(get_camera().get_rot());
-                    m_shared->shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
+                    sh.shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
                 }
                 else
                 {
                     const nya_math::quat v=get_camera().get_rot();
-                    m_shared->shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
+                    sh.shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
                 }
             }
             break;
 
             case shared_shader::bones_pos:
             {
-                if(m_skeleton && m_shared->last_skeleton_pos!=m_skeleton)
-                {
-                    m_shared->shdr.set_uniform3_array(p.location,m_skeleton->get_pos_buffer(),m_skeleton->get_bones_count());
-                    m_shared->last_skeleton_pos=m_skeleton;
-                }
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_pos,sh.last_skeleton_pos_version))
+                    sh.shdr.set_uniform3_array(p.location,m_skeleton->get_pos_buffer(),m_skeleton->get_bones_count());
             }
             break;
 
             case shared_shader::bones_pos_tr:
             {
-                if(m_skeleton && m_shared->last_skeleton_pos!=m_skeleton)
-                {
-                    nya_memory::tmp_buffer_scoped tmp(m_skeleton->get_bones_count()*3*4);
-                    nya_math::vec3 *pos=(nya_math::vec3 *)tmp.get_data();
-
-                    if(m_skeleton->has_original_rot())
-                    {
-                        for(int i=0;i<m_skeleton->get_bones_count();++i)
-                        {
-                            pos[i]=m_skeleton->get_bone_pos(i)
-                                  +(m_skeleton->get_bone_rot(i)*nya_math::quat::invert(m_skeleton->get_bone_original_rot(i)))
-                                  .rotate(-m_skeleton->get_bone_original_pos(i));
-                        }
-                    }
-                    else
-                    {
-                        for(int i=0;i<m_skeleton->get_bones_count();++i)
-                        {
-                            pos[i]=m_skeleton->get_bone_pos(i)
-                                  +m_skeleton->get_bone_rot(i).rotate(-m_skeleton->get_bone_original_pos(i));
-                        }
-                    }
-
-                    m_shared->shdr.set_uniform3_array(p.location,(float *)tmp.get_data(),m_skeleton->get_bones_count());
-                    m_shared->last_skeleton_pos=m_skeleton;
-                }
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_pos,sh.last_skeleton_pos_version))
+                    sh.shdr.set_uniform3_array(p.location,m_skeleton->get_skinning_pos_buffer(),m_skeleton->get_bones_count());
             }
             break;
 
             case shared_shader::bones_rot:
             {
-                if(m_skeleton && m_shared->last_skeleton_rot!=m_skeleton)
-                {
-                    m_shared->shdr.set_uniform4_array(p.location,m_skeleton->get_rot_buffer(),m_skeleton->get_bones_count());
-                    m_shared->last_skeleton_rot=m_skeleton;
-                }
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_rot,sh.last_skeleton_rot_version))
+                    sh.shdr.set_uniform4_array(p.location,m_skeleton->get_rot_buffer(),m_skeleton->get_bones_count());
             }
             break;
 
             case shared_shader::bones_rot_tr:
             {
-                if(m_skeleton && m_shared->last_skeleton_rot!=m_skeleton)
-                {
-                    nya_memory::tmp_buffer_scoped tmp(m_skeleton->get_bones_count()*4*4);
-                    nya_math::quat *rot=(nya_math::quat *)tmp.get_data();
-                    for(int i=0;i<m_skeleton->get_bones_count();++i)
-                        rot[i]=m_skeleton->get_bone_rot(i)*nya_math::quat::invert(m_skeleton->get_bone_original_rot(i));
-
-                    m_shared->shdr.set_uniform4_array(p.location,(float *)tmp.get_data(),m_skeleton->get_bones_count());
-                    m_shared->last_skeleton_rot=m_skeleton;
-                }
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_rot,sh.last_skeleton_rot_version))
+                    sh.shdr.set_uniform4_array(p.location,m_skeleton->get_skinning_rot_buffer(),m_skeleton->get_bones_count());
             }
             break;
 
-            case shared_shader::bones_pos_tex:
+            case shared_shader::bones_dq_tr:
             {
-                if(!m_shared->texture_buffers.is_valid())
-                    m_shared->texture_buffers.allocate();
-
-                if(m_skeleton && m_shared->texture_buffers->last_skeleton_pos_texture!=m_skeleton && m_skeleton->get_bones_count()>0)
-                {
-                    skeleton_blit.blit(m_shared->texture_buffers->skeleton_pos_texture,m_skeleton->get_pos_buffer(),m_skeleton->get_bones_count(),3);
-                    m_shared->texture_buffers->last_skeleton_pos_texture=m_skeleton;
-                }
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_pos,sh.last_skeleton_pos_version))
+                    sh.shdr.set_uniform4_array(p.location,m_skeleton->get_skinning_dq_buffer(),m_skeleton->get_bones_count()*2);
+            }
+            break;
 
-                m_shared->texture_buffers->skeleton_pos_texture.bind(p.location);
+            case shared_shader::bones_mat34_tr:
+            {
+                if(skeleton_outdated(m_skeleton,sh.last_skeleton_pos,sh.last_skeleton_pos_version))
+                    sh.shdr.set_uniform4_array(p.location,m_skeleton->get_skinning_mat34_buffer(),m_skeleton->get_bones_count()*3);
             }
             break;
 
+            case shared_shader::bones_pos_tex:
             case shared_shader::bones_pos_tr_tex:
             {
-                if(!m_shared->texture_buffers.is_valid())
-                    m_shared->texture_buffers.allocate();
+                if(!sh.texture_buffers.is_valid())
+                    sh.texture_buffers.allocate();
 
-                //ToDo: if(m_skeleton->has_original_rot())
-
-                if(m_skeleton && m_shared->texture_buffers->last_skeleton_pos_texture!=m_skeleton && m_skeleton->get_bones_count()>0)
+                if(m_skeleton && m_skeleton->get_bones_count()>0
+                   && skeleton_outdated(m_skeleton,sh.texture_buffers->last_skeleton_pos_texture,sh.texture_buffers->last_skeleton_pos_texture_version))
                 {
-                    nya_memory::tmp_buffer_scoped tmp(m_skeleton->get_bones_count()*3*4);
-                    nya_math::vec3 *pos=(nya_math::vec3 *)tmp.get_data();
-                    for(int i=0;i<m_skeleton->get_bones_count();++i)
-                        pos[i]=m_skeleton->get_bone_pos(i)+m_skeleton->get_bone_rot(i).rotate(-m_skeleton->get_bone_original_pos(i));
-
-                    skeleton_blit.blit(m_shared->texture_buffers->skeleton_pos_texture,(float *)tmp.get_data(),m_skeleton->get_bones_count(),3);
-                    m_shared->texture_buffers->last_skeleton_pos_texture=m_skeleton;
+                    const float *buf=p.type==shared_shader::bones_pos_tex?m_skeleton->get_pos_buffer():m_skeleton->get_skinning_pos_buffer();
+                    skeleton_blit.blit(sh.texture_buffers->skeleton_pos_texture,buf,m_skeleton->get_bones_count(),3);
                 }
 
-                m_shared->texture_buffers->skeleton_pos_texture.bind(p.location);
+                sh.texture_buffers->skeleton_pos_texture.bind(p.location);
             }
             break;
 
             case shared_shader::bones_rot_tex:
             {
-                if(!m_shared->texture_buffers.is_valid())
-                    m_shared->texture_buffers.allocate();
+                if(!sh.texture_buffers.is_valid())
+                    sh.texture_buffers.allocate();
 
-                if(m_skeleton && m_shared->texture_buffers->last_skeleton_rot_texture!=m_skeleton && m_skeleton->get_bones_count()>0)
+                if(m_skeleton && m_skeleton->get_bones_count()>0
+                   && skeleton_outdated(m_skeleton,sh.texture_buffers->last_skeleton_rot_texture,sh.texture_buffers->last_skeleton_rot_texture_version))
                 {
-                    skeleton_blit.blit(m_shared->texture_buffers->skeleton_rot_texture,m_skeleton->get_rot_buffer(),m_skeleton->get_bones_count(),4);
-                    m_shared->texture_buffers->last_skeleton_rot_texture=m_skeleton;
+                    skeleton_blit.blit(sh.texture_buffers->skeleton_rot_texture,m_skeleton->get_rot_buffer(),m_skeleton->get_bones_count(),4);
                 }
 
-                m_shared->texture_buffers->skeleton_rot_texture.bind(p.location);
+                sh.texture_buffers->skeleton_rot_texture.bind(p.location);
             }
             break;
 
             case shared_shader::viewport:
             {
                 nya_render::rect r=nya_render::get_viewport();
-                m_shared->shdr.set_uniform(p.location,float(r.x),float(r.y),float(r.width),float(r.height));
+                sh.shdr.set_uniform(p.location,float(r.x),float(r.y),float(r.width),float(r.height));
             }
             break;
 
             case shared_shader::model_pos:
             {
                 const nya_math::vec3 v=transform::get().get_pos();
-                m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
             }
             break;
 
             case shared_shader::model_rot:
             {
                 const nya_math::quat v=transform::get().get_rot();
-                m_shared->shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
+                sh.shdr.set_uniform(p.location,v.v.x,v.v.y,v.v.z,v.w);
             }
             break;
 
             case shared_shader::model_scale:
             {
                 const nya_math::vec3 v=transform::get().get_scale();
-                m_shared->shdr.set_uniform(p.location,v.x,v.y,v.z);
+                sh.shdr.set_uniform(p.location,v.x,v.y,v.z);
             }
             break;
 
@@ -664,7 +758,56 @@ void shader_internal::set() const
         }
     }
 
-    m_shared->shdr.bind();
+    sh.shdr.bind();
+}
+
+const shared_shader &shader_internal::get_permutation(unsigned int mask) const
+{
+    const shared_shader &base=*m_shared.const_get();
+    mask&=base.features.size()<32?(1u<<base.features.size())-1:~0u;
+    if(!mask || !base.description.is_valid())
+        return base;
+
+    std::map<unsigned int,nya_memory::shared_ptr<shared_shader> >::const_iterator it=base.permutations.find(mask);
+    if(it!=base.permutations.end())
+        return it->second.is_valid()?*it->second.operator->():base;
+
+    nya_memory::shared_ptr<shared_shader> &p=base.permutations[mask];
+
+    shared_shader variant;
+    variant.uniforms=base.uniforms;
+    variant.features=base.features;
+    shader_description desc=*base.description.operator->();
+    if(!build_nya_shader(variant,desc,mask))
+    {
+        log()<<"unable to build permutation "<<mask<<" of shader "<<get_name()<<"\n";
+        variant.features.clear();
+        variant.release();
+        return base;
+    }
+
+    //skeleton features are selected at draw time, so they shouldn't move samplers bound by materials
+    const unsigned int static_mask=mask & ~base.skeleton_features;
+    if(static_mask!=mask && variant.samplers!=get_permutation(static_mask).samplers)
+    {
+        log()<<"shader "<<get_name()<<": skeleton features change samplers layout, permutation "<<mask<<" is not used\n";
+        variant.features.clear();
+        variant.release();
+        const shared_shader &fallback=get_permutation(static_mask);
+        if(static_mask)
+            p=base.permutations[static_mask];
+        return fallback;
+    }
+
+    variant.features.clear();
+    p.create(variant);
+    return *p.operator->();
+}
+
+const shared_shader &shader_internal::get_current_permutation() const
+{
+    const bool skinned=m_skeleton && m_skeleton->get_bones_count()>0;
+    return get_permutation(skinned?m_features|m_shared->skeleton_features:m_features & ~m_shared->skeleton_features);
 }
 
 int shader_internal::get_texture_slot(const char *semantics) const
@@ -672,9 +815,10 @@ int shader_internal::get_texture_slot(const char *semantics) const
     if(!semantics || !m_shared.is_valid())
         return -1;
 
-    for(int i=0;i<(int)m_shared->samplers.size();++i)
+    const shared_shader &sh=get_permutation(m_features);
+    for(int i=0;i<(int)sh.samplers.size();++i)
     {
-        if(m_shared->samplers[i]==semantics)
+        if(sh.samplers[i]==semantics)
             return i;
     }
 
@@ -683,10 +827,11 @@ int shader_internal::get_texture_slot(const char *semantics) const
 
 const char *shader_internal::get_texture_semantics(int slot) const
 {
-    if(!m_shared.is_valid() || slot<0 || slot>=(int)m_shared->samplers.size())
+    if(!m_shared.is_valid() || slot<0)
         return 0;
 
-    return m_shared->samplers[slot].c_str();
+    const shared_shader &sh=get_permutation(m_features);
+    return slot<(int)sh.samplers.size()?sh.samplers[slot].c_str():0;
 }
 
 int shader_internal::get_texture_slots_count() const
@@ -694,7 +839,7 @@ int shader_internal::get_texture_slots_count() const
     if(!m_shared.is_valid())
         return 0;
 
-    return (int)m_shared->samplers.size();
+    return (int)get_permutation(m_features).samplers.size();
 }
 
 int shader_internal::get_uniform_idx(const char *name) const
@@ -724,7 +869,11 @@ nya_render::shader::uniform_type shader_internal::get_uniform_type(int idx) cons
     if(!m_shared.is_valid())
         return nya_render::shader::uniform_not_found;
 
-    return m_shared->shdr.get_uniform_type(get_uniform(idx).location);
+    if(idx<0 || idx>=(int)m_shared->uniforms.size())
+        return nya_render::shader::uniform_not_found;
+
+    const shared_shader &sh=get_current_permutation();
+    return sh.shdr.get_uniform_type(sh.uniforms[idx].location);
 }
 
 unsigned int shader_internal::get_uniform_array_size(int idx) const
@@ -732,7 +881,11 @@ unsigned int shader_internal::get_uniform_array_size(int idx) const
     if(!m_shared.is_valid())
         return 0;
 
-    return m_shared->shdr.get_uniform_array_size(get_uniform(idx).location);
+    if(idx<0 || idx>=(int)m_shared->uniforms.size())
+        return 0;
+
+    const shared_shader &sh=get_current_permutation();
+    return sh.shdr.get_uniform_array_size(sh.uniforms[idx].location);
 }
 
 void shader_internal::set_uniform_value(int idx,float f0,float f1,float f2,float f3) const
@@ -740,26 +893,27 @@ void shader_internal::set_uniform_value(int idx,float f0,float f1,float f2,float
     if(!m_shared.is_valid() || idx<0 || idx >=(int)m_shared->uniforms.size())
         return;
 
-    if(m_shared->uniforms[idx].location<0)
+    const shared_shader &sh=get_current_permutation();
+    if(sh.uniforms[idx].location<0)
         return;
 
-    if(m_shared->uniforms[idx].transform==shared_shader::local)
+    if(sh.uniforms[idx].transform==shared_shader::local)
     {
         nya_math::vec3 v=transform::get().inverse_transform(nya_math::vec3(f0,f1,f2));
-        m_shared->shdr.set_uniform(m_shared->uniforms[idx].location,v.x,v.y,v.z,f3);
+        sh.shdr.set_uniform(sh.uniforms[idx].location,v.x,v.y,v.z,f3);
     }
-    else if(m_shared->uniforms[idx].transform==shared_shader::local_rot)
+    else if(sh.uniforms[idx].transform==shared_shader::local_rot)
     {
         nya_math::vec3 v=transform::get().inverse_rot(nya_math::vec3(f0,f1,f2));
-        m_shared->shdr.set_uniform(m_shared->uniforms[idx].location,v.x,v.y,v.z,f3);
+        sh.shdr.set_uniform(sh.uniforms[idx].location,v.x,v.y,v.z,f3);
     }
-    else if(m_shared->uniforms[idx].transform==shared_shader::local_rot_scale)
+    else if(sh.uniforms[idx].transform==shared_shader::local_rot_scale)
     {
         nya_math::vec3 v=transform::get().inverse_rot_scale(nya_math::vec3(f0,f1,f2));
-        m_shared->shdr.set_uniform(m_shared->uniforms[idx].location,v.x,v.y,v.z,f3);
+        sh.shdr.set_uniform(sh.uniforms[idx].location,v.x,v.y,v.z,f3);
     }
     else
-        m_shared->shdr.set_uniform(m_shared->uniforms[idx].location,f0,f1,f2,f3);
+        sh.shdr.set_uniform(sh.uniforms[idx].location,f0,f1,f2,f3);
 }
 
 void shader_internal::set_uniform4_array(int idx,const float *array,unsigned int count) const
@@ -767,7 +921,8 @@ void shader_internal::set_uniform4_array(int idx,const float *array,unsigned int
     if(!m_shared.is_valid() || idx<0 || idx >=(int)m_shared->uniforms.size())
         return;
 
-    m_shared->shdr.set_uniform4_array(m_shared->uniforms[idx].location,array,count);
+    const shared_shader &sh=get_current_permutation();
+    sh.shdr.set_uniform4_array(sh.uniforms[idx].location,array,count);
 }
 
 int shader_internal::get_uniforms_count() const
@@ -7,11 +7,16 @@
 #include "render/skeleton.h"
 #include "math/vector.h"
 #include "memory/optional.h"
+#include "memory/shared_ptr.h"
 #include "scene/texture.h"
+#include "formats/math_expr_parser.h"
+#include <map>
 
 namespace nya_scene
 {
 
+struct shader_description;
+
 struct shared_shader
 {
     nya_render::shader shdr;
@@ -30,6 +35,8 @@ struct shared_shader
         bones_pos_tex,
         bones_pos_tr_tex,
         bones_rot_tex,
+        bones_dq_tr,
+        bones_mat34_tr,
         viewport,
         model_pos,
         model_rot,
@@ -69,10 +76,32 @@ struct shared_shader
 
     std::vector<uniform> uniforms;
 
-	shared_shader():last_skeleton_pos(0),last_skeleton_rot(0){}
+    //permutations, @feature keys resolved with shader_code_parser; this resource is built with none of them
+    //variants are built lazily from the description and keyed by enabled features mask
+    std::vector<std::string> features;
+    unsigned int skeleton_features; //enabled automatically when drawn with a skeleton
+    nya_memory::shared_ptr<shader_description> description;
+    mutable std::map<unsigned int,nya_memory::shared_ptr<shared_shader> > permutations;
+
+    std::vector<std::string> includes; //files included by nya shader, for hot reload
+    unsigned int version; //changes when released, so materials rebind reloaded shaders
+
+	shared_shader():skeleton_features(0),version(0),last_skeleton_pos(0),last_skeleton_rot(0),last_skeleton_pos_version(0),last_skeleton_rot_version(0){}
 
     bool release()
     {
+        for(std::map<unsigned int,nya_memory::shared_ptr<shared_shader> >::iterator it=permutations.begin();it!=permutations.end();++it)
+        {
+            if(it->second.is_valid())
+                it->second->release();
+        }
+        permutations.clear();
+        features.clear();
+        includes.clear();
+        ++version;
+        skeleton_features=0;
+        description.free();
+
         shdr.release();
         predefines.clear();
         uniforms.clear();
@@ -95,22 +124,58 @@ struct shared_shader
         nya_render::texture skeleton_rot_texture;
         const nya_render::skeleton *last_skeleton_pos_texture;
         const nya_render::skeleton *last_skeleton_rot_texture;
+        unsigned int last_skeleton_pos_texture_version;
+        unsigned int last_skeleton_rot_texture_version;
 
         texture_buffers():skeleton_pos_max_count(0),skeleton_rot_max_count(0),
-                          last_skeleton_pos_texture(0),last_skeleton_rot_texture(0) {}
+                          last_skeleton_pos_texture(0),last_skeleton_rot_texture(0),
+                          last_skeleton_pos_texture_version(0),last_skeleton_rot_texture_version(0) {}
     };
 
     mutable nya_memory::optional<texture_buffers> texture_buffers;
 
-    //cache
+    //cache, skeleton and its version at the last upload
+    //dq and mat34 palettes carry position, so they share the pos slot
     const mutable nya_render::skeleton *last_skeleton_pos;
     const mutable nya_render::skeleton *last_skeleton_rot;
+    mutable unsigned int last_skeleton_pos_version;
+    mutable unsigned int last_skeleton_rot_version;
+};
+
+inline void replace_shared_resource(shared_shader &res,shared_shader &reloaded) { const unsigned int v=res.version; res=reloaded; res.version=v; }
+
+//parsed nya shader, sources for permutations
+struct shader_description
+{
+    struct predefined
+    {
+        std::string name;
+        shared_shader::transform_type transform;
+    };
+
+    predefined predefines[shared_shader::predefines_count];
+
+    typedef std::map<std::string,std::string> strings_map;
+    strings_map samplers;
+    strings_map uniforms;
+
+    std::vector<std::pair<std::string,nya_formats::math_expr_parser> > procedural;
+
+    std::string vertex;
+    std::string pixel;
+
+    unsigned int skeleton_pos_max_count;
+    unsigned int skeleton_rot_max_count;
+
+    shader_description(): skeleton_pos_max_count(0),skeleton_rot_max_count(0) {}
 };
 
 class shader_internal: public scene_shared<shared_shader>
 {
 public:
     void set() const;
+    void set_features(unsigned int mask) { m_features=mask; }
+    unsigned int get_features() const { return m_features; }
     static void unset() { nya_render::shader::unbind(); }
 
     static void set_skeleton(const nya_render::skeleton *skeleton) { m_skeleton=skeleton; }
@@ -131,8 +196,17 @@ public:
     void set_uniform_value(int idx,float f0,float f1,float f2,float f3) const;
     void set_uniform4_array(int idx,const float *array,unsigned int count) const;
 
+public:
+    //permutation selected by features, with skeleton features if drawn with a skeleton
+    const shared_shader &get_permutation(unsigned int mask) const;
+    const shared_shader &get_current_permutation() const;
+
+public:
+    shader_internal(): m_features(0) {}
+
 private:
     static const nya_render::skeleton *m_skeleton;
+    unsigned int m_features;
 };
 
 class shader
@@ -152,6 +226,16 @@ public:
 public:
     const char *get_name() const { return m_internal.get_name(); }
 
+public:
+    //enables feature keys declared with @feature in shader, separated by commas or spaces
+    //keys declared with "nya skeleton" semantics are enabled automatically for meshes with bones
+    bool set_features(const char *keys);
+    int get_features_count() const;
+    const char *get_feature_name(int idx) const;
+
+    //builds the selected permutation and its skeleton variant ahead of drawing
+    void prepare_permutations() const;
+
 public:
     shader() {}
     shader(const char *name) { *this=shader(); load(name); }
@@ -0,0 +1,128 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "shader_warmup.h"
+#include "material.h"
+#include "scene.h"
+#include "resources/resources.h"
+#include "formats/text_parser.h"
+#include <string.h>
+
+namespace nya_scene
+{
+
+namespace
+{
+    bool read_resource(const std::string &name,std::vector<char> &buf)
+    {
+        nya_resources::resource_data *data=nya_resources::get_resources_provider().access(name.c_str());
+        if(!data)
+            return false;
+
+        buf.resize(data->get_size());
+        const bool result=buf.empty() || data->read_all(&buf[0]);
+        data->release();
+        return result;
+    }
+}
+
+void shader_warmup::start(const char **materials,int count)
+{
+    if(!is_ready())
+        finish();
+
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        m_materials.clear();
+        for(int i=0;materials && i<count;++i)
+        {
+            if(materials[i] && materials[i][0])
+                m_materials.push_back(materials[i]);
+        }
+        m_shader_names.clear();
+        m_ready=false;
+    }
+
+    nya_memory::thread_pool::get().add_task(&m_task,&m_group);
+}
+
+bool shader_warmup::is_ready()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    return m_ready;
+}
+
+int shader_warmup::finish()
+{
+    nya_memory::thread_pool::get().wait(m_group);
+
+    int count=0;
+    for(size_t i=0;i<m_shader_names.size();++i)
+    {
+        shader sh;
+        if(!sh.load(m_shader_names[i].c_str()))
+            continue;
+
+        m_shaders.push_back(sh);
+        ++count;
+    }
+
+    m_shader_names.clear();
+    return count;
+}
+
+void shader_warmup::release()
+{
+    m_shaders.clear();
+}
+
+void shader_warmup::parse()
+{
+    std::vector<std::string> materials;
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        materials.swap(m_materials);
+    }
+
+    std::vector<std::string> names;
+    std::vector<char> buf;
+    for(size_t i=0;i<materials.size();++i)
+    {
+        if(!read_resource(std::string(material_internal::get_resources_prefix())+materials[i],buf))
+        {
+            log()<<"shader warmup: unable to read material "<<materials[i].c_str()<<"\n";
+            continue;
+        }
+
+        nya_formats::text_parser parser;
+        parse_text(parser,buf.empty()?0:&buf[0],buf.size());
+        for(int section_idx=0;section_idx<parser.get_sections_count();++section_idx)
+        {
+            if(strcmp(parser.get_section_type(section_idx),"@pass")!=0)
+                continue;
+
+            for(int subsection_idx=0;subsection_idx<parser.get_subsections_count(section_idx);++subsection_idx)
+            {
+                const char *type=parser.get_subsection_type(section_idx,subsection_idx);
+                const char *value=parser.get_subsection_value(section_idx,subsection_idx);
+                if(!type || !value || strcmp(type,"shader")!=0)
+                    continue;
+
+                bool found=false;
+                for(size_t j=0;j<names.size() && !found;++j)
+                    found=names[j]==value;
+                if(!found)
+                    names.push_back(value);
+            }
+        }
+    }
+
+    //read ahead, so loading in finish() hits the os file cache
+    for(size_t i=0;i<names.size();++i)
+        read_resource(std::string(shader_internal::get_resources_prefix())+names[i],buf);
+
+    nya_memory::lock_guard lock(m_mutex);
+    m_shader_names.swap(names);
+    m_ready=true;
+}
+
+}
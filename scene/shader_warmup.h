@@ -0,0 +1,58 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "shader.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
+#include <string>
+#include <vector>
+
+namespace nya_scene
+{
+
+//precompiles shaders referenced by a material list at startup
+//materials are parsed and shader files are read on the shared thread pool,
+//gl programs are created on the render thread in finish(), where the compiled shaders provider serves binaries
+//warmed up shaders are held until release(), so later material loads share them
+class shader_warmup
+{
+public:
+    void start(const char **materials,int count);
+    bool is_ready();
+
+    //render thread, waits for the background part, returns loaded shaders count
+    int finish();
+
+    void release();
+
+public:
+    int get_shaders_count() const { return (int)m_shaders.size(); }
+
+public:
+    shader_warmup(): m_ready(true) { m_task.w=this; }
+    ~shader_warmup() { finish(); release(); }
+
+private:
+    void parse();
+
+    class task: public nya_memory::thread_pool::task
+    {
+    public:
+        void run() { w->parse(); }
+
+    public:
+        shader_warmup *w;
+    };
+
+private:
+    std::vector<std::string> m_materials;
+    std::vector<std::string> m_shader_names;
+    std::vector<shader> m_shaders;
+    nya_memory::mutex m_mutex;
+    bool m_ready;
+    task m_task;
+    nya_memory::thread_pool::task_group m_group;
+};
+
+}
@@ -10,6 +10,12 @@ namespace nya_scene
 
 typedef nya_memory::tmp_buffer_ref resource_data;
 
+//memory held by a loaded resource for the unused resources cache, overloaded for resources owning vmem
+template<typename t> size_t get_shared_resource_size(const t &res) { return sizeof(t); }
+
+//moves a reloaded resource in place of the released one, overloaded for resources tracking their address or version
+template<typename t> void replace_shared_resource(t &res,t &reloaded) { res=reloaded; }
+
 template<typename t>
 class scene_shared
 {
@@ -76,6 +82,15 @@ public:
         return get_shared_resources().reload_resource((get_resources_prefix_str()+name).c_str());
     }
 
+public:
+    typedef typename nya_resources::shared_resources<t,8>::cache_stats cache_stats;
+
+    //unloaded resources stay loaded up to the budget in bytes and are reused by load(), least recently used are released first
+    //0 by default, resources are released when unused
+    static void set_cache_budget(size_t bytes) { get_shared_resources().set_cache_budget(bytes); }
+    static cache_stats get_cache_stats() { return get_shared_resources().get_cache_stats(); }
+    static void reset_cache_stats() { get_shared_resources().reset_cache_stats(); }
+
 public:
     typedef bool (*load_function)(t &sh,resource_data &data,const char *name);
 
@@ -160,6 +175,19 @@ protected:
         {
             return res.release();
         }
+
+        size_t get_resource_size(const t &res)
+        {
+            return get_shared_resource_size(res);
+        }
+
+        void replace_resource(t &res,t &reloaded)
+        {
+            replace_shared_resource(res,reloaded);
+        }
+
+    public:
+        ~shared_resources_manager() { this->flush_cache(); }
     };
 
 public:
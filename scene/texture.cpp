@@ -4,6 +4,8 @@
 #include "scene.h"
 #include "memory/memory_reader.h"
 #include "memory/tmp_buffer.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
 #include "formats/tga.h"
 #include "formats/dds.h"
 #include "formats/ktx.h"
@@ -13,10 +15,114 @@
 #include "render/screen_quad.h"
 #include "render/bitmap.h"
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 namespace nya_scene
 {
 
+namespace
+{
+    //textures may be loaded and released outside of the render thread
+    std::vector<shared_texture *> streamed_textures;
+    nya_memory::mutex streamed_textures_mutex;
+
+    //paged mips are read on the thread pool and uploaded by update_streaming on the render thread
+    class stream_read: public nya_memory::thread_pool::task
+    {
+    public:
+        void run();
+
+    public:
+        shared_texture *tex; //reset if texture is released before the read is finished
+        int mip;
+        std::string source;
+        std::vector<shared_texture::stream_mip> mips; //from mip to the last one
+        std::vector<char> data; //packed mips
+        bool done,result;
+    };
+
+    std::vector<stream_read *> stream_reads;
+
+    void stream_read::run()
+    {
+        const unsigned int from=mips.front().offset;
+        const unsigned int to=mips.back().offset+mips.back().size;
+
+        std::vector<char> buf(to>from?to-from:0);
+        bool read=false;
+        nya_resources::resource_data *file_data=nya_resources::get_resources_provider().access(source.c_str());
+        if(file_data)
+        {
+            read=!buf.empty() && file_data->read_chunk(&buf[0],buf.size(),from);
+            file_data->release();
+        }
+
+        if(read)
+        {
+            //mips are packed in place, dropping mip and row padding
+            char *d=buf.empty()?0:&buf[0];
+            for(size_t i=0;i<mips.size();++i)
+            {
+                const shared_texture::stream_mip &m=mips[i];
+                const char *src=&buf[m.offset-from];
+                if(m.padded_row!=m.row)
+                {
+                    for(unsigned int y=0;y<m.size/m.padded_row;++y,d+=m.row)
+                        memmove(d,src+y*m.padded_row,m.row);
+                }
+                else
+                {
+                    memmove(d,src,m.size);
+                    d+=m.size;
+                }
+            }
+
+            buf.resize(d-&buf[0]);
+        }
+        else
+            log()<<"unable to stream texture: unable to read "<<source.c_str()<<"\n";
+
+        nya_memory::lock_guard lock(streamed_textures_mutex);
+        data.swap(buf);
+        result=read;
+        done=true;
+    }
+
+    unsigned int get_stream_size(const shared_texture &t,int mip)
+    {
+        unsigned int size=t.tex.get_vmem_size();
+        for(int i=t.stream_resident_mip;i>mip;--i)
+            size*=4;
+        for(int i=t.stream_resident_mip;i<mip;++i)
+            size/=4;
+        return size;
+    }
+
+    //least detail a texture should keep: requested mip if used during the frame, initial mip otherwise
+    int get_stream_keep_mip(const shared_texture &t,unsigned int frame)
+    {
+        return t.stream_last_frame==frame?t.stream_required_mip:t.stream_lowest_mip;
+    }
+}
+
+bool shared_texture::release()
+{
+    texture::stream_unregister(*this);
+    tex.release();
+    *this=shared_texture();
+    return true;
+}
+
+void replace_shared_resource(shared_texture &res,shared_texture &reloaded)
+{
+    //streaming tracks textures by address, reads of the old data are dropped
+    texture::stream_unregister(res);
+    texture::stream_unregister(reloaded);
+    res=reloaded;
+    texture::stream_register(res);
+}
+
 int texture::m_load_ktx_mip_offset=0;
 
 bool texture::load_ktx(shared_texture &res,resource_data &data,const char* name)
@@ -59,10 +165,37 @@ bool texture::load_ktx(shared_texture &res,resource_data &data,const char* name)
         default: log()<<"unable to load ktx: unsupported color format in file "<<name<<"\n"; return false;
     }
 
-    const int mip_off=m_load_ktx_mip_offset>=int(ktx.mipmap_count)?0:m_load_ktx_mip_offset;
+    int mip_off=m_load_ktx_mip_offset>=int(ktx.mipmap_count)?0:m_load_ktx_mip_offset;
+    const unsigned int bpp=ktx.pf==nya_formats::ktx::rgb?3:(ktx.pf<nya_formats::ktx::etc1?4:0);
+
+    if(m_streaming)
+    {
+        std::vector<shared_texture::stream_mip> mips;
+        const size_t data_offset=(const char *)ktx.data-(const char *)data.get_data();
+        nya_memory::memory_reader r(ktx.data,ktx.data_size);
+        for(unsigned int i=0,w=ktx.width,h=ktx.height;i<ktx.mipmap_count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
+        {
+            const unsigned int size=r.read<unsigned int>();
+            if(r.get_remained()<size)
+                break;
+
+            if(int(i)>=mip_off)
+            {
+                const unsigned int row=w*bpp,padded_row=(row+3)&~3u;
+                const shared_texture::stream_mip m={(unsigned int)(data_offset+r.get_offset()),size,row,
+                                                     padded_row!=row && size==padded_row*h?padded_row:row};
+                mips.push_back(m);
+            }
+            r.skip(size+3-(size+3)%4);
+        }
+
+        if(mips.size()==ktx.mipmap_count-mip_off)
+            mip_off+=stream_init(res,name,ktx.width>>mip_off,ktx.height>>mip_off,cf,mips);
+    }
+
     char *d=(char *)ktx.data;
     nya_memory::memory_reader r(ktx.data,ktx.data_size);
-    for(unsigned int i=0;i<ktx.mipmap_count;++i)
+    for(unsigned int i=0,w=ktx.width,h=ktx.height;i<ktx.mipmap_count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
     {
         const unsigned int size=r.read<unsigned int>();
         if(int(i)>=mip_off)
@@ -73,16 +206,32 @@ bool texture::load_ktx(shared_texture &res,resource_data &data,const char* name)
                 return false;
             }
 
-            memmove(d,r.get_data(),size);
-            d+=size;
+            //uncompressed rows are 4 bytes aligned
+            const unsigned int row=w*bpp,padded_row=(row+3)&~3u;
+            if(padded_row!=row && size==padded_row*h)
+            {
+                for(unsigned int y=0;y<h;++y,d+=row)
+                    memmove(d,(const char *)r.get_data()+y*padded_row,row);
+            }
+            else
+            {
+                memmove(d,r.get_data(),size);
+                d+=size;
+            }
         }
-        r.skip(size);
+        r.skip(size+3-(size+3)%4); //mip padding
     }
 
     const int width=ktx.width>>mip_off;
     const int height=ktx.height>>mip_off;
     read_meta(res,data);
-    return res.tex.build_texture(ktx.data,width>0?width:1,height>0?height:1,cf,ktx.mipmap_count-mip_off);
+    const bool result=res.tex.build_texture(ktx.data,width>0?width:1,height>0?height:1,cf,ktx.mipmap_count-mip_off);
+    if(result && !res.stream_source.empty())
+    {
+        res.stream_lowest_data.assign((char *)ktx.data,d);
+        stream_register(res);
+    }
+    return result;
 }
 
 bool texture::m_load_dds_flip=false;
@@ -168,6 +317,31 @@ bool texture::load_dds(shared_texture &res,resource_data &data,const char* name)
 
     const bool decode_dxt=cf>=nya_render::texture::dxt1 && (!nya_render::texture::is_dxt_supported() || dds.height%2>0);
 
+    //mips are streamed as they are stored, converted or flipped textures are loaded whole
+    if(m_streaming && dds.type==nya_formats::dds::texture_2d && mipmap_count>1 && !decode_dxt && !m_load_dds_flip &&
+       dds.pf!=nya_formats::dds::bgr)
+    {
+        std::vector<shared_texture::stream_mip> mips(mipmap_count);
+        size_t offset=(const char *)dds.data-(const char *)data.get_data();
+        for(int i=0;i<mipmap_count;++i)
+        {
+            const shared_texture::stream_mip m={(unsigned int)offset,(unsigned int)dds.get_mip_size(i),0,0};
+            mips[i]=m;
+            offset+=m.size;
+        }
+
+        const int stream_off=stream_init(res,name,dds.width,dds.height,cf,mips);
+        for(int i=0;i<stream_off;++i)
+        {
+            dds.data=(char *)dds.data+dds.get_mip_size(0);
+            dds.data_size-=dds.get_mip_size(0);
+            dds.width=dds.width>1?dds.width/2:1;
+            dds.height=dds.height>1?dds.height/2:1;
+            --dds.mipmap_count;
+            --mipmap_count;
+        }
+    }
+
     switch(dds.type)
     {
         case nya_formats::dds::texture_2d:
@@ -184,14 +358,20 @@ bool texture::load_dds(shared_texture &res,resource_data &data,const char* name)
                     mipmap_count= -1;
             }
 
+            nya_memory::tmp_buffer_ref flip_buf;
+            const void *tex_data=dds.data;
             if(m_load_dds_flip)
             {
-                nya_memory::tmp_buffer_scoped tmp_data(dds.data_size);
-                dds.flip_vertical(dds.data,tmp_data.get_data());
-                result=res.tex.build_texture(tmp_data.get_data(),dds.width,dds.height,cf,mipmap_count);
+                flip_buf.allocate(dds.data_size);
+                dds.flip_vertical(dds.data,flip_buf.get_data());
+                tex_data=flip_buf.get_data();
             }
-            else
-                result=res.tex.build_texture(dds.data,dds.width,dds.height,cf,mipmap_count);
+
+            const bool compress=cf<nya_render::texture::greyscale && mipmap_count<=1;
+            result=compress && build_compressed(res.tex,tex_data,dds.width,dds.height,cf,read_meta_compression(data,m_load_compression));
+            if(!result)
+                result=res.tex.build_texture(tex_data,dds.width,dds.height,cf,mipmap_count);
+            flip_buf.free();
         }
         break;
 
@@ -224,6 +404,12 @@ bool texture::load_dds(shared_texture &res,resource_data &data,const char* name)
         }
     }
 
+    if(result && !res.stream_source.empty())
+    {
+        res.stream_lowest_data.assign((const char *)dds.data,(const char *)dds.data+dds.data_size);
+        stream_register(res);
+    }
+
     tmp_buf.free();
     read_meta(res,data);
     return result;
@@ -302,9 +488,12 @@ bool texture::load_tga(shared_texture &res,resource_data &data,const char* name)
             nya_render::bitmap_rgb_to_bgr((unsigned char*)color_data,tga.width,tga.height,3);
     }
 
-    const bool result=res.tex.build_texture(color_data,tga.width,tga.height,color_format);
+    read_meta(res,data); //wrap is used for mips generation
+    const compression c=read_meta_compression(data,m_load_compression);
+    bool result=build_compressed(res.tex,color_data,tga.width,tga.height,color_format,c);
+    if(!result)
+        result=res.tex.build_texture(color_data,tga.width,tga.height,color_format);
     tmp_data.free();
-    read_meta(res,data);
     return result;
 }
 
@@ -318,6 +507,357 @@ inline nya_render::texture::wrap get_wrap(const std::string &s)
     return nya_render::texture::wrap_clamp;
 }
 
+texture::compression texture::m_load_compression=texture::compression_none;
+bool texture::m_streaming=false;
+unsigned int texture::m_stream_budget=0;
+unsigned int texture::m_stream_initial_size=64;
+int texture::m_stream_loads_per_update=4;
+unsigned int texture::m_stream_frame=1;
+texture::streaming_stats texture::m_stream_stats=texture::streaming_stats();
+
+void texture::set_streaming(bool enable,unsigned int vmem_budget,unsigned int initial_size)
+{
+    m_streaming=enable;
+    m_stream_budget=vmem_budget;
+    m_stream_initial_size=initial_size>0?initial_size:1;
+}
+
+int texture::stream_init(shared_texture &res,const char *name,uint width,uint height,color_format format,
+                         const std::vector<shared_texture::stream_mip> &mips)
+{
+    const int mip_count=(int)mips.size();
+    if(!m_streaming || !name || mip_count<2)
+        return 0;
+
+    int mip=0;
+    while(mip+1<mip_count && ((width>>mip)>m_stream_initial_size || (height>>mip)>m_stream_initial_size))
+        ++mip;
+
+    if(!mip)
+        return 0;
+
+    res.stream_source=name;
+    res.stream_width=width;
+    res.stream_height=height;
+    res.stream_mip_count=mip_count;
+    res.stream_resident_mip=res.stream_lowest_mip=res.stream_required_mip=mip;
+    res.stream_mips=mips;
+    res.stream_format=format;
+    return mip;
+}
+
+void texture::stream_register(shared_texture &res)
+{
+    if(res.stream_source.empty())
+        return;
+
+    nya_memory::lock_guard lock(streamed_textures_mutex);
+    if(std::find(streamed_textures.begin(),streamed_textures.end(),&res)==streamed_textures.end())
+        streamed_textures.push_back(&res);
+}
+
+void texture::stream_unregister(shared_texture &res)
+{
+    if(res.stream_source.empty())
+        return;
+
+    nya_memory::lock_guard lock(streamed_textures_mutex);
+    std::vector<shared_texture *>::iterator it=std::find(streamed_textures.begin(),streamed_textures.end(),&res);
+    if(it!=streamed_textures.end())
+        streamed_textures.erase(it);
+
+    for(size_t i=0;i<stream_reads.size();++i)
+    {
+        if(stream_reads[i]->tex==&res)
+            stream_reads[i]->tex=0;
+    }
+    res.stream_pending_mip=-1;
+}
+
+bool texture::stream_build(shared_texture &res,int mip,const void *data)
+{
+    nya_render::texture tex;
+    nya_render::texture::wrap s,t;
+    res.tex.get_wrap(s,t);
+    tex.set_wrap(s,t);
+    if(res.stream_aniso>=0)
+        tex.set_aniso(res.stream_aniso);
+
+    const uint width=res.stream_width>>mip,height=res.stream_height>>mip;
+    if(!tex.build_texture(data,width>0?width:1,height>0?height:1,res.stream_format,res.stream_mip_count-mip))
+        return false;
+
+    res.tex.release();
+    res.tex=tex;
+    res.stream_resident_mip=mip;
+    return true;
+}
+
+void texture::request_resolution(unsigned int screen_size) const
+{
+    if(!internal().get_shared_data().is_valid())
+        return;
+
+    const shared_texture &res=*internal().get_shared_data().const_get();
+    if(res.stream_source.empty())
+        return;
+
+    const unsigned int size=res.stream_width>res.stream_height?res.stream_width:res.stream_height;
+    int mip=0;
+    while(mip+1<res.stream_mip_count && (size>>(mip+1))>=screen_size)
+        ++mip;
+
+    if(res.stream_last_frame!=m_stream_frame || mip<res.stream_required_mip)
+        res.stream_required_mip=mip;
+    res.stream_last_frame=m_stream_frame;
+}
+
+void texture::update_streaming()
+{
+    const unsigned int frame=m_stream_frame++;
+
+    streaming_stats &stats=m_stream_stats;
+    std::vector<stream_read *> issued;
+
+    {
+    //streamed textures can't be released while paged
+    nya_memory::lock_guard lock(streamed_textures_mutex);
+
+    stats=streaming_stats();
+    stats.budget=m_stream_budget;
+
+    //finished reads are uploaded here, on the render thread
+    for(size_t i=0;i<stream_reads.size();)
+    {
+        stream_read *r=stream_reads[i];
+        if(!r->done)
+        {
+            ++i;
+            continue;
+        }
+
+        shared_texture *t=r->tex;
+        if(t)
+        {
+            t->stream_pending_mip=-1;
+            if(r->result && r->mip<t->stream_resident_mip && stream_build(*t,r->mip,&r->data[0]))
+                ++stats.loaded_count;
+        }
+
+        delete r;
+        stream_reads.erase(stream_reads.begin()+i);
+    }
+
+    //pending reads are counted at their target size
+    unsigned int resident=0;
+    std::vector<shared_texture *> loads;
+    for(size_t i=0;i<streamed_textures.size();++i)
+    {
+        shared_texture &t=*streamed_textures[i];
+        if(t.stream_pending_mip>=0)
+        {
+            resident+=t.tex.get_vmem_size()+get_stream_size(t,t.stream_pending_mip);
+            continue;
+        }
+
+        resident+=t.tex.get_vmem_size();
+        if(t.stream_last_frame==frame && t.stream_required_mip<t.stream_resident_mip)
+            loads.push_back(&t);
+    }
+
+    //most missing detail first
+    for(size_t i=1;i<loads.size();++i)
+    {
+        for(size_t j=i;j>0 && loads[j]->stream_resident_mip-loads[j]->stream_required_mip >
+                              loads[j-1]->stream_resident_mip-loads[j-1]->stream_required_mip;--j)
+            std::swap(loads[j],loads[j-1]);
+    }
+
+    std::vector<shared_texture *> failed;
+    for(size_t i=0;i<=loads.size();++i)
+    {
+        shared_texture *t=i<loads.size()?loads[i]:0;
+        if(t && (int)stream_reads.size()>=m_stream_loads_per_update)
+            break;
+
+        int mip=t?t->stream_required_mip:0;
+        const unsigned int current=t?t->tex.get_vmem_size():0;
+
+        //evict least recently requested textures to fit the budget, down to the mips kept in memory
+        while(m_stream_budget && resident-current+(t?get_stream_size(*t,mip):0)>m_stream_budget)
+        {
+            shared_texture *victim=0;
+            for(size_t j=0;j<streamed_textures.size();++j)
+            {
+                shared_texture *v=streamed_textures[j];
+                if(v==t || v->stream_pending_mip>=0 || v->stream_resident_mip>=get_stream_keep_mip(*v,frame))
+                    continue;
+
+                if(std::find(failed.begin(),failed.end(),v)!=failed.end())
+                    continue;
+
+                if(!victim || v->stream_last_frame<victim->stream_last_frame)
+                    victim=v;
+            }
+
+            if(!victim)
+                break;
+
+            const unsigned int victim_size=victim->tex.get_vmem_size();
+            if(!stream_build(*victim,victim->stream_lowest_mip,&victim->stream_lowest_data[0]))
+            {
+                failed.push_back(victim);
+                continue;
+            }
+
+            resident=resident-victim_size+victim->tex.get_vmem_size();
+            ++stats.evicted_count;
+        }
+
+        if(!t)
+            break;
+
+        while(m_stream_budget && mip<t->stream_resident_mip && resident-current+get_stream_size(*t,mip)>m_stream_budget)
+            ++mip;
+
+        if(mip>=t->stream_resident_mip)
+            continue;
+
+        stream_read *r=new stream_read();
+        r->tex=t;
+        r->mip=mip;
+        r->source=t->stream_source;
+        r->mips.assign(t->stream_mips.begin()+mip,t->stream_mips.end());
+        r->done=r->result=false;
+        t->stream_pending_mip=mip;
+        stream_reads.push_back(r);
+        issued.push_back(r);
+
+        resident+=get_stream_size(*t,mip);
+    }
+
+    stats.textures_count=(int)streamed_textures.size();
+    stats.resident_size=resident;
+    stats.reading_count=(int)stream_reads.size();
+    for(size_t i=0;i<streamed_textures.size();++i)
+    {
+        const shared_texture &t=*streamed_textures[i];
+        const int required=t.stream_last_frame==frame?t.stream_required_mip:t.stream_resident_mip;
+        stats.required_size+=get_stream_size(t,required);
+        if(required<t.stream_resident_mip)
+            ++stats.partially_resident_count;
+    }
+    }
+
+    //outside of the lock, tasks are run in place if the pool has no threads
+    for(size_t i=0;i<issued.size();++i)
+        nya_memory::thread_pool::get().add_task(issued[i]);
+}
+
+texture::compression texture::read_meta_compression(resource_data &data,compression default_compression)
+{
+    nya_formats::meta m;
+    if(!m.read(data.get_data(),data.get_size()))
+        return default_compression;
+
+    for(int i=0;i<(int)m.values.size();++i)
+    {
+        if(m.values[i].first!="nya_compress")
+            continue;
+
+        const std::string &v=m.values[i].second;
+        if(v=="dxt")
+            return compression_dxt;
+        if(v=="etc")
+            return compression_etc;
+        if(v=="none")
+            return compression_none;
+    }
+
+    return default_compression;
+}
+
+bool texture::build_compressed(nya_render::texture &tex,const void *data,uint width,uint height,color_format format,compression c)
+{
+    if(c==compression_none || !data)
+        return false;
+
+    if(format!=nya_render::texture::color_rgba && format!=nya_render::texture::color_bgra && format!=nya_render::texture::color_rgb)
+        return false;
+
+    if(width%4 || height%4)
+        return false;
+
+    const int channels=format==nya_render::texture::color_rgb?3:4;
+    const bool has_alpha=channels==4 && !nya_render::bitmap_is_full_alpha((const unsigned char *)data,width,height);
+
+    typedef nya_render::texture tex_t;
+    color_format cf;
+    if(c==compression_dxt)
+        cf=has_alpha?tex_t::dxt5:tex_t::dxt1;
+    else if(has_alpha)
+        cf=tex_t::etc2_eac;
+    else
+        cf=tex_t::is_format_supported(tex_t::etc1)?tex_t::etc1:tex_t::etc2;
+
+    if(!tex_t::is_format_supported(cf))
+        return false;
+
+    const bool pot=((width&(width-1))==0 && (height&(height-1))==0);
+    int mip_count=1;
+    if(pot)
+    {
+        for(uint w=width,h=height;w>1 || h>1;w=w>1?w/2:1,h=h>1?h/2:1)
+            ++mip_count;
+    }
+
+    const int block_size=(cf==tex_t::dxt1 || cf==tex_t::etc1 || cf==tex_t::etc2)?8:16;
+    size_t compressed_size=0;
+    uint w=width,h=height;
+    for(int i=0;i<mip_count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
+        compressed_size+=nya_render::bitmap_compressed_size(w,h,block_size);
+
+    nya_memory::tmp_buffer_scoped rgba(nya_render::bitmap_get_mip_chain_size(width,height,4,mip_count));
+    nya_memory::tmp_buffer_scoped compressed(compressed_size);
+    unsigned char *src=(unsigned char *)rgba.get_data();
+    if(channels==3)
+        nya_render::bitmap_rgb_to_rgba((const unsigned char *)data,width,height,255,src);
+    else if(format==tex_t::color_bgra)
+        nya_render::bitmap_rgb_to_bgr((const unsigned char *)data,width,height,4,src);
+    else
+        rgba.copy_from(data,width*height*4);
+
+    tex_t::mip_generation gen;
+    nya_render::bitmap_mip_settings settings;
+    tex_t::get_default_mip_generation(gen,settings.srgb,settings.alpha_coverage);
+    if(gen==tex_t::mip_generation_kaiser)
+        settings.filter=nya_render::bitmap_mip_filter_kaiser;
+    else if(gen==tex_t::mip_generation_lanczos)
+        settings.filter=nya_render::bitmap_mip_filter_lanczos;
+    tex_t::wrap wrap_s,wrap_t;
+    tex.get_wrap(wrap_s,wrap_t);
+    settings.wrap=wrap_s==tex_t::wrap_repeat && wrap_t==tex_t::wrap_repeat;
+    nya_render::bitmap_build_mip_chain(src,width,height,4,mip_count,settings,src);
+
+    unsigned char *out=(unsigned char *)compressed.get_data();
+    w=width,h=height;
+    for(int i=0;i<mip_count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
+    {
+        switch(cf)
+        {
+            case tex_t::dxt1: nya_render::bitmap_compress_dxt1(src,w,h,out); break;
+            case tex_t::dxt5: nya_render::bitmap_compress_dxt5(src,w,h,out); break;
+            case tex_t::etc2_eac: nya_render::bitmap_compress_etc2_eac(src,w,h,out); break;
+            default: nya_render::bitmap_compress_etc1(src,w,h,out); break;
+        }
+
+        out+=nya_render::bitmap_compressed_size(w,h,block_size);
+        src+=w*h*4;
+    }
+
+    return tex.build_texture(compressed.get_data(),width,height,cf,mip_count);
+}
+
 bool texture::read_meta(shared_texture &res,resource_data &data)
 {
     nya_formats::meta m;
@@ -337,7 +877,8 @@ bool texture::read_meta(shared_texture &res,resource_data &data)
         else if(m.values[i].first=="nya_aniso")
         {
             const int aniso=atoi(m.values[i].second.c_str());
-            res.tex.set_aniso(aniso>0?aniso:0);
+            res.stream_aniso=aniso>0?aniso:0;
+            res.tex.set_aniso(res.stream_aniso);
         }
     }
 
@@ -374,6 +915,9 @@ unsigned int texture::get_width() const
     if( !internal().get_shared_data().is_valid() )
         return 0;
 
+    if(internal().get_shared_data()->stream_width)
+        return internal().get_shared_data()->stream_width;
+
     return internal().get_shared_data()->tex.get_width();
 }
 
@@ -382,6 +926,9 @@ unsigned int texture::get_height() const
     if(!internal().get_shared_data().is_valid())
         return 0;
 
+    if(internal().get_shared_data()->stream_height)
+        return internal().get_shared_data()->stream_height;
+
     return internal().get_shared_data()->tex.get_height();
 }
 
@@ -444,13 +991,16 @@ bool texture::crop(uint x,uint y,uint width,uint height)
         return true;
     }
 
-    if(x==0 && y==0 && width==get_width() && height==get_height())
-        return true;
-
-    if(x+width>get_width() || y+height>get_height())
+    if(!m_internal.m_shared.is_valid())
         return false;
 
-    if(!m_internal.m_shared.is_valid())
+    //streamed textures may have only low mips in vmem
+    const uint tex_width=m_internal.m_shared->tex.get_width(),tex_height=m_internal.m_shared->tex.get_height();
+
+    if(x==0 && y==0 && width==tex_width && height==tex_height)
+        return true;
+
+    if(x+width>tex_width || y+height>tex_height)
         return false;
 
     nya_render::texture new_tex;
@@ -472,7 +1022,7 @@ bool texture::crop(uint x,uint y,uint width,uint height)
         }
 
         nya_memory::tmp_buffer_scoped buf(get_data());
-        nya_render::bitmap_crop((unsigned char *)buf.get_data(),get_width(),get_height(),x,y,width,height,channels);
+        nya_render::bitmap_crop((unsigned char *)buf.get_data(),tex_width,tex_height,x,y,width,height,channels);
         return build(buf.get_data(),width,height,get_format());
     }
 
@@ -13,13 +13,33 @@ struct shared_texture
 {
     nya_render::texture tex;
 
-    bool release()
-    {
-        tex.release();
-        return true;
-    }
+    //mip streaming state, stream_source is empty if texture is not streamed
+    std::string stream_source;
+    unsigned int stream_width,stream_height;
+    int stream_mip_count;
+    int stream_resident_mip; //top mip in vmem
+    int stream_lowest_mip; //initially loaded mip, never evicted
+    int stream_pending_mip; //>=0 while its mips are read
+    mutable int stream_required_mip;
+    mutable unsigned int stream_last_frame;
+
+    //file range of every mip, so paged mips are read without parsing the file again
+    struct stream_mip { unsigned int offset,size,row,padded_row; }; //rows are repacked if padded_row differs
+    std::vector<stream_mip> stream_mips;
+    nya_render::texture::color_format stream_format;
+    std::vector<char> stream_lowest_data; //mips from stream_lowest_mip, evicted textures are rebuilt from it
+    int stream_aniso; //from meta, <0 if not set
+
+    bool release();
+
+    shared_texture(): stream_width(0),stream_height(0),stream_mip_count(0),stream_resident_mip(0),stream_lowest_mip(0),
+                      stream_pending_mip(-1),stream_required_mip(0),stream_last_frame(0),stream_format(nya_render::texture::color_rgba),
+                      stream_aniso(-1) {}
 };
 
+inline size_t get_shared_resource_size(const shared_texture &res) { return sizeof(res)+res.tex.get_vmem_size()+res.stream_lowest_data.size(); }
+void replace_shared_resource(shared_texture &res,shared_texture &reloaded);
+
 class texture_internal: public scene_shared<shared_texture>
 {
     friend class texture;
@@ -90,12 +110,56 @@ public:
     static void set_dds_mip_offset(int off) { m_load_dds_mip_offset=off; }
     static void set_ktx_mip_offset(int off) { m_load_ktx_mip_offset=off; }
 
+    enum compression
+    {
+        compression_none,
+        compression_dxt,
+        compression_etc
+    };
+
+    //runtime block compression of rgb/rgba/bgra textures on load, falls back to uncompressed if unsupported
+    //"nya_compress" meta value (none, dxt, etc) overrides it per texture
+    static void set_load_compression(compression c) { m_load_compression=c; }
+
+    //mip streaming of dds and ktx 2d textures with mipmaps, applies to textures loaded after it was enabled
+    //mips up to initial_size are loaded first, higher mips are paged in and out by update_streaming()
+    //within vmem_budget (bytes, 0 - unlimited), least recently requested textures are evicted first
+    //paged mips are read on the thread pool and uploaded by the next update_streaming() call
+    static void set_streaming(bool enable,unsigned int vmem_budget=0,unsigned int initial_size=64);
+    static void set_streaming_loads_per_update(int count) { m_stream_loads_per_update=count; }
+    static void update_streaming(); //call once per frame
+    static bool is_streaming() { return m_streaming; }
+
+    struct streaming_stats
+    {
+        int textures_count;
+        int partially_resident_count; //textures with some requested mips not in vmem
+        unsigned int resident_size; //vmem used by streamed textures
+        unsigned int required_size; //vmem needed for all requested mips
+        unsigned int budget;
+        int loaded_count; //during last update
+        int evicted_count;
+        int reading_count; //page-in reads in progress
+    };
+
+    static const streaming_stats &get_streaming_stats() { return m_stream_stats; }
+
+    //streaming feedback, screen_size is the approximate size in pixels the texture is drawn with
+    void request_resolution(unsigned int screen_size) const;
+
+public:
     static bool read_meta(shared_texture &res,resource_data &data);
+    static compression read_meta_compression(resource_data &data,compression default_compression);
+    static bool build_compressed(nya_render::texture &tex,const void *data,uint width,uint height,color_format format,compression c);
 
 public:
     static void set_resources_prefix(const char *prefix);
     static void register_load_function(texture_internal::load_function function,bool clear_default=true);
 
+    //unloaded textures stay in vmem up to the budget in bytes and are reused by load()
+    static void set_cache_budget(size_t bytes) { texture_internal::set_cache_budget(bytes); }
+    static texture_internal::cache_stats get_cache_stats() { return texture_internal::get_cache_stats(); }
+
 public:
     const texture_internal &internal() const { return m_internal; }
 
@@ -104,6 +168,23 @@ private:
     static bool m_load_dds_flip;
     static int m_load_dds_mip_offset;
     static int m_load_ktx_mip_offset;
+    static compression m_load_compression;
+
+private:
+    friend struct shared_texture;
+    friend void replace_shared_resource(shared_texture &res,shared_texture &reloaded);
+    static int stream_init(shared_texture &res,const char *name,uint width,uint height,color_format format,
+                           const std::vector<shared_texture::stream_mip> &mips);
+    static void stream_register(shared_texture &res);
+    static void stream_unregister(shared_texture &res);
+    static bool stream_build(shared_texture &res,int mip,const void *data);
+
+    static bool m_streaming;
+    static unsigned int m_stream_budget;
+    static unsigned int m_stream_initial_size;
+    static int m_stream_loads_per_update;
+    static unsigned int m_stream_frame;
+    static streaming_stats m_stream_stats;
 };
 
 }
@@ -0,0 +1,345 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "texture_atlas.h"
+#include "scene.h"
+#include "memory/tmp_buffer.h"
+#include "memory/invalid_object.h"
+#include <algorithm>
+#include <string.h>
+
+namespace nya_scene
+{
+
+namespace
+{
+    const unsigned int block_size=4;
+
+    unsigned int align_block(unsigned int size) { return (size+block_size-1)/block_size*block_size; }
+
+    int get_channels(nya_render::texture::color_format format)
+    {
+        switch(format)
+        {
+            case nya_render::texture::color_rgba:
+            case nya_render::texture::color_bgra: return 4;
+            case nya_render::texture::color_rgb: return 3;
+            case nya_render::texture::greyscale: return 1;
+            default: return 0;
+        }
+    }
+
+    //fills the whole cell, pixels outside of the texture repeat its nearest edge
+    void extrude(const unsigned char *src,unsigned int width,unsigned int height,int channels,unsigned int padding,
+                 unsigned int cell_width,unsigned int cell_height,unsigned char *dst,unsigned int dst_pitch)
+    {
+        for(unsigned int cy=0;cy<cell_height;++cy)
+        {
+            const unsigned int sy=cy<padding?0:(cy-padding<height?cy-padding:height-1);
+            const unsigned char *src_row=src+size_t(sy)*width*channels;
+            unsigned char *dst_row=dst+size_t(cy)*dst_pitch;
+            for(unsigned int cx=0;cx<cell_width;++cx)
+            {
+                const unsigned int sx=cx<padding?0:(cx-padding<width?cx-padding:width-1);
+                memcpy(dst_row+cx*channels,src_row+sx*channels,channels);
+            }
+        }
+    }
+}
+
+texture_atlas::texture_atlas(uint page_width,uint page_height,uint padding):
+    m_page_width(align_block(page_width)),m_page_height(align_block(page_height)),m_padding(padding) {}
+
+bool texture_atlas::add(const char *name)
+{
+    if(!name)
+        return false;
+
+    texture tex;
+    if(!tex.load(name))
+        return false;
+
+    return add(name,texture_proxy(tex));
+}
+
+bool texture_atlas::add(const char *name,const texture_proxy &tex)
+{
+    if(!tex.is_valid())
+        return false;
+
+    const nya_memory::tmp_buffer_scoped buf(tex->get_data());
+    if(!buf.get_size())
+    {
+        log()<<"unable to add atlas texture "<<(name?name:"")<<": unable to get texture data\n";
+        return false;
+    }
+
+    return add(name,buf.get_data(),tex->get_width(),tex->get_height(),tex->get_format());
+}
+
+bool texture_atlas::add(const char *name,const void *data,uint width,uint height,color_format format)
+{
+    if(!name || !data || !width || !height)
+        return false;
+
+    const int channels=get_channels(format);
+    if(!channels)
+    {
+        log()<<"unable to add atlas texture "<<name<<": unsupported format\n";
+        return false;
+    }
+
+    const uint cell_width=align_block(width+m_padding*2),cell_height=align_block(height+m_padding*2);
+    if(cell_width>m_page_width || cell_height>m_page_height)
+    {
+        log()<<"unable to add atlas texture "<<name<<": texture with padding is larger than page\n";
+        return false;
+    }
+
+    remove(name);
+
+    uint x,y;
+    const int page_idx=allocate(cell_width,cell_height,x,y);
+    if(page_idx<0)
+        return false;
+
+    page &p=m_pages[page_idx];
+
+    nya_memory::tmp_buffer_scoped buf(size_t(cell_width)*cell_height*channels);
+    extrude((const unsigned char *)data,width,height,channels,m_padding,cell_width,cell_height,
+            (unsigned char *)buf.get_data(),cell_width*channels);
+    if(!p.tex->update_region(buf.get_data(),x,y,cell_width,cell_height,format))
+    {
+        p.packer.remove(x/block_size,y/block_size,cell_width/block_size,cell_height/block_size);
+        return false;
+    }
+
+    region &r=m_regions[name];
+    r.tex=p.tex;
+    r.page=page_idx;
+    r.x=x+m_padding,r.y=y+m_padding;
+    r.width=width,r.height=height;
+    update_tc(r);
+    return true;
+}
+
+int texture_atlas::allocate(uint cell_width,uint cell_height,uint &x,uint &y)
+{
+    const int bw=cell_width/block_size,bh=cell_height/block_size;
+    int bx,by;
+    for(int i=0;i<(int)m_pages.size();++i)
+    {
+        if(!m_pages[i].packer.add(bw,bh,bx,by))
+            continue;
+
+        x=bx*block_size,y=by*block_size;
+        return i;
+    }
+
+    const size_t page_size=size_t(m_page_width)*m_page_height*4;
+    nya_memory::tmp_buffer_scoped buf(page_size);
+    memset(buf.get_data(),0,page_size);
+
+    page p;
+    p.tex=texture_proxy(texture());
+    if(!p.tex->build(buf.get_data(),m_page_width,m_page_height,nya_render::texture::color_rgba))
+    {
+        log()<<"unable to create atlas page\n";
+        return -1;
+    }
+
+    p.packer=nya_math::rect_packer(m_page_width/block_size,m_page_height/block_size);
+    if(!p.packer.add(bw,bh,bx,by))
+        return -1;
+
+    m_pages.push_back(p);
+    x=bx*block_size,y=by*block_size;
+    return (int)m_pages.size()-1;
+}
+
+void texture_atlas::update_tc(region &r) const
+{
+    r.tc.x=float(r.width)/m_page_width;
+    r.tc.y=float(r.height)/m_page_height;
+    r.tc.z=float(r.x)/m_page_width;
+    r.tc.w=float(r.y)/m_page_height;
+}
+
+bool texture_atlas::remove(const char *name)
+{
+    if(!name)
+        return false;
+
+    regions_map::iterator it=m_regions.find(name);
+    if(it==m_regions.end())
+        return false;
+
+    const region &r=it->second;
+    const uint cell_width=align_block(r.width+m_padding*2),cell_height=align_block(r.height+m_padding*2);
+    m_pages[r.page].packer.remove((r.x-m_padding)/block_size,(r.y-m_padding)/block_size,
+                                  cell_width/block_size,cell_height/block_size);
+    m_regions.erase(it);
+    return true;
+}
+
+void texture_atlas::clear()
+{
+    m_regions.clear();
+    m_pages.clear();
+}
+
+namespace
+{
+    struct defrag_item
+    {
+        const std::string *name;
+        unsigned int cell_width,cell_height;
+
+        bool operator < (const defrag_item &other) const
+        {
+            if(cell_height!=other.cell_height)
+                return cell_height>other.cell_height;
+            return cell_width>other.cell_width;
+        }
+    };
+}
+
+bool texture_atlas::defragment()
+{
+    if(m_regions.empty())
+    {
+        clear();
+        return true;
+    }
+
+    const size_t page_size=size_t(m_page_width)*m_page_height*4;
+    const size_t pitch=size_t(m_page_width)*4;
+
+    //old pages are read back once, new ones are composed on cpu
+    std::vector<nya_memory::tmp_buffer_ref> old_data(m_pages.size());
+    bool read_failed=false;
+    for(size_t i=0;i<m_pages.size() && !read_failed;++i)
+    {
+        old_data[i]=m_pages[i].tex->get_data();
+        read_failed=old_data[i].get_size()<page_size || m_pages[i].tex->get_format()!=nya_render::texture::color_rgba;
+    }
+
+    if(read_failed)
+    {
+        for(size_t i=0;i<old_data.size();++i)
+            old_data[i].free();
+
+        log()<<"unable to defragment texture atlas: unable to get page data\n";
+        return false;
+    }
+
+    std::vector<defrag_item> items;
+    for(regions_map::const_iterator it=m_regions.begin();it!=m_regions.end();++it)
+    {
+        defrag_item item;
+        item.name=&it->first;
+        item.cell_width=align_block(it->second.width+m_padding*2);
+        item.cell_height=align_block(it->second.height+m_padding*2);
+        items.push_back(item);
+    }
+
+    std::sort(items.begin(),items.end());
+
+    std::vector<nya_math::rect_packer> packers;
+    std::vector<nya_memory::tmp_buffer_ref> new_data;
+    regions_map new_regions;
+    for(size_t i=0;i<items.size();++i)
+    {
+        const defrag_item &item=items[i];
+        const int bw=item.cell_width/block_size,bh=item.cell_height/block_size;
+        int bx=0,by=0;
+        size_t page_idx=0;
+        while(page_idx<packers.size() && !packers[page_idx].add(bw,bh,bx,by))
+            ++page_idx;
+
+        if(page_idx==packers.size())
+        {
+            packers.push_back(nya_math::rect_packer(m_page_width/block_size,m_page_height/block_size));
+            packers.back().add(bw,bh,bx,by);
+            new_data.resize(new_data.size()+1);
+            new_data.back().allocate(page_size);
+            memset(new_data.back().get_data(),0,page_size);
+        }
+
+        const region &from=m_regions[*item.name];
+        const unsigned char *src=(const unsigned char *)old_data[from.page].get_data();
+        unsigned char *dst=(unsigned char *)new_data[page_idx].get_data();
+        const uint src_x=from.x-m_padding,src_y=from.y-m_padding;
+        const uint dst_x=bx*block_size,dst_y=by*block_size;
+        for(uint y=0;y<item.cell_height;++y)
+            memcpy(dst+(dst_y+y)*pitch+dst_x*4,src+(src_y+y)*pitch+src_x*4,item.cell_width*4);
+
+        region &r=new_regions[*item.name];
+        r=from;
+        r.page=(int)page_idx;
+        r.x=dst_x+m_padding,r.y=dst_y+m_padding;
+        update_tc(r);
+    }
+
+    for(size_t i=0;i<old_data.size();++i)
+        old_data[i].free();
+
+    //page proxies are kept so that regions already given out still reference a page
+    m_pages.resize(packers.size());
+    bool result=true;
+    for(size_t i=0;i<packers.size();++i)
+    {
+        page &p=m_pages[i];
+        if(!p.tex.is_valid())
+            p.tex=texture_proxy(texture());
+
+        p.packer=packers[i];
+        result=p.tex->build(new_data[i].get_data(),m_page_width,m_page_height,nya_render::texture::color_rgba) && result;
+        new_data[i].free();
+    }
+
+    for(regions_map::iterator it=new_regions.begin();it!=new_regions.end();++it)
+        it->second.tex=m_pages[it->second.page].tex;
+
+    m_regions.swap(new_regions);
+    return result;
+}
+
+bool texture_atlas::has(const char *name) const
+{
+    return name && m_regions.find(name)!=m_regions.end();
+}
+
+const texture_atlas::region &texture_atlas::get(const char *name) const
+{
+    if(!name)
+        return nya_memory::invalid_object<region>();
+
+    regions_map::const_iterator it=m_regions.find(name);
+    if(it==m_regions.end())
+        return nya_memory::invalid_object<region>();
+
+    return it->second;
+}
+
+const texture_proxy &texture_atlas::get_page(int idx) const
+{
+    if(idx<0 || idx>=(int)m_pages.size())
+        return nya_memory::invalid_object<texture_proxy>();
+
+    return m_pages[idx].tex;
+}
+
+texture_atlas::stats texture_atlas::get_stats() const
+{
+    stats s;
+    s.textures_count=(int)m_regions.size();
+    s.pages_count=(int)m_pages.size();
+    s.binds_saved=s.textures_count>s.pages_count?s.textures_count-s.pages_count:0;
+    s.used_area=0;
+    for(size_t i=0;i<m_pages.size();++i)
+        s.used_area+=m_pages[i].packer.get_used_area()*block_size*block_size;
+    s.pages_area=(uint)m_pages.size()*m_page_width*m_page_height;
+    return s;
+}
+
+}
@@ -0,0 +1,83 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "texture.h"
+#include "math/vector.h"
+#include "math/rect_packer.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nya_scene
+{
+
+//packs small textures into shared rgba pages so that they could be drawn with a single bind
+//each texture gets an extruded border of padding pixels and is aligned to 4 pixels to stay separated in lower mips
+class texture_atlas
+{
+public:
+    typedef unsigned int uint;
+    typedef nya_render::texture::color_format color_format;
+
+    struct region
+    {
+        texture_proxy tex; //page texture
+        nya_math::vec4 tc; //page_uv = uv * tc.xy + tc.zw
+        uint x,y,width,height; //in page pixels, without padding
+        int page;
+
+        region(): x(0),y(0),width(0),height(0),page(-1) {}
+    };
+
+public:
+    bool add(const char *name); //loads texture with that name
+    bool add(const char *name,const texture_proxy &tex);
+    bool add(const char *name,const void *data,uint width,uint height,color_format format);
+    bool remove(const char *name);
+    void clear();
+
+    //repacks all textures into as few pages as possible, regions may move
+    bool defragment();
+
+public:
+    bool has(const char *name) const;
+    const region &get(const char *name) const; //region with page -1 if not found
+    int get_pages_count() const { return (int)m_pages.size(); }
+    const texture_proxy &get_page(int idx) const;
+
+public:
+    struct stats
+    {
+        int textures_count;
+        int pages_count;
+        int binds_saved; //per frame, if every texture is drawn
+        uint used_area; //page pixels taken by textures with their borders
+        uint pages_area;
+    };
+
+    stats get_stats() const;
+
+public:
+    texture_atlas(uint page_width=1024,uint page_height=1024,uint padding=2);
+
+private:
+    int allocate(uint cell_width,uint cell_height,uint &x,uint &y);
+    void update_tc(region &r) const;
+
+private:
+    struct page
+    {
+        texture_proxy tex;
+        nya_math::rect_packer packer; //in 4x4 blocks
+    };
+
+    std::vector<page> m_pages;
+    typedef std::map<std::string,region> regions_map;
+    regions_map m_regions;
+
+    uint m_page_width,m_page_height;
+    uint m_padding;
+};
+
+}
@@ -0,0 +1,161 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include "assets_cache_provider.h"
+#include "resources/resources.h"
+
+#include <string.h>
+#include <stdio.h>
+
+namespace nya_system
+{
+
+namespace
+{
+    const char pack_name[]="assets.nac";
+    const char pack_sign[]={'n','a','c','1'};
+
+    struct pack_entry
+    {
+        uint64_t key;
+        uint32_t offset;
+        uint32_t size;
+    };
+}
+
+void compiled_assets_provider::set_load_path(const char *path)
+{
+    nya_memory::lock_guard lock(m_mutex);
+    m_load_path.assign(path?path:"");
+    m_entries.clear();
+    m_loaded=m_changed=false;
+}
+
+bool compiled_assets_provider::get(uint64_t key,std::vector<char> &data)
+{
+    data.clear();
+
+    nya_memory::lock_guard lock(m_mutex);
+    load_pack();
+
+    std::map<uint64_t,std::vector<char> >::const_iterator it=m_entries.find(key);
+    if(it==m_entries.end() || it->second.empty())
+    {
+        ++m_misses;
+        return false;
+    }
+
+    data=it->second;
+    ++m_hits;
+    return true;
+}
+
+bool compiled_assets_provider::set(uint64_t key,const void *data,size_t size)
+{
+    if(!data || !size)
+        return false;
+
+    nya_memory::lock_guard lock(m_mutex);
+    load_pack();
+    m_entries[key].assign((const char *)data,(const char *)data+size);
+    m_changed=true;
+    return true;
+}
+
+bool compiled_assets_provider::save()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    if(!m_changed)
+        return true;
+
+    load_pack();
+
+    std::vector<pack_entry> index;
+    index.reserve(m_entries.size());
+    uint32_t offset=uint32_t(sizeof(pack_sign)+sizeof(uint32_t)+m_entries.size()*sizeof(pack_entry));
+    for(std::map<uint64_t,std::vector<char> >::const_iterator it=m_entries.begin();it!=m_entries.end();++it)
+    {
+        pack_entry e;
+        e.key=it->first;
+        e.offset=offset;
+        e.size=uint32_t(it->second.size());
+        index.push_back(e);
+        offset+=e.size;
+    }
+
+    FILE *f=fopen((m_save_path+pack_name).c_str(),"wb");
+    if(!f)
+        return false;
+
+    const uint32_t count=uint32_t(index.size());
+    fwrite(pack_sign,sizeof(pack_sign),1,f);
+    fwrite(&count,sizeof(count),1,f);
+    if(count)
+        fwrite(&index[0],sizeof(pack_entry),count,f);
+    for(std::map<uint64_t,std::vector<char> >::const_iterator it=m_entries.begin();it!=m_entries.end();++it)
+    {
+        if(!it->second.empty())
+            fwrite(&it->second[0],it->second.size(),1,f);
+    }
+
+    const bool result=ferror(f)==0;
+    fclose(f);
+
+    m_changed=!result;
+    return result;
+}
+
+void compiled_assets_provider::preload_async()
+{
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        if(m_loaded)
+            return;
+    }
+
+    nya_memory::thread_pool::get().add_task(&m_preload);
+}
+
+void compiled_assets_provider::load_pack()
+{
+    if(m_loaded)
+        return;
+
+    m_loaded=true;
+
+    nya_resources::resource_data *data=nya_resources::get_resources_provider().access((m_load_path+pack_name).c_str());
+    if(!data)
+        return;
+
+    std::vector<char> buf(data->get_size());
+    const bool read=!buf.empty() && data->read_all(&buf[0]);
+    data->release();
+
+    const size_t header_size=sizeof(pack_sign)+sizeof(uint32_t);
+    if(!read || buf.size()<header_size || memcmp(&buf[0],pack_sign,sizeof(pack_sign))!=0)
+    {
+        nya_resources::log()<<"invalid compiled assets pack "<<m_load_path.c_str()<<pack_name<<"\n";
+        return;
+    }
+
+    uint32_t count;
+    memcpy(&count,&buf[sizeof(pack_sign)],sizeof(count));
+    if(count>(buf.size()-header_size)/sizeof(pack_entry))
+    {
+        nya_resources::log()<<"invalid compiled assets pack "<<m_load_path.c_str()<<pack_name<<"\n";
+        return;
+    }
+
+    for(uint32_t i=0;i<count;++i)
+    {
+        pack_entry e;
+        memcpy(&e,&buf[header_size+i*sizeof(pack_entry)],sizeof(e));
+        if(size_t(e.offset)+e.size>buf.size())
+            continue;
+
+        std::vector<char> &entry=m_entries[e.key];
+        if(entry.empty()) //entries added before loading are newer
+            entry.assign(buf.begin()+e.offset,buf.begin()+e.offset+e.size);
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#pragma once
+
+#include "scene/scene.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace nya_system
+{
+    //all compiled text assets are kept in a single pack file with an index, assets.nac in the load and save paths
+    //entries are keyed by nya_formats compiled keys, which include the source hash and the compiled format version
+    class compiled_assets_provider: public nya_scene::compiled_assets_provider
+    {
+    public:
+        void set_load_path(const char *path);
+        void set_save_path(const char *path) { m_save_path.assign(path?path:""); }
+
+    public:
+        static compiled_assets_provider &get()
+        {
+            static compiled_assets_provider cap;
+            return cap;
+        }
+
+    public:
+        bool get(uint64_t key,std::vector<char> &data);
+        bool set(uint64_t key,const void *data,size_t size);
+
+    public:
+        //writes the pack if there are new entries
+        bool save();
+
+        //reads the pack on the shared thread pool, get() waits for it if called earlier
+        //provider should be valid until preload is finished
+        void preload_async();
+
+    public:
+        unsigned int get_hits() const { return m_hits; }
+        unsigned int get_misses() const { return m_misses; }
+        void reset_stats() { m_hits=m_misses=0; }
+
+    public:
+        compiled_assets_provider(): m_loaded(false),m_changed(false),m_hits(0),m_misses(0) { m_preload.cap=this; }
+
+    private:
+        void load_pack();
+
+    private:
+        class preload_task: public nya_memory::thread_pool::task
+        {
+        public:
+            void run() { nya_memory::lock_guard lock(cap->m_mutex); cap->load_pack(); }
+
+        public:
+            compiled_assets_provider *cap;
+        };
+
+    private:
+        std::string m_load_path;
+        std::string m_save_path;
+        std::map<uint64_t,std::vector<char> > m_entries;
+        bool m_loaded;
+        bool m_changed;
+        unsigned int m_hits;
+        unsigned int m_misses;
+        nya_memory::mutex m_mutex;
+        preload_task m_preload;
+    };
+}
@@ -6,11 +6,32 @@
 #include <string.h>
 #include <stdio.h>
 
-//ToDo: hash collisions
-
 namespace nya_system
 {
 
+namespace
+{
+    const char pack_name[]="shaders.nsc";
+    const char pack_sign[]={'n','s','c','2'};
+
+    struct pack_entry
+    {
+        uint64_t hash;
+        uint32_t text_size;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t reserved;
+    };
+}
+
+void compiled_shaders_provider::set_load_path(const char *path)
+{
+    nya_memory::lock_guard lock(m_mutex);
+    m_load_path.assign(path?path:"");
+    m_entries.clear();
+    m_loaded=m_changed=false;
+}
+
 bool compiled_shaders_provider::get(const char *text,nya_render::compiled_shader &shader)
 {
     shader=nya_render::compiled_shader();
@@ -18,15 +39,23 @@ bool compiled_shaders_provider::get(const char *text,nya_render::compiled_shader
     if(!text)
         return false;
 
-    nya_resources::resource_data *data=
-    nya_resources::get_resources_provider().access((m_load_path+crc(text)+".nsc").c_str());
-    if(!data)
-        return false;
+    const uint64_t h=hash(text);
+    const uint32_t text_size=uint32_t(strlen(text));
 
-    shader=nya_render::compiled_shader(data->get_size());
-    data->read_all(shader.get_data());
-    data->release();
+    nya_memory::lock_guard lock(m_mutex);
+    load_pack();
 
+    std::map<uint64_t,entry>::const_iterator it=m_entries.find(h);
+    if(it==m_entries.end() || it->second.data.empty() || it->second.text_size!=text_size)
+    {
+        ++m_misses;
+        return false;
+    }
+
+    const std::vector<char> &data=it->second.data;
+    shader=nya_render::compiled_shader(data.size());
+    memcpy(shader.get_data(),&data[0],data.size());
+    ++m_hits;
     return true;
 }
 
@@ -35,51 +64,144 @@ bool compiled_shaders_provider::set(const char *text,const nya_render::compiled_
     if(!text)
         return false;
 
-    const void *data=shader.get_data();
+    const char *data=(const char *)shader.get_data();
     if(!data)
         return false;
 
-    FILE *f=fopen((m_save_path+crc(text)+".nsc").c_str(),"wb");
+    const uint64_t h=hash(text);
+    const uint32_t text_size=uint32_t(strlen(text));
+
+    nya_memory::lock_guard lock(m_mutex);
+    load_pack();
+
+    entry &e=m_entries[h];
+    if(!e.data.empty() && e.text_size==text_size && e.data.size()==shader.get_size() && memcmp(&e.data[0],data,e.data.size())==0)
+        return true;
+
+    e.text_size=text_size;
+    e.data.assign(data,data+shader.get_size());
+    m_changed=true;
+    return m_write_through?save_pack():true;
+}
+
+bool compiled_shaders_provider::save()
+{
+    nya_memory::lock_guard lock(m_mutex);
+    if(!m_changed)
+        return true;
+
+    load_pack();
+    return save_pack();
+}
+
+bool compiled_shaders_provider::save_pack()
+{
+    std::vector<pack_entry> index;
+    index.reserve(m_entries.size());
+    uint32_t offset=uint32_t(sizeof(pack_sign)+sizeof(uint32_t)+m_entries.size()*sizeof(pack_entry));
+    for(std::map<uint64_t,entry>::const_iterator it=m_entries.begin();it!=m_entries.end();++it)
+    {
+        pack_entry e;
+        memset(&e,0,sizeof(e));
+        e.hash=it->first;
+        e.text_size=it->second.text_size;
+        e.offset=offset;
+        e.size=uint32_t(it->second.data.size());
+        index.push_back(e);
+        offset+=e.size;
+    }
+
+    FILE *f=fopen((m_save_path+pack_name).c_str(),"wb");
     if(!f)
         return false;
 
-    fwrite(data,shader.get_size(),1,f);
+    const uint32_t count=uint32_t(index.size());
+    fwrite(pack_sign,sizeof(pack_sign),1,f);
+    fwrite(&count,sizeof(count),1,f);
+    if(count)
+        fwrite(&index[0],sizeof(pack_entry),count,f);
+    for(std::map<uint64_t,entry>::const_iterator it=m_entries.begin();it!=m_entries.end();++it)
+    {
+        if(!it->second.data.empty())
+            fwrite(&it->second.data[0],it->second.data.size(),1,f);
+    }
     fclose(f);
 
+    m_changed=false;
     return true;
 }
 
-std::string compiled_shaders_provider::crc(const char *text)
+void compiled_shaders_provider::preload_async()
 {
-    if(!text)
-        return "";
+    {
+        nya_memory::lock_guard lock(m_mutex);
+        if(m_loaded)
+            return;
+    }
+
+    nya_memory::thread_pool::get().add_task(&m_preload);
+}
+
+void compiled_shaders_provider::load_pack()
+{
+    if(m_loaded)
+        return;
+
+    m_loaded=true;
+
+    nya_resources::resource_data *data=nya_resources::get_resources_provider().access((m_load_path+pack_name).c_str());
+    if(!data)
+        return;
 
-    static unsigned int crc_table[256];
-    static bool initialised=false;
-    if(!initialised)
+    std::vector<char> buf(data->get_size());
+    const bool read=!buf.empty() && data->read_all(&buf[0]);
+    data->release();
+
+    const size_t header_size=sizeof(pack_sign)+sizeof(uint32_t);
+    if(!read || buf.size()<header_size || memcmp(&buf[0],pack_sign,sizeof(pack_sign))!=0)
     {
-        for(int i=0;i<256;i++)
-        {
-            unsigned int crc=i;
-            for(int j=0;j<8;j++)
-                crc=crc&1?(crc>>1)^0xEDB88320UL:crc>>1;
+        nya_resources::log()<<"invalid compiled shaders pack "<<m_load_path.c_str()<<pack_name<<"\n";
+        return;
+    }
 
-            crc_table[i]=crc;
-        };
+    uint32_t count;
+    memcpy(&count,&buf[sizeof(pack_sign)],sizeof(count));
+    if(count>(buf.size()-header_size)/sizeof(pack_entry))
+    {
+        nya_resources::log()<<"invalid compiled shaders pack "<<m_load_path.c_str()<<pack_name<<"\n";
+        return;
+    }
+
+    for(uint32_t i=0;i<count;++i)
+    {
+        pack_entry e;
+        memcpy(&e,&buf[header_size+i*sizeof(pack_entry)],sizeof(e));
+        if(size_t(e.offset)+e.size>buf.size())
+            continue;
 
-        initialised=true;
+        entry &en=m_entries[e.hash];
+        if(!en.data.empty()) //entries added before loading are newer
+            continue;
+
+        en.text_size=e.text_size;
+        en.data.assign(buf.begin()+e.offset,buf.begin()+e.offset+e.size);
     }
+}
 
-    unsigned int crc=0xFFFFFFFFUL;
-    size_t len=strlen(text);
-    unsigned char *buf=(unsigned char*)text;
-    while(len--)
-        crc=crc_table[(crc^ *buf++)&0xFF]^(crc>>8);
+uint64_t compiled_shaders_provider::hash(const char *text)
+{
+    if(!text)
+        return 0;
 
-    char tmp[256];
-    sprintf(tmp,"%ud",crc);
+    //fnv-1a
+    uint64_t h=14695981039346656037ULL;
+    for(const unsigned char *c=(const unsigned char *)text;*c;++c)
+    {
+        h^=*c;
+        h*=1099511628211ULL;
+    }
 
-    return std::string(tmp);
+    return h;
 }
 
 }
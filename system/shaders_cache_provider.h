@@ -3,18 +3,29 @@
 #pragma once
 
 #include "render/shader.h"
+#include "memory/mutex.h"
+#include "memory/thread_pool.h"
 #include <string>
+#include <map>
+#include <vector>
+#include <stdint.h>
 
 namespace nya_render{ class compiled_shader; }
 
 namespace nya_system
 {
+    //all compiled shaders are kept in a single pack file with an index, shaders.nsc in the load and save paths
+    //entries are keyed by a 64-bit hash and the length of the text, which includes backend-specific data such as defines or renderer
+    //ToDo: hash collisions of texts with equal length
     class compiled_shaders_provider: public nya_render::compiled_shaders_provider
     {
     public:
-        void set_load_path(const char *path) { m_load_path.assign(path?path:""); }
+        void set_load_path(const char *path);
         void set_save_path(const char *path) { m_save_path.assign(path?path:""); }
 
+        //set() writes the pack on each new entry, disable to write it once with save() after a batch
+        void set_write_through(bool enable) { m_write_through=enable; }
+
     public:
         static compiled_shaders_provider &get()
         {
@@ -26,11 +37,57 @@ namespace nya_system
         bool get(const char *text,nya_render::compiled_shader &shader);
         bool set(const char *text,const nya_render::compiled_shader &shader);
 
+    public:
+        //writes the pack if there are new entries
+        bool save();
+
+        //reads the pack on the shared thread pool, get() waits for it if called earlier
+        //provider should be valid until preload is finished
+        void preload_async();
+
+    public:
+        unsigned int get_hits() const { return m_hits; }
+        unsigned int get_misses() const { return m_misses; }
+        void reset_stats() { m_hits=m_misses=0; }
+
+    public:
+        static uint64_t hash(const char *text);
+
+    public:
+        compiled_shaders_provider(): m_loaded(false),m_changed(false),m_write_through(true),m_hits(0),m_misses(0) { m_preload.csp=this; }
+
+    private:
+        void load_pack();
+        bool save_pack();
+
     private:
-        std::string crc(const char *text);
+        class preload_task: public nya_memory::thread_pool::task
+        {
+        public:
+            void run() { nya_memory::lock_guard lock(csp->m_mutex); csp->load_pack(); }
+
+        public:
+            compiled_shaders_provider *csp;
+        };
 
     private:
         std::string m_load_path;
         std::string m_save_path;
+        struct entry
+        {
+            uint32_t text_size;
+            std::vector<char> data;
+
+            entry(): text_size(0) {}
+        };
+
+        std::map<uint64_t,entry> m_entries;
+        bool m_loaded;
+        bool m_changed;
+        bool m_write_through;
+        unsigned int m_hits;
+        unsigned int m_misses;
+        nya_memory::mutex m_mutex;
+        preload_task m_preload;
     };
 }
@@ -270,10 +270,16 @@ bool pmd_loader::load(nya_scene::shared_mesh &res,nya_scene::resource_data &data
             v.bone_idx[j]=(v.bone_idx[j]+0.5f)*tf;
     }
 
-    res.vbo.set_vertex_data(&vertices[0],sizeof(vertices[0]),vert_count);
-    res.vbo.set_normals(3*sizeof(float));
-    res.vbo.set_tc(0,6*sizeof(float),2);
-    res.vbo.set_tc(1,8*sizeof(float),3); //skin info
+    nya_render::vbo::layout layout;
+    layout.normal.offset=3*sizeof(float),layout.normal.dimension=3;
+    layout.tc[0].offset=6*sizeof(float),layout.tc[0].dimension=2;
+    layout.tc[1].offset=8*sizeof(float),layout.tc[1].dimension=3; //skin info: bone texture coordinates and weight
+
+    nya_render::vertex_compression::hint tc_hints[nya_render::vbo::max_tex_coord];
+    for(unsigned int i=0;i<nya_render::vbo::max_tex_coord;++i)
+        tc_hints[i]=nya_render::vertex_compression::hint_auto;
+
+    nya_scene::mesh::set_vertex_data(res.vbo,&vertices[0],sizeof(vertices[0]),vert_count,layout,tc_hints);
 
     reader.skip(reader.read<uchar>()*sizeof(ushort));
 
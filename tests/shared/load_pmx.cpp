@@ -764,14 +764,21 @@ bool pmx_loader::load(nya_scene::shared_mesh &res,nya_scene::resource_data &data
             v.bone_idx[j]=(v.bone_idx[j]+0.5f)*tf;
     }
 
-    res.vbo.set_vertex_data(&verts[0],sizeof(vert),(unsigned int)vert_count);
-    verts_data.free();
+    nya_render::vbo::layout layout;
     int offset=0;
-    res.vbo.set_vertices(offset,4); offset+=sizeof(verts[0].pos); offset+=sizeof(float);
-    res.vbo.set_normals(offset); offset+=sizeof(verts[0].normal);
-    res.vbo.set_tc(0,offset,2); offset+=sizeof(verts[0].tc);
-    res.vbo.set_tc(1,offset,4); offset+=sizeof(verts[0].bone_idx);
-    res.vbo.set_tc(2,offset,4); //offset+=sizeof(verts[0].bone_weight);
+    layout.pos.offset=offset,layout.pos.dimension=4; offset+=sizeof(verts[0].pos); offset+=sizeof(float);
+    layout.normal.offset=offset,layout.normal.dimension=3; offset+=sizeof(verts[0].normal);
+    layout.tc[0].offset=offset,layout.tc[0].dimension=2; offset+=sizeof(verts[0].tc);
+    layout.tc[1].offset=offset,layout.tc[1].dimension=4; offset+=sizeof(verts[0].bone_idx);
+    layout.tc[2].offset=offset,layout.tc[2].dimension=4; //offset+=sizeof(verts[0].bone_weight);
+
+    nya_render::vertex_compression::hint tc_hints[nya_render::vbo::max_tex_coord];
+    for(unsigned int i=0;i<nya_render::vbo::max_tex_coord;++i)
+        tc_hints[i]=nya_render::vertex_compression::hint_auto; //bone idx are bone texture coordinates
+    tc_hints[2]=nya_render::vertex_compression::hint_weights;
+
+    nya_scene::mesh::set_vertex_data(res.vbo,&verts[0],sizeof(vert),(unsigned int)vert_count,layout,tc_hints);
+    verts_data.free();
 
     if(header.index_size==2)
     {
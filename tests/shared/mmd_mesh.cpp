@@ -70,10 +70,49 @@ bool mmd_mesh::init()
         }
     }
 
+    m_group_morphs.clear();
+    m_vertex_morphs.clear();
+    m_uv_morphs.clear();
+    m_group_refs.clear();
+    m_group_refs.resize(m_morphs.size());
+    m_vmorph_slots.assign(m_morphs.size(),-1);
+    if(m_pmx_data)
+    {
+        for(int i=0;i<(int)m_pmx_data->morphs.size();++i)
+        {
+            const pmx_loader::additional_data::morph &m=m_pmx_data->morphs[i];
+            switch(m.type)
+            {
+                case pmx_loader::morph_type_group:
+                {
+                    m_group_morphs.push_back(i);
+                    const pmx_loader::additional_data::group_morph &gm=m_pmx_data->group_morphs[m.idx];
+                    for(int j=0;j<(int)gm.morphs.size();++j)
+                    {
+                        const int target=gm.morphs[j].first;
+                        if(target>=0 && target<(int)m_morphs.size())
+                            m_group_refs[target].push_back(std::make_pair(i,gm.morphs[j].second));
+                    }
+                    break;
+                }
+
+                case pmx_loader::morph_type_vertex: m_vertex_morphs.push_back(i); break;
+                case pmx_loader::morph_type_uv: m_uv_morphs.push_back(i); break;
+                default: break;
+            }
+        }
+    }
+
     update(0);
     return true;
 }
 
+void mmd_mesh::reset_morphs_state()
+{
+    for(int i=0;i<(int)m_morphs.size();++i)
+        m_morphs[i].last_value=m_morphs[i].last_group_source= -1.0f;
+}
+
 void mmd_mesh::unload()
 {
     mesh::unload();
@@ -93,8 +132,7 @@ void mmd_mesh::set_anim(const nya_scene::animation_proxy &anim,int layer,bool le
     if (!anim.is_valid())
         return;
 
-    for(int i=0;i<m_morphs.size();++i)
-        m_morphs[i].last_value=-1.0f;
+    reset_morphs_state();
 
     int idx=-1;
     for(int i=0;i<int(m_anims.size());++i)
@@ -114,21 +152,17 @@ void mmd_mesh::set_anim(const nya_scene::animation_proxy &anim,int layer,bool le
     }
 
     m_anims[idx].lerp = lerp;
-    m_anims[idx].curves_map.clear();
-    m_anims[idx].curves_map.resize(m_morphs.size(), -1);
+    m_anims[idx].curves.clear();
     m_anims[idx].sh = anim->get_shared_data().operator->();
     if(!anim->get_shared_data().is_valid())
         return;
 
-    if(m_pmd_data)
-    {
-        for(int i=0;i<int(m_morphs.size());++i)
-            m_anims[idx].curves_map[i]=anim->get_shared_data()->anim.get_curve_idx(m_pmd_data->morphs[i].name.c_str());
-    }
-    else if(m_pmx_data)
+    const nya_render::animation &a=anim->get_shared_data()->anim;
+    for(int i=0;i<int(m_morphs.size());++i)
     {
-        for(int i=0;i<int(m_morphs.size());++i)
-            m_anims[idx].curves_map[i]=anim->get_shared_data()->anim.get_curve_idx(m_pmx_data->morphs[i].name.c_str());
+        const int curve=a.get_curve_idx(get_morph_name(i));
+        if(curve>=0)
+            m_anims[idx].curves.push_back(std::make_pair(i,curve));
     }
 }
 
@@ -186,50 +220,69 @@ void mmd_mesh::update(unsigned int dt)
             const int time=get_anim_time(m_anims[i].layer);
             const float weight=ap->get_weight();
 
-            for(int j=0;j<m_anims[i].curves_map.size();++j)
+            const std::vector<std::pair<int,int> > &curves=m_anims[i].curves;
+            for(int j=0;j<(int)curves.size();++j)
             {
-                if(m_morphs[j].overriden)
-                    continue;
-
-                m_morphs[j].value+=a.get_curve(m_anims[i].curves_map[j],time)*weight;
+                morph &m=m_morphs[curves[j].first];
+                if(!m.overriden)
+                    m.value+=a.get_curve(curves[j].second,time)*weight;
             }
         }
     }
 
     if(m_pmx_data)
     {
-        //update group morphs first
-        for(auto &m: m_morphs)
-            m.group_value=0.0f;
-
-        for(int i=0;i<(int)m_pmx_data->morphs.size();++i)
+        //propagate only the group morphs that changed since last update
+        m_changed_targets.clear();
+        for(int i=0;i<(int)m_group_morphs.size();++i)
         {
-            const pmx_loader::additional_data::morph &m=m_pmx_data->morphs[i];
-            if(m.type!=pmx_loader::morph_type_group)
+            morph &g=m_morphs[m_group_morphs[i]];
+            if(g.value==g.last_group_source)
                 continue;
 
-            //if(m_morphs[i].value==m_morphs[i].last_value)
-            //    continue;
-
-            const pmx_loader::additional_data::group_morph &gm=m_pmx_data->group_morphs[m.idx];
+            g.last_group_source=g.value;
+            const pmx_loader::additional_data::group_morph &gm=m_pmx_data->group_morphs[m_pmx_data->morphs[m_group_morphs[i]].idx];
             for(int j=0;j<(int)gm.morphs.size();++j)
-            {
-                float &v=m_morphs[gm.morphs[j].first].group_value;
-                v=nya_math::max(v,m_morphs[i].value*gm.morphs[j].second);
-            }
+                m_changed_targets.push_back(gm.morphs[j].first);
+        }
 
-            m_morphs[i].last_value=m_morphs[i].value;
+        for(int i=0;i<(int)m_changed_targets.size();++i)
+        {
+            const int t=m_changed_targets[i];
+            if(t<0 || t>=(int)m_morphs.size())
+                continue;
+
+            float v=0.0f;
+            for(int j=0;j<(int)m_group_refs[t].size();++j)
+                v=nya_math::max(v,m_morphs[m_group_refs[t][j].first].value*m_group_refs[t][j].second);
+            m_morphs[t].group_value=v;
         }
+    }
 
-        //update material morphs before last_value updated
-        update_material_morphs();
+    m_changed_morphs.clear();
+    bool material_changed=false;
+    for(int i=0;i<(int)m_morphs.size();++i)
+    {
+        const morph &m=m_morphs[i];
+        if(nya_math::max(m.value,m.group_value)==m.last_value)
+            continue;
+
+        m_changed_morphs.push_back(i);
+        if(m_pmx_data && m_pmx_data->morphs[i].type==pmx_loader::morph_type_material)
+            material_changed=true;
     }
 
-    if(m_vmorphs.is_valid())
-        m_vmorphs->set_count(0);
+    if(m_changed_morphs.empty())
+        return;
+
+    //update material morphs before last_value updated
+    if(material_changed)
+        update_material_morphs();
 
-    for(int i=0;i<m_morphs.size();++i)
+    bool rebuild_vmorphs=false;
+    for(int k=0;k<(int)m_changed_morphs.size();++k)
     {
+        const int i=m_changed_morphs[k];
         const float value=nya_math::max(m_morphs[i].value,m_morphs[i].group_value);
 
         if(m_pmd_data)
@@ -248,26 +301,27 @@ void mmd_mesh::update(unsigned int dt)
             {
                 case pmx_loader::morph_type_vertex:
                 {
-                    if(value<0.001f)
-                        continue;
-
-                    const int idx=m_vmorphs->get_count();
-                    m_vmorphs->set_count(idx+1);
-                    m_vmorphs->set(idx,value,float(m.idx*m_pmx_data->mvert_count));
+                    const int slot=m_vmorph_slots[i];
+                    if((slot>=0)!=(value>=0.001f))
+                        rebuild_vmorphs=true;
+                    else if(slot>=0)
+                    {
+                        m_vmorphs->set(slot,value,float(m.idx*m_pmx_data->mvert_count));
+                        m_update_skining=true;
+                    }
                     break;
                 }
 
+                case pmx_loader::morph_type_uv: rebuild_vmorphs=true; break;
+
                 case pmx_loader::morph_type_bone:
                 {
-                    if(value==m_morphs[i].last_value)
-                        continue;
-
                     const pmx_loader::additional_data::bone_morph &bm=m_pmx_data->bone_morphs[m.idx];
                     for(int j=0;j<int(bm.bones.size());++j)
                     {
-                        set_bone_pos(bm.bones[j].idx,bm.bones[j].pos*m_morphs[i].value,true);
+                        set_bone_pos(bm.bones[j].idx,bm.bones[j].pos*value,true);
                         nya_math::quat rot=bm.bones[j].rot;
-                        rot.apply_weight(m_morphs[i].value);
+                        rot.apply_weight(value);
                         set_bone_rot(bm.bones[j].idx,rot,true);
                     }
                     break;
@@ -279,26 +333,47 @@ void mmd_mesh::update(unsigned int dt)
 
         m_morphs[i].last_value=value;
     }
-    
-    const int vmorphs_count=m_vmorphs->get_count();
 
-    if(m_pmx_data)
+    if(rebuild_vmorphs)
+        update_vertex_morphs();
+}
+
+void mmd_mesh::update_vertex_morphs()
+{
+    if(!m_vmorphs.is_valid() || !m_pmx_data)
+        return;
+
+    m_vmorphs->set_count(0);
+
+    for(int k=0;k<(int)m_vertex_morphs.size();++k)
     {
-        for(int i=0;i<m_morphs.size();++i)
+        const int i=m_vertex_morphs[k];
+        const float value=nya_math::max(m_morphs[i].value,m_morphs[i].group_value);
+        if(value<0.001f)
         {
-            const pmx_loader::additional_data::morph &m=m_pmx_data->morphs[i];
-            if(m.type!=pmx_loader::morph_type_uv)
-                continue;
+            m_vmorph_slots[i]= -1;
+            continue;
+        }
 
-            const float value=nya_math::max(m_morphs[i].value,m_morphs[i].group_value);
-            if(value<0.001f)
-                continue;
+        const int idx=m_vmorphs->get_count();
+        m_vmorphs->set_count(idx+1);
+        m_vmorphs->set(idx,value,float(m_pmx_data->morphs[i].idx*m_pmx_data->mvert_count));
+        m_vmorph_slots[i]=idx;
+    }
 
-            const int idx=m_vmorphs->get_count();
-            m_vmorphs->set_count(idx+1);
-            m_vmorphs->set(idx,value,float((m_pmx_data->vert_morphs.size() + m.idx)*m_pmx_data->mvert_count));
-            break;
-        }
+    const int vmorphs_count=m_vmorphs->get_count();
+
+    for(int k=0;k<(int)m_uv_morphs.size();++k)
+    {
+        const int i=m_uv_morphs[k];
+        const float value=nya_math::max(m_morphs[i].value,m_morphs[i].group_value);
+        if(value<0.001f)
+            continue;
+
+        const int idx=m_vmorphs->get_count();
+        m_vmorphs->set_count(idx+1);
+        m_vmorphs->set(idx,value,float((m_pmx_data->vert_morphs.size() + m_pmx_data->morphs[i].idx)*m_pmx_data->mvert_count));
+        break;
     }
 
     if(m_morphs_count.is_valid())
@@ -419,12 +494,13 @@ const char *mmd_mesh::get_morph_name(int idx) const
 
 void mmd_mesh::update_skining() const
 {
-    if(!m_update_skining)
+    const nya_render::skeleton &sk=get_skeleton();
+    if(!m_update_skining && sk.get_version()==m_skining_version)
         return;
 
+    m_skining_version=sk.get_version();
     m_skining->swap();
 
-    const nya_render::skeleton &sk=get_skeleton();
     const int bones_count=sk.get_bones_count();
     const nya_math::vec3 *pos=(nya_math::vec3 *)sk.get_pos_buffer();
     const nya_math::quat *rot=(nya_math::quat *)sk.get_rot_buffer();
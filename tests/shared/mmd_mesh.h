@@ -31,9 +31,9 @@ public:
 
     bool is_mmd() const { return m_pmd_data!=0 || m_pmx_data!=0; }
 
-    mmd_mesh(): m_pmd_data(0),m_pmx_data(0),m_update_skining(false) {}
+    mmd_mesh(): m_pmd_data(0),m_pmx_data(0),m_update_skining(false),m_skining_version(0) {}
 
-    mmd_mesh(const mmd_mesh &from): mesh(from) { init(); m_morphs=from.m_morphs; m_anims=from.m_anims; }
+    mmd_mesh(const mmd_mesh &from): mesh(from) { init(); m_morphs=from.m_morphs; m_anims=from.m_anims; reset_morphs_state(); }
 
     mmd_mesh &operator = (const mmd_mesh &from)
     {
@@ -47,6 +47,8 @@ public:
 private:
     bool init();
     void update_material_morphs();
+    void update_vertex_morphs();
+    void reset_morphs_state();
     void update_skining() const;
 
     const pmd_loader::additional_data *m_pmd_data;
@@ -56,20 +58,30 @@ private:
     {
         bool overriden;
         float value;
-        float last_value;
+        float last_value; //applied max(value,group_value)
+        float last_group_source; //value last propagated to group targets
         float group_value;
 
-        morph(): overriden(false),value(0.0f),last_value(0.0f),group_value(0.0f) {}
+        morph(): overriden(false),value(0.0f),last_value(0.0f),last_group_source(0.0f),group_value(0.0f) {}
     };
     std::vector<morph> m_morphs;
 
+    //morph indices by type, built at init
+    std::vector<int> m_group_morphs;
+    std::vector<int> m_vertex_morphs;
+    std::vector<int> m_uv_morphs;
+    std::vector<std::vector<std::pair<int,float> > > m_group_refs; //per morph: groups that drive it and their weights
+    std::vector<int> m_vmorph_slots; //per morph: index in m_vmorphs or -1
+    std::vector<int> m_changed_morphs;
+    std::vector<int> m_changed_targets;
+
     nya_scene::material::param_proxy m_morphs_count;
     nya_scene::material::param_array_proxy m_vmorphs;
 
     struct applied_anim
     {
         int layer;
-        std::vector<int> curves_map;
+        std::vector<std::pair<int,int> > curves; //morph idx, curve idx
         const nya_scene::shared_animation *sh;
         bool lerp;
     };
@@ -101,4 +113,5 @@ private:
     };
     mutable nya_memory::shared_ptr<skining_data> m_skining;
     mutable bool m_update_skining;
+    mutable unsigned int m_skining_version;
 };
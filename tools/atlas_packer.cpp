@@ -0,0 +1,184 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "log/log.h"
+#include "math/rect_packer.h"
+#include "formats/tga.h"
+
+const char *help="Usage: atlas_packer [options] %%dst_prefix%% %%src.tga%% ...\n"
+                 "packs textures into %%dst_prefix%%N.tga pages, same layout as nya_scene::texture_atlas\n"
+                 "writes %%dst_prefix%%.txt with a line per texture: name page x y width height tc.x tc.y tc.z tc.w\n"
+                 "where page_uv = uv * tc.xy + tc.zw, stdout is empty, errors begin with Error:\n"
+                 "options:\n"
+                 "-size %%width%% %%height%% - page size, 1024 1024 by default\n"
+                 "-padding %%pixels%% - extruded border around each texture, 2 by default\n"
+                 "\n";
+
+const int block_size=4;
+
+int align_block(int size) { return (size+block_size-1)/block_size*block_size; }
+
+struct item
+{
+    std::string name;
+    nya_formats::tga_file tga;
+    int cell_width,cell_height;
+    int page,x,y;
+
+    bool operator < (const item &other) const
+    {
+        if(cell_height!=other.cell_height)
+            return cell_height>other.cell_height;
+        return cell_width>other.cell_width;
+    }
+};
+
+bool sort_items(const item *a,const item *b) { return *a<*b; }
+
+int main(int argc,char *argv[])
+{
+    int page_width=1024,page_height=1024,padding=2;
+    std::vector<std::string> files;
+
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-size")==0 && i+2<argc)
+        {
+            page_width=align_block(atoi(argv[i+1]));
+            page_height=align_block(atoi(argv[i+2]));
+            i+=2;
+        }
+        else if(strcmp(argv[i],"-padding")==0 && i+1<argc)
+            padding=atoi(argv[++i]);
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.size()<2 || page_width<=0 || page_height<=0 || padding<0)
+    {
+        fprintf(stderr,"Error: invalid arguments\n");
+        printf("%s",help);
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    std::vector<item> items(files.size()-1);
+    std::vector<item*> sorted(items.size());
+    for(size_t i=0;i<items.size();++i)
+    {
+        item &it=items[i];
+        it.name=files[i+1];
+        if(!it.tga.load(it.name.c_str()))
+        {
+            fprintf(stderr,"Error: unable to load %s\n",it.name.c_str());
+            return -1;
+        }
+
+        if(it.tga.is_rle())
+            it.tga.decode_rle();
+        if(it.tga.is_flipped_horisontal())
+            it.tga.flip_horisontal();
+        if(it.tga.is_flipped_vertical())
+            it.tga.flip_vertical();
+
+        it.cell_width=align_block(it.tga.get_width()+padding*2);
+        it.cell_height=align_block(it.tga.get_height()+padding*2);
+        if(it.cell_width>page_width || it.cell_height>page_height)
+        {
+            fprintf(stderr,"Error: %s with padding is larger than page\n",it.name.c_str());
+            return -1;
+        }
+
+        sorted[i]=&it;
+    }
+
+    std::sort(sorted.begin(),sorted.end(),sort_items);
+
+    std::vector<nya_math::rect_packer> packers;
+    for(size_t i=0;i<sorted.size();++i)
+    {
+        item &it=*sorted[i];
+        const int bw=it.cell_width/block_size,bh=it.cell_height/block_size;
+        int bx=0,by=0;
+        size_t page=0;
+        while(page<packers.size() && !packers[page].add(bw,bh,bx,by))
+            ++page;
+
+        if(page==packers.size())
+        {
+            packers.push_back(nya_math::rect_packer(page_width/block_size,page_height/block_size));
+            packers.back().add(bw,bh,bx,by);
+        }
+
+        it.page=(int)page;
+        it.x=bx*block_size,it.y=by*block_size;
+    }
+
+    const std::string prefix=files[0];
+    for(size_t p=0;p<packers.size();++p)
+    {
+        std::vector<unsigned char> data(size_t(page_width)*page_height*4,0);
+        for(size_t i=0;i<items.size();++i)
+        {
+            const item &it=items[i];
+            if(it.page!=(int)p)
+                continue;
+
+            const int w=it.tga.get_width(),h=it.tga.get_height(),channels=it.tga.get_channels();
+            const unsigned char *src=it.tga.get_data();
+            for(int cy=0;cy<it.cell_height;++cy)
+            {
+                const int sy=std::min(std::max(cy-padding,0),h-1);
+                unsigned char *dst=&data[(size_t(it.y+cy)*page_width+it.x)*4];
+                for(int cx=0;cx<it.cell_width;++cx,dst+=4)
+                {
+                    const int sx=std::min(std::max(cx-padding,0),w-1);
+                    const unsigned char *s=src+(size_t(sy)*w+sx)*channels;
+                    if(channels==1)
+                        dst[0]=dst[1]=dst[2]=s[0],dst[3]=255;
+                    else
+                        dst[0]=s[0],dst[1]=s[1],dst[2]=s[2],dst[3]=channels==4?s[3]:255;
+                }
+            }
+        }
+
+        char name[32];
+        sprintf(name,"%d.tga",(int)p);
+        nya_formats::tga_file out;
+        if(!out.create(page_width,page_height,nya_formats::tga::bgra,&data[0]) || !out.save((prefix+name).c_str()))
+        {
+            fprintf(stderr,"Error: unable to write %s%s\n",prefix.c_str(),name);
+            return -1;
+        }
+    }
+
+    FILE *desc=fopen((prefix+".txt").c_str(),"wb");
+    if(!desc)
+    {
+        fprintf(stderr,"Error: unable to write %s.txt\n",prefix.c_str());
+        return -1;
+    }
+
+    for(size_t i=0;i<items.size();++i)
+    {
+        const item &it=items[i];
+        const int x=it.x+padding,y=it.y+padding,w=it.tga.get_width(),h=it.tga.get_height();
+        fprintf(desc,"%s %d %d %d %d %d %f %f %f %f\n",it.name.c_str(),it.page,x,y,w,h,
+                float(w)/page_width,float(h)/page_height,float(x)/page_width,float(y)/page_height);
+    }
+
+    fclose(desc);
+    return 0;
+}
@@ -0,0 +1,282 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "log/log.h"
+#include "render/bitmap.h"
+#include "render/bitmap_simd.h"
+#include "formats/tga.h"
+#include "formats/dds.h"
+#include "memory/thread_pool.h"
+#include "system/system.h"
+
+const char *help="Usage: compress_benchmark [options] [%%src.tga%%]\n"
+                 "measures quality (PSNR) and throughput (MB/s of rgba input) of the runtime block compressors\n"
+                 "uses a generated image if no tga is specified\n"
+                 "options:\n"
+                 "-size %%n%% - generated image size, 1024 by default\n"
+                 "-iterations %%n%% - minimum runs per format, 5 by default\n"
+                 "\n";
+
+typedef unsigned char uchar;
+
+inline int clamp255(int c) { return c<0?0:(c>255?255:c); }
+
+//reference decoders for the modes the compressor emits
+
+const int etc_modifiers[8][2]={{2,8},{5,17},{9,29},{13,42},{18,60},{24,80},{33,106},{47,183}};
+
+const int eac_modifiers[16][8]=
+{
+    {-3,-6,-9,-15,2,5,8,14},{-3,-7,-10,-13,2,6,9,12},{-2,-5,-8,-13,1,4,7,12},{-2,-4,-6,-13,1,3,5,12},
+    {-3,-6,-8,-12,2,5,7,11},{-3,-7,-9,-11,2,6,8,10},{-4,-7,-8,-11,3,6,7,10},{-3,-5,-8,-11,2,4,7,10},
+    {-2,-6,-8,-10,1,5,7,9},{-2,-5,-8,-10,1,4,7,9},{-2,-4,-8,-10,1,3,7,9},{-2,-5,-7,-10,1,4,6,9},
+    {-3,-4,-7,-10,2,3,6,9},{-1,-2,-3,-10,0,1,2,9},{-4,-6,-8,-9,3,5,7,8},{-3,-5,-7,-9,2,4,6,8}
+};
+
+unsigned long long read_be64(const uchar *p)
+{
+    unsigned long long v=0;
+    for(int i=0;i<8;++i)
+        v=v<<8|p[i];
+    return v;
+}
+
+void decode_etc1(const uchar *p,uchar *rgba,int pitch)
+{
+    const unsigned long long b=read_be64(p);
+    const bool diff=(b>>33)&1, flip=(b>>32)&1;
+    int base[2][3];
+    for(int c=0;c<3;++c)
+    {
+        const int shift=59-c*8;
+        if(diff)
+        {
+            int d=(b>>(shift-3))&7;
+            if(d>=4)
+                d-=8;
+            const int c0=(b>>shift)&31, c1=c0+d;
+            base[0][c]=(c0<<3)|(c0>>2);
+            base[1][c]=(c1<<3)|(c1>>2);
+        }
+        else
+        {
+            base[0][c]=((b>>(shift+1))&15)*17;
+            base[1][c]=((b>>(shift-3))&15)*17;
+        }
+    }
+
+    const int tables[2]={int((b>>37)&7),int((b>>34)&7)};
+    for(int x=0;x<4;++x) for(int y=0;y<4;++y)
+    {
+        const int s=flip?(y>=2):(x>=2), bit=x*4+y;
+        const int code=int((b>>(bit+16))&1)<<1 | int((b>>bit)&1);
+        const int *m=etc_modifiers[tables[s]];
+        const int mod=code==0?m[0]:(code==1?m[1]:(code==2?-m[0]:-m[1]));
+        uchar *o=rgba+y*pitch+x*4;
+        for(int c=0;c<3;++c)
+            o[c]=clamp255(base[s][c]+mod);
+        o[3]=255;
+    }
+}
+
+void decode_eac_alpha(const uchar *p,uchar *rgba,int pitch)
+{
+    const unsigned long long b=read_be64(p);
+    const int base=int(b>>56), mul=int((b>>52)&15), table=int((b>>48)&15);
+    for(int k=0;k<16;++k)
+        rgba[(k%4)*pitch+(k/4)*4+3]=clamp255(base+eac_modifiers[table][(b>>(45-3*k))&7]*mul);
+}
+
+enum format
+{
+    format_dxt1,
+    format_dxt5,
+    format_etc1,
+    format_etc2_eac
+};
+
+void compress(format f,const uchar *data,int width,int height,uchar *out)
+{
+    switch(f)
+    {
+        case format_dxt1: nya_render::bitmap_compress_dxt1(data,width,height,out); break;
+        case format_dxt5: nya_render::bitmap_compress_dxt5(data,width,height,out); break;
+        case format_etc1: nya_render::bitmap_compress_etc1(data,width,height,out); break;
+        case format_etc2_eac: nya_render::bitmap_compress_etc2_eac(data,width,height,out); break;
+    }
+}
+
+void decode(format f,const uchar *data,int width,int height,uchar *out)
+{
+    if(f==format_dxt1 || f==format_dxt5)
+    {
+        nya_formats::dds dds;
+        dds.width=width,dds.height=height;
+        dds.mipmap_count=1;
+        dds.type=nya_formats::dds::texture_2d;
+        dds.pf=f==format_dxt1?nya_formats::dds::dxt1:nya_formats::dds::dxt5;
+        dds.data=data;
+        dds.data_size=nya_render::bitmap_compressed_size(width,height,f==format_dxt1?8:16);
+        dds.decode_dxt(out);
+        return;
+    }
+
+    const int block_size=f==format_etc1?8:16;
+    for(int by=0;by<height;by+=4)
+    {
+        for(int bx=0;bx<width;bx+=4,data+=block_size)
+        {
+            uchar *o=out+(by*width+bx)*4;
+            if(f==format_etc1)
+                decode_etc1(data,o,width*4);
+            else
+            {
+                decode_etc1(data+8,o,width*4);
+                decode_eac_alpha(data,o,width*4);
+            }
+        }
+    }
+}
+
+double psnr(const uchar *a,const uchar *b,int count,int from_channel,int channels_count)
+{
+    double err=0.0;
+    for(int i=0;i<count;++i)
+    {
+        for(int c=from_channel;c<from_channel+channels_count;++c)
+        {
+            const double d=double(a[i*4+c])-double(b[i*4+c]);
+            err+=d*d;
+        }
+    }
+
+    err/=double(count)*channels_count;
+    return err>0.0?10.0*log10(255.0*255.0/err):99.0;
+}
+
+//smooth gradients, hard edges and noise, so every encoder mode is exercised
+void generate(int size,std::vector<uchar> &data)
+{
+    data.resize(size_t(size)*size*4);
+    unsigned int seed=1;
+    for(int y=0;y<size;++y)
+    {
+        for(int x=0;x<size;++x)
+        {
+            seed=seed*1103515245+12345;
+            const int noise=int((seed>>16)%16)-8;
+            uchar *p=&data[(size_t(y)*size+x)*4];
+            const bool edge=((x/37)+(y/29))%2==0;
+            p[0]=clamp255(x*255/size+noise);
+            p[1]=clamp255((edge?y*255/size:255-y*255/size)+noise);
+            p[2]=clamp255(int(128+100*sin(x*0.05)*cos(y*0.03))+noise);
+            p[3]=clamp255(int(128+120*sin((x+y)*0.02)));
+        }
+    }
+}
+
+int main(int argc,char *argv[])
+{
+    int size=1024,iterations=5;
+    std::string file;
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-size")==0 && i+1<argc)
+            size=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-iterations")==0 && i+1<argc)
+            iterations=atoi(argv[++i]);
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            file=argv[i];
+    }
+
+    if(size<4 || iterations<1)
+    {
+        fprintf(stderr,"Error: invalid size or iterations count\n");
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    std::vector<uchar> data;
+    int width=size,height=size;
+    if(file.empty())
+        generate(size,data);
+    else
+    {
+        nya_formats::tga_file tga;
+        if(!tga.load(file.c_str()))
+        {
+            fprintf(stderr,"Error: unable to load %s\n",file.c_str());
+            return -1;
+        }
+
+        if(tga.is_rle())
+            tga.decode_rle();
+        if(tga.is_flipped_horisontal())
+            tga.flip_horisontal();
+        if(tga.is_flipped_vertical())
+            tga.flip_vertical();
+
+        width=tga.get_width(),height=tga.get_height();
+        const int channels=tga.get_channels();
+        if(channels<3 || width%4 || height%4)
+        {
+            fprintf(stderr,"Error: rgb or rgba tga with size multiple of 4 required\n");
+            return -1;
+        }
+
+        std::vector<uchar> src(tga.get_data(),tga.get_data()+size_t(width)*height*channels);
+        nya_render::bitmap_rgb_to_bgr(&src[0],width,height,channels);
+        if(channels==3)
+        {
+            data.resize(size_t(width)*height*4);
+            nya_render::bitmap_rgb_to_rgba(&src[0],width,height,255,&data[0]);
+        }
+        else
+            data.swap(src);
+    }
+
+    printf("%dx%d, %s kernels, %d threads\n",width,height,nya_render::get_bitmap_kernels().name,
+           nya_memory::thread_pool::get().get_threads_count()+1);
+
+    const char *names[]={"dxt1","dxt5","etc1","etc2_eac"};
+    const double mb=double(data.size())/(1024.0*1024.0);
+    std::vector<uchar> decoded(data.size());
+    for(int f=format_dxt1;f<=format_etc2_eac;++f)
+    {
+        const bool alpha=f==format_dxt5 || f==format_etc2_eac;
+        std::vector<uchar> out(nya_render::bitmap_compressed_size(width,height,f==format_dxt1 || f==format_etc1?8:16));
+
+        //at least iterations runs and 100 ms, so small images are measurable
+        int runs=0;
+        unsigned long time=0;
+        const unsigned long start=nya_system::get_time();
+        while(runs<iterations || time<100)
+        {
+            compress(format(f),&data[0],width,height,&out[0]);
+            time=nya_system::get_time()-start;
+            ++runs;
+        }
+
+        decode(format(f),&out[0],width,height,&decoded[0]);
+        const double rgb=psnr(&data[0],&decoded[0],width*height,0,3);
+        const double speed=mb*runs*1000.0/time;
+        if(alpha)
+            printf("%-9s rgb %.2f dB, alpha %.2f dB, %.1f MB/s\n",names[f],rgb,psnr(&data[0],&decoded[0],width*height,3,1),speed);
+        else
+            printf("%-9s rgb %.2f dB, %.1f MB/s\n",names[f],rgb,speed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "log/log.h"
+#include "render/bitmap.h"
+#include "formats/tga.h"
+#include "formats/dds.h"
+#include "formats/ktx.h"
+
+const char *help="Usage: mip_generator [options] %%src.tga%% %%dst.dds|dst.ktx%%\n"
+                 "bakes a complete mipmap chain, stdout is empty, errors begin with Error:\n"
+                 "options:\n"
+                 "-filter box|kaiser|lanczos - downsampling filter, box by default\n"
+                 "-srgb - average color in linear space\n"
+                 "-wrap - sample across edges for tiled textures\n"
+                 "-alpha_coverage %%ref%% - keep the share of pixels with alpha above ref, for alpha tested textures\n"
+                 "-mips %%count%% - limit mip count\n"
+                 "-compress - dxt1/dxt5 for dds, etc1/etc2_eac for ktx, requires size multiple of 4\n"
+                 "\n";
+
+bool ends_with(const std::string &s,const char *ext)
+{
+    const size_t len=strlen(ext);
+    return s.length()>=len && strcmp(s.c_str()+s.length()-len,ext)==0;
+}
+
+int main(int argc,char *argv[])
+{
+    nya_render::bitmap_mip_settings settings;
+    int mip_count= -1;
+    bool compress=false;
+    std::vector<std::string> files;
+
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-filter")==0 && i+1<argc)
+        {
+            ++i;
+            if(strcmp(argv[i],"box")==0)
+                settings.filter=nya_render::bitmap_mip_filter_box;
+            else if(strcmp(argv[i],"kaiser")==0)
+                settings.filter=nya_render::bitmap_mip_filter_kaiser;
+            else if(strcmp(argv[i],"lanczos")==0)
+                settings.filter=nya_render::bitmap_mip_filter_lanczos;
+            else
+            {
+                fprintf(stderr,"Error: unknown filter %s\n",argv[i]);
+                return -1;
+            }
+        }
+        else if(strcmp(argv[i],"-srgb")==0)
+            settings.srgb=true;
+        else if(strcmp(argv[i],"-wrap")==0)
+            settings.wrap=true;
+        else if(strcmp(argv[i],"-alpha_coverage")==0 && i+1<argc)
+            settings.alpha_coverage=(float)atof(argv[++i]);
+        else if(strcmp(argv[i],"-mips")==0 && i+1<argc)
+            mip_count=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-compress")==0)
+            compress=true;
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.size()!=2)
+    {
+        fprintf(stderr,"Error: src and dst files not specified\n");
+        printf("%s",help);
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    const bool to_dds=ends_with(files[1],".dds");
+    if(!to_dds && !ends_with(files[1],".ktx"))
+    {
+        fprintf(stderr,"Error: unsupported output format %s\n",files[1].c_str());
+        return -1;
+    }
+
+    nya_formats::tga_file tga;
+    if(!tga.load(files[0].c_str()))
+    {
+        fprintf(stderr,"Error: unable to load %s\n",files[0].c_str());
+        return -1;
+    }
+
+    if(tga.is_rle())
+        tga.decode_rle();
+    if(tga.is_flipped_horisontal())
+        tga.flip_horisontal();
+    if(tga.is_flipped_vertical())
+        tga.flip_vertical();
+
+    const int width=tga.get_width(),height=tga.get_height();
+    int channels=tga.get_channels();
+    std::vector<unsigned char> data(tga.get_data(),tga.get_data()+size_t(width)*height*channels);
+
+    //tga stores bgr and bgra, ktx and compressors take rgb and rgba
+    const bool to_rgb=compress || (!to_dds && channels==3);
+    if(to_rgb && channels>=3)
+        nya_render::bitmap_rgb_to_bgr(&data[0],width,height,channels);
+
+    if(compress)
+    {
+        if(channels==1 || width%4 || height%4)
+        {
+            fprintf(stderr,"Error: unable to compress greyscale or not multiple of 4 texture\n");
+            return -1;
+        }
+
+        if(channels==3)
+        {
+            std::vector<unsigned char> rgba(size_t(width)*height*4);
+            nya_render::bitmap_rgb_to_rgba(&data[0],width,height,255,&rgba[0]);
+            data.swap(rgba);
+            channels=4;
+        }
+    }
+
+    if(!to_dds && channels==1)
+    {
+        fprintf(stderr,"Error: greyscale ktx is not supported\n");
+        return -1;
+    }
+
+    const int max_mips=nya_render::bitmap_get_mip_count(width,height);
+    if(mip_count<=0 || mip_count>max_mips)
+        mip_count=max_mips;
+
+    std::vector<unsigned char> chain(nya_render::bitmap_get_mip_chain_size(width,height,channels,mip_count));
+    nya_render::bitmap_build_mip_chain(&data[0],width,height,channels,mip_count,settings,&chain[0]);
+
+    const bool has_alpha=channels==4 && !nya_render::bitmap_is_full_alpha(&chain[0],width,height);
+    const bool etc=compress && !to_dds;
+    const int block_size=has_alpha?16:8;
+
+    std::vector<std::vector<unsigned char> > mips(mip_count);
+    const unsigned char *src=&chain[0];
+    for(int i=0,w=width,h=height;i<mip_count;++i,w=w>1?w/2:1,h=h>1?h/2:1)
+    {
+        const size_t size=size_t(w)*h*channels;
+        if(!compress && !to_dds)
+        {
+            //ktx rows are 4 bytes aligned
+            const size_t row=size_t(w)*channels,padded_row=(row+3)&~size_t(3);
+            mips[i].resize(padded_row*h,0);
+            for(int y=0;y<h;++y)
+                memcpy(&mips[i][y*padded_row],src+y*row,row);
+        }
+        else if(!compress)
+            mips[i].assign(src,src+size);
+        else
+        {
+            mips[i].resize(nya_render::bitmap_compressed_size(w,h,block_size));
+            if(etc && has_alpha)
+                nya_render::bitmap_compress_etc2_eac(src,w,h,&mips[i][0]);
+            else if(etc)
+                nya_render::bitmap_compress_etc1(src,w,h,&mips[i][0]);
+            else if(has_alpha)
+                nya_render::bitmap_compress_dxt5(src,w,h,&mips[i][0]);
+            else
+                nya_render::bitmap_compress_dxt1(src,w,h,&mips[i][0]);
+        }
+        src+=size;
+    }
+
+    std::vector<unsigned char> header;
+    if(to_dds)
+    {
+        nya_formats::dds dds;
+        dds.width=width,dds.height=height;
+        dds.mipmap_count=mip_count;
+        dds.type=nya_formats::dds::texture_2d;
+        if(compress)
+            dds.pf=has_alpha?nya_formats::dds::dxt5:nya_formats::dds::dxt1;
+        else
+            dds.pf=channels==4?nya_formats::dds::bgra:(channels==3?nya_formats::dds::bgr:nya_formats::dds::greyscale);
+
+        header.resize(nya_formats::dds::dds_header_size);
+        header.resize(dds.encode_header(&header[0],header.size()));
+    }
+    else
+    {
+        nya_formats::ktx ktx;
+        ktx.width=width,ktx.height=height;
+        ktx.mipmap_count=mip_count;
+        if(compress)
+            ktx.pf=has_alpha?nya_formats::ktx::etc2_eac:nya_formats::ktx::etc1;
+        else
+            ktx.pf=channels==4?nya_formats::ktx::bgra:nya_formats::ktx::rgb;
+
+        header.resize(nya_formats::ktx::ktx_header_size);
+        header.resize(ktx.encode_header(&header[0],header.size()));
+    }
+
+    if(header.empty())
+    {
+        fprintf(stderr,"Error: unable to encode header\n");
+        return -1;
+    }
+
+    FILE *out=fopen(files[1].c_str(),"wb");
+    if(!out)
+    {
+        fprintf(stderr,"Error: unable to write %s\n",files[1].c_str());
+        return -1;
+    }
+
+    fwrite(&header[0],1,header.size(),out);
+    for(int i=0;i<mip_count;++i)
+    {
+        const unsigned int size=(unsigned int)mips[i].size();
+        if(!to_dds)
+            fwrite(&size,1,sizeof(size),out);
+        fwrite(&mips[i][0],1,mips[i].size(),out);
+
+        //ktx mips are 4 bytes aligned
+        const unsigned char padding[3]={0};
+        if(!to_dds && size%4)
+            fwrite(padding,1,4-size%4,out);
+    }
+
+    fclose(out);
+    return 0;
+}
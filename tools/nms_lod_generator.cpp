@@ -0,0 +1,341 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "log/log.h"
+#include "formats/nms.h"
+#include "render/mesh_optimize.h"
+
+const char *help="Usage: nms_lod_generator [options] %%src.nms%% %%dst.nms%%\n"
+                 "replaces mesh lods with simplified versions of the first one, sharing its vertices,\n"
+                 "prints triangles per lod to stdout, errors begin with Error:\n"
+                 "options:\n"
+                 "-lods %%count%% - lods to generate besides the first one, 3 by default\n"
+                 "-ratio %%value%% - triangles of each lod relative to the previous one, 0.5 by default\n"
+                 "-error %%value%% - max error relative to the mesh size, 0.02 by default\n"
+                 "-screen_size %%pixels%% - projected size to switch to the first generated lod, halves for each next, 256 by default\n"
+                 "\n";
+
+struct options
+{
+    int lods;
+    float ratio;
+    float error;
+    float screen_size;
+};
+
+const nya_formats::nms_mesh_chunk::element *find_element(const nya_formats::nms_mesh_chunk &c,const char *semantics)
+{
+    for(size_t i=0;i<c.elements.size();++i)
+    {
+        const nya_formats::nms_mesh_chunk::element &e=c.elements[i];
+        if(e.semantics==semantics && e.type>=nya_formats::nms_mesh_chunk::tc0 && e.data_type==nya_formats::nms_mesh_chunk::float32)
+            return &e;
+    }
+
+    return 0;
+}
+
+//vertices collapse only into ones with the same dominant bone, so skinning stays intact
+bool get_vertex_classes(const nya_formats::nms_mesh_chunk &c,std::vector<unsigned int> &classes)
+{
+    const nya_formats::nms_mesh_chunk::element *bones=find_element(c,"bone_idx");
+    if(!bones)
+        return false;
+
+    const nya_formats::nms_mesh_chunk::element *weights=find_element(c,"bone_weight");
+    if(weights && weights->dimension!=bones->dimension)
+        weights=0;
+
+    classes.resize(c.verts_count);
+    for(unsigned int i=0;i<c.verts_count;++i)
+    {
+        const char *v=(const char *)c.vertices_data+size_t(i)*c.vertex_stride;
+        unsigned int best=0;
+        float best_weight= -1.0f;
+        for(unsigned int j=0;j<bones->dimension;++j)
+        {
+            float w=1.0f;
+            if(weights)
+                memcpy(&w,v+weights->offset+j*sizeof(float),sizeof(float));
+            if(w<=best_weight)
+                continue;
+
+            best=j,best_weight=w;
+            if(!weights)
+                break;
+        }
+
+        float idx;
+        memcpy(&idx,v+bones->offset+best*sizeof(float),sizeof(float));
+        classes[i]=(unsigned int)idx;
+    }
+
+    return true;
+}
+
+template<typename t> bool generate(nya_formats::nms_mesh_chunk &c,std::vector<char> &indices_buf,const options &o,int mesh_idx)
+{
+    const nya_formats::nms_mesh_chunk::element *pos=0;
+    for(size_t i=0;i<c.elements.size();++i)
+    {
+        const nya_formats::nms_mesh_chunk::element &e=c.elements[i];
+        if(e.type==nya_formats::nms_mesh_chunk::pos && e.data_type==nya_formats::nms_mesh_chunk::float32 &&
+           e.dimension>=3 && e.offset+3*sizeof(float)<=c.vertex_stride)
+            pos=&e;
+    }
+
+    if(!pos)
+    {
+        fprintf(stderr,"Error: mesh %d has no float32 positions\n",mesh_idx);
+        return false;
+    }
+
+    std::vector<unsigned int> classes;
+    const bool skinned=get_vertex_classes(c,classes);
+
+    std::vector<t> indices((const t *)c.indices_data,(const t *)c.indices_data+c.indices_count);
+    const void *positions=(const char *)c.vertices_data+pos->offset;
+
+    c.lods.resize(1);
+    const std::vector<nya_formats::nms_mesh_chunk::group> &groups=c.lods[0].groups;
+
+    unsigned int prev_tris=0;
+    for(size_t i=0;i<groups.size();++i)
+    {
+        if(groups[i].element_type==nya_formats::nms_mesh_chunk::triangles)
+            prev_tris+=groups[i].count/3;
+    }
+
+    printf("mesh %d%s: lod 0 %u triangles\n",mesh_idx,skinned?" skinned":"",prev_tris);
+
+    std::vector<t> buf;
+    for(int lod=1;lod<=o.lods;++lod)
+    {
+        nya_formats::nms_mesh_chunk::lod l=c.lods.back();
+        unsigned int tris=0;
+        for(size_t i=0;i<l.groups.size();++i)
+        {
+            nya_formats::nms_mesh_chunk::group &g=l.groups[i];
+            if(g.element_type!=nya_formats::nms_mesh_chunk::triangles || !g.count || g.offset+g.count>indices.size())
+                continue;
+
+            const unsigned int target=(unsigned int)(g.count/3*o.ratio)*3;
+            buf.resize(g.count);
+            const unsigned int count=nya_render::simplify_mesh(&indices[g.offset],g.count,positions,c.vertex_stride,c.verts_count,
+                                                               target,o.error,&buf[0],skinned?&classes[0]:0);
+            nya_render::optimize_vertex_cache(&buf[0],count,c.verts_count);
+
+            g.offset=(unsigned int)indices.size();
+            g.count=count;
+            indices.insert(indices.end(),buf.begin(),buf.begin()+count);
+            tris+=count/3;
+        }
+
+        if(tris>=prev_tris*0.95f)
+        {
+            printf("mesh %d: lod %d %u triangles, not enough reduction, stopped\n",mesh_idx,lod,tris);
+            break;
+        }
+
+        printf("mesh %d: lod %d %u triangles\n",mesh_idx,lod,tris);
+        c.lods.push_back(l);
+        prev_tris=tris;
+    }
+
+    indices_buf.resize(indices.size()*sizeof(t));
+    memcpy(&indices_buf[0],&indices[0],indices_buf.size());
+    c.indices_count=(unsigned int)indices.size();
+    c.indices_data=&indices_buf[0];
+    return true;
+}
+
+int main(int argc,char *argv[])
+{
+    options o;
+    o.lods=3;
+    o.ratio=0.5f;
+    o.error=0.02f;
+    o.screen_size=256.0f;
+    std::vector<std::string> files;
+
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-lods")==0 && i+1<argc)
+            o.lods=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-ratio")==0 && i+1<argc)
+            o.ratio=(float)atof(argv[++i]);
+        else if(strcmp(argv[i],"-error")==0 && i+1<argc)
+            o.error=(float)atof(argv[++i]);
+        else if(strcmp(argv[i],"-screen_size")==0 && i+1<argc)
+            o.screen_size=(float)atof(argv[++i]);
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.size()!=2)
+    {
+        fprintf(stderr,"Error: src and dst files not specified\n");
+        printf("%s",help);
+        return -1;
+    }
+
+    if(!(o.ratio>0.0f && o.ratio<1.0f))
+    {
+        fprintf(stderr,"Error: ratio should be between 0 and 1\n");
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    FILE *in=fopen(files[0].c_str(),"rb");
+    if(!in)
+    {
+        fprintf(stderr,"Error: unable to open %s\n",files[0].c_str());
+        return -1;
+    }
+
+    fseek(in,0,SEEK_END);
+    std::vector<char> src(ftell(in));
+    fseek(in,0,SEEK_SET);
+    const bool read=src.empty() || fread(&src[0],1,src.size(),in)==src.size();
+    fclose(in);
+
+    nya_formats::nms nms;
+    if(!read || src.empty() || !nms.read_chunks_info(&src[0],src.size()))
+    {
+        fprintf(stderr,"Error: unable to read nms %s\n",files[0].c_str());
+        return -1;
+    }
+
+    std::vector<std::vector<char> > chunks(nms.chunks.size()+1);
+    int lods_count=0,general_idx= -1;
+    for(size_t i=0,mesh_idx=0;i<nms.chunks.size();++i)
+    {
+        nya_formats::nms::chunk_info &ci=nms.chunks[i];
+        if(ci.type==nya_formats::nms::general)
+            general_idx=int(i);
+
+        if(ci.type==nya_formats::nms::skeleton)
+        {
+            nya_formats::nms_skeleton_chunk sk;
+            if(!sk.read(ci.data,ci.size,nms.version))
+            {
+                fprintf(stderr,"Error: invalid skeleton chunk %d\n",int(i));
+                return -1;
+            }
+
+            chunks[i].resize(sk.get_chunk_size());
+            chunks[i].resize(sk.write_to_buf(&chunks[i][0],chunks[i].size()));
+            ci.data=&chunks[i][0];
+            ci.size=(unsigned int)chunks[i].size();
+            continue;
+        }
+
+        if(ci.type!=nya_formats::nms::mesh_data)
+            continue;
+
+        nya_formats::nms_mesh_chunk c;
+        if(!c.read_header(ci.data,ci.size,nms.version))
+        {
+            fprintf(stderr,"Error: invalid mesh chunk %d\n",int(i));
+            return -1;
+        }
+
+        if(c.lods.empty() || !c.indices_count || c.index_size==nya_formats::nms_mesh_chunk::no_indices)
+        {
+            printf("mesh %d: no indexed groups, skipped\n",int(mesh_idx++));
+            continue;
+        }
+
+        std::vector<char> indices;
+        const bool result=c.index_size==nya_formats::nms_mesh_chunk::index2b?generate<unsigned short>(c,indices,o,int(mesh_idx)):
+                                                                              generate<unsigned int>(c,indices,o,int(mesh_idx));
+        if(!result)
+            return -1;
+
+        ++mesh_idx;
+        if((int)c.lods.size()-1>lods_count)
+            lods_count=(int)c.lods.size()-1;
+
+        chunks[i].resize(c.get_chunk_size());
+        chunks[i].resize(c.write_to_buf(&chunks[i][0],chunks[i].size()));
+        ci.data=&chunks[i][0];
+        ci.size=(unsigned int)chunks[i].size();
+    }
+
+    //switch sizes go to general objects named lod1, lod2... of type lod, as nya_scene::mesh reads them
+    nya_formats::nms_general_chunk general;
+    if(general_idx>=0 && !general.read(nms.chunks[general_idx].data,nms.chunks[general_idx].size,nms.version))
+    {
+        fprintf(stderr,"Error: invalid general chunk\n");
+        return -1;
+    }
+
+    for(size_t i=0;i<general.objects.size();)
+    {
+        if(general.objects[i].type=="lod")
+            general.objects.erase(general.objects.begin()+i);
+        else
+            ++i;
+    }
+
+    float screen_size=o.screen_size;
+    for(int i=1;i<=lods_count;++i,screen_size*=0.5f)
+    {
+        char name[16];
+        sprintf(name,"lod%d",i);
+        nya_formats::nms_general_chunk::object obj;
+        obj.name=name;
+        obj.type="lod";
+        obj.add_vector_param("screen_size",nya_math::vec4(screen_size,0.0f,0.0f,0.0f));
+        general.objects.push_back(obj);
+    }
+
+    if(general_idx<0 && !general.objects.empty())
+    {
+        general_idx=(int)nms.chunks.size();
+        nya_formats::nms::chunk_info ci;
+        ci.type=nya_formats::nms::general;
+        nms.chunks.push_back(ci);
+    }
+
+    if(general_idx>=0)
+    {
+        std::vector<char> &buf=chunks.back();
+        buf.resize(general.get_chunk_size());
+        buf.resize(general.write_to_buf(buf.empty()?0:&buf[0],buf.size()));
+        nms.chunks[general_idx].data=buf.empty()?0:&buf[0];
+        nms.chunks[general_idx].size=(unsigned int)buf.size();
+    }
+
+    //mesh and skeleton chunks are written in the latest format, other chunks don't depend on version
+    nms.version=nya_formats::nms::latest_version;
+    std::vector<char> dst(nms.get_nms_size());
+    dst.resize(nms.write_to_buf(&dst[0],dst.size()));
+    if(dst.empty())
+    {
+        fprintf(stderr,"Error: unable to write nms\n");
+        return -1;
+    }
+
+    FILE *out=fopen(files[1].c_str(),"wb");
+    if(!out)
+    {
+        fprintf(stderr,"Error: unable to write %s\n",files[1].c_str());
+        return -1;
+    }
+
+    fwrite(&dst[0],1,dst.size(),out);
+    fclose(out);
+    return 0;
+}
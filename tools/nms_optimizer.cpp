@@ -0,0 +1,206 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "log/log.h"
+#include "formats/nms.h"
+#include "render/mesh_optimize.h"
+
+const char *help="Usage: nms_optimizer [options] %%src.nms%% %%dst.nms%%\n"
+                 "reorders triangles of each mesh group for vertex cache and overdraw and vertices for fetch,\n"
+                 "prints acmr and atvr per group before and after to stdout, errors begin with Error:\n"
+                 "options:\n"
+                 "-threshold %%value%% - allowed acmr increase for overdraw ordering, 1.05 by default\n"
+                 "-no_overdraw - vertex cache ordering only\n"
+                 "-cache_size %%verts%% - fifo size for the report, 16 by default\n"
+                 "\n";
+
+struct options
+{
+    float threshold;
+    bool overdraw;
+    unsigned int cache_size;
+};
+
+template<typename t> void optimize(nya_formats::nms_mesh_chunk &c,std::vector<char> &verts,t *indices,const options &o,int mesh_idx)
+{
+    const nya_formats::nms_mesh_chunk::element *pos=0;
+    for(size_t i=0;i<c.elements.size();++i)
+    {
+        const nya_formats::nms_mesh_chunk::element &e=c.elements[i];
+        if(e.type==nya_formats::nms_mesh_chunk::pos && e.data_type==nya_formats::nms_mesh_chunk::float32 &&
+           e.dimension>=3 && e.offset+3*sizeof(float)<=c.vertex_stride)
+            pos=&e;
+    }
+
+    if(o.overdraw && !pos)
+        fprintf(stderr,"Warning: mesh %d has no float32 positions, overdraw ordering skipped\n",mesh_idx);
+
+    std::vector<nya_render::vertex_cache_stats> before;
+    for(size_t i=0;i<c.lods.size();++i)
+    {
+        for(size_t j=0;j<c.lods[i].groups.size();++j)
+        {
+            const nya_formats::nms_mesh_chunk::group &g=c.lods[i].groups[j];
+            if(g.element_type!=nya_formats::nms_mesh_chunk::triangles || g.offset+g.count>c.indices_count)
+                continue;
+
+            t *gi=indices+g.offset;
+            before.push_back(nya_render::analyze_vertex_cache(gi,g.count,c.verts_count,o.cache_size));
+            nya_render::optimize_vertex_cache(gi,g.count,c.verts_count);
+            if(o.overdraw && pos)
+                nya_render::optimize_overdraw(gi,g.count,&verts[pos->offset],c.vertex_stride,c.verts_count,o.threshold);
+        }
+    }
+
+    const unsigned int used=nya_render::optimize_vertex_fetch(&verts[0],c.vertex_stride,c.verts_count,indices,c.indices_count);
+    if(used<c.verts_count)
+        printf("mesh %d: %u of %u vertices unused\n",mesh_idx,c.verts_count-used,c.verts_count);
+
+    for(size_t i=0,k=0;i<c.lods.size();++i)
+    {
+        for(size_t j=0;j<c.lods[i].groups.size();++j)
+        {
+            const nya_formats::nms_mesh_chunk::group &g=c.lods[i].groups[j];
+            if(g.element_type!=nya_formats::nms_mesh_chunk::triangles || g.offset+g.count>c.indices_count)
+                continue;
+
+            const nya_render::vertex_cache_stats after=nya_render::analyze_vertex_cache(indices+g.offset,g.count,c.verts_count,o.cache_size);
+            printf("mesh %d lod %d group %d '%s': %u triangles, acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+                   mesh_idx,int(i),int(j),g.name.c_str(),g.count/3,before[k].acmr,after.acmr,before[k].atvr,after.atvr);
+            ++k;
+        }
+    }
+}
+
+int main(int argc,char *argv[])
+{
+    options o;
+    o.threshold=1.05f;
+    o.overdraw=true;
+    o.cache_size=16;
+    std::vector<std::string> files;
+
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-threshold")==0 && i+1<argc)
+            o.threshold=(float)atof(argv[++i]);
+        else if(strcmp(argv[i],"-no_overdraw")==0)
+            o.overdraw=false;
+        else if(strcmp(argv[i],"-cache_size")==0 && i+1<argc)
+            o.cache_size=(unsigned int)atoi(argv[++i]);
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.size()!=2)
+    {
+        fprintf(stderr,"Error: src and dst files not specified\n");
+        printf("%s",help);
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    FILE *in=fopen(files[0].c_str(),"rb");
+    if(!in)
+    {
+        fprintf(stderr,"Error: unable to open %s\n",files[0].c_str());
+        return -1;
+    }
+
+    fseek(in,0,SEEK_END);
+    std::vector<char> src(ftell(in));
+    fseek(in,0,SEEK_SET);
+    const bool read=src.empty() || fread(&src[0],1,src.size(),in)==src.size();
+    fclose(in);
+
+    nya_formats::nms nms;
+    if(!read || src.empty() || !nms.read_chunks_info(&src[0],src.size()))
+    {
+        fprintf(stderr,"Error: unable to read nms %s\n",files[0].c_str());
+        return -1;
+    }
+
+    std::vector<std::vector<char> > chunks(nms.chunks.size());
+    for(size_t i=0,mesh_idx=0;i<nms.chunks.size();++i)
+    {
+        nya_formats::nms::chunk_info &ci=nms.chunks[i];
+        if(ci.type==nya_formats::nms::skeleton)
+        {
+            nya_formats::nms_skeleton_chunk sk;
+            if(!sk.read(ci.data,ci.size,nms.version))
+            {
+                fprintf(stderr,"Error: invalid skeleton chunk %d\n",int(i));
+                return -1;
+            }
+
+            chunks[i].resize(sk.get_chunk_size());
+            chunks[i].resize(sk.write_to_buf(&chunks[i][0],chunks[i].size()));
+            ci.data=&chunks[i][0];
+            ci.size=(unsigned int)chunks[i].size();
+            continue;
+        }
+
+        if(ci.type!=nya_formats::nms::mesh_data)
+            continue;
+
+        nya_formats::nms_mesh_chunk c;
+        if(!c.read_header(ci.data,ci.size,nms.version))
+        {
+            fprintf(stderr,"Error: invalid mesh chunk %d\n",int(i));
+            return -1;
+        }
+
+        if(!c.verts_count || !c.indices_count || c.index_size==nya_formats::nms_mesh_chunk::no_indices)
+        {
+            printf("mesh %d: no indices, skipped\n",int(mesh_idx++));
+            continue;
+        }
+
+        std::vector<char> verts((const char *)c.vertices_data,(const char *)c.vertices_data+size_t(c.vertex_stride)*c.verts_count);
+        std::vector<char> indices((const char *)c.indices_data,(const char *)c.indices_data+size_t(c.index_size)*c.indices_count);
+        if(c.index_size==nya_formats::nms_mesh_chunk::index2b)
+            optimize(c,verts,(unsigned short *)&indices[0],o,int(mesh_idx++));
+        else
+            optimize(c,verts,(unsigned int *)&indices[0],o,int(mesh_idx++));
+
+        c.vertices_data=&verts[0];
+        c.indices_data=&indices[0];
+
+        chunks[i].resize(c.get_chunk_size());
+        chunks[i].resize(c.write_to_buf(&chunks[i][0],chunks[i].size()));
+        ci.data=&chunks[i][0];
+        ci.size=(unsigned int)chunks[i].size();
+    }
+
+    //mesh and skeleton chunks are written in the latest format, other chunks don't depend on version
+    nms.version=nya_formats::nms::latest_version;
+    std::vector<char> dst(nms.get_nms_size());
+    dst.resize(nms.write_to_buf(&dst[0],dst.size()));
+    if(dst.empty())
+    {
+        fprintf(stderr,"Error: unable to write nms\n");
+        return -1;
+    }
+
+    FILE *out=fopen(files[1].c_str(),"wb");
+    if(!out)
+    {
+        fprintf(stderr,"Error: unable to write %s\n",files[1].c_str());
+        return -1;
+    }
+
+    fwrite(&dst[0],1,dst.size(),out);
+    fclose(out);
+    return 0;
+}
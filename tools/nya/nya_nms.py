@@ -21,7 +21,7 @@ class nms_container:
             print("unable to open file ", file_name)
             return
 
-        if f.read(8) != "nya mesh":
+        if f.read(8) != b"nya mesh":
             print("invalid nms file ", file_name)
             return
 
@@ -35,9 +35,17 @@ class nms_container:
             c = nms_container.nms_chunk()
             c.type = read_uint(f)
             size = read_uint(f)
+            f.read(nms_container.get_padding(f.tell(), self.version))
             c.data = f.read(size)
             self.chunks.append(c)
 
+    #since version 3 chunk data is 16 bytes aligned in the file
+    @staticmethod
+    def get_padding( offset, version ):
+        if version < 3:
+            return 0
+        return (16 - offset % 16) % 16
+
     def write( self, file_name ):
         f = open(file_name,"wb")
         if f == 0:
@@ -51,6 +59,7 @@ class nms_container:
         for c in self.chunks:
             out.add_uint(c.type)
             out.add_uint(len(c.data))
+            out.data += b'\x00' * nms_container.get_padding(len(out.data), self.version)
             out.data += c.data
 
         f.write(out.data)
@@ -167,9 +176,174 @@ class nms_mesh:
         self.materials = []
         self.joints = []
 
+    #version 3 chunks are fixed size records with a string table and 16 bytes aligned vertex and index data,
+    #see nya_formats::nms_v3
+    class string_table:
+        def __init__( self ):
+            self.data = bytes()
+
+        def add( self, s ):
+            offset = len(self.data)
+            self.data += str(s).encode() + b'\x00'
+            return offset
+
+    @staticmethod
+    def pad( buf ):
+        buf.data += b'\x00' * ((16 - len(buf.data) % 16) % 16)
+
+    def get_materials_chunk(self):
+        buf = bin_data()
+        buf.add_ushort(len(self.materials))
+        for m in self.materials:
+            buf.add_string(m.name)
+            buf.add_ushort(len(m.textures))
+            for tex in m.textures:
+                buf.add_string(tex.name)
+                buf.add_string(tex.value)
+
+            params=m.params
+            buf.add_ushort(len(params))
+            for p in params:
+                buf.add_string(p.name)
+                buf.add_string(p.value)
+
+            vec_params=m.vec_params
+            buf.add_ushort(len(vec_params))
+            for p in vec_params:
+                buf.add_string(p.name)
+                buf.add_float(p.x)
+                buf.add_float(p.y)
+                buf.add_float(p.z)
+                buf.add_float(p.w)
+
+            buf.add_ushort(0) #ToDo: integer params
+
+        c = nms_container.nms_chunk()
+        c.type = 2 #materials
+        c.data = buf.data
+        return c
+
     def write(self, file_name):
         out = nms_container()
-        out.version = 1  #ToDo: version 2
+        out.version = 3
+
+        mat_count = len(self.materials)
+        jcount = len(self.joints)
+
+        #---------------- mesh data -----------------
+
+        if self.vcount > 0:
+            strings = nms_mesh.string_table()
+
+            lods_count = 1
+            header_size = 6*4 + 12*4
+            element_size = 12
+            elements_offset = header_size
+            lods_offset = elements_offset + len(self.vert_attr)*element_size
+            groups_offset = lods_offset + lods_count*8
+
+            records = bin_data()
+            stride = 0
+            for a in self.vert_attr:
+                records.add_uchar(a.type)
+                records.add_uchar(a.dimension)
+                records.add_uchar(1) #float32
+                records.add_uchar(0)
+                records.add_uint(stride)
+                records.add_uint(strings.add(a.semantics))
+                stride += a.dimension*4
+
+            records.add_uint(len(self.groups))
+            records.add_uint(groups_offset)
+            for g in self.groups:
+                for j in range(6): #ToDo: aabb
+                    records.add_float(0)
+                records.add_uint(strings.add(g.name))
+                records.add_uint(g.mat_idx)
+                records.add_uint(g.offset)
+                records.add_uint(g.count)
+                records.add_uint(0) #triangles
+                records.add_uint(0)
+
+            strings_offset = header_size + len(records.data)
+            vertices_offset = strings_offset + len(strings.data)
+            vertices_offset += (16 - vertices_offset % 16) % 16
+
+            icount = len(self.indices)
+            index_size = 0 if icount == 0 else (4 if icount > 65535 else 2)
+            indices_offset = 0
+            if index_size > 0:
+                indices_offset = vertices_offset + self.vcount*stride
+                indices_offset += (16 - indices_offset % 16) % 16
+
+            buf = bin_data()
+            for i in range(6): #ToDo: aabb
+                buf.add_float(0)
+            buf.add_uint(len(self.vert_attr))
+            buf.add_uint(elements_offset)
+            buf.add_uint(stride)
+            buf.add_uint(self.vcount)
+            buf.add_uint(vertices_offset)
+            buf.add_uint(index_size)
+            buf.add_uint(icount)
+            buf.add_uint(indices_offset)
+            buf.add_uint(lods_count)
+            buf.add_uint(lods_offset)
+            buf.add_uint(strings_offset)
+            buf.add_uint(len(strings.data))
+            buf.data += records.data + strings.data
+
+            nms_mesh.pad(buf)
+            buf.add_floats(self.verts_data)
+            if index_size == 4:
+                nms_mesh.pad(buf)
+                buf.add_uints(self.indices)
+            elif index_size == 2:
+                nms_mesh.pad(buf)
+                buf.add_ushorts(self.indices)
+
+            c = nms_container.nms_chunk()
+            c.type = 0 #mesh
+            c.data = buf.data
+            out.chunks.append(c)
+
+        if mat_count > 0:
+            out.chunks.append(self.get_materials_chunk())
+
+        #-------------- skeleton data ---------------
+
+        if jcount > 0:
+            strings = nms_mesh.string_table()
+            bones = bin_data()
+            for j in self.joints:
+                bones.add_float(j.rot.v.x)
+                bones.add_float(j.rot.v.y)
+                bones.add_float(j.rot.v.z)
+                bones.add_float(j.rot.w)
+                bones.add_float(j.pos.x)
+                bones.add_float(j.pos.y)
+                bones.add_float(j.pos.z)
+                bones.add_int(j.parent)
+                bones.add_uint(strings.add(j.name))
+
+            buf = bin_data()
+            buf.add_uint(jcount)
+            buf.add_uint(16)
+            buf.add_uint(16 + len(bones.data))
+            buf.add_uint(len(strings.data))
+            buf.data += bones.data + strings.data
+
+            c = nms_container.nms_chunk()
+            c.type = 1 #skeleton
+            c.data = buf.data
+            out.chunks.append(c)
+
+        out.write(file_name)
+
+    #for engine builds without version 3 support
+    def write_v1(self, file_name):
+        out = nms_container()
+        out.version = 1
 
         mat_count = len(self.materials)
         jcount = len(self.joints)
@@ -220,39 +394,8 @@ class nms_mesh:
             c.data = buf.data
             out.chunks.append(c)
 
-        #-------------- materials data ---------------
-
         if mat_count > 0:
-            buf = bin_data()
-            buf.add_ushort(mat_count)
-            for m in self.materials:
-                buf.add_string(m.name)
-                buf.add_ushort(len(m.textures))
-                for tex in m.textures:
-                    buf.add_string(tex.name)
-                    buf.add_string(tex.value)
-
-                params=m.params
-                buf.add_ushort(len(params))
-                for p in params:
-                    buf.add_string(p.name)
-                    buf.add_string(p.value)
-
-                vec_params=m.vec_params
-                buf.add_ushort(len(vec_params))
-                for p in vec_params:
-                    buf.add_string(p.name)
-                    buf.add_float(p.x)
-                    buf.add_float(p.y)
-                    buf.add_float(p.z)
-                    buf.add_float(p.w)
-
-                buf.add_ushort(0) #ToDo: integer params
-
-            c = nms_container.nms_chunk()
-            c.type = 2 #materials
-            c.data = buf.data
-            out.chunks.append(c)
+            out.chunks.append(self.get_materials_chunk())
 
         #-------------- skeleton data ---------------
 
@@ -0,0 +1,223 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+//desktop opengl only, checks the gl state cache through render_buffered
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <gl/gl.h>
+#elif defined __APPLE__
+    #include <OpenGL/gl.h>
+#else
+    #include <GL/gl.h>
+#endif
+
+#include <stdio.h>
+#include "log/log.h"
+#include "system/app.h"
+#include "render/render.h"
+#include "render/render_buffered.h"
+#include "render/render_opengl.h"
+#include "render/shader.h"
+#include "render/vbo.h"
+#include "render/fbo.h"
+#include "render/texture.h"
+#include "render/statistics.h"
+
+const char *help="Usage: render_state_check\n"
+                 "draws through render_buffered over the opengl backend and prints the state changes count,\n"
+                 "then checks that cached state is reset on target switches, shader release and render api switch\n"
+                 "returns non-zero if a check fails\n"
+                 "\n";
+
+const char *vs_code="void main() { gl_Position=vec4(gl_Vertex.xy,0.0,1.0); }";
+const char *texture_ps_code="uniform sampler2D base; void main() { gl_FragColor=texture2D(base,vec2(0.5)); }";
+const char *green_ps_code="void main() { gl_FragColor=vec4(0.0,1.0,0.0,1.0); }";
+
+const float quad[]={-1.0f,-1.0f, 1.0f,-1.0f, 1.0f,1.0f, -1.0f,-1.0f, 1.0f,1.0f, -1.0f,1.0f};
+
+class render_state_check: public nya_system::app
+{
+public:
+    render_state_check(): m_failed(0) {}
+    int get_failed_count() const { return m_failed; }
+
+private:
+    void on_init()
+    {
+        nya_render::render_buffered buffered(nya_render::render_opengl::get());
+        m_buffered=&buffered;
+        if(!nya_render::set_render_api(&buffered))
+        {
+            fail("render_buffered over opengl is not available");
+            finish();
+            return;
+        }
+
+        nya_render::set_viewport(0,0,64,64);
+
+        nya_render::shader sh;
+        sh.add_program(nya_render::shader::vertex,vs_code);
+        sh.add_program(nya_render::shader::pixel,texture_ps_code);
+
+        nya_render::vbo quad_vbo;
+        quad_vbo.set_vertex_data(quad,sizeof(float)*2,6);
+        quad_vbo.set_vertices(0,2);
+
+        unsigned char red[4*4*4];
+        for(int i=0;i<16;++i)
+            red[i*4]=255,red[i*4+1]=0,red[i*4+2]=0,red[i*4+3]=255;
+
+        nya_render::texture tex,depth_a,depth_c,color;
+        tex.build_texture(red,4,4,nya_render::texture::color_rgba);
+        depth_a.build_texture(0,64,64,nya_render::texture::depth16);
+        depth_c.build_texture(0,64,64,nya_render::texture::depth16);
+        color.build_texture(0,64,64,nya_render::texture::color_rgba);
+
+        nya_render::fbo target_a,target_c,target_color;
+        target_a.set_depth_target(depth_a);
+        target_c.set_depth_target(depth_c);
+        target_color.set_color_target(color);
+        flush();
+
+        //the first draw applies the whole state, the rest are filtered
+        const nya_render::statistics &stats=nya_render::statistics::get();
+        nya_render::statistics::begin_frame();
+        sh.bind();
+        quad_vbo.bind();
+        tex.bind(0);
+        nya_render::vbo::draw();
+        flush();
+        const unsigned int full_state_changes=stats.state_changes;
+
+        for(int i=1;i<100;++i)
+        {
+            sh.bind();
+            quad_vbo.bind();
+            tex.bind(0);
+            nya_render::vbo::draw();
+        }
+        flush();
+
+        printf("100 identical draws: %u state changes, %u skipped\n",stats.state_changes,stats.state_changes_skipped);
+        if(stats.state_changes!=full_state_changes)
+            fail("identical draws are not filtered");
+
+        //draw and read buffers are per framebuffer, so they must survive switching through other targets
+        target_a.bind();
+        nya_render::clear(false,true,false);
+        nya_render::vbo::draw();
+        flush();
+        nya_render::fbo::unbind();
+        nya_render::vbo::draw();
+        flush();
+        target_color.bind();
+        nya_render::vbo::draw();
+        flush();
+        target_c.bind();
+        nya_render::clear(false,true,false);
+        nya_render::vbo::draw();
+        flush();
+
+        GLint draw_buffer=0;
+        glGetIntegerv(GL_DRAW_BUFFER,&draw_buffer);
+        if(draw_buffer!=GL_NONE)
+            fail("depth-only target has a draw buffer after target switches");
+        nya_render::fbo::unbind();
+
+        //the released shader index is reused by the next shader
+        sh.bind();
+        quad_vbo.bind();
+        nya_render::vbo::draw();
+        flush();
+        sh.release();
+
+        nya_render::shader green;
+        green.add_program(nya_render::shader::vertex,vs_code);
+        green.add_program(nya_render::shader::pixel,green_ps_code);
+        green.bind();
+        quad_vbo.bind();
+        nya_render::vbo::draw();
+        flush();
+        if(!check_pixel(0,255,0))
+            fail("stale shader after shader release");
+
+        nya_render::shader::unbind();
+        nya_render::texture::unbind(0);
+        nya_render::vbo::unbind();
+        target_a.release(),target_c.release(),target_color.release();
+        tex.release(),depth_a.release(),depth_c.release(),color.release();
+        green.release();
+        quad_vbo.release();
+        flush();
+
+        //resources can't be shared between apis, the switch itself must reset the cache
+        nya_render::set_render_api(nya_render::render_api_opengl);
+        nya_render::statistics::begin_frame();
+
+        nya_render::shader sh_gl;
+        sh_gl.add_program(nya_render::shader::vertex,vs_code);
+        sh_gl.add_program(nya_render::shader::pixel,texture_ps_code);
+
+        nya_render::vbo quad_vbo_gl;
+        quad_vbo_gl.set_vertex_data(quad,sizeof(float)*2,6);
+        quad_vbo_gl.set_vertices(0,2);
+
+        nya_render::texture tex_gl;
+        tex_gl.build_texture(red,4,4,nya_render::texture::color_rgba);
+
+        sh_gl.bind();
+        quad_vbo_gl.bind();
+        tex_gl.bind(0);
+        nya_render::vbo::draw();
+        printf("first draw after render api switch: %u state changes\n",stats.state_changes);
+        if(!check_pixel(255,0,0) || stats.state_changes<full_state_changes)
+            fail("cached state is kept after render api switch");
+
+        sh_gl.release();
+        quad_vbo_gl.release();
+        tex_gl.release();
+
+        printf("%s\n",m_failed?"failed":"passed");
+        finish();
+    }
+
+private:
+    void flush()
+    {
+        m_buffered->commit();
+        m_buffered->push();
+        m_buffered->execute();
+    }
+
+    bool check_pixel(unsigned char r,unsigned char g,unsigned char b)
+    {
+        unsigned char p[4]={0};
+        glReadPixels(32,32,1,1,GL_RGBA,GL_UNSIGNED_BYTE,p);
+        return p[0]==r && p[1]==g && p[2]==b;
+    }
+
+    void fail(const char *msg)
+    {
+        printf("Error: %s\n",msg);
+        ++m_failed;
+    }
+
+private:
+    nya_render::render_buffered *m_buffered;
+    int m_failed;
+};
+
+int main(int argc,char *argv[])
+{
+    if(argc>1)
+    {
+        printf("%s",help);
+        return -1;
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    render_state_check app;
+    app.start_windowed(100,100,64,64,0);
+    return app.get_failed_count()?1:0;
+}
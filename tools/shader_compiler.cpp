@@ -145,6 +145,7 @@ bool generate_cache( const char* dir_from,  const char* dir_to, bool recursive )
 
     nya_system::compiled_shaders_provider csp;
     csp.set_save_path((std::string(dir_to)+"\\").c_str());
+    csp.set_write_through(false); //saved once after all shaders
 
     nya_resources::file_resources_provider fp;
     nya_resources::set_resources_provider(&fp);
@@ -184,6 +185,12 @@ bool generate_cache( const char* dir_from,  const char* dir_to, bool recursive )
         }
     }
 
+    if(!csp.save())
+    {
+        fprintf(stderr,"Error: cannot write shaders cache to %s\n",dir_to);
+        return false;
+    }
+
     return true;
 }
 
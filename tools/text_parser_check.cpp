@@ -0,0 +1,271 @@
+//nya-engine (C) nyan.developer@gmail.com released under the MIT license (see LICENSE)
+
+//build with text_parser_reference.cpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <new>
+#include "log/log.h"
+#include "formats/text_parser.h"
+#include "resources/file_resources_provider.h"
+#include "system/system.h"
+#include "text_parser_reference.h"
+
+const char *help="Usage: text_parser_check [options] [%%folder%%]\n"
+                 "compares text_parser with the reference implementation on every .txt and .nsh file in the folder,\n"
+                 "current folder by default, and on random texts, then measures parse time of both\n"
+                 "options:\n"
+                 "-fuzz %%n%% - random texts count, 100000 by default\n"
+                 "-no_benchmark - only compare\n"
+                 "\n";
+
+static size_t allocations_count=0;
+
+void *operator new(size_t size)
+{
+    ++allocations_count;
+    void *p=malloc(size?size:1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+bool equal(const char *a,const char *b) { return a && b?strcmp(a,b)==0:a==b; }
+bool equal(const nya_math::vec4 &a,const nya_math::vec4 &b) { return memcmp(&a,&b,sizeof(a))==0; }
+
+//every accessor, including out of range indices
+const char *compare(const nya_formats::text_parser &a,const nya_formats_reference::text_parser &b)
+{
+    if(a.get_sections_count()!=b.get_sections_count())
+        return "sections count";
+
+    for(int i=-1;i<=a.get_sections_count();++i)
+    {
+        if(!equal(a.get_section_type(i),b.get_section_type(i)))
+            return "section type";
+
+        const char *type=a.get_section_type(i);
+        if(type && (a.is_section_type(i,type)!=b.is_section_type(i,type) ||
+                    (type[0] && a.is_section_type(i,type+1)!=b.is_section_type(i,type+1))))
+            return "is section type";
+
+        if(!equal(a.get_section_option(i),b.get_section_option(i)))
+            return "section option";
+
+        if(!equal(a.get_section_value(i),b.get_section_value(i)))
+            return "section value";
+
+        if(!equal(a.get_section_value_vec4(i),b.get_section_value_vec4(i)))
+            return "section vec4";
+
+        if(a.get_section_names_count(i)!=b.get_section_names_count(i))
+            return "section names count";
+
+        for(int j=-1;j<=a.get_section_names_count(i);++j)
+        {
+            if(!equal(a.get_section_name(i,j),b.get_section_name(i,j)))
+                return "section name";
+        }
+
+        if(a.get_subsections_count(i)!=b.get_subsections_count(i))
+            return "subsections count";
+
+        for(int j=-1;j<=a.get_subsections_count(i);++j)
+        {
+            if(!equal(a.get_subsection_type(i,j),b.get_subsection_type(i,j)))
+                return "subsection type";
+
+            if(!equal(a.get_subsection_value(i,j),b.get_subsection_value(i,j)))
+                return "subsection value";
+
+            if(a.get_subsection_value_int(i,j)!=b.get_subsection_value_int(i,j))
+                return "subsection int";
+
+            if(a.get_subsection_value_bool(i,j)!=b.get_subsection_value_bool(i,j))
+                return "subsection bool";
+
+            if(!equal(a.get_subsection_value_vec4(i,j),b.get_subsection_value_vec4(i,j)))
+                return "subsection vec4";
+
+            const char *subtype=a.get_subsection_type(i,j);
+            if(subtype && !equal(a.get_subsection_value(i,subtype),b.get_subsection_value(i,subtype)))
+                return "subsection value by type";
+        }
+    }
+
+    return 0;
+}
+
+const char *compare(const std::string &text)
+{
+    const nya_formats::text_parser a(text.c_str(),text.size());
+    const nya_formats_reference::text_parser b(text.c_str(),text.size());
+    return compare(a,b);
+}
+
+void print_escaped(const std::string &text)
+{
+    for(size_t i=0;i<text.size();++i)
+    {
+        if(text[i]=='\n')
+            printf("\\n");
+        else if(text[i]=='\r')
+            printf("\\r");
+        else
+            printf("%c",text[i]);
+    }
+    printf("\n");
+}
+
+//location-like text, large enough to time
+std::string generate_location(int objects_count)
+{
+    std::string text;
+    char buf[512];
+    for(int i=0;i<objects_count;++i)
+    {
+        sprintf(buf,"@object obj%d //placed by editor\n    mesh=\"meshes/m%d.nms\"\n    pos=%d.5,%d.25,%d\n"
+                    "    rot=0,%d,0\n    tags=static,shadow\n\n",i,i%50,i,i*2,i*3,i%360);
+        text.append(buf);
+    }
+
+    return text;
+}
+
+//ms per parse with every subsection accessed, at least 100 ms of runs
+template<typename parser> double measure(const std::string &text,size_t &allocations)
+{
+    static volatile size_t checksum=0;
+    int runs=0;
+    unsigned long time=0;
+    const size_t allocations_from=allocations_count;
+    const unsigned long start=nya_system::get_time();
+    while(time<100 || runs<3)
+    {
+        const parser p(text.c_str(),text.size());
+        for(int i=0;i<p.get_sections_count();++i)
+        {
+            for(int j=0;j<p.get_subsections_count(i);++j)
+                checksum+=strlen(p.get_subsection_value(i,j));
+        }
+
+        time=nya_system::get_time()-start;
+        ++runs;
+    }
+
+    allocations=(allocations_count-allocations_from)/runs;
+    return double(time)/runs;
+}
+
+void benchmark(const char *name,const std::string &text)
+{
+    size_t allocations,reference_allocations;
+    const double ms=measure<nya_formats::text_parser>(text,allocations);
+    const double reference_ms=measure<nya_formats_reference::text_parser>(text,reference_allocations);
+    printf("%-20s %6d KB: reference %.3f ms %d allocations, text_parser %.3f ms %d allocations\n",name,int(text.size()/1024),
+           reference_ms,int(reference_allocations),ms,int(allocations));
+}
+
+int main(int argc,char *argv[])
+{
+    std::string folder=".";
+    int fuzz_count=100000;
+    bool do_benchmark=true;
+    for(int i=1;i<argc;++i)
+    {
+        if(strcmp(argv[i],"-fuzz")==0 && i+1<argc)
+            fuzz_count=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-no_benchmark")==0)
+            do_benchmark=false;
+        else if(argv[i][0]=='-')
+        {
+            fprintf(stderr,"Error: unknown option %s\n",argv[i]);
+            printf("%s",help);
+            return -1;
+        }
+        else
+            folder=argv[i];
+    }
+
+    nya_log::set_log(&nya_log::no_log());
+
+    nya_resources::file_resources_provider files;
+    if(!files.set_folder(folder.c_str()))
+    {
+        fprintf(stderr,"Error: unable to open folder %s\n",folder.c_str());
+        return -1;
+    }
+
+    int failed=0,checked=0;
+    std::string assets;
+    for(int i=0;i<files.get_resources_count();++i)
+    {
+        const std::string name=files.get_resource_name(i);
+        const size_t ext=name.rfind('.');
+        if(ext==std::string::npos || (name.compare(ext,std::string::npos,".txt")!=0 && name.compare(ext,std::string::npos,".nsh")!=0))
+            continue;
+
+        nya_resources::resource_data *data=files.access(name.c_str());
+        if(!data)
+            continue;
+
+        std::string text(data->get_size(),0);
+        if(!text.empty())
+            data->read_all(&text[0]);
+        data->release();
+
+        ++checked;
+        assets.append(text).append("\n");
+        const char *mismatch=compare(text);
+        if(mismatch)
+        {
+            printf("%s: %s mismatch\n",name.c_str(),mismatch);
+            ++failed;
+        }
+    }
+
+    printf("files: %d checked, %d mismatched\n",checked,failed);
+
+    //random texts made of the characters the parser treats specially
+    const char alphabet[]="@@@===::\"\"//**\n\n\n\r  \t\tabcxyz0123456789-.,";
+    unsigned int seed=1;
+    int fuzz_failed=0;
+    for(int i=0;i<fuzz_count;++i)
+    {
+        std::string text="ab\n";
+        seed=seed*1103515245+12345;
+        const int length=int((seed>>16)%(i%10==0?3000:120));
+        for(int j=0;j<length;++j)
+        {
+            seed=seed*1103515245+12345;
+            text.push_back(alphabet[(seed>>16)%(sizeof(alphabet)-1)]);
+        }
+
+        const char *mismatch=compare(text);
+        if(!mismatch)
+            continue;
+
+        if(++fuzz_failed<=5)
+        {
+            printf("%s mismatch: ",mismatch);
+            print_escaped(text);
+        }
+    }
+
+    printf("random texts: %d checked, %d mismatched\n",fuzz_count,fuzz_failed);
+
+    if(do_benchmark)
+    {
+        if(!assets.empty())
+            benchmark("all checked files",assets);
+        benchmark("location 5000",generate_location(5000));
+        benchmark("location 20000",generate_location(20000));
+    }
+
+    return failed || fuzz_failed?1:0;
+}